@@ -7,6 +7,9 @@ CApp::CApp()
     isRunning = true;
     pWindow = NULL;
     pRenderer = NULL;
+    pTexture = NULL;
+    m_xSize = 1280;
+    m_ySize = 720;
 }
 
 bool CApp::OnInit() {
@@ -14,18 +17,28 @@ bool CApp::OnInit() {
         return false;
     }
 
-    pWindow = SDL_CreateWindow("YADAYAD", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1280, 720, SDL_WINDOW_SHOWN);
+    pWindow = SDL_CreateWindow("YADAYAD", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, m_xSize, m_ySize, SDL_WINDOW_SHOWN);
 
     if (pWindow != NULL) {
         pRenderer = SDL_CreateRenderer(pWindow, -1, 0);
-        // Init the image
-        m_image.Initialize(1280, 720, pRenderer);
+        // the engine writes RGBA bytes in memory order, which RGBA32 names on either byte order
+        pTexture = SDL_CreateTexture(pRenderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, m_xSize, m_ySize);
+        // Init the frame buffers
+        m_hdrPixels.assign(static_cast<size_t>(m_xSize) * m_ySize * 3, 0.0f);
+        m_displayPixels.assign(static_cast<size_t>(m_xSize) * m_ySize, 0);
+        m_engine.SetFrameBuffer(m_xSize, m_ySize, m_hdrPixels.data(), m_displayPixels.data());
 
         SDL_SetRenderDrawColor(pRenderer, 255, 255, 255, 255);
         SDL_RenderClear(pRenderer);
-        m_scene.Render(m_image);
-        m_image.Display();
         SDL_RenderPresent(pRenderer);
+
+        // the frame is traced on its own thread, the tile callback only queues the rectangles for OnRender()
+        m_renderThread = std::thread([this]() {
+            m_engine.Render([this](int x0, int y0, int x1, int y1) {
+                std::lock_guard<std::mutex> lock(m_tileMutex);
+                m_finishedTiles.push_back(SDL_Rect{x0, y0, x1 - x0, y1 - y0});
+            });
+        });
     } else {
         return false;
     }
@@ -45,6 +58,8 @@ int CApp::OnExecute() {
         OnLoop();
         OnRender();
     }
+    OnExit();
+    return 0;
 }
 
 void CApp::OnEvent(SDL_Event *event) {
@@ -56,20 +71,34 @@ void CApp::OnEvent(SDL_Event *event) {
 void CApp::OnLoop() {}
 
 void CApp::OnRender() {
-/*     SDL_SetRenderDrawColor(pRenderer, 255, 255, 255, 255);
-    SDL_RenderClear(pRenderer);
-
-    // render scene
-    m_scene.Render(m_image);
-
-    // display image
-    m_image.Display();
+    {
+        std::lock_guard<std::mutex> lock(m_tileMutex);
+        m_uploadTiles.swap(m_finishedTiles);
+    }
+    if (m_uploadTiles.empty()) {
+        return;
+    }
 
-    // result
-    SDL_RenderPresent(pRenderer); */
+    // upload only the finished tiles, straight from the rows of the display buffer
+    for (const SDL_Rect &rect : m_uploadTiles) {
+        const uint32_t *firstPixel = m_displayPixels.data() + static_cast<size_t>(rect.y) * m_xSize + rect.x;
+        SDL_UpdateTexture(pTexture, &rect, firstPixel, m_xSize * static_cast<int>(sizeof(uint32_t)));
+    }
+    m_uploadTiles.clear();
+    SDL_RenderCopy(pRenderer, pTexture, NULL, NULL);
+    SDL_RenderPresent(pRenderer);
 }
 
 void CApp::OnExit() {
+    // the render thread writes into m_displayPixels, stop it before anything goes away
+    if (m_renderThread.joinable()) {
+        m_engine.Cancel();
+        m_renderThread.join();
+    }
+    if (pTexture != NULL) {
+        SDL_DestroyTexture(pTexture);
+        pTexture = NULL;
+    }
     SDL_DestroyRenderer(pRenderer);
     SDL_DestroyWindow(pWindow);
     pWindow = NULL;
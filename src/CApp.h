@@ -2,9 +2,13 @@
 #define CAPP_H
 
 #include <SDL2/SDL.h>
-#include "./waRayTrace/waImage.hpp"
-#include "./waRayTrace/scene.hpp"
-#include "./waRayTrace/camera.hpp"
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "./waRayTrace/engine.hpp"
+#include "./waRayTrace/linAlgModule/qbVector.h"
 class CApp {
     public:
         CApp();
@@ -17,12 +21,21 @@ class CApp {
     private:
         void PrintVector(const qbVector<double> &inputVector);
     private:
-        waImage m_image;
-        waRT::Scene m_scene;
+        // the engine renders straight into these, the texture is refreshed from m_displayPixels
+        waRT::Engine m_engine;
+        std::vector<float>    m_hdrPixels;
+        std::vector<uint32_t> m_displayPixels;
+        int m_xSize, m_ySize;
+        // tiles the render thread finished, uploaded and cleared by OnRender()
+        std::thread m_renderThread;
+        std::mutex m_tileMutex;
+        std::vector<SDL_Rect> m_finishedTiles;
+        std::vector<SDL_Rect> m_uploadTiles;
         // SDL2 STUFF
         bool isRunning;
         SDL_Window *pWindow;
         SDL_Renderer *pRenderer;
+        SDL_Texture *pTexture;
 };
 
-#endif
\ No newline at end of file
+#endif
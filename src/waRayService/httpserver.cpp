@@ -0,0 +1,245 @@
+/*
+    The `HttpServer` class is a minimal HTTP/1.1 server on top of POSIX sockets. It is only meant for the render service, which is reached by tools on the same machine, so it binds to the loopback address and keeps the protocol support small.
+
+    1. **Listening (`Listen`)**:
+       - Creates a TCP socket with `SO_REUSEADDR`, binds it to the given address (normally `127.0.0.1`) and port and starts listening. Returns `false` if any step fails, so the caller can report a port that is already in use.
+
+    2. **Serving (`Serve`)**:
+       - Blocks in an accept loop until `Stop()` is called. Every connection is handled on its own detached thread, so a slow client downloading an image does not hold up status polls. At most `MAX_CONNECTIONS` connections are handled at once, further ones get `503`.
+       - Each connection carries exactly one request (`Connection: close`). The request line, the headers and a body of `Content-Length` bytes are read, the path is split from its query string, and the handler's response is written back with its status, content type and extra headers.
+       - Requests with headers larger than 64 KiB or bodies larger than 16 MiB are rejected, and sockets have a receive timeout so an idle client cannot keep a thread forever.
+
+    3. **Stopping (`Stop`)**:
+       - Clears the running flag and shuts down the listening socket, which wakes the accept loop. Connections that are already being handled finish normally.
+       - `Stop()` is called from the daemon's signal handler, while `Serve()` is blocked in `accept()` on the same socket. So it only does async-signal-safe things: the socket and the flags are atomics, and it calls `shutdown()` but never `close()`. The socket is closed by `Serve()` once its loop has exited and `Stop()` has finished with it (`m_listenShutDown`), so the descriptor cannot be reused while `Stop()` still holds its number. The destructor closes it if `Serve()` never ran.
+*/
+
+#include "httpserver.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+constexpr int    MAX_CONNECTIONS  = 32;
+constexpr size_t MAX_HEADER_BYTES = 64 * 1024;
+constexpr size_t MAX_BODY_BYTES   = 16 * 1024 * 1024;
+constexpr int    RECEIVE_TIMEOUT  = 10;
+
+waRT::HttpServer::HttpServer() {
+    m_listenSocket = -1;
+    m_running = false;
+    // nothing to shut down until Listen() succeeds
+    m_listenShutDown = true;
+    m_activeConnections = 0;
+}
+
+waRT::HttpServer::~HttpServer() {
+    Stop();
+    CloseListenSocket();
+}
+
+bool waRT::HttpServer::Listen(const std::string &address, int port) {
+    int listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenSocket < 0) {
+        return false;
+    }
+
+    int enable = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    sockaddr_in socketAddress;
+    memset(&socketAddress, 0, sizeof(socketAddress));
+    socketAddress.sin_family = AF_INET;
+    socketAddress.sin_port   = htons(static_cast<uint16_t>(port));
+    if (inet_pton(AF_INET, address.c_str(), &socketAddress.sin_addr) != 1) {
+        close(listenSocket);
+        return false;
+    }
+
+    if ((bind(listenSocket, reinterpret_cast<sockaddr *>(&socketAddress), sizeof(socketAddress)) < 0) ||
+        (listen(listenSocket, 16) < 0)) {
+        close(listenSocket);
+        return false;
+    }
+
+    m_listenSocket   = listenSocket;
+    m_listenShutDown = false;
+    m_running        = true;
+    return true;
+}
+
+void waRT::HttpServer::Serve(const std::function<waRT::HttpResponse(const waRT::HttpRequest &)> &handler) {
+    while (m_running) {
+        int clientSocket = accept(m_listenSocket, nullptr, nullptr);
+        if (clientSocket < 0) {
+            if (!m_running) {
+                break;
+            }
+            continue;
+        }
+
+        timeval timeout;
+        timeout.tv_sec  = RECEIVE_TIMEOUT;
+        timeout.tv_usec = 0;
+        setsockopt(clientSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        if (m_activeConnections >= MAX_CONNECTIONS) {
+            waRT::HttpResponse busy;
+            busy.status = 503;
+            busy.body   = "{\"error\":\"too many connections\"}";
+            WriteResponse(clientSocket, busy);
+            close(clientSocket);
+            continue;
+        }
+
+        ++m_activeConnections;
+        std::thread(&waRT::HttpServer::HandleConnection, this, clientSocket, handler).detach();
+    }
+
+    // only Stop() ends the loop; wait until it is done with the socket before closing it
+    while (!m_listenShutDown) {
+        std::this_thread::yield();
+    }
+    CloseListenSocket();
+
+    // let detached connection threads finish before the server can be destroyed
+    while (m_activeConnections > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+void waRT::HttpServer::Stop() {
+    bool wasRunning = m_running.exchange(false);
+    if (wasRunning) {
+        int listenSocket = m_listenSocket;
+        if (listenSocket >= 0) {
+            shutdown(listenSocket, SHUT_RDWR);
+        }
+        m_listenShutDown = true;
+    }
+}
+
+// private funks
+
+void waRT::HttpServer::CloseListenSocket() {
+    int listenSocket = m_listenSocket.exchange(-1);
+    if (listenSocket >= 0) {
+        close(listenSocket);
+    }
+}
+
+void waRT::HttpServer::HandleConnection(int clientSocket, const std::function<waRT::HttpResponse(const waRT::HttpRequest &)> &handler) {
+    waRT::HttpRequest request;
+    if (ReadRequest(clientSocket, request)) {
+        WriteResponse(clientSocket, handler(request));
+    } else {
+        waRT::HttpResponse badRequest;
+        badRequest.status = 400;
+        badRequest.body   = "{\"error\":\"malformed request\"}";
+        WriteResponse(clientSocket, badRequest);
+    }
+    close(clientSocket);
+    --m_activeConnections;
+}
+
+bool waRT::HttpServer::ReadRequest(int clientSocket, waRT::HttpRequest &request) {
+    std::string data;
+    char buffer[4096];
+    size_t headerEnd = std::string::npos;
+
+    while (headerEnd == std::string::npos) {
+        ssize_t received = recv(clientSocket, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            return false;
+        }
+        data.append(buffer, static_cast<size_t>(received));
+        headerEnd = data.find("\r\n\r\n");
+        if ((headerEnd == std::string::npos) && (data.size() > MAX_HEADER_BYTES)) {
+            return false;
+        }
+    }
+
+    // request line
+    size_t lineEnd = data.find("\r\n");
+    std::string requestLine = data.substr(0, lineEnd);
+    size_t firstSpace  = requestLine.find(' ');
+    size_t secondSpace = requestLine.find(' ', firstSpace + 1);
+    if ((firstSpace == std::string::npos) || (secondSpace == std::string::npos)) {
+        return false;
+    }
+    request.method = requestLine.substr(0, firstSpace);
+    std::string target = requestLine.substr(firstSpace + 1, secondSpace - firstSpace - 1);
+    size_t queryStart = target.find('?');
+    request.path  = target.substr(0, queryStart);
+    request.query = (queryStart == std::string::npos) ? "" : target.substr(queryStart + 1);
+
+    // only Content-Length matters to us
+    size_t contentLength = 0;
+    size_t pos = lineEnd + 2;
+    while (pos < headerEnd) {
+        size_t next = data.find("\r\n", pos);
+        std::string line = data.substr(pos, next - pos);
+        size_t colon = line.find(':');
+        if (colon != std::string::npos) {
+            std::string name = line.substr(0, colon);
+            for (auto &c : name) {
+                c = static_cast<char>(tolower(c));
+            }
+            if (name == "content-length") {
+                contentLength = strtoul(line.c_str() + colon + 1, nullptr, 10);
+            }
+        }
+        pos = next + 2;
+    }
+    if (contentLength > MAX_BODY_BYTES) {
+        return false;
+    }
+
+    request.body = data.substr(headerEnd + 4);
+    while (request.body.size() < contentLength) {
+        ssize_t received = recv(clientSocket, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            return false;
+        }
+        request.body.append(buffer, static_cast<size_t>(received));
+    }
+    request.body.resize(contentLength);
+    return true;
+}
+
+void waRT::HttpServer::WriteResponse(int clientSocket, const waRT::HttpResponse &response) {
+    const char *reason = "OK";
+    switch (response.status) {
+        case 201: reason = "Created"; break;
+        case 202: reason = "Accepted"; break;
+        case 400: reason = "Bad Request"; break;
+        case 404: reason = "Not Found"; break;
+        case 405: reason = "Method Not Allowed"; break;
+        case 409: reason = "Conflict"; break;
+        case 503: reason = "Service Unavailable"; break;
+    }
+
+    std::string header = "HTTP/1.1 " + std::to_string(response.status) + " " + reason + "\r\n";
+    header += "Content-Type: " + response.contentType + "\r\n";
+    header += "Content-Length: " + std::to_string(response.body.size()) + "\r\n";
+    for (auto &extra : response.headers) {
+        header += extra.first + ": " + extra.second + "\r\n";
+    }
+    header += "Connection: close\r\n\r\n";
+
+    std::string out = header + response.body;
+    size_t sent = 0;
+    while (sent < out.size()) {
+        ssize_t written = send(clientSocket, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+        if (written <= 0) {
+            return;
+        }
+        sent += static_cast<size_t>(written);
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef HTTPSERVER_H
+#define HTTPSERVER_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace waRT {
+    struct HttpRequest {
+        std::string method;
+        std::string path;
+        std::string query;
+        std::string body;
+    };
+
+    struct HttpResponse {
+        int         status      = 200;
+        std::string contentType = "application/json";
+        std::string body;
+        std::vector<std::pair<std::string, std::string>> headers;
+    };
+
+    class HttpServer {
+    public:
+        HttpServer();
+        ~HttpServer();
+
+        bool Listen(const std::string &address, int port);
+        void Serve(const std::function<waRT::HttpResponse(const waRT::HttpRequest &)> &handler);
+        void Stop();
+
+    private:
+        void HandleConnection(int clientSocket, const std::function<waRT::HttpResponse(const waRT::HttpRequest &)> &handler);
+        static bool ReadRequest(int clientSocket, waRT::HttpRequest &request);
+        static void WriteResponse(int clientSocket, const waRT::HttpResponse &response);
+        void CloseListenSocket();
+
+    private:
+        // Stop() may run in a signal handler on another thread, so it only reads the socket and shuts it down
+        std::atomic<int>  m_listenSocket;
+        std::atomic<bool> m_running;
+        std::atomic<bool> m_listenShutDown;
+        std::atomic<int>  m_activeConnections;
+    };
+}
+
+#endif
@@ -0,0 +1,361 @@
+/*
+    The `JsonValue` class is a small JSON reader used by the render service to parse job requests. It only has to handle the short, trusted documents that a local pipeline sends, so it favours simplicity over speed.
+
+    1. **Parsing (`Parse`)**:
+       - A recursive descent parser for the full JSON grammar: null, booleans, numbers, strings (with escapes, `\u` escapes are decoded to UTF-8), arrays and objects.
+       - Nesting is limited to 64 levels so a malicious request cannot exhaust the stack. On failure `Parse` returns `false` and a short description with the byte offset.
+       - Numbers are matched against the JSON number grammar (`ScanNumber`) before `strtod` converts them, so `nan`, `inf`, hex floats, a leading `+` or `.` and the like are malformed input rather than numbers. A number too large for a double (`1e999`) is rejected as well, so no value that reaches the scene setters is NaN or infinite. A `\u` escape must be followed by four hex digits.
+
+    2. **Access**:
+       - `operator[]` with a key or an index never fails. A missing member, an out of range index or the wrong type gives a shared null value, so lookups like `job["camera"]["position"]` can be chained without checks.
+       - The typed getters (`GetBool`, `GetNumber`, `GetString`) return the given fallback if the value has a different type. `GetVector3` reads a three-element numeric array.
+       - `GetInt` is for numbers that end up in an `int`. It checks the double against the range before casting, as a cast of NaN or of a value outside the `int` range is undefined, and returns `false` (leaving the output alone) if the value is not a number in `[minValue, maxValue]`. Fractions are truncated, like the plain cast.
+
+    3. **Writing (`Escape`)**:
+       - Responses are built with plain string concatenation, and `Escape` quotes a string for safe inclusion.
+*/
+
+#include "json.hpp"
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+constexpr int MAX_JSON_DEPTH = 64;
+
+// the length of the JSON number at pos, -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?, or 0 if there is none
+static size_t ScanNumber(const std::string &text, size_t pos) {
+    auto isDigit = [&text](size_t i) { return (i < text.size()) && (text[i] >= '0') && (text[i] <= '9');};
+    size_t i = pos;
+    if ((i < text.size()) && (text[i] == '-')) {
+        ++i;
+    }
+    if (!isDigit(i)) {
+        return 0;
+    }
+    if (text[i] == '0') {
+        ++i;
+    } else {
+        while (isDigit(i)) {
+            ++i;
+        }
+    }
+    if ((i < text.size()) && (text[i] == '.')) {
+        ++i;
+        if (!isDigit(i)) {
+            return 0;
+        }
+        while (isDigit(i)) {
+            ++i;
+        }
+    }
+    if ((i < text.size()) && ((text[i] == 'e') || (text[i] == 'E'))) {
+        ++i;
+        if ((i < text.size()) && ((text[i] == '+') || (text[i] == '-'))) {
+            ++i;
+        }
+        if (!isDigit(i)) {
+            return 0;
+        }
+        while (isDigit(i)) {
+            ++i;
+        }
+    }
+    return i - pos;
+}
+
+waRT::JsonValue::JsonValue() {
+    m_type   = JSON_NULL;
+    m_bool   = false;
+    m_number = 0.0;
+}
+
+bool waRT::JsonValue::Parse(const std::string &text, waRT::JsonValue &result, std::string &error) {
+    size_t pos = 0;
+    result = JsonValue();
+    if (!result.ParseValue(text, pos, 0)) {
+        error = "invalid JSON near offset " + std::to_string(pos);
+        return false;
+    }
+    SkipSpace(text, pos);
+    if (pos != text.size()) {
+        error = "unexpected data after JSON value at offset " + std::to_string(pos);
+        return false;
+    }
+    return true;
+}
+
+std::string waRT::JsonValue::Escape(const std::string &text) {
+    std::string out = "\"";
+    for (unsigned char c : text) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n";  break;
+            case '\r': out += "\\r";  break;
+            case '\t': out += "\\t";  break;
+            default:
+                if (c < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    out += "\"";
+    return out;
+}
+
+// GETTERS
+waRT::JsonValue::Type waRT::JsonValue::GetType() const { return m_type;}
+bool waRT::JsonValue::IsNull() const { return m_type == JSON_NULL;}
+
+size_t waRT::JsonValue::Size() const {
+    if (m_type == JSON_ARRAY) {
+        return m_array.size();
+    }
+    if (m_type == JSON_OBJECT) {
+        return m_object.size();
+    }
+    return 0;
+}
+
+bool waRT::JsonValue::Has(const std::string &key) const {
+    for (auto &member : m_object) {
+        if (member.first == key) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool waRT::JsonValue::GetBool(bool fallback) const {
+    return (m_type == JSON_BOOL) ? m_bool : fallback;
+}
+
+double waRT::JsonValue::GetNumber(double fallback) const {
+    return (m_type == JSON_NUMBER) ? m_number : fallback;
+}
+
+bool waRT::JsonValue::GetInt(int minValue, int maxValue, int &value) const {
+    // the negated test also rejects NaN
+    if ((m_type != JSON_NUMBER) || !((m_number >= minValue) && (m_number <= maxValue))) {
+        return false;
+    }
+    value = static_cast<int>(m_number);
+    return true;
+}
+
+std::string waRT::JsonValue::GetString(const std::string &fallback) const {
+    return (m_type == JSON_STRING) ? m_string : fallback;
+}
+
+bool waRT::JsonValue::GetVector3(double out[3]) const {
+    if ((m_type != JSON_ARRAY) || (m_array.size() != 3)) {
+        return false;
+    }
+    for (int i = 0; i < 3; ++i) {
+        if (m_array[i].m_type != JSON_NUMBER) {
+            return false;
+        }
+    }
+    for (int i = 0; i < 3; ++i) {
+        out[i] = m_array[i].m_number;
+    }
+    return true;
+}
+
+const waRT::JsonValue &waRT::JsonValue::operator[] (const std::string &key) const {
+    static const JsonValue nullValue;
+    for (auto &member : m_object) {
+        if (member.first == key) {
+            return member.second;
+        }
+    }
+    return nullValue;
+}
+
+const waRT::JsonValue &waRT::JsonValue::operator[] (size_t index) const {
+    static const JsonValue nullValue;
+    if ((m_type == JSON_ARRAY) && (index < m_array.size())) {
+        return m_array[index];
+    }
+    return nullValue;
+}
+
+// private funks
+
+void waRT::JsonValue::SkipSpace(const std::string &text, size_t &pos) {
+    while ((pos < text.size()) && ((text[pos] == ' ') || (text[pos] == '\t') || (text[pos] == '\n') || (text[pos] == '\r'))) {
+        ++pos;
+    }
+}
+
+bool waRT::JsonValue::ParseString(const std::string &text, size_t &pos, std::string &out) {
+    if ((pos >= text.size()) || (text[pos] != '"')) {
+        return false;
+    }
+    ++pos;
+    out.clear();
+    while (pos < text.size()) {
+        char c = text[pos++];
+        if (c == '"') {
+            return true;
+        }
+        if (c != '\\') {
+            out += c;
+            continue;
+        }
+        if (pos >= text.size()) {
+            return false;
+        }
+        char escape = text[pos++];
+        switch (escape) {
+            case '"':  out += '"';  break;
+            case '\\': out += '\\'; break;
+            case '/':  out += '/';  break;
+            case 'b':  out += '\b'; break;
+            case 'f':  out += '\f'; break;
+            case 'n':  out += '\n'; break;
+            case 'r':  out += '\r'; break;
+            case 't':  out += '\t'; break;
+            case 'u': {
+                if (pos + 4 > text.size()) {
+                    return false;
+                }
+                for (size_t i = pos; i < pos + 4; ++i) {
+                    if (!isxdigit(static_cast<unsigned char>(text[i]))) {
+                        return false;
+                    }
+                }
+                unsigned long code = strtoul(text.substr(pos, 4).c_str(), nullptr, 16);
+                pos += 4;
+                if (code < 0x80) {
+                    out += static_cast<char>(code);
+                } else if (code < 0x800) {
+                    out += static_cast<char>(0xc0 | (code >> 6));
+                    out += static_cast<char>(0x80 | (code & 0x3f));
+                } else {
+                    out += static_cast<char>(0xe0 | (code >> 12));
+                    out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+                    out += static_cast<char>(0x80 | (code & 0x3f));
+                }
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return false;
+}
+
+bool waRT::JsonValue::ParseValue(const std::string &text, size_t &pos, int depth) {
+    if (depth > MAX_JSON_DEPTH) {
+        return false;
+    }
+    SkipSpace(text, pos);
+    if (pos >= text.size()) {
+        return false;
+    }
+
+    char c = text[pos];
+    if (c == '{') {
+        m_type = JSON_OBJECT;
+        ++pos;
+        SkipSpace(text, pos);
+        if ((pos < text.size()) && (text[pos] == '}')) {
+            ++pos;
+            return true;
+        }
+        while (true) {
+            std::string key;
+            SkipSpace(text, pos);
+            if (!ParseString(text, pos, key)) {
+                return false;
+            }
+            SkipSpace(text, pos);
+            if ((pos >= text.size()) || (text[pos] != ':')) {
+                return false;
+            }
+            ++pos;
+            JsonValue member;
+            if (!member.ParseValue(text, pos, depth + 1)) {
+                return false;
+            }
+            m_object.push_back({key, member});
+            SkipSpace(text, pos);
+            if ((pos < text.size()) && (text[pos] == ',')) {
+                ++pos;
+                continue;
+            }
+            if ((pos < text.size()) && (text[pos] == '}')) {
+                ++pos;
+                return true;
+            }
+            return false;
+        }
+    }
+    if (c == '[') {
+        m_type = JSON_ARRAY;
+        ++pos;
+        SkipSpace(text, pos);
+        if ((pos < text.size()) && (text[pos] == ']')) {
+            ++pos;
+            return true;
+        }
+        while (true) {
+            JsonValue element;
+            if (!element.ParseValue(text, pos, depth + 1)) {
+                return false;
+            }
+            m_array.push_back(element);
+            SkipSpace(text, pos);
+            if ((pos < text.size()) && (text[pos] == ',')) {
+                ++pos;
+                continue;
+            }
+            if ((pos < text.size()) && (text[pos] == ']')) {
+                ++pos;
+                return true;
+            }
+            return false;
+        }
+    }
+    if (c == '"') {
+        m_type = JSON_STRING;
+        return ParseString(text, pos, m_string);
+    }
+    if (text.compare(pos, 4, "true") == 0) {
+        m_type = JSON_BOOL;
+        m_bool = true;
+        pos += 4;
+        return true;
+    }
+    if (text.compare(pos, 5, "false") == 0) {
+        m_type = JSON_BOOL;
+        m_bool = false;
+        pos += 5;
+        return true;
+    }
+    if (text.compare(pos, 4, "null") == 0) {
+        m_type = JSON_NULL;
+        pos += 4;
+        return true;
+    }
+
+    // strtod alone would also take nan, inf and hex floats, and 1e999 becomes inf
+    size_t length = ScanNumber(text, pos);
+    if (length == 0) {
+        return false;
+    }
+    double number = strtod(text.substr(pos, length).c_str(), nullptr);
+    if (!std::isfinite(number)) {
+        return false;
+    }
+    m_type   = JSON_NUMBER;
+    m_number = number;
+    pos += length;
+    return true;
+}
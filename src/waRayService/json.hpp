@@ -0,0 +1,46 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace waRT {
+    class JsonValue {
+    public:
+        enum Type { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+
+        JsonValue();
+        static bool Parse(const std::string &text, JsonValue &result, std::string &error);
+        static std::string Escape(const std::string &text);
+
+        Type GetType() const;
+        bool IsNull() const;
+        bool Has(const std::string &key) const;
+        size_t Size() const;
+
+        bool        GetBool(bool fallback) const;
+        double      GetNumber(double fallback) const;
+        bool        GetInt(int minValue, int maxValue, int &value) const;
+        std::string GetString(const std::string &fallback) const;
+        bool        GetVector3(double out[3]) const;
+
+        const JsonValue &operator[] (const std::string &key) const;
+        const JsonValue &operator[] (size_t index) const;
+
+    private:
+        bool ParseValue(const std::string &text, size_t &pos, int depth);
+        static bool ParseString(const std::string &text, size_t &pos, std::string &out);
+        static void SkipSpace(const std::string &text, size_t &pos);
+
+    private:
+        Type        m_type;
+        bool        m_bool;
+        double      m_number;
+        std::string m_string;
+        std::vector<JsonValue> m_array;
+        std::vector<std::pair<std::string, JsonValue>> m_object;
+    };
+}
+
+#endif
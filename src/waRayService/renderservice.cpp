@@ -0,0 +1,802 @@
+/*
+    The `RenderService` class turns the engine into a long running render server. Scenes stay resident in memory between requests, so a pipeline that renders many frames of the same scene only pays for the changes it makes, and jobs are scheduled by priority onto a fixed number of worker threads.
+
+    1. **Resident Scenes**:
+       - Scenes are kept by name in `m_scenes`. A scene called `default` (the built in test scene) exists from the start, and `POST /scenes/{name}` creates another one or edits an existing one.
+       - Each scene has its own mutex. Jobs on the same scene run one after another, while jobs on different scenes run side by side. The scene keeps its primitive set between frames, so a job that only moves the camera or a light does not rebuild it.
+       - With `SetAccelerationDir()` every scene keeps its built primitive set in `<dir>/<scene>.wabvh` (see `Scene::SetAccelerationFile`). Render servers on one machine that share the directory build a static scene once and map the same file, so they also share its memory.
+
+    2. **Deltas (`ApplyDeltas`)**:
+       - Scene and job requests can carry changes that are applied to the resident scene before rendering, and they stay applied for later jobs:
+         - `camera`: any of `position`, `lookAt`, `up` (three numbers each), `length`, `horzSize`, `aspect`, `projection` (`"perspective"`, `"equirectangular"` or `"fisheye"`), `aperture`, `focusDistance`, `fov` (fisheye field of view in radians) and `shutter` (open and close time).
+         - `objects`: a list of `{ "index", "color", "translation", "rotation", "scale" }`. If any transform part is given the object's transform is rebuilt, missing parts default to no translation, no rotation and unit scale.
+         - `lights`: a list of `{ "index", "location", "color", "intensity" }`.
+         - `compactStorage`: `true` keeps the scene's primitives and BVHs in the compact float layout, which takes about a quarter of the memory (see `Scene::SetCompactStorage`).
+         - `hybridVisibility`: `true` finds the closest object of every pixel with the rasterized visibility buffer before tracing (see `Scene::SetHybridVisibility`).
+         - `indirectSamples`: hemisphere rays per gather for diffuse indirect light, from `0` (off) to `MAX_JOB_INDIRECT_SAMPLES` (see `Scene::SetIndirectSamples`). Anything else fails the request with `400`.
+         - `integrator`: `direct` (the default) or `path` for the path tracer, and `maxPathDepth`, the most vertices a path may have, from `1` to `MAX_JOB_PATH_DEPTH` (see `Scene::SetIntegrator`).
+         - `numaAware`: `true` pins the render threads node by node and renders into an image whose pages they place themselves (see `Scene::SetNumaAware`).
+       - Object changes call `NotifyTransformsChanged()`, so the next frame refits the scene's BVHs instead of rebuilding them. A bad index or malformed value fails the request and leaves the remaining deltas unapplied.
+       - Every number that ends up in an `int` (sizes, counts, indices, region corners) is read with `JsonValue::GetInt()`, which checks the range before casting. A value out of range, or not a number, is a `400`, never an undefined cast.
+
+    3. **Job Queue**:
+       - `POST /jobs` takes `scene`, `width`, `height`, optional `priority` (higher runs first, equal priorities run in submission order), `threads` (render threads for this job, `0` picks an even share of the cores), `samples` (per pixel, default 1), `seed` (for the sample pattern, default 0), `regions` (a list of `[x0, y0, x1, y1]` rectangles, x1 and y1 exclusive, to trace only those parts of the frame), `timeBudget` (seconds) and `targetError` (relative) for a progressive render with adaptive sampling that stops at whichever comes first, `maxPasses` to cap its passes (see `Scene::RenderProgressive`), and the deltas above. The same scene, samples and seed always give the same pixels, whatever the thread count, so tiles from different jobs or machines can be merged. It answers `202` with the job id.
+       - Up to `maxConcurrentJobs` worker threads take the best queued job, lock its scene, apply the deltas, and render into a headless `waImage` with a `RenderControl` attached. A job cancelled while it is still queued never touches its scene.
+       - Finished jobs are kept so their results can be fetched. Only the newest `MAX_FINISHED_JOBS` finished jobs are kept, and `DELETE /jobs/{id}` drops one early.
+
+    4. **Progress and Results**:
+       - `GET /jobs/{id}` reports the state (`queued`, `running`, `done`, `cancelled`, `failed`), progress, tile counts, render time and a `tileMap` string with one `0`/`1` per tile in row major order. A progressive job reports its tiles only once it finishes, and then also has a `quality` object with its passes, mean samples per pixel, mean and largest estimated error, the fraction of pixels within the target and whether the target was reached or the budget ran out. A finished job also has a `memory` object with the resident bytes of its scene's objects, lights, primitives, BVHs and texture tiles and of its image, and the bytes of its mapped acceleration file, which are shared and not in the total.
+       - `GET /jobs/{id}/tiles/{index}` returns the linear RGB floats of one finished tile (row major, three little-endian floats per pixel) with its rectangle in the `X-Tile-Rect` header, so a client can show a frame while it is still rendering.
+       - `GET /jobs/{id}/image` returns the finished frame as a PFM image.
+       - `POST /jobs/{id}/cancel` stops a queued or running job. Tiles that were already finished stay available.
+
+    5. **Status**:
+       - `GET /status` reports the engine version, the number of running and queued jobs, the resident scenes and the render cache counters when a cache is attached.
+*/
+
+#include "renderservice.hpp"
+#include "../waRayTrace/version.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+constexpr int MAX_IMAGE_SIZE           = 8192;
+constexpr int MAX_JOB_THREADS          = 256;
+constexpr int MAX_JOB_SAMPLES          = 4096;
+constexpr int MAX_JOB_PASSES           = 4096;
+constexpr int MAX_JOB_INDIRECT_SAMPLES = 1024;
+constexpr int MAX_JOB_PATH_DEPTH       = 256;
+constexpr size_t MAX_FINISHED_JOBS = 64;
+
+static const char *StateName(int state) {
+    switch (state) {
+        case waRT::JOB_QUEUED:    return "queued";
+        case waRT::JOB_RUNNING:   return "running";
+        case waRT::JOB_DONE:      return "done";
+        case waRT::JOB_CANCELLED: return "cancelled";
+        default:                  return "failed";
+    }
+}
+
+static bool ParseIndex(const std::string &text, int &value) {
+    if (text.empty() || (text.size() > 9)) {
+        return false;
+    }
+    for (char c : text) {
+        if ((c < '0') || (c > '9')) {
+            return false;
+        }
+    }
+    value = atoi(text.c_str());
+    return true;
+}
+
+// an optional integer member; false with an error if it is there but not a number in [minValue, maxValue]
+static bool GetIntField(const waRT::JsonValue &body, const std::string &key, int minValue, int maxValue, int &value, std::string &error) {
+    if (body.Has(key) && !body[key].GetInt(minValue, maxValue, value)) {
+        error = key + " must be between " + std::to_string(minValue) + " and " + std::to_string(maxValue);
+        return false;
+    }
+    return true;
+}
+
+waRT::RenderService::RenderService(int maxConcurrentJobs) {
+    m_nextJobId   = 1;
+    m_runningJobs = 0;
+    m_stopping    = false;
+    m_scenes["default"] = std::make_shared<ResidentScene>();
+
+    int numWorkers = std::max(1, maxConcurrentJobs);
+    for (int i = 0; i < numWorkers; ++i) {
+        m_workers.push_back(std::thread(&waRT::RenderService::WorkerLoop, this));
+    }
+}
+
+waRT::RenderService::~RenderService() {
+    Shutdown();
+}
+
+void waRT::RenderService::Shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping) {
+            return;
+        }
+        m_stopping = true;
+        for (auto &job : m_jobs) {
+            job.second->control.Cancel();
+        }
+    }
+    m_wakeup.notify_all();
+    for (auto &worker : m_workers) {
+        worker.join();
+    }
+}
+
+// SETTERS
+void waRT::RenderService::SetRenderCache(const std::shared_ptr<waRT::RenderCache> &renderCache) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_renderCache = renderCache;
+}
+
+// applies to the scenes that exist already as well as to new ones
+void waRT::RenderService::SetAccelerationDir(const std::string &accelerationDir) {
+    std::vector<std::pair<std::string, std::shared_ptr<ResidentScene>>> scenes;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_accelerationDir = accelerationDir;
+        scenes.assign(m_scenes.begin(), m_scenes.end());
+    }
+    for (auto &entry : scenes) {
+        std::lock_guard<std::mutex> sceneLock(entry.second->mutex);
+        entry.second->scene.SetAccelerationFile(AccelerationFileName(accelerationDir, entry.first));
+    }
+}
+
+waRT::HttpResponse waRT::RenderService::Handle(const waRT::HttpRequest &request) {
+    // split the path into its segments
+    std::vector<std::string> parts;
+    size_t pos = 0;
+    while (pos < request.path.size()) {
+        size_t next = request.path.find('/', pos);
+        if (next == std::string::npos) {
+            next = request.path.size();
+        }
+        if (next > pos) {
+            parts.push_back(request.path.substr(pos, next - pos));
+        }
+        pos = next + 1;
+    }
+
+    if ((parts.size() == 1) && (parts[0] == "status")) {
+        return (request.method == "GET") ? GetStatus() : Error(405, "use GET");
+    }
+    if ((parts.size() == 2) && (parts[0] == "scenes")) {
+        return (request.method == "POST") ? PostScene(parts[1], request) : Error(405, "use POST");
+    }
+    if ((parts.size() == 1) && (parts[0] == "jobs")) {
+        return (request.method == "POST") ? PostJob(request) : Error(405, "use POST");
+    }
+    if ((parts.size() < 2) || (parts[0] != "jobs")) {
+        return Error(404, "unknown endpoint");
+    }
+
+    int jobId = 0;
+    std::shared_ptr<Job> job;
+    if (ParseIndex(parts[1], jobId)) {
+        job = FindJob(jobId);
+    }
+    if (!job) {
+        return Error(404, "unknown job");
+    }
+
+    if (parts.size() == 2) {
+        if (request.method == "GET") {
+            return GetJob(job);
+        }
+        if (request.method != "DELETE") {
+            return Error(405, "use GET or DELETE");
+        }
+    }
+    if (((parts.size() == 3) && (parts[2] == "cancel") && (request.method == "POST")) ||
+        ((parts.size() == 2) && (request.method == "DELETE"))) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            job->control.Cancel();
+            auto queued = std::find(m_queue.begin(), m_queue.end(), job);
+            if (queued != m_queue.end()) {
+                m_queue.erase(queued);
+                std::make_heap(m_queue.begin(), m_queue.end(), QueueOrder);
+                job->state = JOB_CANCELLED;
+            }
+            if (request.method == "DELETE") {
+                m_jobs.erase(job->id);
+            }
+        }
+        return GetJob(job);
+    }
+    if ((parts.size() == 3) && (parts[2] == "image") && (request.method == "GET")) {
+        return GetImage(job);
+    }
+    if ((parts.size() == 4) && (parts[2] == "tiles") && (request.method == "GET")) {
+        int tileIndex = 0;
+        if (!ParseIndex(parts[3], tileIndex)) {
+            return Error(400, "bad tile index");
+        }
+        return GetTile(job, tileIndex);
+    }
+    return Error(404, "unknown endpoint");
+}
+
+// private funks
+
+bool waRT::RenderService::QueueOrder(const std::shared_ptr<Job> &a, const std::shared_ptr<Job> &b) {
+    // max-heap: highest priority first, then the oldest job
+    if (a->priority != b->priority) {
+        return a->priority < b->priority;
+    }
+    return a->id > b->id;
+}
+
+void waRT::RenderService::WorkerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_wakeup.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+        if (m_stopping) {
+            return;
+        }
+        std::pop_heap(m_queue.begin(), m_queue.end(), QueueOrder);
+        std::shared_ptr<Job> job = m_queue.back();
+        m_queue.pop_back();
+        ++m_runningJobs;
+
+        lock.unlock();
+        RunJob(job);
+        lock.lock();
+
+        --m_runningJobs;
+        RetireOldJobs();
+    }
+}
+
+void waRT::RenderService::RunJob(const std::shared_ptr<Job> &job) {
+    std::shared_ptr<ResidentScene> resident;
+    std::shared_ptr<waRT::RenderCache> renderCache;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        resident    = FindScene(job->sceneName, false);
+        renderCache = m_renderCache;
+    }
+    if (!resident) {
+        job->error = "unknown scene";
+        job->state = JOB_FAILED;
+        return;
+    }
+
+    std::lock_guard<std::mutex> sceneLock(resident->mutex);
+    if (job->control.IsCancelled()) {
+        job->state = JOB_CANCELLED;
+        return;
+    }
+    if (!ApplyDeltas(resident->scene, job->deltas, job->error)) {
+        job->state = JOB_FAILED;
+        return;
+    }
+
+    job->image = std::make_unique<waImage>();
+    // a NUMA-aware scene places the frame's pages next to the threads that render them
+    job->image->SetFirstTouch(resident->scene.IsNumaAware());
+    job->image->Initialize(job->xSize, job->ySize, NULL);
+
+    Job *rawJob = job.get();
+    job->control.m_onTileDone = [rawJob](int x0, int y0, int x1, int y1) {
+        // a cache hit reports the whole frame as one rectangle
+        for (int ty = y0 / TILE_SIZE; ty < (y1 + TILE_SIZE - 1) / TILE_SIZE; ++ty) {
+            for (int tx = x0 / TILE_SIZE; tx < (x1 + TILE_SIZE - 1) / TILE_SIZE; ++tx) {
+                rawJob->tileDone[ty * rawJob->numTilesX + tx] = true;
+            }
+        }
+    };
+
+    int threads = job->threads;
+    if (threads == 0) {
+        int numWorkers = static_cast<int>(m_workers.size());
+        threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / numWorkers);
+    }
+
+    job->state = JOB_RUNNING;
+    resident->scene.SetNumThreads(threads);
+    resident->scene.SetSamplesPerPixel(job->samples);
+    resident->scene.SetSampleSeed(job->seed);
+    resident->scene.SetRenderCache(renderCache);
+    bool progressive = (job->budget.seconds > 0.0) || (job->budget.targetError > 0.0);
+    bool finished = progressive             ? resident->scene.RenderProgressive(*job->image, job->budget, &job->control)
+                  : job->regions.empty()    ? resident->scene.Render(*job->image, &job->control)
+                                            : resident->scene.RenderRegions(*job->image, job->regions, &job->control);
+    job->stats = resident->scene.GetRenderStats();
+    resident->jobsRendered++;
+    job->state = finished ? JOB_DONE : JOB_CANCELLED;
+}
+
+void waRT::RenderService::RetireOldJobs() {
+    size_t numFinished = 0;
+    for (auto &entry : m_jobs) {
+        if (entry.second->state >= JOB_DONE) {
+            ++numFinished;
+        }
+    }
+    // ids grow over time, so the oldest finished jobs come first
+    for (auto it = m_jobs.begin(); (it != m_jobs.end()) && (numFinished > MAX_FINISHED_JOBS);) {
+        if (it->second->state >= JOB_DONE) {
+            it = m_jobs.erase(it);
+            --numFinished;
+        } else {
+            ++it;
+        }
+    }
+}
+
+std::shared_ptr<waRT::RenderService::ResidentScene> waRT::RenderService::FindScene(const std::string &name, bool create) {
+    auto found = m_scenes.find(name);
+    if (found != m_scenes.end()) {
+        return found->second;
+    }
+    if (!create) {
+        return nullptr;
+    }
+    auto resident = std::make_shared<ResidentScene>();
+    resident->scene.SetAccelerationFile(AccelerationFileName(m_accelerationDir, name));
+    m_scenes[name] = resident;
+    return resident;
+}
+
+// empty without a directory; a scene name never leaves the directory
+std::string waRT::RenderService::AccelerationFileName(const std::string &accelerationDir, const std::string &sceneName) {
+    if (accelerationDir.empty()) {
+        return std::string();
+    }
+    std::string fileName = sceneName;
+    std::replace(fileName.begin(), fileName.end(), '/', '_');
+    return accelerationDir + "/" + fileName + ".wabvh";
+}
+
+std::shared_ptr<waRT::RenderService::Job> waRT::RenderService::FindJob(int id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_jobs.find(id);
+    return (found != m_jobs.end()) ? found->second : nullptr;
+}
+
+bool waRT::RenderService::ApplyDeltas(waRT::Scene &scene, const waRT::JsonValue &deltas, std::string &error) {
+    double v[3];
+
+    if (deltas.Has("compactStorage")) {
+        scene.SetCompactStorage(deltas["compactStorage"].GetBool(scene.IsCompactStorage()));
+    }
+    if (deltas.Has("hybridVisibility")) {
+        scene.SetHybridVisibility(deltas["hybridVisibility"].GetBool(scene.IsHybridVisibility()));
+    }
+    if (deltas.Has("indirectSamples")) {
+        int indirectSamples = 0;
+        if (!GetIntField(deltas, "indirectSamples", 0, MAX_JOB_INDIRECT_SAMPLES, indirectSamples, error)) {
+            return false;
+        }
+        scene.SetIndirectSamples(indirectSamples);
+    }
+    if (deltas.Has("integrator")) {
+        std::string integrator = deltas["integrator"].GetString("");
+        if (integrator == "direct") {
+            scene.SetIntegrator(waRT::INTEGRATOR_DIRECT);
+        } else if (integrator == "path") {
+            scene.SetIntegrator(waRT::INTEGRATOR_PATH);
+        } else {
+            error = "integrator must be direct or path";
+            return false;
+        }
+    }
+    if (deltas.Has("maxPathDepth")) {
+        int maxPathDepth = 1;
+        if (!GetIntField(deltas, "maxPathDepth", 1, MAX_JOB_PATH_DEPTH, maxPathDepth, error)) {
+            return false;
+        }
+        scene.SetMaxPathDepth(maxPathDepth);
+    }
+    if (deltas.Has("numaAware")) {
+        scene.SetNumaAware(deltas["numaAware"].GetBool(scene.IsNumaAware()));
+    }
+
+    const waRT::JsonValue &camera = deltas["camera"];
+    if (camera.GetType() == waRT::JsonValue::JSON_OBJECT) {
+        waRT::Camera &sceneCamera = scene.GetCamera();
+        if (camera.Has("position")) {
+            if (!camera["position"].GetVector3(v)) {
+                error = "camera.position needs three numbers";
+                return false;
+            }
+            sceneCamera.SetPosition(qbVector<double>{std::vector<double>{v[0], v[1], v[2]}});
+        }
+        if (camera.Has("lookAt")) {
+            if (!camera["lookAt"].GetVector3(v)) {
+                error = "camera.lookAt needs three numbers";
+                return false;
+            }
+            sceneCamera.SetLookAt(qbVector<double>{std::vector<double>{v[0], v[1], v[2]}});
+        }
+        if (camera.Has("up")) {
+            if (!camera["up"].GetVector3(v)) {
+                error = "camera.up needs three numbers";
+                return false;
+            }
+            sceneCamera.SetUp(qbVector<double>{std::vector<double>{v[0], v[1], v[2]}});
+        }
+        if (camera.Has("length")) {
+            sceneCamera.SetLength(camera["length"].GetNumber(sceneCamera.GetLength()));
+        }
+        if (camera.Has("horzSize")) {
+            sceneCamera.SetHorzSize(camera["horzSize"].GetNumber(sceneCamera.GetHorzSize()));
+        }
+        if (camera.Has("aspect")) {
+            sceneCamera.SetAspect(camera["aspect"].GetNumber(sceneCamera.GetAspect()));
+        }
+        if (camera.Has("projection")) {
+            std::string projection = camera["projection"].GetString("");
+            if (projection == "perspective") {
+                sceneCamera.SetProjection(waRT::PROJECTION_PERSPECTIVE);
+            } else if (projection == "equirectangular") {
+                sceneCamera.SetProjection(waRT::PROJECTION_EQUIRECTANGULAR);
+            } else if (projection == "fisheye") {
+                sceneCamera.SetProjection(waRT::PROJECTION_FISHEYE);
+            } else {
+                error = "camera.projection must be perspective, equirectangular or fisheye";
+                return false;
+            }
+        }
+        if (camera.Has("aperture")) {
+            sceneCamera.SetAperture(camera["aperture"].GetNumber(sceneCamera.GetAperture()));
+        }
+        if (camera.Has("focusDistance")) {
+            sceneCamera.SetFocusDistance(camera["focusDistance"].GetNumber(sceneCamera.GetFocusDistance()));
+        }
+        if (camera.Has("fov")) {
+            sceneCamera.SetFieldOfView(camera["fov"].GetNumber(sceneCamera.GetFieldOfView()));
+        }
+        if (camera.Has("shutter")) {
+            const waRT::JsonValue &shutter = camera["shutter"];
+            if ((shutter.GetType() != waRT::JsonValue::JSON_ARRAY) || (shutter.Size() != 2)) {
+                error = "camera.shutter needs two numbers";
+                return false;
+            }
+            double times[2];
+            for (size_t k = 0; k < 2; ++k) {
+                times[k] = shutter[k].GetNumber(0.0);
+            }
+            sceneCamera.SetShutter(times[0], times[1]);
+        }
+        sceneCamera.UpdateCameraGeometry();
+    }
+
+    const waRT::JsonValue &objects = deltas["objects"];
+    auto &objectList = scene.GetObjectList();
+    for (size_t i = 0; i < objects.Size(); ++i) {
+        const waRT::JsonValue &change = objects[i];
+        int index = -1;
+        if (!change["index"].GetInt(0, static_cast<int>(objectList.size()) - 1, index)) {
+            error = "objects[" + std::to_string(i) + "].index is out of range";
+            return false;
+        }
+        auto &object = objectList.at(index);
+        if (change.Has("color")) {
+            if (!change["color"].GetVector3(v)) {
+                error = "objects[" + std::to_string(i) + "].color needs three numbers";
+                return false;
+            }
+            object->m_baseColor = qbVector<double>{std::vector<double>{v[0], v[1], v[2]}};
+        }
+        if (change.Has("translation") || change.Has("rotation") || change.Has("scale")) {
+            double translation[3] = {0.0, 0.0, 0.0};
+            double rotation[3]    = {0.0, 0.0, 0.0};
+            double scale[3]       = {1.0, 1.0, 1.0};
+            if ((change.Has("translation") && !change["translation"].GetVector3(translation)) ||
+                (change.Has("rotation")    && !change["rotation"].GetVector3(rotation)) ||
+                (change.Has("scale")       && !change["scale"].GetVector3(scale))) {
+                error = "objects[" + std::to_string(i) + "] transform parts need three numbers";
+                return false;
+            }
+            waRT::GTform transform;
+            transform.SetTransform(qbVector<double>{std::vector<double>{translation[0], translation[1], translation[2]}},
+                                   qbVector<double>{std::vector<double>{rotation[0], rotation[1], rotation[2]}},
+                                   qbVector<double>{std::vector<double>{scale[0], scale[1], scale[2]}});
+            object->SetTransformMatrix(transform);
+        }
+        scene.NotifyTransformsChanged();
+    }
+
+    const waRT::JsonValue &lights = deltas["lights"];
+    auto &lightList = scene.GetLightList();
+    for (size_t i = 0; i < lights.Size(); ++i) {
+        const waRT::JsonValue &change = lights[i];
+        int index = -1;
+        if (!change["index"].GetInt(0, static_cast<int>(lightList.size()) - 1, index)) {
+            error = "lights[" + std::to_string(i) + "].index is out of range";
+            return false;
+        }
+        auto &light = lightList.at(index);
+        // PointLight keeps its own colour and intensity
+        auto pointLight = std::dynamic_pointer_cast<waRT::PointLight>(light);
+        if (change.Has("location")) {
+            if (!change["location"].GetVector3(v)) {
+                error = "lights[" + std::to_string(i) + "].location needs three numbers";
+                return false;
+            }
+            light->m_location = qbVector<double>{std::vector<double>{v[0], v[1], v[2]}};
+        }
+        if (change.Has("color")) {
+            if (!change["color"].GetVector3(v)) {
+                error = "lights[" + std::to_string(i) + "].color needs three numbers";
+                return false;
+            }
+            light->m_color = qbVector<double>{std::vector<double>{v[0], v[1], v[2]}};
+            if (pointLight) {
+                pointLight->m_color = light->m_color;
+            }
+        }
+        if (change.Has("intensity")) {
+            double intensity = change["intensity"].GetNumber(-1.0);
+            if (intensity < 0.0) {
+                error = "lights[" + std::to_string(i) + "].intensity needs a non-negative number";
+                return false;
+            }
+            light->m_instensity = intensity;
+            if (pointLight) {
+                pointLight->m_intensity = intensity;
+            }
+        }
+    }
+    return true;
+}
+
+waRT::HttpResponse waRT::RenderService::GetStatus() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string body = "{\"version\":" + waRT::JsonValue::Escape(waRT::ENGINE_VERSION);
+    body += ",\"workers\":" + std::to_string(m_workers.size());
+    body += ",\"running\":" + std::to_string(m_runningJobs);
+    body += ",\"queued\":" + std::to_string(m_queue.size());
+    body += ",\"scenes\":[";
+    bool first = true;
+    for (auto &entry : m_scenes) {
+        body += (first ? "" : ",") + waRT::JsonValue::Escape(entry.first);
+        first = false;
+    }
+    body += "]";
+    if (m_renderCache) {
+        body += ",\"cache\":{\"hits\":" + std::to_string(m_renderCache->GetHits());
+        body += ",\"misses\":" + std::to_string(m_renderCache->GetMisses());
+        body += ",\"bytes\":" + std::to_string(m_renderCache->GetTotalBytes()) + "}";
+    }
+    body += "}";
+
+    waRT::HttpResponse response;
+    response.body = body;
+    return response;
+}
+
+waRT::HttpResponse waRT::RenderService::PostScene(const std::string &name, const waRT::HttpRequest &request) {
+    waRT::JsonValue deltas;
+    std::string error;
+    if (!request.body.empty() && !waRT::JsonValue::Parse(request.body, deltas, error)) {
+        return Error(400, error);
+    }
+
+    std::shared_ptr<ResidentScene> resident;
+    bool created = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        created  = (m_scenes.find(name) == m_scenes.end());
+        resident = FindScene(name, true);
+    }
+
+    std::lock_guard<std::mutex> sceneLock(resident->mutex);
+    if (!ApplyDeltas(resident->scene, deltas, error)) {
+        return Error(400, error);
+    }
+
+    waRT::HttpResponse response;
+    response.status = created ? 201 : 200;
+    response.body   = "{\"scene\":" + waRT::JsonValue::Escape(name) + "}";
+    return response;
+}
+
+waRT::HttpResponse waRT::RenderService::PostJob(const waRT::HttpRequest &request) {
+    waRT::JsonValue body;
+    std::string error;
+    if (!waRT::JsonValue::Parse(request.body, body, error)) {
+        return Error(400, error);
+    }
+
+    auto job = std::make_shared<Job>();
+    job->sceneName = body["scene"].GetString("default");
+    job->priority  = 0;
+    job->threads   = 0;
+    job->samples   = 1;
+    double seed    = body["seed"].GetNumber(0.0);
+    job->budget.seconds     = body["timeBudget"].GetNumber(0.0);
+    job->budget.targetError = body["targetError"].GetNumber(0.0);
+    job->deltas    = body;
+    // every number that becomes an int is range checked as a double first
+    if (!body["width"].GetInt(1, MAX_IMAGE_SIZE, job->xSize) || !body["height"].GetInt(1, MAX_IMAGE_SIZE, job->ySize)) {
+        return Error(400, "width and height must be between 1 and " + std::to_string(MAX_IMAGE_SIZE));
+    }
+    if (!GetIntField(body, "priority", std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), job->priority, error) ||
+        !GetIntField(body, "threads", 0, MAX_JOB_THREADS, job->threads, error) ||
+        !GetIntField(body, "samples", 1, MAX_JOB_SAMPLES, job->samples, error) ||
+        !GetIntField(body, "maxPasses", 1, MAX_JOB_PASSES, job->budget.maxPasses, error)) {
+        return Error(400, error);
+    }
+    if (!(seed >= 0.0) || (seed > 4294967295.0)) {
+        return Error(400, "seed must be between 0 and 4294967295");
+    }
+    job->seed = static_cast<uint32_t>(seed);
+    if (!(job->budget.seconds >= 0.0) || !(job->budget.targetError >= 0.0)) {
+        return Error(400, "timeBudget and targetError must not be negative");
+    }
+    // deltas are applied by the worker, so the ones that can be out of range are checked before queueing
+    int checked;
+    if (!GetIntField(body, "indirectSamples", 0, MAX_JOB_INDIRECT_SAMPLES, checked, error) ||
+        !GetIntField(body, "maxPathDepth", 1, MAX_JOB_PATH_DEPTH, checked, error)) {
+        return Error(400, error);
+    }
+    const waRT::JsonValue &regions = body["regions"];
+    for (size_t i = 0; i < regions.Size(); ++i) {
+        const waRT::JsonValue &rect = regions[i];
+        if ((rect.GetType() != waRT::JsonValue::JSON_ARRAY) || (rect.Size() != 4)) {
+            return Error(400, "regions[" + std::to_string(i) + "] needs four numbers x0, y0, x1, y1");
+        }
+        // corners may lie outside the frame, the scene clips them
+        int corners[4];
+        for (size_t k = 0; k < 4; ++k) {
+            if (!rect[k].GetInt(-MAX_IMAGE_SIZE, 2 * MAX_IMAGE_SIZE, corners[k])) {
+                return Error(400, "regions[" + std::to_string(i) + "] corners must be between " + std::to_string(-MAX_IMAGE_SIZE) +
+                                  " and " + std::to_string(2 * MAX_IMAGE_SIZE));
+            }
+        }
+        job->regions.push_back(waRT::RenderRegion{corners[0], corners[1], corners[2], corners[3]});
+    }
+    if (!job->regions.empty() && ((job->budget.seconds > 0.0) || (job->budget.targetError > 0.0))) {
+        return Error(400, "regions cannot be combined with timeBudget or targetError");
+    }
+
+    job->numTilesX = (job->xSize + TILE_SIZE - 1) / TILE_SIZE;
+    job->numTilesY = (job->ySize + TILE_SIZE - 1) / TILE_SIZE;
+    int numTiles = job->numTilesX * job->numTilesY;
+    job->tileDone = std::make_unique<std::atomic<bool>[]>(numTiles);
+    for (int i = 0; i < numTiles; ++i) {
+        job->tileDone[i] = false;
+    }
+    job->state = JOB_QUEUED;
+    job->control.BeginFrame(numTiles);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping) {
+            return Error(503, "service is shutting down");
+        }
+        if (m_scenes.find(job->sceneName) == m_scenes.end()) {
+            return Error(404, "unknown scene");
+        }
+        job->id = m_nextJobId++;
+        m_jobs[job->id] = job;
+        m_queue.push_back(job);
+        std::push_heap(m_queue.begin(), m_queue.end(), QueueOrder);
+    }
+    m_wakeup.notify_one();
+
+    waRT::HttpResponse response = GetJob(job);
+    response.status = 202;
+    return response;
+}
+
+waRT::HttpResponse waRT::RenderService::GetJob(const std::shared_ptr<Job> &job) {
+    waRT::HttpResponse response;
+    response.body = JobToJson(*job);
+    return response;
+}
+
+waRT::HttpResponse waRT::RenderService::GetImage(const std::shared_ptr<Job> &job) {
+    if (job->state != JOB_DONE) {
+        return Error(409, "job has not finished");
+    }
+
+    char header[64];
+    snprintf(header, sizeof(header), "PF\n%d %d\n-1.0\n", job->xSize, job->ySize);
+    std::string body = header;
+    size_t headerSize = body.size();
+    body.resize(headerSize + static_cast<size_t>(job->xSize) * job->ySize * 3 * sizeof(float));
+
+    // PFM stores rows bottom to top
+    char *out = &body[headerSize];
+    for (int y = job->ySize - 1; y >= 0; --y) {
+        for (int x = 0; x < job->xSize; ++x) {
+            double red, green, blue;
+            job->image->GetPixel(x, y, red, green, blue);
+            float rgb[3] = {static_cast<float>(red), static_cast<float>(green), static_cast<float>(blue)};
+            memcpy(out, rgb, sizeof(rgb));
+            out += sizeof(rgb);
+        }
+    }
+
+    waRT::HttpResponse response;
+    response.contentType = "image/x-portable-floatmap";
+    response.body = std::move(body);
+    return response;
+}
+
+waRT::HttpResponse waRT::RenderService::GetTile(const std::shared_ptr<Job> &job, int tileIndex) {
+    if (tileIndex >= job->numTilesX * job->numTilesY) {
+        return Error(404, "tile index out of range");
+    }
+    if (!job->tileDone[tileIndex]) {
+        return Error(409, "tile has not been rendered");
+    }
+
+    int x0 = (tileIndex % job->numTilesX) * TILE_SIZE;
+    int y0 = (tileIndex / job->numTilesX) * TILE_SIZE;
+    int x1 = std::min(x0 + TILE_SIZE, job->xSize);
+    int y1 = std::min(y0 + TILE_SIZE, job->ySize);
+
+    std::string body;
+    body.resize(static_cast<size_t>(x1 - x0) * (y1 - y0) * 3 * sizeof(float));
+    char *out = &body[0];
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            double red, green, blue;
+            job->image->GetPixel(x, y, red, green, blue);
+            float rgb[3] = {static_cast<float>(red), static_cast<float>(green), static_cast<float>(blue)};
+            memcpy(out, rgb, sizeof(rgb));
+            out += sizeof(rgb);
+        }
+    }
+
+    waRT::HttpResponse response;
+    response.contentType = "application/octet-stream";
+    response.body = std::move(body);
+    response.headers.push_back({"X-Tile-Rect", std::to_string(x0) + "," + std::to_string(y0) + "," +
+                                               std::to_string(x1) + "," + std::to_string(y1)});
+    return response;
+}
+
+std::string waRT::RenderService::JobToJson(Job &job) {
+    int numTiles = job.numTilesX * job.numTilesY;
+    std::string tileMap(static_cast<size_t>(numTiles), '0');
+    for (int i = 0; i < numTiles; ++i) {
+        if (job.tileDone[i]) {
+            tileMap[i] = '1';
+        }
+    }
+
+    // stats and error are written before the final state is stored
+    int state = job.state;
+    double renderSeconds = (state >= JOB_DONE) ? job.stats.renderSeconds : 0.0;
+    char numbers[256];
+    snprintf(numbers, sizeof(numbers),
+             ",\"priority\":%d,\"width\":%d,\"height\":%d,\"progress\":%.4f,\"tilesDone\":%d,\"tilesTotal\":%d,\"tilesX\":%d,\"tilesY\":%d,\"renderSeconds\":%.6f",
+             job.priority, job.xSize, job.ySize, (state == JOB_DONE) ? 1.0 : job.control.GetProgress(),
+             job.control.GetTilesDone(), numTiles, job.numTilesX, job.numTilesY, renderSeconds);
+
+    std::string body = "{\"id\":" + std::to_string(job.id);
+    body += ",\"scene\":" + waRT::JsonValue::Escape(job.sceneName);
+    body += ",\"state\":\"" + std::string(StateName(state)) + "\"";
+    body += numbers;
+    if (state == JOB_FAILED) {
+        body += ",\"error\":" + waRT::JsonValue::Escape(job.error);
+    }
+    if (state == JOB_DONE) {
+        const waRT::MemoryReport &memory = job.stats.memory;
+        body += ",\"memory\":{\"objects\":" + std::to_string(memory.objectBytes);
+        body += ",\"lights\":" + std::to_string(memory.lightBytes);
+        body += ",\"primitives\":" + std::to_string(memory.primitiveBytes);
+        body += ",\"bvh\":" + std::to_string(memory.bvhBytes);
+        body += ",\"textures\":" + std::to_string(memory.textureBytes);
+        body += ",\"image\":" + std::to_string(memory.imageBytes);
+        body += ",\"mapped\":" + std::to_string(memory.mappedBytes);
+        body += ",\"total\":" + std::to_string(memory.TotalBytes()) + "}";
+    }
+    if ((state >= JOB_DONE) && (job.stats.quality.passes > 0)) {
+        const waRT::QualityReport &quality = job.stats.quality;
+        char report[256];
+        snprintf(report, sizeof(report),
+                 ",\"quality\":{\"passes\":%d,\"meanSamples\":%.3f,\"meanError\":%.6f,\"maxError\":%.6f,\"convergedFraction\":%.4f,\"targetReached\":%s,\"budgetExhausted\":%s}",
+                 quality.passes, quality.meanSamples, quality.meanError, quality.maxError, quality.convergedFraction,
+                 quality.targetReached ? "true" : "false", quality.budgetExhausted ? "true" : "false");
+        body += report;
+    }
+    body += ",\"tileMap\":\"" + tileMap + "\"}";
+    return body;
+}
+
+waRT::HttpResponse waRT::RenderService::Error(int status, const std::string &message) {
+    waRT::HttpResponse response;
+    response.status = status;
+    response.body   = "{\"error\":" + waRT::JsonValue::Escape(message) + "}";
+    return response;
+}
@@ -0,0 +1,94 @@
+#ifndef RENDERSERVICE_H
+#define RENDERSERVICE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "httpserver.hpp"
+#include "json.hpp"
+#include "../waRayTrace/scene.hpp"
+
+namespace waRT {
+    constexpr int JOB_QUEUED    = 0;
+    constexpr int JOB_RUNNING   = 1;
+    constexpr int JOB_DONE      = 2;
+    constexpr int JOB_CANCELLED = 3;
+    constexpr int JOB_FAILED    = 4;
+
+    class RenderService {
+    public:
+        RenderService(int maxConcurrentJobs);
+        ~RenderService();
+
+        void SetRenderCache(const std::shared_ptr<waRT::RenderCache> &renderCache);
+        void SetAccelerationDir(const std::string &accelerationDir);
+        waRT::HttpResponse Handle(const waRT::HttpRequest &request);
+        void Shutdown();
+
+    private:
+        struct ResidentScene {
+            std::mutex  mutex;
+            waRT::Scene scene;
+            int         jobsRendered = 0;
+        };
+
+        struct Job {
+            int id;
+            int priority;
+            int threads;
+            int samples;
+            uint32_t seed;
+            std::vector<waRT::RenderRegion> regions;
+            waRT::RenderBudget budget;
+            int xSize, ySize;
+            int numTilesX, numTilesY;
+            std::string     sceneName;
+            waRT::JsonValue deltas;
+            std::atomic<int> state;
+            waRT::RenderControl control;
+            std::unique_ptr<waImage> image;
+            std::unique_ptr<std::atomic<bool>[]> tileDone;
+            waRT::RenderStats stats;
+            std::string error;
+        };
+
+    private:
+        void WorkerLoop();
+        void RunJob(const std::shared_ptr<Job> &job);
+        void RetireOldJobs();
+        std::shared_ptr<ResidentScene> FindScene(const std::string &name, bool create);
+        std::shared_ptr<Job> FindJob(int id);
+        static std::string AccelerationFileName(const std::string &accelerationDir, const std::string &sceneName);
+        static bool ApplyDeltas(waRT::Scene &scene, const waRT::JsonValue &deltas, std::string &error);
+
+        waRT::HttpResponse GetStatus();
+        waRT::HttpResponse PostScene(const std::string &name, const waRT::HttpRequest &request);
+        waRT::HttpResponse PostJob(const waRT::HttpRequest &request);
+        waRT::HttpResponse GetJob(const std::shared_ptr<Job> &job);
+        waRT::HttpResponse GetImage(const std::shared_ptr<Job> &job);
+        waRT::HttpResponse GetTile(const std::shared_ptr<Job> &job, int tileIndex);
+        static bool QueueOrder(const std::shared_ptr<Job> &a, const std::shared_ptr<Job> &b);
+        static std::string JobToJson(Job &job);
+        static waRT::HttpResponse Error(int status, const std::string &message);
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_wakeup;
+        std::vector<std::shared_ptr<Job>> m_queue;
+        std::map<int, std::shared_ptr<Job>> m_jobs;
+        std::map<std::string, std::shared_ptr<ResidentScene>> m_scenes;
+        std::vector<std::thread> m_workers;
+        std::shared_ptr<waRT::RenderCache> m_renderCache;
+        std::string m_accelerationDir;
+        int  m_nextJobId;
+        int  m_runningJobs;
+        bool m_stopping;
+    };
+}
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include <algorithm>
+#include <limits>
+
+namespace waRT {
+    struct AABB {
+        double boxMin[3] = { std::numeric_limits<double>::infinity(),  std::numeric_limits<double>::infinity(),  std::numeric_limits<double>::infinity()};
+        double boxMax[3] = {-std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()};
+
+        void Grow(const double *point) {
+            for (int i = 0; i < 3; ++i) {
+                boxMin[i] = std::min(boxMin[i], point[i]);
+                boxMax[i] = std::max(boxMax[i], point[i]);
+            }
+        }
+
+        void Grow(const AABB &other) {
+            for (int i = 0; i < 3; ++i) {
+                boxMin[i] = std::min(boxMin[i], other.boxMin[i]);
+                boxMax[i] = std::max(boxMax[i], other.boxMax[i]);
+            }
+        }
+
+        bool IsEmpty() const { return boxMin[0] > boxMax[0];}
+
+        double Centroid(int axis) const { return 0.5 * (boxMin[axis] + boxMax[axis]);}
+
+        double HalfArea() const {
+            if (IsEmpty()) {
+                return 0.0;
+            }
+            double dx = boxMax[0] - boxMin[0];
+            double dy = boxMax[1] - boxMin[1];
+            double dz = boxMax[2] - boxMin[2];
+            return dx * dy + dy * dz + dz * dx;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,42 @@
+/*
+    These functions count calls to the global allocator so we can check that the render hot path does not allocate.
+
+    1. **Enabling**:
+       - Counting is compiled in only when the engine is built with `-DWART_COUNT_ALLOCS` (add it to `CFLAGS` in the makefile). In that case this file replaces the global `operator new` and `operator delete`, and every allocation made by a thread increments that thread's counter.
+       - Without the flag nothing is replaced, `AllocationCountingEnabled()` returns `false` and the count is always zero, so normal builds pay nothing.
+
+    2. **Reading the Counter (`GetThreadAllocationCount`)**:
+       - The counter is thread local, so taking the difference before and after a piece of work gives the number of allocations that work made on the calling thread, without any atomic traffic. `Scene::Render` does this around every tile and reports the total in its `RenderStats`.
+*/
+
+#include "allocstats.hpp"
+#include <cstdlib>
+#include <new>
+
+#ifdef WART_COUNT_ALLOCS
+static thread_local uint64_t g_threadAllocations = 0;
+
+void *operator new(std::size_t size) {
+    ++g_threadAllocations;
+    void *memory = std::malloc(size ? size : 1);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void *operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *memory) noexcept { std::free(memory);}
+void operator delete[](void *memory) noexcept { std::free(memory);}
+void operator delete(void *memory, std::size_t) noexcept { std::free(memory);}
+void operator delete[](void *memory, std::size_t) noexcept { std::free(memory);}
+
+bool waRT::AllocationCountingEnabled() { return true;}
+uint64_t waRT::GetThreadAllocationCount() { return g_threadAllocations;}
+#else
+bool waRT::AllocationCountingEnabled() { return false;}
+uint64_t waRT::GetThreadAllocationCount() { return 0;}
+#endif
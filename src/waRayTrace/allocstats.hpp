@@ -0,0 +1,11 @@
+#ifndef ALLOCSTATS_H
+#define ALLOCSTATS_H
+
+#include <cstdint>
+
+namespace waRT {
+    bool     AllocationCountingEnabled();
+    uint64_t GetThreadAllocationCount();
+}
+
+#endif
@@ -0,0 +1,336 @@
+/*
+    The `BVH` class is a bounding volume hierarchy over a list of axis-aligned boxes. It knows nothing about the primitives themselves: the caller passes one box per primitive, and traversal reports the leaves a ray passes through so the caller can test its own primitives there. The primitive set builds one BVH per primitive type (see `primitives/primitiveset.cpp`).
+
+    1. **Layout**:
+       - Nodes live in one array (`m_nodes`), the root is node 0. An interior node stores the index of its left child; the right child always follows it, so children are allocated in pairs. A leaf stores the first primitive and the primitive count.
+       - `GetPrimitiveOrder()` returns the order the primitives end up in after the build. The caller reorders its own arrays the same way, so every leaf covers a contiguous range and the leaf loop streams through memory.
+
+    2. **Parallel Build (`Build`)**:
+       - A top-down binned SAH builder. For each node the primitive centroids are sorted into `BIN_COUNT` bins along each of the three axes, and the split with the lowest surface area heuristic cost (`area(left) * count(left) + area(right) * count(right)`) is chosen. If no split is cheaper than a leaf and the node is small, it becomes a leaf. A node whose centroids all coincide, or whose best split puts everything on one side, is split at the median instead.
+       - Task parallelism: when a node with more than `PARALLEL_SUBTREE` primitives is split and fewer than `numThreads` tasks are running, its left child is built on a new thread while the current thread continues with the right child. Tasks work on disjoint ranges of the primitive array and take their child pairs from an atomic counter, so they need no other synchronization.
+       - The bounds of the big nodes near the root are computed by several threads in parallel, because those passes run before there is enough parallel work for the task scheme.
+       - The tree is at most `BVH_STACK_SIZE - 2` levels deep, which keeps the fixed traversal stack safe.
+
+    3. **Refitting (`Refit`)**:
+       - For animated transforms the tree topology is kept and only the boxes are updated. Children are always allocated after their parent, so one reverse pass over the node array updates every node after its children. This is much cheaper than a rebuild, and the tree stays valid, although it slowly gets worse if objects move far.
+
+    4. **Traversal (`Traverse`)**:
+       - The ray is given with a precomputed inverse direction. Both children are tested with the slab test, the nearer one is visited first and the farther one is pushed with its entry distance. Popped nodes that start beyond the closest hit so far are skipped, so the leaf callback can shrink `tMax` to cull the rest of the tree.
+
+    5. **Compact Nodes (`Compact`)**:
+       - After a build the tree can be converted to `CompactBVHNode`s, which store the boxes as floats. Each bound is rounded outwards (`std::nextafter` when the float conversion moved it inwards), so every box still contains its primitives and traversal finds exactly the same hits, only a few more box tests may pass. A node takes 32 bytes instead of 56, and the double nodes are freed.
+       - `Refit()` works on compact trees too: the boxes are recomputed in double precision and rounded again. `Traverse()` uses whichever node array the tree has.
+       - `GetMemoryBytes()` reports what the tree holds, for the scene's memory report.
+       - `MapNodes()` makes the tree traverse compact nodes it does not own, straight from a memory mapped file (see `Scene::SetAccelerationFile`). Such a tree has no primitive order and cannot be refitted, and its nodes are not counted by `GetMemoryBytes()`, since they are file pages the kernel shares between processes.
+       - Copying a tree copies its nodes and primitive order only, the build's scratch arrays stay behind. The scene uses this for its per-node copies of the primitives (see `scene.cpp`).
+*/
+
+#include "bvh.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <thread>
+
+constexpr int    BIN_COUNT         = 16;
+constexpr int    PARALLEL_SUBTREE  = 4096;
+constexpr int    PARALLEL_BOUNDS   = 65536;
+constexpr int    MAX_BUILD_DEPTH   = waRT::BVH_STACK_SIZE - 2;
+constexpr int    MAX_SAH_LEAF_SIZE = 16;
+
+waRT::BVH::BVH() {
+    m_nodeCount      = 0;
+    m_activeTasks    = 0;
+    m_numThreads     = 1;
+    m_mappedNodes    = nullptr;
+    m_numMappedNodes = 0;
+}
+
+waRT::BVH::BVH(const waRT::BVH &other) : BVH() {
+    *this = other;
+}
+
+waRT::BVH &waRT::BVH::operator= (const waRT::BVH &other) {
+    if (this != &other) {
+        m_nodes          = other.m_nodes;
+        m_compactNodes   = other.m_compactNodes;
+        m_mappedNodes    = other.m_mappedNodes;
+        m_numMappedNodes = other.m_numMappedNodes;
+        m_primOrder      = other.m_primOrder;
+        m_numThreads     = other.m_numThreads;
+    }
+    return *this;
+}
+
+void waRT::BVH::Clear() {
+    m_nodes.clear();
+    m_compactNodes.clear();
+    m_primOrder.clear();
+    m_mappedNodes    = nullptr;
+    m_numMappedNodes = 0;
+}
+
+// swap the double nodes for float ones, rounding every box outwards so it still contains its primitives
+void waRT::BVH::Compact() {
+    m_compactNodes.resize(m_nodes.size());
+    for (size_t i = 0; i < m_nodes.size(); ++i) {
+        StoreCompactNode(m_nodes[i].bounds, m_nodes[i].leftFirst, m_nodes[i].count, m_compactNodes[i]);
+    }
+    m_nodes.clear();
+    m_nodes.shrink_to_fit();
+}
+
+void waRT::BVH::MapNodes(const waRT::CompactBVHNode *nodes, size_t numNodes) {
+    Clear();
+    m_mappedNodes    = (numNodes > 0) ? nodes : nullptr;
+    m_numMappedNodes = (numNodes > 0) ? numNodes : 0;
+}
+
+void waRT::BVH::Build(const std::vector<waRT::AABB> &primBounds, int numThreads) {
+    int numPrims = static_cast<int>(primBounds.size());
+    m_nodes.clear();
+    m_compactNodes.clear();
+    m_mappedNodes    = nullptr;
+    m_numMappedNodes = 0;
+    m_primOrder.resize(numPrims);
+    if (numPrims == 0) {
+        return;
+    }
+
+    m_numThreads  = std::max(1, numThreads);
+    m_buildBounds = primBounds;
+    m_centroids.resize(static_cast<size_t>(numPrims) * 3);
+    for (int i = 0; i < numPrims; ++i) {
+        m_primOrder[i] = i;
+        for (int axis = 0; axis < 3; ++axis) {
+            m_centroids[static_cast<size_t>(i) * 3 + axis] = primBounds[i].Centroid(axis);
+        }
+    }
+
+    // a binary tree over n leaves of at least one primitive has at most 2n - 1 nodes
+    m_nodes.resize(static_cast<size_t>(numPrims) * 2);
+    m_nodeCount   = 1;
+    m_activeTasks = 1;
+    BuildNode(0, 0, numPrims, 0);
+    m_nodes.resize(m_nodeCount);
+    m_nodes.shrink_to_fit();
+
+    m_buildBounds.clear();
+    m_buildBounds.shrink_to_fit();
+    m_centroids.clear();
+    m_centroids.shrink_to_fit();
+}
+
+void waRT::BVH::Refit(const std::vector<waRT::AABB> &orderedBounds) {
+    if (m_mappedNodes != nullptr) {
+        return;
+    }
+    if (!m_compactNodes.empty()) {
+        // refit in double precision on the side, then round into the compact nodes
+        std::vector<waRT::AABB> nodeBounds(m_compactNodes.size());
+        for (int nodeIndex = static_cast<int>(m_compactNodes.size()) - 1; nodeIndex >= 0; --nodeIndex) {
+            waRT::CompactBVHNode &node = m_compactNodes[nodeIndex];
+            if (node.count > 0) {
+                for (int i = node.leftFirst; i < node.leftFirst + node.count; ++i) {
+                    nodeBounds[nodeIndex].Grow(orderedBounds[i]);
+                }
+            } else {
+                nodeBounds[nodeIndex].Grow(nodeBounds[node.leftFirst]);
+                nodeBounds[nodeIndex].Grow(nodeBounds[node.leftFirst + 1]);
+            }
+            StoreCompactNode(nodeBounds[nodeIndex], node.leftFirst, node.count, node);
+        }
+        return;
+    }
+    for (int nodeIndex = static_cast<int>(m_nodes.size()) - 1; nodeIndex >= 0; --nodeIndex) {
+        waRT::BVHNode &node = m_nodes[nodeIndex];
+        node.bounds = waRT::AABB();
+        if (node.count > 0) {
+            for (int i = node.leftFirst; i < node.leftFirst + node.count; ++i) {
+                node.bounds.Grow(orderedBounds[i]);
+            }
+        } else {
+            node.bounds.Grow(m_nodes[node.leftFirst].bounds);
+            node.bounds.Grow(m_nodes[node.leftFirst + 1].bounds);
+        }
+    }
+}
+
+// GETTERS
+const std::vector<int> &waRT::BVH::GetPrimitiveOrder() { return m_primOrder;}
+size_t waRT::BVH::GetNumNodes() { return m_nodes.size() + m_compactNodes.size() + m_numMappedNodes;}
+bool waRT::BVH::IsEmpty() { return GetNumNodes() == 0;}
+bool waRT::BVH::IsCompact() { return !m_compactNodes.empty() || (m_mappedNodes != nullptr);}
+bool waRT::BVH::IsMapped() { return m_mappedNodes != nullptr;}
+
+const waRT::CompactBVHNode *waRT::BVH::GetCompactNodes() {
+    return (m_mappedNodes != nullptr) ? m_mappedNodes : (m_compactNodes.empty() ? nullptr : m_compactNodes.data());
+}
+
+size_t waRT::BVH::GetMemoryBytes() {
+    return m_nodes.capacity() * sizeof(waRT::BVHNode) + m_compactNodes.capacity() * sizeof(waRT::CompactBVHNode) +
+           m_primOrder.capacity() * sizeof(int);
+}
+
+// private funks
+
+void waRT::BVH::StoreCompactNode(const waRT::AABB &bounds, int leftFirst, int count, waRT::CompactBVHNode &node) {
+    for (int axis = 0; axis < 3; ++axis) {
+        float lower = static_cast<float>(bounds.boxMin[axis]);
+        float upper = static_cast<float>(bounds.boxMax[axis]);
+        if (static_cast<double>(lower) > bounds.boxMin[axis]) {
+            lower = std::nextafter(lower, -std::numeric_limits<float>::infinity());
+        }
+        if (static_cast<double>(upper) < bounds.boxMax[axis]) {
+            upper = std::nextafter(upper, std::numeric_limits<float>::infinity());
+        }
+        node.boundsMin[axis] = lower;
+        node.boundsMax[axis] = upper;
+    }
+    node.leftFirst = leftFirst;
+    node.count     = count;
+}
+
+void waRT::BVH::ComputeBounds(int begin, int end, waRT::AABB &bounds, waRT::AABB &centroidBounds) {
+    auto accumulate = [this](int first, int last, waRT::AABB &box, waRT::AABB &centroidBox) {
+        for (int i = first; i < last; ++i) {
+            int prim = m_primOrder[i];
+            box.Grow(m_buildBounds[prim]);
+            centroidBox.Grow(&m_centroids[static_cast<size_t>(prim) * 3]);
+        }
+    };
+
+    int count = end - begin;
+    int numChunks = std::min(m_numThreads, count / PARALLEL_BOUNDS);
+    if (numChunks <= 1) {
+        accumulate(begin, end, bounds, centroidBounds);
+        return;
+    }
+
+    std::vector<waRT::AABB> chunkBounds(numChunks);
+    std::vector<waRT::AABB> chunkCentroids(numChunks);
+    std::vector<std::thread> threads;
+    int chunkSize = (count + numChunks - 1) / numChunks;
+    for (int chunk = 0; chunk < numChunks; ++chunk) {
+        int first = begin + chunk * chunkSize;
+        int last  = std::min(end, first + chunkSize);
+        threads.emplace_back(accumulate, first, last, std::ref(chunkBounds[chunk]), std::ref(chunkCentroids[chunk]));
+    }
+    for (int chunk = 0; chunk < numChunks; ++chunk) {
+        threads[chunk].join();
+        bounds.Grow(chunkBounds[chunk]);
+        centroidBounds.Grow(chunkCentroids[chunk]);
+    }
+}
+
+void waRT::BVH::BuildNode(int nodeIndex, int begin, int end, int depth) {
+    waRT::AABB bounds, centroidBounds;
+    ComputeBounds(begin, end, bounds, centroidBounds);
+
+    waRT::BVHNode &node = m_nodes[nodeIndex];
+    node.bounds    = bounds;
+    node.leftFirst = begin;
+    node.count     = end - begin;
+
+    int count = end - begin;
+    if ((count <= BVH_MAX_LEAF_SIZE) || (depth >= MAX_BUILD_DEPTH)) {
+        return;
+    }
+
+    // bin the centroids along all three axes
+    struct Bin {
+        waRT::AABB bounds;
+        int count = 0;
+    };
+    Bin bins[3][BIN_COUNT];
+    double binScale[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        double extent = centroidBounds.boxMax[axis] - centroidBounds.boxMin[axis];
+        binScale[axis] = (extent > 0.0) ? (BIN_COUNT * (1.0 - 1e-9)) / extent : 0.0;
+    }
+    for (int i = begin; i < end; ++i) {
+        int prim = m_primOrder[i];
+        for (int axis = 0; axis < 3; ++axis) {
+            int bin = static_cast<int>((m_centroids[static_cast<size_t>(prim) * 3 + axis] - centroidBounds.boxMin[axis]) * binScale[axis]);
+            bins[axis][bin].bounds.Grow(m_buildBounds[prim]);
+            bins[axis][bin].count++;
+        }
+    }
+
+    // sweep the bins from both sides to find the cheapest split
+    double bestCost  = INFINITY;
+    int    bestAxis  = -1;
+    int    bestSplit = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (binScale[axis] == 0.0) {
+            continue;
+        }
+        double rightArea[BIN_COUNT];
+        int    rightCount[BIN_COUNT];
+        waRT::AABB rightBox;
+        int rightSum = 0;
+        for (int bin = BIN_COUNT - 1; bin > 0; --bin) {
+            rightBox.Grow(bins[axis][bin].bounds);
+            rightSum += bins[axis][bin].count;
+            rightArea[bin]  = rightBox.HalfArea();
+            rightCount[bin] = rightSum;
+        }
+        waRT::AABB leftBox;
+        int leftSum = 0;
+        for (int split = 1; split < BIN_COUNT; ++split) {
+            leftBox.Grow(bins[axis][split - 1].bounds);
+            leftSum += bins[axis][split - 1].count;
+            if ((leftSum == 0) || (rightCount[split] == 0)) {
+                continue;
+            }
+            double cost = leftBox.HalfArea() * leftSum + rightArea[split] * rightCount[split];
+            if (cost < bestCost) {
+                bestCost  = cost;
+                bestAxis  = axis;
+                bestSplit = split;
+            }
+        }
+    }
+
+    int mid = begin;
+    if (bestAxis >= 0) {
+        double leafCost = bounds.HalfArea() * count;
+        if ((bestCost >= leafCost) && (count <= MAX_SAH_LEAF_SIZE)) {
+            return;
+        }
+        double splitMin   = centroidBounds.boxMin[bestAxis];
+        double splitScale = binScale[bestAxis];
+        int   *order      = m_primOrder.data();
+        mid = static_cast<int>(std::partition(order + begin, order + end, [&](int prim) {
+            return static_cast<int>((m_centroids[static_cast<size_t>(prim) * 3 + bestAxis] - splitMin) * splitScale) < bestSplit;
+        }) - order);
+    }
+    if ((mid == begin) || (mid == end)) {
+        // all centroids coincide: any split is as good as another
+        mid = begin + count / 2;
+    }
+
+    int leftChild = m_nodeCount.fetch_add(2);
+    node.leftFirst = leftChild;
+    node.count     = 0;
+
+    bool spawn = false;
+    if ((count > PARALLEL_SUBTREE) && (m_activeTasks.load() < m_numThreads)) {
+        spawn = (m_activeTasks.fetch_add(1) < m_numThreads);
+        if (!spawn) {
+            m_activeTasks.fetch_sub(1);
+        }
+    }
+
+    if (spawn) {
+        std::thread leftTask([this, leftChild, begin, mid, depth]() {
+            BuildNode(leftChild, begin, mid, depth + 1);
+            m_activeTasks.fetch_sub(1);
+        });
+        BuildNode(leftChild + 1, mid, end, depth + 1);
+        leftTask.join();
+    } else {
+        BuildNode(leftChild, begin, mid, depth + 1);
+        BuildNode(leftChild + 1, mid, end, depth + 1);
+    }
+}
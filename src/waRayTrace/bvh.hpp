@@ -0,0 +1,170 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "aabb.hpp"
+
+namespace waRT {
+    constexpr int BVH_MAX_LEAF_SIZE = 4;
+    constexpr int BVH_STACK_SIZE    = 64;
+
+    // interior nodes have count == 0 and their children at leftFirst and leftFirst + 1,
+    // leaves cover primitives [leftFirst, leftFirst + count) in build order
+    struct BVHNode {
+        waRT::AABB bounds;
+        int leftFirst;
+        int count;
+    };
+
+    // the same node with float bounds rounded outwards, 32 instead of 56 bytes
+    struct CompactBVHNode {
+        float boundsMin[3];
+        float boundsMax[3];
+        int32_t leftFirst;
+        int32_t count;
+    };
+
+    class BVH {
+    public:
+        BVH();
+        // copies the finished tree, not the build's scratch
+        BVH(const BVH &other);
+        BVH &operator= (const BVH &other);
+
+        void Build(const std::vector<waRT::AABB> &primBounds, int numThreads);
+        void Refit(const std::vector<waRT::AABB> &orderedBounds);
+        void Clear();
+        void Compact();
+        // traverses nodes that live elsewhere, e.g. in a mapped file, which must outlive the tree; such a tree cannot be refitted
+        void MapNodes(const waRT::CompactBVHNode *nodes, size_t numNodes);
+
+        const std::vector<int> &GetPrimitiveOrder();
+        size_t GetNumNodes();
+        bool IsEmpty();
+        bool IsCompact();
+        bool IsMapped();
+        // the float nodes, mapped or owned, or nullptr if the tree is not compact
+        const waRT::CompactBVHNode *GetCompactNodes();
+        size_t GetMemoryBytes();
+
+        // calls leafFunc(first, count) for every leaf the ray reaches before tMax, nearest first;
+        // leafFunc may lower tMax
+        template <class LeafFunc>
+        void Traverse(const double *origin, const double *invDir, double &tMax, LeafFunc &&leafFunc) const;
+
+    private:
+        template <class Node, class LeafFunc>
+        static void TraverseNodes(const Node *nodes, size_t numNodes, const double *origin, const double *invDir, double &tMax, LeafFunc &leafFunc);
+        void BuildNode(int nodeIndex, int begin, int end, int depth);
+        void ComputeBounds(int begin, int end, waRT::AABB &bounds, waRT::AABB &centroidBounds);
+        static bool IntersectBox(const waRT::BVHNode &node, const double *origin, const double *invDir, double tMax, double &tEntry);
+        static bool IntersectBox(const waRT::CompactBVHNode &node, const double *origin, const double *invDir, double tMax, double &tEntry);
+        static void StoreCompactNode(const waRT::AABB &bounds, int leftFirst, int count, waRT::CompactBVHNode &node);
+
+    private:
+        std::vector<waRT::BVHNode> m_nodes;
+        std::vector<waRT::CompactBVHNode> m_compactNodes;
+        const waRT::CompactBVHNode *m_mappedNodes;
+        size_t m_numMappedNodes;
+        std::vector<int> m_primOrder;
+        std::vector<waRT::AABB> m_buildBounds;
+        std::vector<double> m_centroids;
+        std::atomic<int> m_nodeCount;
+        std::atomic<int> m_activeTasks;
+        int m_numThreads;
+    };
+}
+
+inline bool waRT::BVH::IntersectBox(const waRT::BVHNode &node, const double *origin, const double *invDir, double tMax, double &tEntry) {
+    double tNear = 0.0;
+    double tFar  = tMax;
+    for (int axis = 0; axis < 3; ++axis) {
+        double t0 = (node.bounds.boxMin[axis] - origin[axis]) * invDir[axis];
+        double t1 = (node.bounds.boxMax[axis] - origin[axis]) * invDir[axis];
+        tNear = std::max(tNear, std::min(t0, t1));
+        tFar  = std::min(tFar,  std::max(t0, t1));
+    }
+    tEntry = tNear;
+    return tNear <= tFar;
+}
+
+inline bool waRT::BVH::IntersectBox(const waRT::CompactBVHNode &node, const double *origin, const double *invDir, double tMax, double &tEntry) {
+    double tNear = 0.0;
+    double tFar  = tMax;
+    for (int axis = 0; axis < 3; ++axis) {
+        double t0 = (static_cast<double>(node.boundsMin[axis]) - origin[axis]) * invDir[axis];
+        double t1 = (static_cast<double>(node.boundsMax[axis]) - origin[axis]) * invDir[axis];
+        tNear = std::max(tNear, std::min(t0, t1));
+        tFar  = std::min(tFar,  std::max(t0, t1));
+    }
+    tEntry = tNear;
+    return tNear <= tFar;
+}
+
+template <class LeafFunc>
+void waRT::BVH::Traverse(const double *origin, const double *invDir, double &tMax, LeafFunc &&leafFunc) const {
+    if (m_mappedNodes != nullptr) {
+        TraverseNodes(m_mappedNodes, m_numMappedNodes, origin, invDir, tMax, leafFunc);
+    } else if (!m_compactNodes.empty()) {
+        TraverseNodes(m_compactNodes.data(), m_compactNodes.size(), origin, invDir, tMax, leafFunc);
+    } else {
+        TraverseNodes(m_nodes.data(), m_nodes.size(), origin, invDir, tMax, leafFunc);
+    }
+}
+
+template <class Node, class LeafFunc>
+void waRT::BVH::TraverseNodes(const Node *nodes, size_t numNodes, const double *origin, const double *invDir, double &tMax, LeafFunc &leafFunc) {
+    if (numNodes == 0) {
+        return;
+    }
+    double tEntry;
+    if (!IntersectBox(nodes[0], origin, invDir, tMax, tEntry)) {
+        return;
+    }
+
+    int    stack[BVH_STACK_SIZE];
+    double stackEntry[BVH_STACK_SIZE];
+    int    stackSize = 0;
+    int    nodeIndex = 0;
+    while (true) {
+        const Node &node = nodes[nodeIndex];
+        if (node.count > 0) {
+            leafFunc(node.leftFirst, node.count);
+        } else {
+            double tLeft, tRight;
+            bool hitLeft  = IntersectBox(nodes[node.leftFirst],     origin, invDir, tMax, tLeft);
+            bool hitRight = IntersectBox(nodes[node.leftFirst + 1], origin, invDir, tMax, tRight);
+            if (hitLeft && hitRight) {
+                // visit the nearer child first, keep the other for later
+                int nearChild = (tLeft <= tRight) ? node.leftFirst : node.leftFirst + 1;
+                stack[stackSize]      = (tLeft <= tRight) ? node.leftFirst + 1 : node.leftFirst;
+                stackEntry[stackSize] = (tLeft <= tRight) ? tRight : tLeft;
+                ++stackSize;
+                nodeIndex = nearChild;
+                continue;
+            }
+            if (hitLeft || hitRight) {
+                nodeIndex = hitLeft ? node.leftFirst : node.leftFirst + 1;
+                continue;
+            }
+        }
+
+        // pop, skipping nodes that start beyond the closest hit found so far
+        bool found = false;
+        while (stackSize > 0) {
+            --stackSize;
+            if (stackEntry[stackSize] <= tMax) {
+                nodeIndex = stack[stackSize];
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return;
+        }
+    }
+}
+
+#endif
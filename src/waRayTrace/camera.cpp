@@ -22,7 +22,7 @@
        - The method also scales `m_projectionScreenU` and `m_projectionScreenV` by the horizontal size and adjusts for the aspect ratio to ensure proper projection scaling.
 
     4. **Ray Generation (`GenerateRay`)**:
-       This method generates a ray that originates from the camera and passes through a given point on the projection screen. It takes two parameters `proScreenX` and `proScreenY`, which represent normalized coordinates on the projection screen. The steps are as follows:
+       This method generates a ray that originates from the camera and passes through a given point on the projection screen. It takes two parameters `proScreenX` and `proScreenY`, which represent normalized coordinates on the projection screen (as doubles, so pixel positions are not rounded to float on the way). The steps are as follows:
        - `screenWorldPart1`: Computes the world coordinate along the horizontal direction of the projection screen based on `proScreenX`.
        - `screenWorldCoordinate`: Adds the vertical displacement (using `proScreenY`) to find the final world coordinates of the point on the projection screen.
        - The ray (`cameraRay`) is then created:
@@ -30,8 +30,34 @@
            - `m_point2`: The ray's destination is set to the computed screen world coordinate.
            - `m_lab`: The direction of the ray is the difference between the screen world coordinate and the camera's position.
 
+       The computation is done one element at a time and written straight into the existing ray, so generating a ray allocates nothing.
+
+       The overload that also takes `pixelSizeX` and `pixelSizeY` (the size of one pixel in the same normalized screen coordinates) additionally fills the ray differentials: the origins and directions of the rays through the next pixel to the right and the next pixel down. All camera rays share the camera position, so only the directions differ.
+
        This function allows the camera to cast rays into the scene based on screen coordinates, which is essential for ray tracing as it projects rays from the camera into the 3D world.
 
+    5. **Lens Models**:
+       - `SetProjection()` picks how screen coordinates map to directions:
+         - `PROJECTION_PERSPECTIVE` (the default) is the projection screen described above.
+         - `PROJECTION_EQUIRECTANGULAR` covers the full sphere around the camera: `x` from -1 to 1 is the longitude from -180 to 180 degrees around the up vector (0 looks at the look-at point) and `y` is the latitude from -90 to 90 degrees. Use an image twice as wide as it is high.
+         - `PROJECTION_FISHEYE` is an equidistant fisheye: the angle from the view direction grows linearly with the distance from the image centre, reaching half of `SetFieldOfView()` at the left and right edges. The circle is kept round for any aspect ratio, and points outside it produce no ray (`GenerateRay()` returns `false`).
+       - `SetAperture()` turns the perspective camera into a thin lens with that radius. Rays start on a disk around the camera position (the lens sample mapped with the concentric disk mapping) and all rays for one screen point meet at the plane `SetFocusDistance()` in front of the camera, so only that plane is sharp. A focus distance of 0 focuses on the projection screen. The panoramic projections have no lens.
+       - `SetShutter()` sets the time interval the shutter is open. Each ray gets a time in it from the sample's `time`, which moving objects use to blur (see `ObjectBase::GetTransformAt()`). The default `[0, 0]` freezes everything at time 0.
+       - `GenerateRay(const CameraSample &, ...)` takes all of these at once: a screen position, a point on the lens and a point in the shutter, usually from the scene's `Sampler`. The two coordinate overloads use the lens centre and the shutter opening time.
+
+    6. **Batched Generation (`GenerateRays`)**:
+       - Fills a `RayBatch` with the rays for many samples at once, for example a row of a tile with all its samples. The batch holds origins, targets (`m_point2`) and times as separate arrays, and each projection has its own tight loop over plain doubles copied from the camera, so the compiler can vectorize it and nothing goes through `qbVector` per ray.
+       - `RayBatch::GetRay()` copies one ray out in place. It gives exactly the ray `GenerateRay()` would.
+       - `RayBatch::Resize()` only allocates when a batch grows past its largest size so far, so a render thread that keeps its batch allocates once.
+
+    7. **View Bounds (`GetViewFrustum`, `GetPixelsPerRadian`, `ProjectPoint`)**:
+       - `GetViewFrustum()` gives the four side planes of the pyramid from the camera position through the edges of the screen, widened by `marginX` and `marginY` in screen coordinates (the scene passes one pixel, since samples may sit half a pixel outside). Normals point inwards, so `dot(normal, p) + d < 0` is outside. Anything outside one of the planes cannot be reached by a camera ray. Only pinhole perspective cameras have such a pyramid, so it returns `false` for the panoramic projections and with a lens aperture.
+       - `GetPixelsPerRadian()` is the image width in pixels divided by the horizontal angle it covers (measured at the centre for perspective). Together with an object's angular size it gives how many pixels the object covers, which drives level of detail.
+       - `ProjectPoint()` is the inverse of `GenerateRay()` for a pinhole perspective camera: the screen coordinates whose ray passes through a world point, and the point's depth along the view direction. Points at or behind the camera plane (and the other projections) return `false`. The visibility buffer uses it to rasterize bounding boxes.
+
+    8. **Serialization (`Serialize`)**:
+       Writes the position, look-at, up vector, length, horizontal size and aspect ratio, then the projection, aperture, focus distance, field of view and shutter as one line of hex floats, so two cameras produce the same text only if they generate exactly the same rays. Used to key the render cache.
+
     Summary:
     - The `Camera` class is critical in defining how rays are generated from a camera's viewpoint into a 3D scene.
     - It handles orientation, projection geometry, and ray generation, all of which are fundamental for correctly tracing rays in a ray tracing engine.
@@ -49,6 +75,16 @@ waRT::Camera::Camera() {
     m_cameraLength      = 1.0;
     m_cameraHorzSize    = 1.0;
     m_cameraAspectRatio = 1.0;
+    m_projection    = waRT::PROJECTION_PERSPECTIVE;
+    m_aperture      = 0.0;
+    m_focusDistance = 0.0;
+    m_fieldOfView   = M_PI;
+    m_shutterOpen   = 0.0;
+    m_shutterClose  = 0.0;
+    for (int i = 0; i < 3; ++i) {
+        m_position[i] = m_centre[i] = m_screenU[i] = m_screenV[i] = 0.0;
+        m_forward[i]  = m_rightHat[i] = m_upHat[i] = 0.0;
+    }
 }
 
 // SETTERS
@@ -58,6 +94,11 @@ void waRT::Camera::SetUp(const qbVector<double> &upVector)          { m_cameraUp
 void waRT::Camera::SetLength(double newLength)                      { m_cameraLength = newLength;}
 void waRT::Camera::SetHorzSize(double newHorzSize)                  { m_cameraHorzSize = newHorzSize;}
 void waRT::Camera::SetAspect(double newAspect)                      { m_cameraAspectRatio = newAspect;}
+void waRT::Camera::SetProjection(waRT::CameraProjection projection) { m_projection = projection;}
+void waRT::Camera::SetAperture(double radius)                       { m_aperture = (radius > 0.0) ? radius : 0.0;}
+void waRT::Camera::SetFocusDistance(double distance)                { m_focusDistance = (distance > 0.0) ? distance : 0.0;}
+void waRT::Camera::SetFieldOfView(double radians)                   { m_fieldOfView = radians;}
+void waRT::Camera::SetShutter(double open, double close)            { m_shutterOpen = open; m_shutterClose = close;}
 
 // GETTERS
 qbVector<double> waRT::Camera::GetPosition()     { return m_cameraPosition;}
@@ -66,6 +107,12 @@ qbVector<double> waRT::Camera::GetUp()           { return m_cameraUp;}
 double waRT::Camera::GetLength()                 { return m_cameraLength;}
 double waRT::Camera::GetHorzSize()               { return m_cameraHorzSize;}
 double waRT::Camera::GetAspect()                 { return m_cameraAspectRatio;}
+waRT::CameraProjection waRT::Camera::GetProjection() { return m_projection;}
+double waRT::Camera::GetAperture()               { return m_aperture;}
+double waRT::Camera::GetFocusDistance()          { return m_focusDistance;}
+double waRT::Camera::GetFieldOfView()            { return m_fieldOfView;}
+double waRT::Camera::GetShutterOpen()            { return m_shutterOpen;}
+double waRT::Camera::GetShutterClose()           { return m_shutterClose;}
 qbVector<double> waRT::Camera::GetU()            { return m_projectionScreenU;}
 qbVector<double> waRT::Camera::GetV()            { return m_projectionScreenV;}
 qbVector<double> waRT::Camera::GetScreenCenter() { return m_projectionScreenCentre;}
@@ -76,15 +123,277 @@ void waRT::Camera::UpdateCameraGeometry() {
     m_projectionScreenU      = (qbVector<double>::cross(m_alignmentVector, m_cameraUp)).Normalized();
     m_projectionScreenV      = qbVector<double>::cross(m_projectionScreenU, m_alignmentVector);
     m_projectionScreenCentre = m_cameraPosition + (m_cameraLength * m_alignmentVector);
+    for (int i = 0; i < 3; ++i) {
+        m_rightHat[i] = m_projectionScreenU.GetElement(i);
+        m_upHat[i]    = m_projectionScreenV.GetElement(i);
+    }
     m_projectionScreenU      = m_projectionScreenU * m_cameraHorzSize;
     m_projectionScreenV      = m_projectionScreenV * (m_cameraHorzSize / m_cameraAspectRatio);
+    for (int i = 0; i < 3; ++i) {
+        m_position[i] = m_cameraPosition.GetElement(i);
+        m_centre[i]   = m_projectionScreenCentre.GetElement(i);
+        m_screenU[i]  = m_projectionScreenU.GetElement(i);
+        m_screenV[i]  = m_projectionScreenV.GetElement(i);
+        m_forward[i]  = m_alignmentVector.GetElement(i);
+    }
+}
+
+bool waRT::Camera::GetViewFrustum(double marginX, double marginY, double planes[4][4]) {
+    if ((m_projection != waRT::PROJECTION_PERSPECTIVE) || (m_aperture > 0.0)) {
+        return false;
+    }
+    // the screen corners in order around the edge, each plane goes through the camera and two of them
+    const double cornerX[4] = {-1.0 - marginX,  1.0 + marginX, 1.0 + marginX, -1.0 - marginX};
+    const double cornerY[4] = {-1.0 - marginY, -1.0 - marginY, 1.0 + marginY,  1.0 + marginY};
+    double corners[4][3];
+    for (int c = 0; c < 4; ++c) {
+        for (int i = 0; i < 3; ++i) {
+            corners[c][i] = m_centre[i] + m_screenU[i] * cornerX[c] + m_screenV[i] * cornerY[c] - m_position[i];
+        }
+    }
+    for (int p = 0; p < 4; ++p) {
+        const double *a = corners[p];
+        const double *b = corners[(p + 1) % 4];
+        double normal[3] = {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+        // the centre of the screen is inside, flip the normal towards it
+        double side = 0.0;
+        for (int i = 0; i < 3; ++i) {
+            side += normal[i] * (m_centre[i] - m_position[i]);
+        }
+        double sign = (side < 0.0) ? -1.0 : 1.0;
+        double d = 0.0;
+        for (int i = 0; i < 3; ++i) {
+            planes[p][i] = normal[i] * sign;
+            d -= planes[p][i] * m_position[i];
+        }
+        planes[p][3] = d;
+    }
+    return true;
+}
+
+double waRT::Camera::GetPixelsPerRadian(int xSize) {
+    if (m_projection == waRT::PROJECTION_EQUIRECTANGULAR) {
+        return xSize / (2.0 * M_PI);
+    }
+    if (m_projection == waRT::PROJECTION_FISHEYE) {
+        return xSize / m_fieldOfView;
+    }
+    // the screen is 2 * horzSize wide at distance length
+    return xSize * m_cameraLength / (2.0 * m_cameraHorzSize);
+}
+
+bool waRT::Camera::ProjectPoint(const double *point, double &screenX, double &screenY, double &depth) {
+    if ((m_projection != waRT::PROJECTION_PERSPECTIVE) || (m_aperture > 0.0)) {
+        return false;
+    }
+    double offset[3];
+    depth = 0.0;
+    for (int i = 0; i < 3; ++i) {
+        offset[i] = point[i] - m_position[i];
+        depth    += offset[i] * m_forward[i];
+    }
+    if (depth <= 0.0) {
+        return false;
+    }
+    // where the ray through the point crosses the projection screen, relative to its centre
+    double scale = m_cameraLength / depth;
+    double alongU = 0.0, alongV = 0.0, lengthU = 0.0, lengthV = 0.0;
+    for (int i = 0; i < 3; ++i) {
+        double onScreen = offset[i] * scale - (m_centre[i] - m_position[i]);
+        alongU  += onScreen * m_screenU[i];
+        alongV  += onScreen * m_screenV[i];
+        lengthU += m_screenU[i] * m_screenU[i];
+        lengthV += m_screenV[i] * m_screenV[i];
+    }
+    screenX = alongU / lengthU;
+    screenY = alongV / lengthV;
+    return true;
+}
+
+void waRT::Camera::Serialize(std::ostream &out) {
+    out << "Camera ";
+    for (int i = 0; i < 3; ++i) {
+        out << std::hexfloat << m_cameraPosition.GetElement(i) << " "
+            << m_cameraLookAt.GetElement(i) << " "
+            << m_cameraUp.GetElement(i) << " ";
+    }
+    out << m_cameraLength << " " << m_cameraHorzSize << " " << m_cameraAspectRatio << " "
+        << static_cast<int>(m_projection) << " " << m_aperture << " " << m_focusDistance << " "
+        << m_fieldOfView << " " << m_shutterOpen << " " << m_shutterClose << std::defaultfloat << "\n";
+}
+
+bool waRT::Camera::GenerateRay(double proScreenX, double proScreenY, waRT::Ray &cameraRay) {
+    waRT::CameraSample sample;
+    sample.screenX = proScreenX;
+    sample.screenY = proScreenY;
+    return GenerateRay(sample, cameraRay);
 }
 
-bool waRT::Camera::GenerateRay(float proScreenX, float proScreenY, waRT::Ray &cameraRay) {
-    qbVector<double> screenWorldPart1      = m_projectionScreenCentre + (m_projectionScreenU * proScreenX);
-    qbVector<double> screenWorldCoordinate = screenWorldPart1 + (m_projectionScreenV * proScreenY);
-    cameraRay.m_point1 = m_cameraPosition;
-    cameraRay.m_point2 = screenWorldCoordinate;
-    cameraRay.m_lab    = screenWorldCoordinate - m_cameraPosition;
+bool waRT::Camera::GenerateRay(double proScreenX, double proScreenY, double pixelSizeX, double pixelSizeY, waRT::Ray &cameraRay) {
+    bool valid = GenerateRay(proScreenX, proScreenY, cameraRay);
+    if (m_projection == waRT::PROJECTION_PERSPECTIVE) {
+        // all pinhole rays share the camera position, only the directions differ
+        for (int i = 0; i < 3; ++i) {
+            cameraRay.m_rxPoint1.SetElement(i, m_position[i]);
+            cameraRay.m_ryPoint1.SetElement(i, m_position[i]);
+            cameraRay.m_rxLab.SetElement(i, (cameraRay.m_point2.GetElement(i) - m_position[i]) + m_screenU[i] * pixelSizeX);
+            cameraRay.m_ryLab.SetElement(i, (cameraRay.m_point2.GetElement(i) - m_position[i]) + m_screenV[i] * pixelSizeY);
+        }
+    } else {
+        waRT::CameraSample offsetSample;
+        double origin[3], target[3];
+        offsetSample.screenX = proScreenX + pixelSizeX;
+        offsetSample.screenY = proScreenY;
+        ComputeRay(offsetSample, origin, target);
+        for (int i = 0; i < 3; ++i) {
+            cameraRay.m_rxPoint1.SetElement(i, origin[i]);
+            cameraRay.m_rxLab.SetElement(i, target[i] - origin[i]);
+        }
+        offsetSample.screenX = proScreenX;
+        offsetSample.screenY = proScreenY + pixelSizeY;
+        ComputeRay(offsetSample, origin, target);
+        for (int i = 0; i < 3; ++i) {
+            cameraRay.m_ryPoint1.SetElement(i, origin[i]);
+            cameraRay.m_ryLab.SetElement(i, target[i] - origin[i]);
+        }
+    }
+    cameraRay.m_hasDifferentials = true;
+    return valid;
+}
+
+bool waRT::Camera::GenerateRay(const waRT::CameraSample &sample, waRT::Ray &cameraRay) {
+    // element-wise so the ray is filled in place without temporary vectors
+    double origin[3], target[3];
+    bool valid = ComputeRay(sample, origin, target);
+    for (int i = 0; i < 3; ++i) {
+        cameraRay.m_point1.SetElement(i, origin[i]);
+        cameraRay.m_point2.SetElement(i, target[i]);
+        cameraRay.m_lab.SetElement(i, target[i] - origin[i]);
+    }
+    cameraRay.m_time = m_shutterOpen + (m_shutterClose - m_shutterOpen) * sample.time;
+    cameraRay.m_hasDifferentials = false;
+    return valid;
+}
+
+void waRT::Camera::GenerateRays(const waRT::CameraSample *samples, size_t count, waRT::RayBatch &batch) {
+    batch.Resize(count);
+    double *ox = batch.originX.data(), *oy = batch.originY.data(), *oz = batch.originZ.data();
+    double *tx = batch.targetX.data(), *ty = batch.targetY.data(), *tz = batch.targetZ.data();
+    double *time = batch.time.data();
+    unsigned char *valid = batch.valid.data();
+
+    double shutterLength = m_shutterClose - m_shutterOpen;
+    for (size_t i = 0; i < count; ++i) {
+        time[i] = m_shutterOpen + shutterLength * samples[i].time;
+    }
+
+    if ((m_projection == waRT::PROJECTION_PERSPECTIVE) && (m_aperture <= 0.0)) {
+        // the common pinhole case, one straight loop the compiler can vectorize
+        for (size_t i = 0; i < count; ++i) {
+            double x = samples[i].screenX;
+            double y = samples[i].screenY;
+            ox[i] = m_position[0];
+            oy[i] = m_position[1];
+            oz[i] = m_position[2];
+            tx[i] = (m_centre[0] + (m_screenU[0] * x)) + (m_screenV[0] * y);
+            ty[i] = (m_centre[1] + (m_screenU[1] * x)) + (m_screenV[1] * y);
+            tz[i] = (m_centre[2] + (m_screenU[2] * x)) + (m_screenV[2] * y);
+            valid[i] = 1;
+        }
+        return;
+    }
+
+    double origin[3], target[3];
+    for (size_t i = 0; i < count; ++i) {
+        valid[i] = ComputeRay(samples[i], origin, target) ? 1 : 0;
+        ox[i] = origin[0];
+        oy[i] = origin[1];
+        oz[i] = origin[2];
+        tx[i] = target[0];
+        ty[i] = target[1];
+        tz[i] = target[2];
+    }
+}
+
+// private funks
+
+bool waRT::Camera::ComputeRay(const waRT::CameraSample &sample, double *origin, double *target) {
+    double x = sample.screenX;
+    double y = sample.screenY;
+
+    if (m_projection == waRT::PROJECTION_EQUIRECTANGULAR) {
+        double longitude = x * M_PI;
+        double latitude  = y * M_PI * 0.5;
+        double horizontal = cos(latitude);
+        for (int i = 0; i < 3; ++i) {
+            double direction = horizontal * (sin(longitude) * m_rightHat[i] + cos(longitude) * m_forward[i]) + sin(latitude) * m_upHat[i];
+            origin[i] = m_position[i];
+            target[i] = m_position[i] + direction;
+        }
+        return true;
+    }
+
+    if (m_projection == waRT::PROJECTION_FISHEYE) {
+        double scaledY = y / m_cameraAspectRatio;
+        double radius  = sqrt(x * x + scaledY * scaledY);
+        double theta   = radius * m_fieldOfView * 0.5;
+        double sinTheta = sin(theta);
+        double cosX = (radius > 0.0) ? x / radius : 0.0;
+        double cosY = (radius > 0.0) ? scaledY / radius : 0.0;
+        for (int i = 0; i < 3; ++i) {
+            double direction = sinTheta * (cosX * m_rightHat[i] + cosY * m_upHat[i]) + cos(theta) * m_forward[i];
+            origin[i] = m_position[i];
+            target[i] = m_position[i] + direction;
+        }
+        return radius <= 1.0;
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        origin[i] = m_position[i];
+        target[i] = (m_centre[i] + (m_screenU[i] * x)) + (m_screenV[i] * y);
+    }
+    if (m_aperture > 0.0) {
+        // concentric mapping of the lens sample onto the unit disk
+        double diskX = 2.0 * sample.lensU - 1.0;
+        double diskY = 2.0 * sample.lensV - 1.0;
+        double lensX = 0.0, lensY = 0.0;
+        if ((diskX != 0.0) || (diskY != 0.0)) {
+            double radius, angle;
+            if (fabs(diskX) > fabs(diskY)) {
+                radius = diskX;
+                angle  = (M_PI / 4.0) * (diskY / diskX);
+            } else {
+                radius = diskY;
+                angle  = (M_PI / 2.0) - (M_PI / 4.0) * (diskX / diskY);
+            }
+            lensX = radius * cos(angle) * m_aperture;
+            lensY = radius * sin(angle) * m_aperture;
+        }
+        // every ray through this screen point meets at the focus plane
+        double focusScale = (m_focusDistance > 0.0) ? m_focusDistance / m_cameraLength : 1.0;
+        for (int i = 0; i < 3; ++i) {
+            target[i]  = m_position[i] + (target[i] - m_position[i]) * focusScale;
+            origin[i] += lensX * m_rightHat[i] + lensY * m_upHat[i];
+        }
+    }
     return true;
-}
\ No newline at end of file
+}
+
+void waRT::RayBatch::Resize(size_t count) {
+    for (auto *column : {&originX, &originY, &originZ, &targetX, &targetY, &targetZ, &time}) {
+        column->resize(count);
+    }
+    valid.resize(count);
+}
+
+void waRT::RayBatch::GetRay(size_t index, waRT::Ray &ray) const {
+    double origin[3] = {originX[index], originY[index], originZ[index]};
+    double target[3] = {targetX[index], targetY[index], targetZ[index]};
+    for (int i = 0; i < 3; ++i) {
+        ray.m_point1.SetElement(i, origin[i]);
+        ray.m_point2.SetElement(i, target[i]);
+        ray.m_lab.SetElement(i, target[i] - origin[i]);
+    }
+    ray.m_time = time[index];
+    ray.m_hasDifferentials = false;
+}
@@ -1,10 +1,35 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
+#include <ostream>
+#include <vector>
 #include "./linAlgModule/qbVector.h"
 #include "ray.hpp"
 
 namespace waRT {
+    enum CameraProjection {
+        PROJECTION_PERSPECTIVE = 0,
+        PROJECTION_EQUIRECTANGULAR,
+        PROJECTION_FISHEYE
+    };
+
+    // screen position plus a point on the lens and in the shutter, each in [0, 1)
+    struct CameraSample {
+        double screenX = 0.0, screenY = 0.0;
+        double lensU   = 0.5, lensV   = 0.5;
+        double time    = 0.0;
+    };
+
+    // rays for a batch of camera samples, structure-of-arrays
+    struct RayBatch {
+        std::vector<double> originX, originY, originZ;
+        std::vector<double> targetX, targetY, targetZ;
+        std::vector<double> time;
+        std::vector<unsigned char> valid;
+        void Resize(size_t count);
+        void GetRay(size_t index, waRT::Ray &ray) const;
+    };
+
     class Camera {
     public:
         Camera();
@@ -15,6 +40,11 @@ namespace waRT {
         void SetLength(double newLength);
         void SetHorzSize(double newSize);
         void SetAspect(double newAspect);
+        void SetProjection(waRT::CameraProjection projection);
+        void SetAperture(double radius);
+        void SetFocusDistance(double distance);
+        void SetFieldOfView(double radians);
+        void SetShutter(double open, double close);
 
         qbVector<double> GetPosition();
         qbVector<double> GetLookAt();
@@ -25,13 +55,32 @@ namespace waRT {
         double GetLength();
         double GetHorzSize();
         double GetAspect();
+        waRT::CameraProjection GetProjection();
+        double GetAperture();
+        double GetFocusDistance();
+        double GetFieldOfView();
+        double GetShutterOpen();
+        double GetShutterClose();
 
         // generate the ray
-        bool GenerateRay(float proScreenX, float proScreenY, waRT::Ray &cameraRay);
+        bool GenerateRay(double proScreenX, double proScreenY, waRT::Ray &cameraRay);
+        bool GenerateRay(double proScreenX, double proScreenY, double pixelSizeX, double pixelSizeY, waRT::Ray &cameraRay);
+        bool GenerateRay(const waRT::CameraSample &sample, waRT::Ray &cameraRay);
+        void GenerateRays(const waRT::CameraSample *samples, size_t count, waRT::RayBatch &batch);
+
+        // view bounds for culling and level of detail
+        bool GetViewFrustum(double marginX, double marginY, double planes[4][4]);
+        double GetPixelsPerRadian(int xSize);
+        bool ProjectPoint(const double *point, double &screenX, double &screenY, double &depth);
 
         // update camera geom
         void UpdateCameraGeometry();
 
+        void Serialize(std::ostream &out);
+
+    private:
+        bool ComputeRay(const waRT::CameraSample &sample, double *origin, double *target);
+
     private:
         qbVector<double> m_cameraPosition{3};
         qbVector<double> m_cameraLookAt{3};
@@ -45,6 +94,17 @@ namespace waRT {
         qbVector<double> m_projectionScreenU{3};
         qbVector<double> m_projectionScreenV{3};
         qbVector<double> m_projectionScreenCentre{3};
+
+        waRT::CameraProjection m_projection;
+        double m_aperture;
+        double m_focusDistance;
+        double m_fieldOfView;
+        double m_shutterOpen;
+        double m_shutterClose;
+
+        // plain copies of the geometry for the batched loops
+        double m_position[3], m_centre[3], m_screenU[3], m_screenV[3];
+        double m_forward[3], m_rightHat[3], m_upHat[3];
     };
 }
 
@@ -0,0 +1,192 @@
+/*
+    The `Denoiser` class removes sampling noise from a rendered image with an edge-avoiding à-trous wavelet filter (Dammertz et al., 2010). It works on the image's color buffer and is guided by the albedo, normal and depth AOVs, so a few samples per pixel give a clean image without blurring across object edges.
+
+    1. **Demodulation**:
+       - Before filtering, each pixel's color is divided by its albedo, leaving only the lighting. Lighting is smooth across a surface even where the surface color is not, so the filter can blur it strongly. Afterwards the filtered lighting is multiplied by the albedo again, which brings back full resolution surface detail.
+       - Channels with an albedo near zero and pixels without a hit are left as they are.
+
+    2. **À-trous Iterations**:
+       - Every iteration applies the 5x5 B3 spline kernel `(1, 4, 6, 4, 1) / 16`, with the taps spread `2^i` pixels apart in iteration `i`. Five iterations cover a 125 pixel wide footprint with only 25 taps per pixel each.
+       - Each tap is weighted by how similar it is to the centre pixel:
+         - **Color**: `exp(-|c_p - c_q|^2 / sigmaColor^2)`, measured on `c / (1 + c)` so very bright pixels do not dominate. The squared sigma halves every iteration, as in the paper, so coarse levels only average values that are already close.
+         - **Normal**: `max(0, n_p . n_q)^sigmaNormal`, which stops at creases.
+         - **Depth**: `exp(-|z_p - z_q| / (sigmaDepth * z_p * 2^i))`, relative to the depth of the centre so far and near surfaces behave alike.
+         - **Albedo**: `exp(-|a_p - a_q|^2 / sigmaAlbedo^2)`, which keeps texture and material borders.
+       - A pixel without a hit never mixes with one that has a hit.
+
+    3. **Threading**:
+       - Each iteration is split into bands of rows that `m_numThreads` threads take from a shared counter (`0` uses all cores). Iterations ping-pong between two buffers that are kept in the object, so repeated calls do not allocate.
+
+    4. **Use**:
+       - `Denoise()` returns `false` if the image has no AOVs. Attach a denoiser to a scene with `Scene::SetDenoiser()` and it is run on every finished frame that has AOVs.
+*/
+
+#include "denoiser.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+constexpr int   DENOISE_BAND_ROWS = 8;
+constexpr float ALBEDO_EPSILON    = 1e-3f;
+constexpr float KERNEL[5] = {1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f};
+
+waRT::Denoiser::Denoiser() {
+    m_iterations  = 5;
+    m_sigmaColor  = 0.6;
+    m_sigmaNormal = 64.0;
+    m_sigmaDepth  = 0.05;
+    m_sigmaAlbedo = 0.1;
+    m_numThreads  = 0;
+    m_xSize = 0;
+    m_ySize = 0;
+    m_albedo = nullptr;
+    m_normal = nullptr;
+    m_depth  = nullptr;
+}
+
+// SETTERS
+void waRT::Denoiser::SetIterations(int newIterations) {
+    m_iterations = std::max(0, newIterations);
+}
+
+void waRT::Denoiser::SetSigmaColor(double newSigma)  { m_sigmaColor  = std::max(1e-6, newSigma);}
+void waRT::Denoiser::SetSigmaNormal(double newSigma) { m_sigmaNormal = std::max(0.0, newSigma);}
+void waRT::Denoiser::SetSigmaDepth(double newSigma)  { m_sigmaDepth  = std::max(1e-6, newSigma);}
+void waRT::Denoiser::SetSigmaAlbedo(double newSigma) { m_sigmaAlbedo = std::max(1e-6, newSigma);}
+
+void waRT::Denoiser::SetNumThreads(int numThreads) {
+    m_numThreads = std::max(0, numThreads);
+}
+
+// GETTERS
+int waRT::Denoiser::GetIterations() { return m_iterations;}
+
+bool waRT::Denoiser::Denoise(waImage &image) {
+    if (!image.HasAOVs()) {
+        return false;
+    }
+    m_xSize  = image.GetXSize();
+    m_ySize  = image.GetYSize();
+    m_albedo = image.GetAlbedoBuffer();
+    m_normal = image.GetNormalBuffer();
+    m_depth  = image.GetDepthBuffer();
+    size_t numValues = static_cast<size_t>(m_xSize) * m_ySize * 3;
+    float *color = image.GetHDRBuffer();
+
+    // demodulate: filter the lighting, not the surface color
+    m_irradiance.resize(numValues);
+    m_scratch.resize(numValues);
+    for (size_t i = 0; i < numValues; ++i) {
+        m_irradiance[i] = (m_albedo[i] > ALBEDO_EPSILON) ? color[i] / m_albedo[i] : color[i];
+    }
+
+    int numThreads = (m_numThreads > 0) ? m_numThreads : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    int numBands   = (m_ySize + DENOISE_BAND_ROWS - 1) / DENOISE_BAND_ROWS;
+    numThreads     = std::min(numThreads, numBands);
+
+    float *input  = m_irradiance.data();
+    float *output = m_scratch.data();
+    for (int iteration = 0; iteration < m_iterations; ++iteration) {
+        int   stepSize   = 1 << iteration;
+        float colorScale = static_cast<float>(1.0 / (m_sigmaColor * m_sigmaColor)) * static_cast<float>(stepSize);
+        std::atomic<int> nextBand {0};
+        auto filterBands = [&]() {
+            for (int band = nextBand.fetch_add(1); band < numBands; band = nextBand.fetch_add(1)) {
+                int rowStart = band * DENOISE_BAND_ROWS;
+                FilterRows(rowStart, std::min(rowStart + DENOISE_BAND_ROWS, m_ySize), stepSize, colorScale, input, output);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (int i = 1; i < numThreads; ++i) {
+            threads.emplace_back(filterBands);
+        }
+        filterBands();
+        for (auto &t : threads) { t.join();}
+        std::swap(input, output);
+    }
+
+    // remodulate
+    for (size_t i = 0; i < numValues; ++i) {
+        color[i] = (m_albedo[i] > ALBEDO_EPSILON) ? input[i] * m_albedo[i] : input[i];
+    }
+    return true;
+}
+
+// private funks
+
+void waRT::Denoiser::FilterRows(int rowStart, int rowEnd, int stepSize, float colorScale, const float *input, float *output) {
+    float normalPower  = static_cast<float>(m_sigmaNormal);
+    float depthScale   = static_cast<float>(1.0 / (m_sigmaDepth * stepSize));
+    float albedoScale  = static_cast<float>(1.0 / (m_sigmaAlbedo * m_sigmaAlbedo));
+
+    for (int y = rowStart; y < rowEnd; ++y) {
+        for (int x = 0; x < m_xSize; ++x) {
+            size_t p = static_cast<size_t>(y) * m_xSize + x;
+            const float *cp = &input[p * 3];
+            const float *np = &m_normal[p * 3];
+            const float *ap = &m_albedo[p * 3];
+            float zp = m_depth[p];
+            bool  hitP = (zp > 0.0f);
+            float invDepth = hitP ? 1.0f / zp : 0.0f;
+            float tp[3] = {cp[0] / (1.0f + cp[0]), cp[1] / (1.0f + cp[1]), cp[2] / (1.0f + cp[2])};
+
+            float sum[3] = {0.0f, 0.0f, 0.0f};
+            float weightSum = 0.0f;
+            for (int ky = 0; ky < 5; ++ky) {
+                int qy = y + (ky - 2) * stepSize;
+                if ((qy < 0) || (qy >= m_ySize)) {
+                    continue;
+                }
+                for (int kx = 0; kx < 5; ++kx) {
+                    int qx = x + (kx - 2) * stepSize;
+                    if ((qx < 0) || (qx >= m_xSize)) {
+                        continue;
+                    }
+                    size_t q = static_cast<size_t>(qy) * m_xSize + qx;
+                    float zq = m_depth[q];
+                    if (hitP != (zq > 0.0f)) {
+                        continue;
+                    }
+                    const float *cq = &input[q * 3];
+
+                    float colorDist = 0.0f;
+                    for (int c = 0; c < 3; ++c) {
+                        float delta = tp[c] - cq[c] / (1.0f + cq[c]);
+                        colorDist += delta * delta;
+                    }
+                    // all edge stopping terms are summed in the exponent, so each tap costs one exp
+                    float exponent = colorDist * colorScale;
+                    if (hitP) {
+                        const float *nq = &m_normal[q * 3];
+                        const float *aq = &m_albedo[q * 3];
+                        float cosine = np[0] * nq[0] + np[1] * nq[1] + np[2] * nq[2];
+                        if (cosine <= 0.0f) {
+                            continue;
+                        }
+                        float albedoDist = 0.0f;
+                        for (int c = 0; c < 3; ++c) {
+                            float delta = ap[c] - aq[c];
+                            albedoDist += delta * delta;
+                        }
+                        exponent += std::fabs(zp - zq) * depthScale * invDepth;
+                        exponent += albedoDist * albedoScale;
+                        exponent -= normalPower * std::log(cosine);
+                    }
+                    float weight = KERNEL[kx] * KERNEL[ky] * std::exp(-exponent);
+
+                    sum[0] += cq[0] * weight;
+                    sum[1] += cq[1] * weight;
+                    sum[2] += cq[2] * weight;
+                    weightSum += weight;
+                }
+            }
+
+            // the centre tap always has weight KERNEL[2]^2, so weightSum > 0
+            float *out = &output[p * 3];
+            out[0] = sum[0] / weightSum;
+            out[1] = sum[1] / weightSum;
+            out[2] = sum[2] / weightSum;
+        }
+    }
+}
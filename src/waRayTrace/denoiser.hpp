@@ -0,0 +1,44 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include <vector>
+#include "waImage.hpp"
+
+namespace waRT {
+    class Denoiser {
+    public:
+        Denoiser();
+
+        void SetIterations(int newIterations);
+        void SetSigmaColor(double newSigma);
+        void SetSigmaNormal(double newSigma);
+        void SetSigmaDepth(double newSigma);
+        void SetSigmaAlbedo(double newSigma);
+        void SetNumThreads(int numThreads);
+
+        int GetIterations();
+
+        // filters the image's color buffer in place, needs the image's AOVs
+        bool Denoise(waImage &image);
+
+    private:
+        void FilterRows(int rowStart, int rowEnd, int stepSize, float colorScale, const float *input, float *output);
+
+    private:
+        int    m_iterations;
+        double m_sigmaColor;
+        double m_sigmaNormal;
+        double m_sigmaDepth;
+        double m_sigmaAlbedo;
+        int    m_numThreads;
+
+        int m_xSize, m_ySize;
+        const float *m_albedo;
+        const float *m_normal;
+        const float *m_depth;
+        std::vector<float> m_irradiance;
+        std::vector<float> m_scratch;
+    };
+}
+
+#endif
@@ -0,0 +1,157 @@
+/*
+    The `Engine` class is the entry point for programs that embed the ray tracer as a library instead of running `waRay` or talking to `waRayd`. It is what the `libwaRT.a` and `libwaRT.so` targets of the makefile are meant to be used through.
+
+    1. **Stable Interface**:
+       - The header only uses plain types (`double` arrays, `int`, `float` and `uint32_t` buffers, `std::function`) and keeps every engine type behind a private `Impl`, so the scene, image and object classes can change without touching the host's code or the class layout it was compiled against.
+       - `ENGINE_API_VERSION` (see `version.hpp`) is bumped whenever a declaration in `engine.hpp` changes incompatibly. `GetAPIVersion()` returns the value the library was built with, so a host can check a shared library at run time.
+       - `GetScene()` hands out the full `Scene` for everything the small interface does not cover (textures, SDFs, integrators, caches). That part is not covered by the version.
+
+    2. **Building a Scene**:
+       - An engine starts with the scene's default test objects; `ClearScene()` removes all objects and lights.
+       - `AddSphere()`, `AddPlane()` (the unit square scaled to the half sizes, rotated by `rotation` in radians about x, y and z) and `AddPointLight()` return the index of the new object or light. `SetObjectColor()` recolors an object and only refits the scene's BVHs.
+       - `SetCamera()` places the pinhole camera, `SetSamplesPerPixel()` and `SetNumThreads()` pass straight through.
+
+    3. **Zero-Copy Frames (`SetFrameBuffer`)**:
+       - The caller's arrays are attached to the engine's image with `waImage::AttachBuffers()`, so the render threads write the linear pixels, and the tone mapped RGBA8 pixels if an array for them was given, straight into the host's memory. There is no image to copy out of afterwards.
+       - The buffers must hold the whole frame and stay alive until the next `SetFrameBuffer()` or the engine is destroyed.
+
+    4. **Rendering (`Render`, `Cancel`, `GetProgress`)**:
+       - `Render()` blocks the calling thread and runs the scene's tiled renderer with a fresh `RenderControl`. The tile callback is called on the render thread that finished the tile, after the tile is tone mapped, so a host can upload or stream it while the rest of the frame is still being traced. It must be thread safe and quick.
+       - `Cancel()` and `GetProgress()` may be called from any thread and act on the render in progress. A cancelled render returns `false` and leaves the tiles it finished in the buffers. A `Cancel()` with no render running does nothing.
+*/
+
+#include "engine.hpp"
+#include "scene.hpp"
+#include <chrono>
+#include <mutex>
+
+struct waRT::Engine::Impl {
+    waRT::Scene scene;
+    waImage image;
+    bool hasFrame = false;
+    double renderSeconds = 0.0;
+    // the control of the render in progress, shared so Cancel() can still reach it while Render() lets go
+    std::mutex controlMutex;
+    std::shared_ptr<waRT::RenderControl> control;
+};
+
+static qbVector<double> ToVector(const double *values) {
+    return qbVector<double>{std::vector<double>{values[0], values[1], values[2]}};
+}
+
+waRT::Engine::Engine() : m_impl(new Impl) {}
+
+waRT::Engine::~Engine() {}
+
+void waRT::Engine::ClearScene() {
+    m_impl->scene.GetObjectList().clear();
+    m_impl->scene.GetLightList().clear();
+    m_impl->scene.NotifyObjectsChanged();
+}
+
+int waRT::Engine::AddSphere(const double *centre, double radius, const double *color) {
+    auto sphere = std::make_shared<waRT::ObjSphere>();
+    const double rotation[3] = {0.0, 0.0, 0.0};
+    const double scale[3]    = {radius, radius, radius};
+    waRT::GTform transform;
+    transform.SetTransform(ToVector(centre), ToVector(rotation), ToVector(scale));
+    sphere->SetTransformMatrix(transform);
+    sphere->m_baseColor = ToVector(color);
+    auto &objectList = m_impl->scene.GetObjectList();
+    objectList.push_back(sphere);
+    m_impl->scene.NotifyObjectsChanged();
+    return static_cast<int>(objectList.size()) - 1;
+}
+
+int waRT::Engine::AddPlane(const double *centre, const double *rotation, double halfWidth, double halfHeight, const double *color) {
+    auto plane = std::make_shared<waRT::ObjectPlane>();
+    const double scale[3] = {halfWidth, halfHeight, 1.0};
+    waRT::GTform transform;
+    transform.SetTransform(ToVector(centre), ToVector(rotation), ToVector(scale));
+    plane->SetTransformMatrix(transform);
+    plane->m_baseColor = ToVector(color);
+    auto &objectList = m_impl->scene.GetObjectList();
+    objectList.push_back(plane);
+    m_impl->scene.NotifyObjectsChanged();
+    return static_cast<int>(objectList.size()) - 1;
+}
+
+int waRT::Engine::AddPointLight(const double *position, const double *color, double intensity) {
+    auto light = std::make_shared<waRT::PointLight>();
+    light->m_location  = ToVector(position);
+    light->m_color     = ToVector(color);
+    light->m_intensity = intensity;
+    auto &lightList = m_impl->scene.GetLightList();
+    lightList.push_back(light);
+    return static_cast<int>(lightList.size()) - 1;
+}
+
+bool waRT::Engine::SetObjectColor(int object, const double *color) {
+    auto &objectList = m_impl->scene.GetObjectList();
+    if ((object < 0) || (static_cast<size_t>(object) >= objectList.size())) {
+        return false;
+    }
+    objectList[object]->m_baseColor = ToVector(color);
+    m_impl->scene.NotifyTransformsChanged();
+    return true;
+}
+
+void waRT::Engine::SetCamera(const double *position, const double *lookAt, const double *up, double horzSize, double aspect) {
+    waRT::Camera &camera = m_impl->scene.GetCamera();
+    camera.SetPosition(ToVector(position));
+    camera.SetLookAt(ToVector(lookAt));
+    camera.SetUp(ToVector(up));
+    camera.SetHorzSize(horzSize);
+    camera.SetAspect(aspect);
+    camera.UpdateCameraGeometry();
+}
+
+void waRT::Engine::SetSamplesPerPixel(int samplesPerPixel) { m_impl->scene.SetSamplesPerPixel(samplesPerPixel);}
+void waRT::Engine::SetNumThreads(int numThreads)           { m_impl->scene.SetNumThreads(numThreads);}
+
+bool waRT::Engine::SetFrameBuffer(int width, int height, float *hdrPixels, uint32_t *displayPixels) {
+    if ((width <= 0) || (height <= 0) || (hdrPixels == nullptr)) {
+        return false;
+    }
+    m_impl->image.AttachBuffers(width, height, hdrPixels, displayPixels);
+    m_impl->hasFrame = true;
+    return true;
+}
+
+bool waRT::Engine::Render(const waRT::TileCallback &onTileDone) {
+    if (!m_impl->hasFrame) {
+        return false;
+    }
+    auto control = std::make_shared<waRT::RenderControl>();
+    control->m_onTileDone = onTileDone;
+    {
+        std::lock_guard<std::mutex> lock(m_impl->controlMutex);
+        m_impl->control = control;
+    }
+    auto startTime = std::chrono::steady_clock::now();
+    bool finished = m_impl->scene.Render(m_impl->image, control.get());
+    m_impl->renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    {
+        std::lock_guard<std::mutex> lock(m_impl->controlMutex);
+        m_impl->control.reset();
+    }
+    return finished;
+}
+
+void waRT::Engine::Cancel() {
+    std::lock_guard<std::mutex> lock(m_impl->controlMutex);
+    if (m_impl->control) {
+        m_impl->control->Cancel();
+    }
+}
+
+double waRT::Engine::GetProgress() {
+    std::lock_guard<std::mutex> lock(m_impl->controlMutex);
+    return m_impl->control ? m_impl->control->GetProgress() : 0.0;
+}
+
+double waRT::Engine::GetRenderSeconds() { return m_impl->renderSeconds;}
+
+waRT::Scene &waRT::Engine::GetScene() { return m_impl->scene;}
+
+int waRT::Engine::GetAPIVersion() { return waRT::ENGINE_API_VERSION;}
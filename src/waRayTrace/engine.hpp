@@ -0,0 +1,54 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include "version.hpp"
+
+namespace waRT {
+    class Scene;
+
+    // invoked on a render thread once the tile (x1 and y1 exclusive) is in the caller's buffers
+    using TileCallback = std::function<void(int, int, int, int)>;
+
+    // the renderer behind plain types only, for hosts that embed the library
+    class Engine {
+    public:
+        Engine();
+        ~Engine();
+        Engine(const Engine &) = delete;
+        Engine &operator= (const Engine &) = delete;
+
+        // scene building, objects and lights are returned as indices; vectors are three doubles
+        void ClearScene();
+        int AddSphere(const double *centre, double radius, const double *color);
+        int AddPlane(const double *centre, const double *rotation, double halfWidth, double halfHeight, const double *color);
+        int AddPointLight(const double *position, const double *color, double intensity);
+        bool SetObjectColor(int object, const double *color);
+        void SetCamera(const double *position, const double *lookAt, const double *up, double horzSize, double aspect);
+        void SetSamplesPerPixel(int samplesPerPixel);
+        void SetNumThreads(int numThreads);
+
+        // width * height * 3 linear floats and optionally width * height RGBA8 pixels, owned by the caller
+        bool SetFrameBuffer(int width, int height, float *hdrPixels, uint32_t *displayPixels = nullptr);
+        // blocks until the frame is done; false if it was cancelled or there is no frame buffer
+        bool Render(const waRT::TileCallback &onTileDone = nullptr);
+        // safe from any thread, stops the render in progress after the tiles in flight
+        void Cancel();
+        double GetProgress();
+        double GetRenderSeconds();
+
+        // the full scene interface, outside the stable API
+        waRT::Scene &GetScene();
+
+        // ENGINE_API_VERSION of the library, which may differ from the header the host was built with
+        static int GetAPIVersion();
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> m_impl;
+    };
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include "./linAlgModule/qbVector.h"
 #include "./linAlgModule/qbMatrix.h"
 #include "ray.hpp"
+#include "aabb.hpp"
 
 namespace waRT {
 	constexpr bool FWDTFORM = true;
@@ -21,8 +22,14 @@ namespace waRT {
 			qbMatrix2<double> GetBackward();			
 			waRT::Ray Apply(const waRT::Ray &inputRay, bool dirFlag);
 			qbVector<double> Apply(const qbVector<double> &inputVector, bool dirFlag);
+			void Apply(const waRT::Ray &inputRay, bool dirFlag, waRT::Ray &outputRay);
+			void Apply(const qbVector<double> &inputVector, bool dirFlag, qbVector<double> &outputVector);
+			void TransformBox(const waRT::AABB &localBox, waRT::AABB &worldBox) const;
+			static void Interpolate(const GTform &start, const GTform &end, double t, GTform &result);
+			static void InvertAffine(const double *matrix, double *inverse);
 			friend GTform operator* (const waRT::GTform &lhs, const waRT::GTform &rhs);
 			GTform operator= (const GTform &rhs);
+			void Serialize(std::ostream &out) const;
 			void PrintMatrix(bool dirFlag);
 			static void PrintVector(const qbVector<double> &vector);
 		private:
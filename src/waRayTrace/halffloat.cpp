@@ -0,0 +1,82 @@
+/*
+    These helpers convert between 32-bit IEEE floats and 16-bit IEEE "half" floats, the storage format used by OpenEXR and by GPU textures. Half floats keep roughly three significant decimal digits over a range of about 6e-5 to 65504, which is plenty for linear HDR colour data while halving its size.
+
+    1. **Float to Half (`FloatToHalf`)**:
+       - The float is reinterpreted as its raw bits and split into sign, exponent and mantissa.
+       - NaN and infinity keep their meaning, values too large for a half become infinity, and values too small for a normal half become denormals or zero.
+       - The mantissa is rounded to nearest-even, so converting back and forth is as accurate as the format allows.
+
+    2. **Half to Float (`HalfToFloat`)**:
+       - Reverses the process. Denormal halves are renormalised so that every half value maps to the exact same float.
+*/
+
+#include "halffloat.hpp"
+#include <cstring>
+
+uint16_t waRT::FloatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign     = (bits >> 16) & 0x8000;
+    int32_t  exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x007fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff) {
+        // inf or nan
+        return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x0200 : 0));
+    }
+    if (exponent >= 31) {
+        return static_cast<uint16_t>(sign | 0x7c00);
+    }
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+        mantissa |= 0x00800000;
+        int shift = 14 - exponent;
+        uint32_t halfMantissa = mantissa >> shift;
+        uint32_t remainder    = mantissa & ((1u << shift) - 1);
+        uint32_t halfway      = 1u << (shift - 1);
+        if ((remainder > halfway) || ((remainder == halfway) && (halfMantissa & 1))) {
+            ++halfMantissa;
+        }
+        return static_cast<uint16_t>(sign | halfMantissa);
+    }
+
+    uint32_t half      = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+    if ((remainder > 0x1000) || ((remainder == 0x1000) && (half & 1))) {
+        // a carry out of the mantissa correctly bumps the exponent
+        ++half;
+    }
+    return static_cast<uint16_t>(half);
+}
+
+float waRT::HalfToFloat(uint16_t value) {
+    uint32_t sign     = static_cast<uint32_t>(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x03ff;
+    uint32_t bits;
+
+    if (exponent == 0) {
+        if (mantissa == 0) {
+            bits = sign;
+        } else {
+            exponent = 127 - 15 + 1;
+            while ((mantissa & 0x0400) == 0) {
+                mantissa <<= 1;
+                --exponent;
+            }
+            mantissa &= 0x03ff;
+            bits = sign | (exponent << 23) | (mantissa << 13);
+        }
+    } else if (exponent == 31) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
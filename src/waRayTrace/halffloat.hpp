@@ -0,0 +1,11 @@
+#ifndef HALFFLOAT_H
+#define HALFFLOAT_H
+
+#include <cstdint>
+
+namespace waRT {
+    uint16_t FloatToHalf(float value);
+    float    HalfToFloat(uint16_t value);
+}
+
+#endif
@@ -0,0 +1,183 @@
+/*
+    The `IrradianceCache` class stores diffuse indirect light in world space so it can be reused by neighbouring shading points (Ward et al., 1988). Gathering indirect light at a point takes many hemisphere rays, but it changes slowly over a surface, so most points can interpolate a few nearby gathers instead.
+
+    1. **Records**:
+       - An `IrradianceRecord` holds a gathered point, its normal, the light it gathered and its radius, the harmonic mean distance of the surfaces its rays hit. Near other geometry the radius is small and records are dense; in open space a record covers a large area.
+       - A record is valid at a point `p` with normal `n` if its error estimate `|p - p_i| / R_i + sqrt(1 - n . n_i)` is below the accuracy (`SetAccuracy()`, smaller is more accurate and slower), and it is not in front of the point, which would mean it sees different surroundings.
+
+    2. **Lookup**:
+       - `Lookup()` blends every valid record with the weight `1 / error`, so a point sitting on a record gets that record's value and values change smoothly between records. It returns `false` if no record is valid, and the caller then gathers and inserts a new one.
+       - Records are plain interpolated, without gradients, so records must be somewhat denser than with Ward's gradient extrapolation to hide seams.
+
+    3. **Hashed Grid**:
+       - Space is divided into cubic cells of `cellSize` that are hashed into a power of two number of buckets. Each bucket is a singly linked list of cell nodes, and a record is linked into every cell its validity sphere overlaps. The radius is clamped so the sphere is never wider than a cell, which keeps that to at most eight cells, and a lookup only has to walk the list of the point's own cell.
+
+    4. **Concurrency**:
+       - Records and nodes live in arrays allocated by `Reset()`. `Insert()` claims a record and its nodes with an atomic counter, fills them and then pushes each node onto the front of its bucket's list with a compare-and-swap. Readers load the list heads with acquire order, so a node and its record are complete before they can be seen. Lookups never wait, inserts only retry the swap, and nothing is ever removed until the next `Reset()`.
+       - Once the arrays are full, `Insert()` returns `false` and the point simply uses its own gather.
+       - Which records exist depends on the order threads reach the points, so with the cache a frame is no longer bit identical across thread counts.
+*/
+
+#include "irradiancecache.hpp"
+#include <algorithm>
+#include <cmath>
+
+// every record can overlap at most two cells along each axis
+constexpr int    IRRADIANCE_CELLS_PER_RECORD = 8;
+// records this far in front of a point (relative to their radius) see different surroundings
+constexpr double IRRADIANCE_FRONT_TOLERANCE  = 0.01;
+constexpr double IRRADIANCE_MAX_WEIGHT       = 1e10;
+
+waRT::IrradianceCache::IrradianceCache() {
+    m_accuracy   = IRRADIANCE_DEFAULT_ACCURACY;
+    m_cellSize   = 1.0;
+    m_maxRecords = 0;
+    m_numBuckets = 0;
+    m_numRecords = 0;
+    m_numNodes   = 0;
+}
+
+void waRT::IrradianceCache::Reset(size_t maxRecords, double cellSize) {
+    m_cellSize   = (cellSize > 0.0) ? cellSize : 1.0;
+    m_maxRecords = maxRecords;
+    if (m_records.size() < maxRecords) {
+        m_records.resize(maxRecords);
+        m_nodes.resize(maxRecords * IRRADIANCE_CELLS_PER_RECORD);
+    }
+    size_t numBuckets = 1;
+    while (numBuckets < maxRecords * 2) {
+        numBuckets <<= 1;
+    }
+    if (numBuckets > m_numBuckets) {
+        m_buckets.reset(new std::atomic<int32_t>[numBuckets]);
+    }
+    m_numBuckets = std::max(m_numBuckets, numBuckets);
+    for (size_t i = 0; i < m_numBuckets; ++i) {
+        m_buckets[i].store(-1, std::memory_order_relaxed);
+    }
+    m_numRecords.store(0);
+    m_numNodes.store(0);
+}
+
+bool waRT::IrradianceCache::Lookup(const double *point, const double *normal, double *irradiance) const {
+    if (m_numBuckets == 0) {
+        return false;
+    }
+    int32_t cell[3];
+    CellOf(point, cell);
+    double totalWeight = 0.0;
+    double sum[3] = {0.0, 0.0, 0.0};
+    for (int32_t nodeIndex = m_buckets[BucketOf(cell)].load(std::memory_order_acquire); nodeIndex >= 0; nodeIndex = m_nodes[nodeIndex].next) {
+        const CellNode &node = m_nodes[nodeIndex];
+        if ((node.cell[0] != cell[0]) || (node.cell[1] != cell[1]) || (node.cell[2] != cell[2])) {
+            continue;
+        }
+        const waRT::IrradianceRecord &record = m_records[node.record];
+        double distSquared = 0.0;
+        double cosNormals  = 0.0;
+        double inFront     = 0.0;
+        for (int i = 0; i < 3; ++i) {
+            double offset = point[i] - record.position[i];
+            distSquared += offset * offset;
+            cosNormals  += normal[i] * record.normal[i];
+            inFront     += offset * 0.5 * (normal[i] + record.normal[i]);
+        }
+        if (inFront < -IRRADIANCE_FRONT_TOLERANCE * record.radius) {
+            continue;
+        }
+        double error = sqrt(distSquared) / record.radius + sqrt(std::max(0.0, 1.0 - cosNormals));
+        if (error >= m_accuracy) {
+            continue;
+        }
+        double weight = (error > 0.0) ? std::min(1.0 / error, IRRADIANCE_MAX_WEIGHT) : IRRADIANCE_MAX_WEIGHT;
+        totalWeight += weight;
+        for (int i = 0; i < 3; ++i) {
+            sum[i] += weight * record.irradiance[i];
+        }
+    }
+    if (totalWeight <= 0.0) {
+        return false;
+    }
+    for (int i = 0; i < 3; ++i) {
+        irradiance[i] = sum[i] / totalWeight;
+    }
+    return true;
+}
+
+bool waRT::IrradianceCache::Insert(const double *point, const double *normal, const double *irradiance, double radius) {
+    size_t slot = m_numRecords.fetch_add(1);
+    if (slot >= m_maxRecords) {
+        return false;
+    }
+    // the validity sphere may not be wider than a cell
+    double maxRadius = 0.5 * m_cellSize / m_accuracy;
+    radius = (radius > 0.0) ? std::min(radius, maxRadius) : maxRadius;
+    waRT::IrradianceRecord &record = m_records[slot];
+    for (int i = 0; i < 3; ++i) {
+        record.position[i]   = point[i];
+        record.normal[i]     = normal[i];
+        record.irradiance[i] = irradiance[i];
+    }
+    record.radius = radius;
+
+    double reach = radius * m_accuracy;
+    double low[3], high[3];
+    for (int i = 0; i < 3; ++i) {
+        low[i]  = point[i] - reach;
+        high[i] = point[i] + reach;
+    }
+    int32_t lowCell[3], highCell[3];
+    CellOf(low, lowCell);
+    CellOf(high, highCell);
+
+    int32_t cell[3];
+    for (cell[2] = lowCell[2]; cell[2] <= highCell[2]; ++cell[2]) {
+        for (cell[1] = lowCell[1]; cell[1] <= highCell[1]; ++cell[1]) {
+            for (cell[0] = lowCell[0]; cell[0] <= highCell[0]; ++cell[0]) {
+                int32_t nodeIndex = static_cast<int32_t>(m_numNodes.fetch_add(1));
+                CellNode &node = m_nodes[nodeIndex];
+                for (int i = 0; i < 3; ++i) {
+                    node.cell[i] = cell[i];
+                }
+                node.record = static_cast<int32_t>(slot);
+                // push onto the front of the bucket, publishing the node and its record together
+                std::atomic<int32_t> &head = m_buckets[BucketOf(cell)];
+                node.next = head.load(std::memory_order_relaxed);
+                while (!head.compare_exchange_weak(node.next, nodeIndex, std::memory_order_release, std::memory_order_relaxed)) {
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// SETTERS
+void waRT::IrradianceCache::SetAccuracy(double accuracy) { m_accuracy = (accuracy > 0.0) ? accuracy : IRRADIANCE_DEFAULT_ACCURACY;}
+
+// GETTERS
+double waRT::IrradianceCache::GetAccuracy()   { return m_accuracy;}
+double waRT::IrradianceCache::GetCellSize()   { return m_cellSize;}
+size_t waRT::IrradianceCache::GetNumRecords() { return std::min(m_numRecords.load(), m_maxRecords);}
+size_t waRT::IrradianceCache::GetMaxRecords() { return m_maxRecords;}
+
+size_t waRT::IrradianceCache::GetMemoryBytes() {
+    return m_records.capacity() * sizeof(waRT::IrradianceRecord) + m_nodes.capacity() * sizeof(CellNode) +
+           m_numBuckets * sizeof(std::atomic<int32_t>);
+}
+
+// private funks
+
+void waRT::IrradianceCache::CellOf(const double *point, int32_t *cell) const {
+    for (int i = 0; i < 3; ++i) {
+        double index = floor(point[i] / m_cellSize);
+        cell[i] = static_cast<int32_t>(std::max(-1e9, std::min(1e9, index)));
+    }
+}
+
+size_t waRT::IrradianceCache::BucketOf(const int32_t *cell) const {
+    uint32_t hash = static_cast<uint32_t>(cell[0]) * 73856093u ^ static_cast<uint32_t>(cell[1]) * 19349663u ^ static_cast<uint32_t>(cell[2]) * 83492791u;
+    hash ^= hash >> 16;
+    hash *= 0x7feb352du;
+    hash ^= hash >> 15;
+    return hash & (m_numBuckets - 1);
+}
@@ -0,0 +1,64 @@
+#ifndef IRRADIANCECACHE_H
+#define IRRADIANCECACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace waRT {
+    constexpr size_t IRRADIANCE_DEFAULT_RECORDS  = size_t(1) << 16;
+    constexpr double IRRADIANCE_DEFAULT_ACCURACY = 0.25;
+
+    // diffuse indirect light gathered at one point, valid within accuracy * radius of it
+    struct IrradianceRecord {
+        double position[3];
+        double normal[3];
+        double irradiance[3];
+        double radius;
+    };
+
+    // hashed grid of records that any number of threads can search and extend without a lock
+    class IrradianceCache {
+    public:
+        IrradianceCache();
+
+        // drops every record; allocates only if maxRecords grew
+        void Reset(size_t maxRecords, double cellSize);
+        bool Lookup(const double *point, const double *normal, double *irradiance) const;
+        bool Insert(const double *point, const double *normal, const double *irradiance, double radius);
+
+        // SETTERS
+        void SetAccuracy(double accuracy);
+
+        // GETTERS
+        double GetAccuracy();
+        double GetCellSize();
+        size_t GetNumRecords();
+        size_t GetMaxRecords();
+        size_t GetMemoryBytes();
+
+    private:
+        struct CellNode {
+            int32_t cell[3];
+            int32_t record;
+            int32_t next;
+        };
+
+        void CellOf(const double *point, int32_t *cell) const;
+        size_t BucketOf(const int32_t *cell) const;
+
+    private:
+        double m_accuracy;
+        double m_cellSize;
+        size_t m_maxRecords;
+        std::vector<waRT::IrradianceRecord> m_records;
+        std::vector<CellNode> m_nodes;
+        std::unique_ptr<std::atomic<int32_t>[]> m_buckets;
+        size_t m_numBuckets;
+        std::atomic<size_t> m_numRecords;
+        std::atomic<size_t> m_numNodes;
+    };
+}
+
+#endif
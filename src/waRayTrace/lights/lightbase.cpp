@@ -13,13 +13,23 @@
          - `localNormal`: The surface normal at the intersection point, used to compute how light interacts with the surface.
          - `objectList`: A list of all objects in the scene, passed here to handle potential occlusion (shadow casting) and other object interactions with light.
          - `currentObject`: The object currently being illuminated (the one that the intersection point belongs to).
+         - `time`: The time of the ray that found the point. Shadow rays are sent at the same time, so moving objects cast their shadow where they are in that instant.
          - `color`: A vector that will be populated with the light's contribution to the color at the intersection point.
          - `intensity`: A double that will store the intensity of the light at the intersection point.
        
        - **Return Value**: 
          The function returns a boolean value. In the base class, it always returns `false`, indicating that no actual illumination calculation is performed here. Derived classes are expected to override this method and provide specific implementations for various lighting models.
 
-    3. **Summary**:
+    3. **Serialization (`Serialize`)**:
+       - Writes the light's type, location and color as one text line for the render cache key. Derived lights override it to include their own parameters (for example `PointLight` adds its intensity).
+
+    4. **Shadow Statistics (`GetShadowStats`, `FlushShadowStats`)**:
+       - Lights that cast shadow rays count them in a `ShadowStats`. Render threads count privately, and `FlushShadowStats()` adds the calling thread's counts to the light's totals; the scene calls it at the end of each render thread. The base class casts no shadow rays and reports zeros.
+
+    5. **Photon Sources (`GetPhotonSource`)**:
+       - A light that can take part in photon mapping returns the point its photons leave from and its intensity per color channel, as `ComputeIllumination()` would report it for a surface facing it. The scene sends photons from that point in every direction (see `Scene::EmitPhotons`). The base class sends none.
+
+    6. **Summary**:
        - The `LightBase` class provides a foundation for creating different types of light sources in a ray tracing engine. It defines an interface for calculating the illumination (color and intensity) at a given point in the scene.
        - While the `ComputeIllumination` function is defined in this base class, it serves as a placeholder and returns `false` by default. Derived light classes will override this method to implement actual lighting behavior based on the light type.
        - This structure allows for flexibility in the ray tracing engine, enabling the easy addition of different lighting models and behavior by extending this base class.
@@ -32,6 +42,19 @@ waRT::LightBase::~LightBase(){}
 
 bool waRT::LightBase::ComputeIllumination(const qbVector<double> &intPoint, const qbVector<double> &localNormal,
                                           const std::vector<std::shared_ptr<waRT::ObjectBase>> &objectList,
-                                          const std::shared_ptr<waRT::ObjectBase> &currentObject,
+                                          const std::shared_ptr<waRT::ObjectBase> &currentObject, double time,
                                           qbVector<double> &color, double &intensity) 
-                                          {return false;}
\ No newline at end of file
+                                          {return false;}
+
+void waRT::LightBase::Serialize(std::ostream &out) {
+    out << "LightBase ";
+    for (int i = 0; i < 3; ++i) {
+        out << std::hexfloat << m_location.GetElement(i) << " " << m_color.GetElement(i) << " ";
+    }
+    out << std::defaultfloat << "\n";
+}
+
+waRT::ShadowStats waRT::LightBase::GetShadowStats() { return waRT::ShadowStats();}
+void waRT::LightBase::FlushShadowStats() {}
+
+bool waRT::LightBase::GetPhotonSource(double *position, double *intensity) { return false;}
\ No newline at end of file
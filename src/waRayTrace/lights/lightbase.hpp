@@ -1,19 +1,33 @@
 #ifndef LIGHTBASE_H
 #define LIGHTBASE_H
 
+#include <cstdint>
 #include <memory>
+#include <ostream>
 #include "../linAlgModule/qbVector.h"
 #include "../ray.hpp"
 #include "../primitives/objectbase.hpp"
 namespace waRT {
+    // shadow rays cast, rays stopped by the remembered occluder, and intersection tests made
+    struct ShadowStats {
+        uint64_t rays      = 0;
+        uint64_t cacheHits = 0;
+        uint64_t tests     = 0;
+    };
+
     class LightBase {
         public:
             LightBase();
             virtual ~LightBase();
             virtual bool ComputeIllumination( const qbVector<double> &intPoint, const qbVector<double> &localNormal,
                                               const std::vector<std::shared_ptr<waRT::ObjectBase>> &objectList,
-                                              const std::shared_ptr<waRT::ObjectBase> &currentObject,
+                                              const std::shared_ptr<waRT::ObjectBase> &currentObject, double time,
                                               qbVector<double> &color, double &intensity);
+            virtual void Serialize(std::ostream &out);
+            virtual waRT::ShadowStats GetShadowStats();
+            virtual void FlushShadowStats();
+            // where photons leave from and the light's intensity per color channel; false if it sends none
+            virtual bool GetPhotonSource(double *position, double *intensity);
         public:
             qbVector<double> m_color    {3};
             qbVector<double> m_location {3};
@@ -12,7 +12,8 @@
          - `intPoint`: The intersection point on the object where the light is being evaluated.
          - `localNormal`: The surface normal at the intersection point, used to compute the angle of incidence of the light.
          - `objectList`: A list of all objects in the scene, used for checking potential shadows or occlusion.
-         - `currentObject`: The object that is currently being evaluated for shading (typically the object that the ray intersects).
+         - `currentObject`: The object that is currently being evaluated for shading (typically the object that the ray intersects). It is skipped by the shadow test unless it is an aggregate (`ObjectBase::IsAggregate()`), which can shadow itself.
+         - `time`: The time of the camera ray, copied to the shadow ray so moving occluders are tested where they are at that time.
          - `color`: A vector that stores the computed light color at the intersection point.
          - `intensity`: A double that stores the computed light intensity at the intersection point.
 
@@ -30,39 +31,124 @@
          - The method returns `true` if the surface is illuminated (i.e., the light strikes the surface at an angle less than 90 degrees). In this case, both `color` and `intensity` are updated with the computed values.
          - If the surface is in shadow or facing away from the light, the method returns `false`, indicating no illumination, and the `color` remains as the light's base color while `intensity` is set to zero.
 
-    3. **Summary**:
+    3. **Shadow Occluder Cache**:
+       - Neighbouring pixels are usually shadowed by the same object, so each render thread remembers, per light, the last object that blocked one of its shadow rays. The next shadow ray tests that object first and only scans `objectList` if it misses, skipping the object it already tested. A shadow ray only asks whether anything blocks it, so the order of the tests never changes the result.
+       - The remembered object is kept as its index in `objectList` together with its address, and is only used if the list still holds that object at that index, so edits to the scene can never make it test a stale object.
+       - The memory is `thread_local` and needs no locking. Each thread's entry is created by its first shadow ray for the light, which the scene's per-thread warm up makes before the allocation-free hot path starts.
+       - `GetShadowStats()` reports the shadow rays, how many the remembered occluder stopped, and the intersection tests made, which together show how much scanning the cache saves. `SetShadowCache(false)` turns the cache off for comparison.
+
+    4. **Photon Source (`GetPhotonSource`)**:
+       - Photons leave from `m_location` with the light's color times `m_intensity`, the light a surface facing it head on receives.
+
+    5. **Summary**:
        - The `PointLight` class models a point light source in the scene and computes how it interacts with objects based on their surface normals and the angle of incidence of the light.
        - The method `ComputeIllumination` determines whether a surface point is lit or in shadow, and calculates the color and intensity of the light that contributes to shading the object.
        - This class is essential for implementing basic lighting and shading models in the ray tracing engine, such as Lambertian reflection, by computing how much light reaches a surface and at what intensity.
 */
 
 #include "pointlight.hpp"
+#include <vector>
+
+namespace {
+    // one render thread's memory of the last occluder for one light, and its uncounted stats
+    struct ShadowCacheEntry {
+        const waRT::PointLight *light;
+        const waRT::ObjectBase *occluder;
+        size_t   index;
+        uint64_t rays;
+        uint64_t cacheHits;
+        uint64_t tests;
+    };
+
+    ShadowCacheEntry &ThreadShadowEntry(const waRT::PointLight *light) {
+        thread_local std::vector<ShadowCacheEntry> entries;
+        for (auto &entry : entries) {
+            if (entry.light == light) {
+                return entry;
+            }
+        }
+        entries.push_back(ShadowCacheEntry{light, nullptr, 0, 0, 0, 0});
+        return entries.back();
+    }
+}
 
 waRT::PointLight::PointLight() {
     m_color = qbVector<double>{std::vector<double> {1.0, 1.0, 1.0}};
     m_intensity = 1.0;
+    m_shadowCache     = true;
+    m_shadowRays      = 0;
+    m_shadowCacheHits = 0;
+    m_shadowTests     = 0;
+}
+
+// the copy starts with its own, empty statistics
+waRT::PointLight::PointLight(const PointLight &other) : LightBase(other) {
+    m_color       = other.m_color;
+    m_intensity   = other.m_intensity;
+    m_shadowCache = other.m_shadowCache;
+    m_shadowRays      = 0;
+    m_shadowCacheHits = 0;
+    m_shadowTests     = 0;
 }
 
 waRT::PointLight::~PointLight() {}
 
+void waRT::PointLight::Serialize(std::ostream &out) {
+    out << "PointLight ";
+    for (int i = 0; i < 3; ++i) {
+        out << std::hexfloat << m_location.GetElement(i) << " " << m_color.GetElement(i) << " ";
+    }
+    out << m_intensity << std::defaultfloat << "\n";
+}
+
 bool waRT::PointLight::ComputeIllumination(const qbVector<double> &intPoint, const qbVector<double> &localNormal,
                                            const std::vector<std::shared_ptr<waRT::ObjectBase>> &objectList,
-                                           const std::shared_ptr<waRT::ObjectBase> &currentObject,
+                                           const std::shared_ptr<waRT::ObjectBase> &currentObject, double time,
                                            qbVector<double> &color, double &intensity) {
-    qbVector<double> lightDir   = (m_location - intPoint).Normalized();
-    qbVector<double> startPoint = intPoint;
+    // reuse this thread's shadow ray instead of building a new one per call
+    thread_local qbVector<double> lightDir  {3};
+    thread_local waRT::Ray        lightRay;
+    thread_local qbVector<double> poi       {3};
+    thread_local qbVector<double> poiNormal {3};
+    thread_local qbVector<double> poiColor  {3};
+
+    for (int i = 0; i < 3; ++i) {
+        lightDir.SetElement(i, m_location.GetElement(i) - intPoint.GetElement(i));
+    }
+    lightDir.Normalize();
+    for (int i = 0; i < 3; ++i) {
+        lightRay.m_point1.SetElement(i, intPoint.GetElement(i));
+        lightRay.m_point2.SetElement(i, intPoint.GetElement(i) + lightDir.GetElement(i));
+        lightRay.m_lab.SetElement(i, lightRay.m_point2.GetElement(i) - lightRay.m_point1.GetElement(i));
+    }
+    lightRay.m_time = time;
 
-    waRT::Ray lightRay(startPoint, startPoint + lightDir);
-    qbVector<double> poi       {3};
-    qbVector<double> poiNormal {3};
-    qbVector<double> poiColor  {3};
+    ShadowCacheEntry &cache = ThreadShadowEntry(this);
+    ++cache.rays;
     bool validInt = false;
-    for (auto sceneObject : objectList) {
-        if (sceneObject != currentObject) {
+    const waRT::ObjectBase *tested = nullptr;
+    if (m_shadowCache && (cache.occluder != nullptr) && (cache.index < objectList.size()) && (objectList[cache.index].get() == cache.occluder)) {
+        const auto &occluder = objectList[cache.index];
+        if ((occluder != currentObject) || occluder->IsAggregate()) {
+            ++cache.tests;
+            validInt = occluder->TestIntersection(lightRay, poi, poiNormal, poiColor);
+            tested   = cache.occluder;
+            if (validInt) {
+                ++cache.cacheHits;
+            }
+        }
+    }
+    for (size_t i = 0; (i < objectList.size()) && !validInt; ++i) {
+        const auto &sceneObject = objectList[i];
+        // an aggregate may shadow itself, it avoids self hits on its own
+        if ((sceneObject.get() != tested) && ((sceneObject != currentObject) || sceneObject->IsAggregate())) {
+            ++cache.tests;
             validInt = sceneObject -> TestIntersection(lightRay, poi, poiNormal, poiColor);
+            if (validInt) {
+                cache.occluder = sceneObject.get();
+                cache.index    = i;
+            }
         }
-        if (validInt)
-            break;
     }
     if (!validInt) {
         double angle = acos(qbVector<double>::dot(localNormal, lightDir));
@@ -80,4 +166,31 @@ bool waRT::PointLight::ComputeIllumination(const qbVector<double> &intPoint, con
       intensity = 0.0;
       return false;
     }
-}
\ No newline at end of file
+}
+
+waRT::ShadowStats waRT::PointLight::GetShadowStats() {
+    waRT::ShadowStats stats;
+    stats.rays      = m_shadowRays.load();
+    stats.cacheHits = m_shadowCacheHits.load();
+    stats.tests     = m_shadowTests.load();
+    return stats;
+}
+
+void waRT::PointLight::FlushShadowStats() {
+    ShadowCacheEntry &cache = ThreadShadowEntry(this);
+    m_shadowRays.fetch_add(cache.rays, std::memory_order_relaxed);
+    m_shadowCacheHits.fetch_add(cache.cacheHits, std::memory_order_relaxed);
+    m_shadowTests.fetch_add(cache.tests, std::memory_order_relaxed);
+    cache.rays = cache.cacheHits = cache.tests = 0;
+}
+
+bool waRT::PointLight::GetPhotonSource(double *position, double *intensity) {
+    for (int i = 0; i < 3; ++i) {
+        position[i]  = m_location.GetElement(i);
+        intensity[i] = m_color.GetElement(i) * m_intensity;
+    }
+    return m_intensity > 0.0;
+}
+
+void waRT::PointLight::SetShadowCache(bool enable) { m_shadowCache = enable;}
+bool waRT::PointLight::IsShadowCache() { return m_shadowCache;}
@@ -1,20 +1,34 @@
 #ifndef POINTLIGHT_H
 #define POINTLIGHT_H
 
+#include <atomic>
 #include "lightbase.hpp"
 
 namespace waRT {
     class PointLight : public LightBase {
         public:
             PointLight();
+            PointLight(const PointLight &other);
             virtual ~PointLight() override;
             virtual bool ComputeIllumination(const qbVector<double> &intPoint, const qbVector<double> &localNormal,
                                              const std::vector<std::shared_ptr<waRT::ObjectBase>> &objectList,
-                                             const std::shared_ptr<waRT::ObjectBase> &currentObject,
+                                             const std::shared_ptr<waRT::ObjectBase> &currentObject, double time,
                                              qbVector<double> &color, double &intensity);
+            virtual void Serialize(std::ostream &out) override;
+            virtual waRT::ShadowStats GetShadowStats() override;
+            virtual void FlushShadowStats() override;
+            virtual bool GetPhotonSource(double *position, double *intensity) override;
+
+            void SetShadowCache(bool enable);
+            bool IsShadowCache();
         public:
             qbVector<double> m_color;
             double m_intensity;
+        private:
+            bool m_shadowCache;
+            std::atomic<uint64_t> m_shadowRays;
+            std::atomic<uint64_t> m_shadowCacheHits;
+            std::atomic<uint64_t> m_shadowTests;
     };
 }
 
@@ -0,0 +1,67 @@
+/*
+    The `MappedFile` class maps a whole file into memory read-only, for data that is used in place instead of being read and parsed.
+
+    1. **Mapping (`Open`, `Close`)**:
+       - `Open()` maps the file with `MAP_SHARED` and `PROT_READ`. Every process mapping the same file then uses the same physical pages from the page cache, so a node running many renders of one scene holds its data once. Pages are brought in on first touch, so opening a large file costs almost nothing.
+       - An empty file or a failed `mmap()` makes `Open()` return `false`. `Close()`, and the destructor, unmap the file, and every pointer into it becomes invalid. Objects that keep such pointers hold the `MappedFile` in a shared pointer for that reason.
+
+    2. **Writing Files (`TempFileName`)**:
+       - Files that are mapped or read by other processes (saved primitive sets, paged geometry, tiled textures, cached renders) are written under a temporary name and renamed into place, so a reader never sees a half-written file. `TempFileName()` gives that name: the target with `.tmp`, the process id and a counter of the process appended. Two processes, or two threads of one, writing the same target at once then never share a temporary file.
+*/
+
+#include "mappedfile.hpp"
+#include <atomic>
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+waRT::MappedFile::MappedFile() {
+    m_data = nullptr;
+    m_size = 0;
+}
+
+waRT::MappedFile::~MappedFile() {
+    Close();
+}
+
+bool waRT::MappedFile::Open(const std::string &fileName) {
+    Close();
+    int file = open(fileName.c_str(), O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    struct stat fileInfo;
+    if ((fstat(file, &fileInfo) != 0) || (fileInfo.st_size <= 0)) {
+        close(file);
+        return false;
+    }
+    size_t fileBytes = static_cast<size_t>(fileInfo.st_size);
+    void *mapping = mmap(nullptr, fileBytes, PROT_READ, MAP_SHARED, file, 0);
+    // the mapping stays valid after the descriptor is closed
+    close(file);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    m_data = static_cast<const unsigned char *>(mapping);
+    m_size = fileBytes;
+    return true;
+}
+
+void waRT::MappedFile::Close() {
+    if (m_data != nullptr) {
+        munmap(const_cast<unsigned char *>(m_data), m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+}
+
+std::string waRT::TempFileName(const std::string &target) {
+    static std::atomic<uint64_t> tempCounter{0};
+    return target + ".tmp" + std::to_string(static_cast<long long>(getpid())) + "_" + std::to_string(tempCounter.fetch_add(1));
+}
+
+// GETTERS
+const unsigned char *waRT::MappedFile::GetData() { return m_data;}
+size_t waRT::MappedFile::GetSize() { return m_size;}
@@ -0,0 +1,32 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace waRT {
+    // a whole file mapped read-only, unmapped when the object goes away
+    class MappedFile {
+    public:
+        MappedFile();
+        ~MappedFile();
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator= (const MappedFile &) = delete;
+
+        bool Open(const std::string &fileName);
+        void Close();
+
+        // GETTERS
+        const unsigned char *GetData();
+        size_t GetSize();
+
+    private:
+        const unsigned char *m_data;
+        size_t m_size;
+    };
+
+    // a name next to target to write it under before renaming it into place, unique across threads and processes
+    std::string TempFileName(const std::string &target);
+}
+
+#endif
@@ -0,0 +1,374 @@
+/*
+    The `Texture` class is an image that can be mapped onto objects. It is built so that a scene can reference far more texture data than fits in memory: the image is converted once into a tiled mip pyramid on disk, and rendering only pulls the tiles it needs into the shared `TextureCache` (see `texturecache.cpp`).
+
+    1. **Opening (`Texture::Texture`)**:
+       - The constructor only reads the header of the source file to learn its size, so creating a texture is cheap even for huge images. Supported sources are binary PPM (`P6`, 8 or 16 bits per channel, decoded from sRGB to linear) and PFM (`PF` color or `Pf` grey, either byte order).
+       - `IsValid()` is `false` if the header cannot be read. Such a texture samples as magenta so the problem is visible in the image.
+       - `GetStamp()` is the source's size and modification time. It is part of the scene serialization, so the render cache notices when a texture file changes.
+
+    2. **Tiled Mip Pyramid (`Prepare`, `ConvertToTiles`)**:
+       - On the first tile request the texture looks for its converted file in the cache directory, named after a hash of the source path and stamp. If it is not there, the source is loaded once, each mip level is made by averaging 2x2 blocks of the level above (down to 1x1), and every level is written as `TEXTURE_TILE_SIZE`^2 tiles of linear RGB floats. The file is written under a temporary name and renamed into place, and the full image is freed again right after.
+       - This runs once per texture (`std::call_once`), the other threads wait for it. Later runs of the program reuse the file.
+       - `ReadTile()` reads one tile with `pread()` at an offset computed from the level and tile coordinates, so any number of threads can read at once.
+
+    3. **Sampling (`Sample`)**:
+       - The footprint (UV and its change to the next pixel in x and y, from ray differentials) gives the width of the pixel in texels. Its `log2` picks the mip level, so distant or grazing surfaces read small levels instead of aliasing and dragging full resolution tiles into memory.
+       - The two nearest levels are sampled bilinearly and blended (trilinear filtering). Coordinates wrap, so textures repeat outside `[0, 1]`.
+       - Each render thread keeps its last few tiles in a small direct-mapped table (`THREAD_TILE_SLOTS`), so neighbouring lookups usually hit without taking any lock.
+*/
+
+#include "texture.hpp"
+#include "../rendercache.hpp"
+#include "../mappedfile.hpp"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+constexpr int      THREAD_TILE_SLOTS  = 8;
+constexpr int      TILED_HEADER_BYTES = 64;
+constexpr char     TILED_MAGIC[8]     = {'W', 'A', 'T', 'X', '0', '0', '0', '1'};
+constexpr uint64_t TILE_BYTES         = sizeof(float) * 3 * waRT::TEXTURE_TILE_SIZE * waRT::TEXTURE_TILE_SIZE;
+
+static float SRGBToLinear(float value) {
+    return (value <= 0.04045f) ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+// read the next whitespace separated token of a PPM/PFM header, skipping comments
+static bool ReadToken(FILE *file, std::string &token) {
+    token.clear();
+    int c = fgetc(file);
+    while ((c != EOF) && (isspace(c) || (c == '#'))) {
+        if (c == '#') {
+            while ((c != EOF) && (c != '\n')) {
+                c = fgetc(file);
+            }
+        }
+        c = fgetc(file);
+    }
+    while ((c != EOF) && !isspace(c)) {
+        token += static_cast<char>(c);
+        c = fgetc(file);
+    }
+    return !token.empty();
+}
+
+waRT::Texture::Texture(const std::string &fileName) : Texture(fileName, waRT::TextureCache::Global()) {}
+
+waRT::Texture::Texture(const std::string &fileName, waRT::TextureCache &cache) {
+    m_fileName  = fileName;
+    m_cache     = &cache;
+    m_id        = waRT::TextureCache::NextTextureId();
+    m_width     = 0;
+    m_height    = 0;
+    m_numLevels = 0;
+    m_prepared  = false;
+    m_tiledFile = -1;
+    m_valid     = ReadHeader();
+}
+
+waRT::Texture::~Texture() {
+    if (m_tiledFile >= 0) {
+        close(m_tiledFile);
+    }
+}
+
+// GETTERS
+bool waRT::Texture::IsValid() { return m_valid;}
+uint32_t waRT::Texture::GetId() { return m_id;}
+int waRT::Texture::GetWidth() { return m_width;}
+int waRT::Texture::GetHeight() { return m_height;}
+int waRT::Texture::GetNumLevels() { return m_numLevels;}
+std::string waRT::Texture::GetFileName() { return m_fileName;}
+std::string waRT::Texture::GetStamp() { return m_stamp;}
+
+void waRT::Texture::Sample(const waRT::TextureFootprint &footprint, double *rgb) {
+    if (!m_valid) {
+        rgb[0] = 1.0;
+        rgb[1] = 0.0;
+        rgb[2] = 1.0;
+        return;
+    }
+
+    // footprint width in level 0 texels picks the mip level
+    double dsdx = footprint.dudx * m_width;
+    double dtdx = footprint.dvdx * m_height;
+    double dsdy = footprint.dudy * m_width;
+    double dtdy = footprint.dvdy * m_height;
+    double width = std::max(std::sqrt(dsdx * dsdx + dtdx * dtdx), std::sqrt(dsdy * dsdy + dtdy * dtdy));
+    double lod = std::log2(std::max(width, 1e-8));
+    lod = std::min(std::max(lod, 0.0), static_cast<double>(m_numLevels - 1));
+
+    int   level = static_cast<int>(lod);
+    float blend = static_cast<float>(lod - level);
+    float texel[3];
+    Bilinear(level, footprint.u, footprint.v, texel);
+    if ((blend > 0.0f) && (level + 1 < m_numLevels)) {
+        float coarse[3];
+        Bilinear(level + 1, footprint.u, footprint.v, coarse);
+        for (int i = 0; i < 3; ++i) {
+            texel[i] += (coarse[i] - texel[i]) * blend;
+        }
+    }
+    for (int i = 0; i < 3; ++i) {
+        rgb[i] = texel[i];
+    }
+}
+
+bool waRT::Texture::ReadTile(int level, int tileX, int tileY, float *texels) {
+    std::call_once(m_prepareOnce, [this]() { m_prepared = Prepare(); });
+    if (!m_prepared || (level < 0) || (level >= m_numLevels)) {
+        return false;
+    }
+    int tilesX = (m_levelWidth[level] + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+    uint64_t offset = m_levelOffset[level] + (static_cast<uint64_t>(tileY) * tilesX + tileX) * TILE_BYTES;
+    return pread(m_tiledFile, texels, TILE_BYTES, static_cast<off_t>(offset)) == static_cast<ssize_t>(TILE_BYTES);
+}
+
+// private funks
+
+bool waRT::Texture::ReadHeader() {
+    FILE *file = fopen(m_fileName.c_str(), "rb");
+    if (file == NULL) {
+        return false;
+    }
+    std::string magic, widthText, heightText;
+    bool headerOk = ReadToken(file, magic) && ((magic == "P6") || (magic == "PF") || (magic == "Pf")) &&
+                    ReadToken(file, widthText) && ReadToken(file, heightText);
+    fclose(file);
+    if (!headerOk) {
+        return false;
+    }
+    m_width  = atoi(widthText.c_str());
+    m_height = atoi(heightText.c_str());
+    if ((m_width <= 0) || (m_height <= 0) || (m_width > (1 << 24)) || (m_height > (1 << 24))) {
+        return false;
+    }
+
+    struct stat fileInfo;
+    if (stat(m_fileName.c_str(), &fileInfo) == 0) {
+        m_stamp = std::to_string(fileInfo.st_size) + ":" + std::to_string(static_cast<long long>(fileInfo.st_mtime));
+    }
+
+    // level sizes and where each level starts in the tiled file
+    uint64_t offset = TILED_HEADER_BYTES;
+    int levelWidth  = m_width;
+    int levelHeight = m_height;
+    while (true) {
+        m_levelWidth.push_back(levelWidth);
+        m_levelHeight.push_back(levelHeight);
+        m_levelOffset.push_back(offset);
+        uint64_t tilesX = (levelWidth  + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+        uint64_t tilesY = (levelHeight + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+        offset += tilesX * tilesY * TILE_BYTES;
+        if ((levelWidth == 1) && (levelHeight == 1)) {
+            break;
+        }
+        levelWidth  = std::max(1, levelWidth / 2);
+        levelHeight = std::max(1, levelHeight / 2);
+    }
+    m_numLevels = static_cast<int>(m_levelWidth.size());
+    return true;
+}
+
+bool waRT::Texture::Prepare() {
+    std::string directory = m_cache->GetDirectory();
+    std::string name = waRT::RenderCache::HashKey(m_fileName + "|" + m_stamp + "|" + std::to_string(TEXTURE_TILE_SIZE));
+    std::string tiledPath = (std::filesystem::path(directory) / (name + ".watx")).string();
+
+    std::error_code error;
+    if (!std::filesystem::exists(tiledPath, error)) {
+        std::filesystem::create_directories(directory, error);
+        if (!ConvertToTiles(tiledPath)) {
+            return false;
+        }
+    }
+
+    m_tiledFile = open(tiledPath.c_str(), O_RDONLY);
+    if (m_tiledFile < 0) {
+        return false;
+    }
+    char header[TILED_HEADER_BYTES];
+    int32_t size[2];
+    if ((pread(m_tiledFile, header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) ||
+        (memcmp(header, TILED_MAGIC, sizeof(TILED_MAGIC)) != 0)) {
+        return false;
+    }
+    memcpy(size, header + sizeof(TILED_MAGIC), sizeof(size));
+    return (size[0] == m_width) && (size[1] == m_height);
+}
+
+bool waRT::Texture::ConvertToTiles(const std::string &tiledPath) {
+    int width, height;
+    std::vector<float> level;
+    if (!LoadImage(m_fileName, width, height, level) || (width != m_width) || (height != m_height)) {
+        return false;
+    }
+
+    std::string tempPath = waRT::TempFileName(tiledPath);
+    FILE *outFile = fopen(tempPath.c_str(), "wb");
+    if (outFile == NULL) {
+        return false;
+    }
+    char header[TILED_HEADER_BYTES] = {0};
+    int32_t fields[4] = {m_width, m_height, m_numLevels, TEXTURE_TILE_SIZE};
+    memcpy(header, TILED_MAGIC, sizeof(TILED_MAGIC));
+    memcpy(header + sizeof(TILED_MAGIC), fields, sizeof(fields));
+    bool writeOk = (fwrite(header, 1, sizeof(header), outFile) == sizeof(header));
+
+    std::vector<float> tile(3 * TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE);
+    for (int levelIndex = 0; (levelIndex < m_numLevels) && writeOk; ++levelIndex) {
+        int levelWidth  = m_levelWidth[levelIndex];
+        int levelHeight = m_levelHeight[levelIndex];
+        if (levelIndex > 0) {
+            // 2x2 box filter of the previous level, clamped at odd edges
+            int prevWidth  = m_levelWidth[levelIndex - 1];
+            int prevHeight = m_levelHeight[levelIndex - 1];
+            std::vector<float> next(static_cast<size_t>(levelWidth) * levelHeight * 3);
+            for (int y = 0; y < levelHeight; ++y) {
+                for (int x = 0; x < levelWidth; ++x) {
+                    int x0 = std::min(2 * x, prevWidth - 1),  x1 = std::min(2 * x + 1, prevWidth - 1);
+                    int y0 = std::min(2 * y, prevHeight - 1), y1 = std::min(2 * y + 1, prevHeight - 1);
+                    for (int c = 0; c < 3; ++c) {
+                        next[(static_cast<size_t>(y) * levelWidth + x) * 3 + c] = 0.25f *
+                            (level[(static_cast<size_t>(y0) * prevWidth + x0) * 3 + c] + level[(static_cast<size_t>(y0) * prevWidth + x1) * 3 + c] +
+                             level[(static_cast<size_t>(y1) * prevWidth + x0) * 3 + c] + level[(static_cast<size_t>(y1) * prevWidth + x1) * 3 + c]);
+                    }
+                }
+            }
+            level.swap(next);
+        }
+
+        int tilesX = (levelWidth  + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+        int tilesY = (levelHeight + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+        for (int tileY = 0; (tileY < tilesY) && writeOk; ++tileY) {
+            for (int tileX = 0; (tileX < tilesX) && writeOk; ++tileX) {
+                // texels past the edge repeat the last row and column
+                for (int ty = 0; ty < TEXTURE_TILE_SIZE; ++ty) {
+                    int y = std::min(tileY * TEXTURE_TILE_SIZE + ty, levelHeight - 1);
+                    for (int tx = 0; tx < TEXTURE_TILE_SIZE; ++tx) {
+                        int x = std::min(tileX * TEXTURE_TILE_SIZE + tx, levelWidth - 1);
+                        for (int c = 0; c < 3; ++c) {
+                            tile[(ty * TEXTURE_TILE_SIZE + tx) * 3 + c] = level[(static_cast<size_t>(y) * levelWidth + x) * 3 + c];
+                        }
+                    }
+                }
+                writeOk = (fwrite(tile.data(), 1, TILE_BYTES, outFile) == TILE_BYTES);
+            }
+        }
+    }
+    writeOk = (fclose(outFile) == 0) && writeOk;
+
+    std::error_code error;
+    if (writeOk) {
+        std::filesystem::rename(tempPath, tiledPath, error);
+    }
+    if (!writeOk || error) {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    return true;
+}
+
+bool waRT::Texture::LoadImage(const std::string &fileName, int &width, int &height, std::vector<float> &pixels) {
+    FILE *file = fopen(fileName.c_str(), "rb");
+    if (file == NULL) {
+        return false;
+    }
+    std::string magic, widthText, heightText, rangeText;
+    if (!ReadToken(file, magic) || !ReadToken(file, widthText) || !ReadToken(file, heightText) || !ReadToken(file, rangeText)) {
+        fclose(file);
+        return false;
+    }
+    width  = atoi(widthText.c_str());
+    height = atoi(heightText.c_str());
+    size_t numPixels = static_cast<size_t>(width) * height;
+    pixels.assign(numPixels * 3, 0.0f);
+    bool readOk = false;
+
+    if (magic == "P6") {
+        int maxValue = atoi(rangeText.c_str());
+        int bytesPerSample = (maxValue > 255) ? 2 : 1;
+        std::vector<unsigned char> raw(numPixels * 3 * bytesPerSample);
+        readOk = (maxValue > 0) && (fread(raw.data(), 1, raw.size(), file) == raw.size());
+        for (size_t i = 0; readOk && (i < numPixels * 3); ++i) {
+            int value = (bytesPerSample == 2) ? ((raw[i * 2] << 8) | raw[i * 2 + 1]) : raw[i];
+            pixels[i] = SRGBToLinear(static_cast<float>(value) / maxValue);
+        }
+    } else if ((magic == "PF") || (magic == "Pf")) {
+        int channels = (magic == "PF") ? 3 : 1;
+        bool littleEndian = (atof(rangeText.c_str()) < 0.0);
+        std::vector<uint32_t> raw(numPixels * channels);
+        readOk = (fread(raw.data(), sizeof(uint32_t), raw.size(), file) == raw.size());
+        for (size_t i = 0; readOk && (i < numPixels); ++i) {
+            // PFM stores rows bottom to top
+            size_t row = i / width;
+            size_t destination = ((height - 1 - row) * width + (i % width)) * 3;
+            for (int c = 0; c < 3; ++c) {
+                uint32_t bits = raw[i * channels + std::min(c, channels - 1)];
+                if (!littleEndian) {
+                    bits = __builtin_bswap32(bits);
+                }
+                float value;
+                memcpy(&value, &bits, sizeof(value));
+                pixels[destination + c] = value;
+            }
+        }
+    }
+    fclose(file);
+    return readOk;
+}
+
+void waRT::Texture::Texel(int level, int x, int y, float *rgb) {
+    struct TileSlot {
+        uint64_t key = ~0ull;
+        std::shared_ptr<const waRT::TextureTile> tile;
+    };
+    thread_local TileSlot slots[THREAD_TILE_SLOTS];
+
+    int tileX = x / TEXTURE_TILE_SIZE;
+    int tileY = y / TEXTURE_TILE_SIZE;
+    uint64_t key = waRT::TextureCache::TileKey(m_id, level, tileX, tileY);
+    TileSlot &slot = slots[(key ^ (key >> 17) ^ (key >> 40)) % THREAD_TILE_SLOTS];
+    if (slot.key != key) {
+        slot.tile = m_cache->GetTile(*this, level, tileX, tileY);
+        slot.key  = key;
+    }
+    const float *texel = &slot.tile->texels[((y % TEXTURE_TILE_SIZE) * TEXTURE_TILE_SIZE + (x % TEXTURE_TILE_SIZE)) * 3];
+    rgb[0] = texel[0];
+    rgb[1] = texel[1];
+    rgb[2] = texel[2];
+}
+
+void waRT::Texture::Bilinear(int level, double u, double v, float *rgb) {
+    int levelWidth  = m_levelWidth[level];
+    int levelHeight = m_levelHeight[level];
+    double x = u * levelWidth  - 0.5;
+    double y = v * levelHeight - 0.5;
+    double xFloor = std::floor(x);
+    double yFloor = std::floor(y);
+    float fx = static_cast<float>(x - xFloor);
+    float fy = static_cast<float>(y - yFloor);
+
+    // repeat addressing
+    auto wrap = [](long long value, int size) { return static_cast<int>(((value % size) + size) % size);};
+    int x0 = wrap(static_cast<long long>(xFloor), levelWidth);
+    int y0 = wrap(static_cast<long long>(yFloor), levelHeight);
+    int x1 = (x0 + 1 == levelWidth)  ? 0 : x0 + 1;
+    int y1 = (y0 + 1 == levelHeight) ? 0 : y0 + 1;
+
+    float t00[3], t10[3], t01[3], t11[3];
+    Texel(level, x0, y0, t00);
+    Texel(level, x1, y0, t10);
+    Texel(level, x0, y1, t01);
+    Texel(level, x1, y1, t11);
+    for (int c = 0; c < 3; ++c) {
+        float top    = t00[c] + (t10[c] - t00[c]) * fx;
+        float bottom = t01[c] + (t11[c] - t01[c]) * fx;
+        rgb[c] = top + (bottom - top) * fy;
+    }
+}
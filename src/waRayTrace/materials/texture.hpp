@@ -0,0 +1,63 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "texturecache.hpp"
+
+namespace waRT {
+    // texture coordinates of a hit and how far they change to the next pixel
+    struct TextureFootprint {
+        double u    = 0.0, v    = 0.0;
+        double dudx = 0.0, dvdx = 0.0;
+        double dudy = 0.0, dvdy = 0.0;
+    };
+
+    class Texture {
+    public:
+        Texture(const std::string &fileName);
+        Texture(const std::string &fileName, waRT::TextureCache &cache);
+        ~Texture();
+
+        bool IsValid();
+        uint32_t GetId();
+        int GetWidth();
+        int GetHeight();
+        int GetNumLevels();
+        std::string GetFileName();
+        std::string GetStamp();
+
+        // trilinear lookup with the mip level chosen from the footprint
+        void Sample(const waRT::TextureFootprint &footprint, double *rgb);
+
+        // called by the cache on a miss
+        bool ReadTile(int level, int tileX, int tileY, float *texels);
+
+    private:
+        bool ReadHeader();
+        bool Prepare();
+        bool ConvertToTiles(const std::string &tiledPath);
+        static bool LoadImage(const std::string &fileName, int &width, int &height, std::vector<float> &pixels);
+        void Texel(int level, int x, int y, float *rgb);
+        void Bilinear(int level, double u, double v, float *rgb);
+
+    private:
+        std::string m_fileName;
+        std::string m_stamp;
+        waRT::TextureCache *m_cache;
+        uint32_t m_id;
+        bool m_valid;
+        int  m_width, m_height, m_numLevels;
+        std::vector<int>      m_levelWidth;
+        std::vector<int>      m_levelHeight;
+        std::vector<uint64_t> m_levelOffset;
+
+        std::once_flag m_prepareOnce;
+        bool m_prepared;
+        int  m_tiledFile;
+    };
+}
+
+#endif
@@ -0,0 +1,144 @@
+/*
+    The `TextureCache` class holds the texture tiles that are currently in memory. Textures are never loaded whole: each one is stored on disk as a tiled mip pyramid (see `texture.cpp`) and only the tiles that rays actually touch are read, so memory stays under a fixed budget however many textures a scene uses.
+
+    1. **Tiles and Keys**:
+       - A tile is `TEXTURE_TILE_SIZE` x `TEXTURE_TILE_SIZE` linear RGB floats from one mip level of one texture. It is identified by a 64-bit key made of the texture's id, the mip level and the tile coordinates (`TileKey`).
+       - Tiles are handed out as `shared_ptr<const TextureTile>`, so a tile that is being read by a render thread stays valid even if the cache evicts it at the same time.
+
+    2. **Lookup (`GetTile`)**:
+       - The cache is split into `TEXTURE_CACHE_SHARDS` shards by key, each with its own mutex, LRU list and hash map, so threads reading different tiles rarely wait for each other.
+       - The nodes of a shard's list and map are fixed-size records that come and go with every miss and eviction. They are taken from the shard's `MemPool` through `PoolAllocator` (see `memarena.cpp`), which is only touched under the shard's mutex, so once a shard is full, turning over tiles does not allocate nodes.
+       - On a hit the tile moves to the front of its shard's LRU list. On a miss the tile is read from the texture's tiled file without holding the lock, then inserted. If two threads miss the same tile at once both read it and the first insert wins, which is cheaper than making one wait.
+
+    3. **Budget and Eviction**:
+       - Every shard may hold `maxBytes / TEXTURE_CACHE_SHARDS` bytes of tiles. After an insert the least recently used tiles of that shard are evicted until it is back under its share. `SetMaxBytes()` can change the budget at any time and takes effect on the next insert.
+       - Render threads keep a handful of recently used tiles of their own (see `Texture::Texel`), so the real peak is the budget plus a few tiles per thread.
+
+    4. **Global Cache and Directory**:
+       - `Global()` returns the cache shared by all textures unless a texture is given its own cache. It starts with a 256 MiB budget.
+       - The directory holds the converted tiled files. It defaults to `waRT-textures` in the system temp directory and can be changed with `SetDirectory()`.
+
+    5. **Statistics**:
+       - `GetTotalBytes()`, `GetHits()`, `GetMisses()` and `GetEvictions()` report the cache's state for tuning the budget.
+*/
+
+#include "texturecache.hpp"
+#include "texture.hpp"
+#include <algorithm>
+#include <filesystem>
+
+constexpr uint64_t DEFAULT_TEXTURE_BUDGET = 256ull * 1024 * 1024;
+constexpr uint64_t TILE_BYTES = sizeof(float) * 3 * waRT::TEXTURE_TILE_SIZE * waRT::TEXTURE_TILE_SIZE;
+
+waRT::TextureCache::TextureCache(uint64_t maxBytes) {
+    m_maxBytes  = maxBytes;
+    m_hits      = 0;
+    m_misses    = 0;
+    m_evictions = 0;
+    std::error_code error;
+    m_directory = (std::filesystem::temp_directory_path(error) / "waRT-textures").string();
+}
+
+waRT::TextureCache &waRT::TextureCache::Global() {
+    static waRT::TextureCache globalCache(DEFAULT_TEXTURE_BUDGET);
+    return globalCache;
+}
+
+// SETTERS
+void waRT::TextureCache::SetMaxBytes(uint64_t maxBytes) {
+    m_maxBytes = maxBytes;
+}
+
+void waRT::TextureCache::SetDirectory(const std::string &directory) {
+    std::lock_guard<std::mutex> lock(m_directoryMutex);
+    m_directory = directory;
+}
+
+// GETTERS
+std::string waRT::TextureCache::GetDirectory() {
+    std::lock_guard<std::mutex> lock(m_directoryMutex);
+    return m_directory;
+}
+
+uint64_t waRT::TextureCache::GetTotalBytes() {
+    uint64_t total = 0;
+    for (auto &shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.bytes;
+    }
+    return total;
+}
+
+uint64_t waRT::TextureCache::GetHits()      { return m_hits;}
+uint64_t waRT::TextureCache::GetMisses()    { return m_misses;}
+uint64_t waRT::TextureCache::GetEvictions() { return m_evictions;}
+
+uint32_t waRT::TextureCache::NextTextureId() {
+    static std::atomic<uint32_t> nextId {1};
+    return nextId.fetch_add(1);
+}
+
+// 24 bits texture, 6 bits level, 17 bits for each tile coordinate
+uint64_t waRT::TextureCache::TileKey(uint32_t textureId, int level, int tileX, int tileY) {
+    return (static_cast<uint64_t>(textureId & 0xffffff) << 40) |
+           (static_cast<uint64_t>(level & 0x3f) << 34) |
+           (static_cast<uint64_t>(tileY & 0x1ffff) << 17) |
+            static_cast<uint64_t>(tileX & 0x1ffff);
+}
+
+std::shared_ptr<const waRT::TextureTile> waRT::TextureCache::GetTile(waRT::Texture &texture, int level, int tileX, int tileY) {
+    uint64_t key = TileKey(texture.GetId(), level, tileX, tileY);
+    // mix the key so neighbouring tiles land in different shards
+    Shard &shard = m_shards[((key * 0x9e3779b97f4a7c15ull) >> 60) % TEXTURE_CACHE_SHARDS];
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.entries.find(key);
+        if (found != shard.entries.end()) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, found->second.lruPosition);
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            return found->second.tile;
+        }
+    }
+
+    // read outside the lock
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    auto tile = std::make_shared<waRT::TextureTile>();
+    tile->texels.resize(3 * TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE);
+    if (!texture.ReadTile(level, tileX, tileY, tile->texels.data())) {
+        // a missing or broken file shows as black instead of failing the render
+        std::fill(tile->texels.begin(), tile->texels.end(), 0.0f);
+    }
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.entries.find(key);
+    if (found != shard.entries.end()) {
+        return found->second.tile;
+    }
+    shard.lru.push_front(key);
+    shard.entries[key] = Entry {tile, shard.lru.begin()};
+    shard.bytes += TILE_BYTES;
+    EvictLocked(shard);
+    return tile;
+}
+
+void waRT::TextureCache::Clear() {
+    for (auto &shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.entries.clear();
+        shard.lru.clear();
+        shard.bytes = 0;
+    }
+}
+
+// private funks
+
+void waRT::TextureCache::EvictLocked(Shard &shard) {
+    uint64_t shardBudget = m_maxBytes / TEXTURE_CACHE_SHARDS;
+    // keep at least the tile that was just inserted
+    while ((shard.bytes > shardBudget) && (shard.lru.size() > 1)) {
+        shard.entries.erase(shard.lru.back());
+        shard.lru.pop_back();
+        shard.bytes -= TILE_BYTES;
+        m_evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
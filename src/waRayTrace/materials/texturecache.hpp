@@ -0,0 +1,78 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../memarena.hpp"
+
+namespace waRT {
+    class Texture;
+
+    constexpr int TEXTURE_TILE_SIZE    = 64;
+    constexpr int TEXTURE_CACHE_SHARDS = 16;
+
+    struct TextureTile {
+        // TEXTURE_TILE_SIZE^2 linear rgb texels, row major
+        std::vector<float> texels;
+    };
+
+    class TextureCache {
+    public:
+        TextureCache(uint64_t maxBytes);
+        static TextureCache &Global();
+
+        void SetMaxBytes(uint64_t maxBytes);
+        void SetDirectory(const std::string &directory);
+        std::string GetDirectory();
+
+        std::shared_ptr<const waRT::TextureTile> GetTile(waRT::Texture &texture, int level, int tileX, int tileY);
+        void Clear();
+
+        uint64_t GetTotalBytes();
+        uint64_t GetHits();
+        uint64_t GetMisses();
+        uint64_t GetEvictions();
+
+        static uint32_t NextTextureId();
+        static uint64_t TileKey(uint32_t textureId, int level, int tileX, int tileY);
+
+    private:
+        using LruList = std::list<uint64_t, waRT::PoolAllocator<uint64_t>>;
+
+        struct Entry {
+            std::shared_ptr<const waRT::TextureTile> tile;
+            LruList::iterator lruPosition;
+        };
+
+        using EntryMap = std::unordered_map<uint64_t, Entry, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                                            waRT::PoolAllocator<std::pair<const uint64_t, Entry>>>;
+
+        // the list and map nodes come from the shard's pool, guarded like the rest by its mutex
+        struct Shard {
+            std::mutex mutex;
+            waRT::MemPool pool;
+            LruList  lru     {waRT::PoolAllocator<uint64_t>(pool)};
+            EntryMap entries {waRT::PoolAllocator<std::pair<const uint64_t, Entry>>(pool)};
+            uint64_t bytes = 0;
+        };
+
+        void EvictLocked(Shard &shard);
+
+    private:
+        Shard m_shards[TEXTURE_CACHE_SHARDS];
+        std::atomic<uint64_t> m_maxBytes;
+        std::atomic<uint64_t> m_hits;
+        std::atomic<uint64_t> m_misses;
+        std::atomic<uint64_t> m_evictions;
+        std::mutex  m_directoryMutex;
+        std::string m_directory;
+    };
+}
+
+#endif
@@ -0,0 +1,146 @@
+/*
+    The `MemArena` class is a bump (arena) allocator for short-lived data on the render hot path. Memory is handed out by simply advancing an offset inside a large block, and everything is released at once by `Reset()`, which just rewinds the offset. After the first few tiles the blocks are big enough and the render loop never has to call the global allocator again.
+
+    1. **Allocation (`Allocate`, `AllocateArray`)**:
+       - `Allocate()` aligns the current offset, and if the request does not fit in the current block moves on to the next block, allocating a new one (at least `m_blockSize` bytes, or larger for big requests) only when none is left.
+       - `AllocateArray<T>()` allocates and value-initializes `count` objects. Only trivially destructible types are allowed, because the arena never runs destructors.
+
+    2. **Reset (`Reset`)**:
+       - Rewinds to the first block without freeing anything, so memory is reused from one tile (or frame) to the next. `Scene::Render` resets each render thread's arena at the start of every tile and then allocates the tile's camera samples from it, and resets the calling thread's arena once per frame for its region tables, so pointers into an arena must never be kept across tiles or frames.
+
+    3. **Per-Thread Arenas (`ForThisThread`)**:
+       - Returns an arena owned by the calling thread. Because each thread has its own, allocation needs no locking at all.
+
+    4. **Standard Containers (`ArenaAllocator`)**:
+       - `ArenaAllocator<T>` (in `memarena.hpp`) lets `std::vector` and friends take their storage from an arena. Deallocation does nothing, the memory comes back with the next `Reset()`. `Scene::RenderPixels` builds its per-frame tables of region tiles and row masks this way in the calling thread's arena, which it resets once per frame.
+
+    5. **Pools (`MemPool`, `PoolAllocator`)**:
+       - An arena cannot give back one record, so records that are created and destroyed one at a time, and live for an unknown time, go into a `MemPool` instead. It keeps one free list per slot size (rounded up to `alignof(std::max_align_t)`), carves new slots from chunks of `m_itemsPerChunk` slots only when a list runs dry, and returns chunks to the system only when the pool is destroyed. After warm-up a steady churn of records never calls the global allocator.
+       - `New<T>()` and `Delete()` construct and destroy single objects in it. `PoolAllocator<T>` is the standard allocator adapter for node based containers: single nodes come from the pool, arrays such as the bucket table of an `unordered_map` from the global allocator. Because the size classes live in the pool, every type a container rebinds the allocator to shares it.
+       - A pool is not thread safe; the owner serialises access. The texture cache gives each shard its own pool for the nodes of its LRU list and hash map, under the shard's mutex (see `materials/texturecache.cpp`), so a tile miss or eviction no longer allocates or frees a node.
+
+    6. **Statistics (`GetBytesUsed`, `GetBytesReserved`)**:
+       - Report how many bytes are currently handed out and how many are held in blocks, which is useful for tuning `m_blockSize`.
+*/
+
+#include "memarena.hpp"
+#include <algorithm>
+
+waRT::MemArena::MemArena(size_t blockSize) {
+    m_blockSize    = blockSize;
+    m_currentBlock = 0;
+    m_offset       = 0;
+    m_bytesUsed    = 0;
+}
+
+waRT::MemArena::~MemArena() {
+    for (auto &block : m_blocks) {
+        ::operator delete(block.data);
+    }
+}
+
+void *waRT::MemArena::Allocate(size_t numBytes, size_t alignment) {
+    while (m_currentBlock < m_blocks.size()) {
+        Block &block = m_blocks[m_currentBlock];
+        uintptr_t base    = reinterpret_cast<uintptr_t>(block.data);
+        uintptr_t aligned = (base + m_offset + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+        size_t newOffset  = (aligned - base) + numBytes;
+        if (newOffset <= block.size) {
+            m_bytesUsed += newOffset - m_offset;
+            m_offset = newOffset;
+            return reinterpret_cast<void *>(aligned);
+        }
+        ++m_currentBlock;
+        m_offset = 0;
+    }
+
+    // out of blocks, this is the only place the arena touches the global allocator
+    Block newBlock;
+    newBlock.size = (numBytes + alignment > m_blockSize) ? (numBytes + alignment) : m_blockSize;
+    newBlock.data = static_cast<unsigned char *>(::operator new(newBlock.size));
+    m_blocks.push_back(newBlock);
+    m_currentBlock = m_blocks.size() - 1;
+    m_offset = 0;
+    return Allocate(numBytes, alignment);
+}
+
+void waRT::MemArena::Reset() {
+    m_currentBlock = 0;
+    m_offset       = 0;
+    m_bytesUsed    = 0;
+}
+
+size_t waRT::MemArena::GetBytesUsed() { return m_bytesUsed;}
+
+size_t waRT::MemArena::GetBytesReserved() {
+    size_t total = 0;
+    for (auto &block : m_blocks) {
+        total += block.size;
+    }
+    return total;
+}
+
+waRT::MemArena &waRT::MemArena::ForThisThread() {
+    thread_local MemArena threadArena;
+    return threadArena;
+}
+
+waRT::MemPool::MemPool(size_t itemsPerChunk) {
+    m_itemsPerChunk = std::max<size_t>(1, itemsPerChunk);
+    m_liveCount     = 0;
+    m_bytesReserved = 0;
+}
+
+waRT::MemPool::~MemPool() {
+    for (void *chunk : m_chunks) {
+        ::operator delete(chunk);
+    }
+}
+
+void *waRT::MemPool::Allocate(size_t numBytes) {
+    SizeClass &sizeClass = ClassFor(numBytes);
+    if (sizeClass.freeList == nullptr) {
+        // out of slots of this size, this is the only place the pool touches the global allocator
+        unsigned char *chunk = static_cast<unsigned char *>(::operator new(sizeClass.slotSize * m_itemsPerChunk));
+        m_chunks.push_back(chunk);
+        m_bytesReserved += sizeClass.slotSize * m_itemsPerChunk;
+        for (size_t i = 0; i < m_itemsPerChunk; ++i) {
+            FreeSlot *slot = reinterpret_cast<FreeSlot *>(chunk + i * sizeClass.slotSize);
+            slot->next = sizeClass.freeList;
+            sizeClass.freeList = slot;
+        }
+    }
+    FreeSlot *slot = sizeClass.freeList;
+    sizeClass.freeList = slot->next;
+    ++m_liveCount;
+    return slot;
+}
+
+void waRT::MemPool::Deallocate(void *item, size_t numBytes) {
+    if (item == nullptr) {
+        return;
+    }
+    SizeClass &sizeClass = ClassFor(numBytes);
+    FreeSlot *slot = static_cast<FreeSlot *>(item);
+    slot->next = sizeClass.freeList;
+    sizeClass.freeList = slot;
+    --m_liveCount;
+}
+
+size_t waRT::MemPool::GetLiveCount()     { return m_liveCount;}
+size_t waRT::MemPool::GetBytesReserved() { return m_bytesReserved;}
+
+// private funks
+
+// a container uses a handful of node sizes, so a linear search is enough
+waRT::MemPool::SizeClass &waRT::MemPool::ClassFor(size_t numBytes) {
+    size_t alignment = alignof(std::max_align_t);
+    size_t slotSize  = (std::max(numBytes, sizeof(FreeSlot)) + alignment - 1) & ~(alignment - 1);
+    for (auto &sizeClass : m_classes) {
+        if (sizeClass.slotSize == slotSize) {
+            return sizeClass;
+        }
+    }
+    m_classes.push_back(SizeClass{slotSize, nullptr});
+    return m_classes.back();
+}
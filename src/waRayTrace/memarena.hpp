@@ -0,0 +1,170 @@
+#ifndef MEMARENA_H
+#define MEMARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace waRT {
+    class MemArena {
+    public:
+        MemArena(size_t blockSize = 64 * 1024);
+        ~MemArena();
+        MemArena(const MemArena &) = delete;
+        MemArena &operator= (const MemArena &) = delete;
+
+        void *Allocate(size_t numBytes, size_t alignment = alignof(std::max_align_t));
+        void Reset();
+
+        template <class T>
+        T *AllocateArray(size_t count) {
+            static_assert(std::is_trivially_destructible<T>::value, "arena memory is released without running destructors");
+            T *items = static_cast<T *>(Allocate(count * sizeof(T), alignof(T)));
+            for (size_t i = 0; i < count; ++i) {
+                new (&items[i]) T();
+            }
+            return items;
+        }
+
+        size_t GetBytesUsed();
+        size_t GetBytesReserved();
+
+        static MemArena &ForThisThread();
+
+    private:
+        struct Block {
+            unsigned char *data;
+            size_t         size;
+        };
+
+        std::vector<Block> m_blocks;
+        size_t m_blockSize;
+        size_t m_currentBlock;
+        size_t m_offset;
+        size_t m_bytesUsed;
+    };
+
+    // lets standard containers draw their storage from an arena
+    template <class T>
+    class ArenaAllocator {
+    public:
+        using value_type = T;
+
+        ArenaAllocator(MemArena &arena) : m_arena(&arena) {}
+        template <class U>
+        ArenaAllocator(const ArenaAllocator<U> &other) : m_arena(other.m_arena) {}
+
+        T *allocate(size_t count) { return static_cast<T *>(m_arena->Allocate(count * sizeof(T), alignof(T)));}
+        void deallocate(T *, size_t) {}
+
+        template <class U> bool operator== (const ArenaAllocator<U> &rhs) const { return m_arena == rhs.m_arena;}
+        template <class U> bool operator!= (const ArenaAllocator<U> &rhs) const { return m_arena != rhs.m_arena;}
+
+    public:
+        MemArena *m_arena;
+    };
+
+    // free lists of fixed-size slots for records that are created and destroyed one at a time; not thread safe
+    class MemPool {
+    public:
+        MemPool(size_t itemsPerChunk = 256);
+        ~MemPool();
+        MemPool(const MemPool &) = delete;
+        MemPool &operator= (const MemPool &) = delete;
+
+        void *Allocate(size_t numBytes);
+        void Deallocate(void *item, size_t numBytes);
+
+        template <class T, class... Args>
+        T *New(Args &&... args) {
+            static_assert(alignof(T) <= alignof(std::max_align_t), "pool slots are only max_align_t aligned");
+            return new (Allocate(sizeof(T))) T(std::forward<Args>(args)...);
+        }
+
+        template <class T>
+        void Delete(T *item) {
+            if (item != nullptr) {
+                item->~T();
+                Deallocate(item, sizeof(T));
+            }
+        }
+
+        size_t GetLiveCount();
+        size_t GetBytesReserved();
+
+    private:
+        struct FreeSlot {
+            FreeSlot *next;
+        };
+
+        struct SizeClass {
+            size_t    slotSize;
+            FreeSlot *freeList;
+        };
+
+        SizeClass &ClassFor(size_t numBytes);
+
+    private:
+        std::vector<SizeClass> m_classes;
+        std::vector<void *>    m_chunks;
+        size_t m_itemsPerChunk;
+        size_t m_liveCount;
+        size_t m_bytesReserved;
+    };
+
+    // lets node based containers take their nodes from a pool; arrays (hash buckets) still use the global allocator
+    template <class T>
+    class PoolAllocator {
+    public:
+        using value_type = T;
+
+        PoolAllocator(MemPool &pool) : m_pool(&pool) {}
+        template <class U>
+        PoolAllocator(const PoolAllocator<U> &other) : m_pool(other.m_pool) {}
+
+        T *allocate(size_t count) {
+            if ((count == 1) && (alignof(T) <= alignof(std::max_align_t))) {
+                return static_cast<T *>(m_pool->Allocate(sizeof(T)));
+            }
+            return static_cast<T *>(::operator new(count * sizeof(T)));
+        }
+
+        void deallocate(T *item, size_t count) {
+            if ((count == 1) && (alignof(T) <= alignof(std::max_align_t))) {
+                m_pool->Deallocate(item, sizeof(T));
+            } else {
+                ::operator delete(item);
+            }
+        }
+
+        template <class U> bool operator== (const PoolAllocator<U> &rhs) const { return m_pool == rhs.m_pool;}
+        template <class U> bool operator!= (const PoolAllocator<U> &rhs) const { return m_pool != rhs.m_pool;}
+
+    public:
+        MemPool *m_pool;
+    };
+
+    // default-initializes on resize(), so the new elements of a large buffer stay unwritten and its
+    // pages are only placed in memory by whichever thread writes them first
+    template <class T>
+    class UninitializedAllocator : public std::allocator<T> {
+    public:
+        template <class U>
+        struct rebind { using other = UninitializedAllocator<U>;};
+
+        UninitializedAllocator() = default;
+        template <class U>
+        UninitializedAllocator(const UninitializedAllocator<U> &) {}
+
+        template <class U>
+        void construct(U *item) { ::new (static_cast<void *>(item)) U;}
+        template <class U, class... Args>
+        void construct(U *item, Args &&... args) { ::new (static_cast<void *>(item)) U(std::forward<Args>(args)...);}
+    };
+}
+
+#endif
@@ -0,0 +1,234 @@
+/*
+    The `PhotonMap` class holds photons that light sources sent into the scene and answers the nearest neighbour queries of photon mapping (Jensen, 1996). The scene uses it for caustics, light focused by mirrors and glass onto diffuse surfaces, which camera paths can hardly find on their own (see `Scene::EmitPhotons`).
+
+    1. **Photons**:
+       - A `Photon` is its position and power as floats, the direction it arrived from packed into three bytes, and the split axis of its tree node, 28 bytes in all. The power is in whatever unit the caller chose; the map only sums it.
+
+    2. **Left-Balanced kd-Tree (`Build`)**:
+       - The tree is stored as an implicit heap: the children of node `i` are `2i + 1` and `2i + 2`, so there are no child pointers, and the top levels, which every query walks, sit together at the front of one array.
+       - It is balanced so that every level but the last is full and the last is filled from the left. `LeftSubtreeSize()` works out how many photons the left subtree of `n` holds in that shape, `std::nth_element` moves that many below the split, and the photon at the split becomes the node. Every heap index is then below the photon count.
+       - The split axis is the longest side of the bounds of the node's photons. The two subtrees own disjoint ranges of the input and disjoint heap slots, so the first levels hand one of them to a new thread until `numThreads` threads are busy.
+       - `Build()` reorders the vector it is given and copies the photons into place; the same photons in the same order always give the same tree.
+
+    3. **Queries (`FindNearest`, `FindInRadius`)**:
+       - Both walk the tree depth first with a small stack, visiting the side of the split the point is on first and the far side only if the split plane is closer than the current search radius.
+       - `FindNearest()` keeps the best `k` in a max-heap on the caller's array and shrinks the radius to the farthest of them once it is full. `FindInRadius()` returns every photon inside a fixed radius.
+
+    4. **Density Estimation (`EstimateIrradiance`)**:
+       - The irradiance is the power of the nearest photons over the area of the disc they cover, counting only photons that arrived on the front of the surface. If fewer than `k` were found the disc is the full `maxRadius`, which keeps a few isolated photons from turning into bright spots.
+       - Each photon is weighted with a cone filter, `1 - d / r`, normalised by 3, which keeps the sharp edges of caustics from blurring as much as a plain average would.
+*/
+
+#include "photonmap.hpp"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+// below this many photons a subtree is not worth a thread
+constexpr size_t PHOTON_PARALLEL_MIN     = 4096;
+constexpr int    PHOTON_STACK_SIZE       = 128;
+// 1 / (1 - 2 / 3), for the cone filter with k = 1
+constexpr double PHOTON_CONE_NORMALISATION = 3.0;
+
+waRT::PhotonMap::PhotonMap() {}
+
+void waRT::PhotonMap::Build(std::vector<waRT::Photon> &photons, int numThreads) {
+    m_photons.resize(photons.size());
+    if (!photons.empty()) {
+        Balance(photons.data(), photons.size(), 0, std::max(1, numThreads));
+    }
+}
+
+void waRT::PhotonMap::Clear() {
+    m_photons.clear();
+}
+
+int waRT::PhotonMap::FindNearest(const double *point, int k, double maxRadius, waRT::PhotonNeighbour *neighbours) const {
+    if (m_photons.empty() || (k <= 0)) {
+        return 0;
+    }
+    auto farther = [](const waRT::PhotonNeighbour &a, const waRT::PhotonNeighbour &b) { return a.distSquared < b.distSquared;};
+    double maxDistSquared = maxRadius * maxRadius;
+    int found = 0;
+
+    size_t stack[PHOTON_STACK_SIZE];
+    double stackDist[PHOTON_STACK_SIZE];
+    int top = 0;
+    stack[top] = 0;
+    stackDist[top++] = 0.0;
+    size_t count = m_photons.size();
+    while (top > 0) {
+        --top;
+        size_t node = stack[top];
+        if (stackDist[top] >= maxDistSquared) {
+            continue;
+        }
+        const waRT::Photon &photon = m_photons[node];
+        double distSquared = 0.0;
+        for (int i = 0; i < 3; ++i) {
+            double delta = point[i] - photon.position[i];
+            distSquared += delta * delta;
+        }
+        if (distSquared < maxDistSquared) {
+            if (found < k) {
+                neighbours[found++] = waRT::PhotonNeighbour{static_cast<int>(node), static_cast<float>(distSquared)};
+                std::push_heap(neighbours, neighbours + found, farther);
+            } else {
+                std::pop_heap(neighbours, neighbours + found, farther);
+                neighbours[found - 1] = waRT::PhotonNeighbour{static_cast<int>(node), static_cast<float>(distSquared)};
+                std::push_heap(neighbours, neighbours + found, farther);
+            }
+            if (found == k) {
+                maxDistSquared = neighbours[0].distSquared;
+            }
+        }
+        double planeDist = point[photon.axis] - photon.position[photon.axis];
+        size_t nearChild = 2 * node + ((planeDist > 0.0) ? 2 : 1);
+        size_t farChild  = 2 * node + ((planeDist > 0.0) ? 1 : 2);
+        // the far side goes on the stack first, so the near side is searched first
+        if (farChild < count) {
+            stack[top] = farChild;
+            stackDist[top++] = planeDist * planeDist;
+        }
+        if (nearChild < count) {
+            stack[top] = nearChild;
+            stackDist[top++] = 0.0;
+        }
+    }
+    return found;
+}
+
+void waRT::PhotonMap::FindInRadius(const double *point, double radius, std::vector<int> &indices) const {
+    indices.clear();
+    if (m_photons.empty()) {
+        return;
+    }
+    double radiusSquared = radius * radius;
+    size_t stack[PHOTON_STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    size_t count = m_photons.size();
+    while (top > 0) {
+        size_t node = stack[--top];
+        const waRT::Photon &photon = m_photons[node];
+        double distSquared = 0.0;
+        for (int i = 0; i < 3; ++i) {
+            double delta = point[i] - photon.position[i];
+            distSquared += delta * delta;
+        }
+        if (distSquared < radiusSquared) {
+            indices.push_back(static_cast<int>(node));
+        }
+        double planeDist = point[photon.axis] - photon.position[photon.axis];
+        size_t nearChild = 2 * node + ((planeDist > 0.0) ? 2 : 1);
+        size_t farChild  = 2 * node + ((planeDist > 0.0) ? 1 : 2);
+        if ((farChild < count) && (planeDist * planeDist < radiusSquared)) {
+            stack[top++] = farChild;
+        }
+        if (nearChild < count) {
+            stack[top++] = nearChild;
+        }
+    }
+}
+
+bool waRT::PhotonMap::EstimateIrradiance(const double *point, const double *normal, int k, double maxRadius, double *irradiance) const {
+    waRT::PhotonNeighbour neighbours[PHOTON_MAX_NEAREST];
+    k = std::max(1, std::min(k, PHOTON_MAX_NEAREST));
+    int found = FindNearest(point, k, maxRadius, neighbours);
+    double radiusSquared = maxRadius * maxRadius;
+    if (found == k) {
+        radiusSquared = 0.0;
+        for (int n = 0; n < found; ++n) {
+            radiusSquared = std::max(radiusSquared, static_cast<double>(neighbours[n].distSquared));
+        }
+    }
+    double sum[3] = {0.0, 0.0, 0.0};
+    bool anyFront = false;
+    double radius = sqrt(radiusSquared);
+    for (int n = 0; n < found; ++n) {
+        const waRT::Photon &photon = m_photons[neighbours[n].index];
+        double facing = photon.direction[0] * normal[0] + photon.direction[1] * normal[1] + photon.direction[2] * normal[2];
+        if (facing >= 0.0) {
+            continue;
+        }
+        anyFront = true;
+        double weight = (radius > 0.0) ? 1.0 - sqrt(neighbours[n].distSquared) / radius : 1.0;
+        for (int i = 0; i < 3; ++i) {
+            sum[i] += weight * photon.power[i];
+        }
+    }
+    if (!anyFront || !(radiusSquared > 0.0)) {
+        return false;
+    }
+    double scale = PHOTON_CONE_NORMALISATION / (M_PI * radiusSquared);
+    for (int i = 0; i < 3; ++i) {
+        irradiance[i] = sum[i] * scale;
+    }
+    return true;
+}
+
+void waRT::PhotonMap::PackDirection(const double *direction, int8_t *packed) {
+    for (int i = 0; i < 3; ++i) {
+        packed[i] = static_cast<int8_t>(std::max(-127.0, std::min(127.0, std::round(direction[i] * 127.0))));
+    }
+}
+
+// GETTERS
+const waRT::Photon &waRT::PhotonMap::GetPhoton(int index) const { return m_photons[index];}
+size_t waRT::PhotonMap::GetNumPhotons()  { return m_photons.size();}
+size_t waRT::PhotonMap::GetMemoryBytes() { return m_photons.capacity() * sizeof(waRT::Photon);}
+
+// private funks
+
+void waRT::PhotonMap::Balance(waRT::Photon *photons, size_t count, size_t heapIndex, int numThreads) {
+    if (count == 0) {
+        return;
+    }
+    float boxMin[3] = {photons[0].position[0], photons[0].position[1], photons[0].position[2]};
+    float boxMax[3] = {boxMin[0], boxMin[1], boxMin[2]};
+    for (size_t p = 1; p < count; ++p) {
+        for (int i = 0; i < 3; ++i) {
+            boxMin[i] = std::min(boxMin[i], photons[p].position[i]);
+            boxMax[i] = std::max(boxMax[i], photons[p].position[i]);
+        }
+    }
+    int axis = 0;
+    for (int i = 1; i < 3; ++i) {
+        if (boxMax[i] - boxMin[i] > boxMax[axis] - boxMin[axis]) {
+            axis = i;
+        }
+    }
+    size_t leftCount = LeftSubtreeSize(count);
+    std::nth_element(photons, photons + leftCount, photons + count,
+                     [axis](const waRT::Photon &a, const waRT::Photon &b) { return a.position[axis] < b.position[axis];});
+    m_photons[heapIndex] = photons[leftCount];
+    m_photons[heapIndex].axis = static_cast<uint8_t>(axis);
+
+    waRT::Photon *rightPhotons = photons + leftCount + 1;
+    size_t rightCount = count - leftCount - 1;
+    if ((numThreads > 1) && (count >= PHOTON_PARALLEL_MIN)) {
+        int leftThreads = numThreads / 2;
+        std::thread leftThread([this, photons, leftCount, heapIndex, leftThreads]() {
+            Balance(photons, leftCount, 2 * heapIndex + 1, leftThreads);
+        });
+        Balance(rightPhotons, rightCount, 2 * heapIndex + 2, numThreads - leftThreads);
+        leftThread.join();
+    } else {
+        Balance(photons, leftCount, 2 * heapIndex + 1, 1);
+        Balance(rightPhotons, rightCount, 2 * heapIndex + 2, 1);
+    }
+}
+
+// the left subtree of a complete tree of count nodes: all of the full levels' share, and the last level's from the left
+size_t waRT::PhotonMap::LeftSubtreeSize(size_t count) {
+    if (count <= 1) {
+        return 0;
+    }
+    size_t lastLevelCapacity = 1;
+    while (lastLevelCapacity * 2 <= count) {
+        lastLevelCapacity *= 2;
+    }
+    size_t lastLevelCount = count - (lastLevelCapacity - 1);
+    size_t half = lastLevelCapacity / 2;
+    return (half - 1) + std::min(lastLevelCount, half);
+}
@@ -0,0 +1,56 @@
+#ifndef PHOTONMAP_H
+#define PHOTONMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace waRT {
+    constexpr int PHOTON_DEFAULT_NEAREST = 64;
+    constexpr int PHOTON_MAX_NEAREST     = 256;
+
+    // a photon as it arrived at a diffuse surface; axis is the split plane of its kd-tree node
+    struct Photon {
+        float   position[3];
+        float   power[3];
+        int8_t  direction[3];
+        uint8_t axis;
+    };
+
+    struct PhotonNeighbour {
+        int   index;
+        float distSquared;
+    };
+
+    // photons in a left-balanced kd-tree stored as an implicit heap, for nearest neighbour density estimates
+    class PhotonMap {
+    public:
+        PhotonMap();
+
+        // sorts the photons into the tree with up to numThreads threads; the argument is reordered
+        void Build(std::vector<waRT::Photon> &photons, int numThreads);
+        void Clear();
+
+        // the up to k photons nearest to point within maxRadius, in no particular order; returns how many
+        int FindNearest(const double *point, int k, double maxRadius, waRT::PhotonNeighbour *neighbours) const;
+        void FindInRadius(const double *point, double radius, std::vector<int> &indices) const;
+        // the irradiance at a surface from the photons around it, cone filtered; false if none arrived on its front
+        bool EstimateIrradiance(const double *point, const double *normal, int k, double maxRadius, double *irradiance) const;
+
+        static void PackDirection(const double *direction, int8_t *packed);
+
+        // GETTERS
+        const waRT::Photon &GetPhoton(int index) const;
+        size_t GetNumPhotons();
+        size_t GetMemoryBytes();
+
+    private:
+        void Balance(waRT::Photon *photons, size_t count, size_t heapIndex, int numThreads);
+        static size_t LeftSubtreeSize(size_t count);
+
+    private:
+        std::vector<waRT::Photon> m_photons;
+    };
+}
+
+#endif
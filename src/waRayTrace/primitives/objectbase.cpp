@@ -22,7 +22,24 @@
          - `transformMatrix`: An object of type `waRT::GTform` representing the forward and backward transformation matrices for the object.
        - This transformation matrix is used to transform rays and intersection points between local object space and world space, enabling proper intersection testing and rendering.
 
-    4. **Floating Point Comparison (`CloseEnough`)**:
+    4. **Bounds (`GetBoundingBox`)**:
+       - Returns the world space axis-aligned box around the object, used to build the scene's BVH (see `bvh.cpp`). The base class has no geometry to bound, so it returns `false`, meaning "unbounded". Such objects are tested against every ray, which keeps user defined objects correct even if they do not override it.
+
+    5. **Serialization (`GetTypeName`, `Serialize`)**:
+       - `GetTypeName()` returns a short, stable name for the object's type. Derived classes override it.
+       - `Serialize()` writes the type name, the base color and the forward transform as a single text line. Floating point values are written in hex so the text is exact. The scene uses this to build the content hash for the render cache (see `rendercache.cpp`), so derived classes with extra parameters should override it and append them. A texture adds its file name and stamp (size and modification time), so editing the image invalidates cached frames.
+
+    6. **Texturing (`m_texture`, `GetLocalUV`, `GetTextureFootprint`)**:
+       - When `m_texture` is set, the scene replaces the base color of a hit with a texture lookup (see `materials/texture.cpp`).
+       - `GetLocalUV()` maps a point in local space to texture coordinates and gives the local surface normal there. The base class returns `false` (no mapping), so the object keeps its base color. Derived classes override it.
+       - `GetTextureFootprint()` moves the camera ray, its differentials and the hit point into local space. The two offset rays are intersected with the tangent plane at the hit and mapped to UV as well, and the differences give how far the texture coordinates move per pixel. This selects the mip level. A change in `u` of more than half is taken as a wrap around the seam and folded back. Without differentials the footprint is zero, which samples the full resolution level.
+
+    7. **Motion (`SetMotionTransform`, `GetTransformAt`)**:
+       - An object with a motion transform moves from `m_transformMatrix` at time 0 to `m_motionTransform` at time 1. `GetTransformAt()` returns the transform for a ray's `m_time`, blending the two with `GTform::Interpolate()` in between. Derived classes use it in place of `m_transformMatrix` when testing intersections, and static objects get `m_transformMatrix` back without any work.
+       - `TransformLocalBox()` turns a local box into world bounds that hold for the whole motion (the union of the start and end boxes), for derived classes' `GetBoundingBox()`.
+       - Moving objects are not flattened into the scene's `PrimitiveSet`; they are tested through `TestIntersection` so the ray time is honoured.
+
+    8. **Floating Point Comparison (`CloseEnough`)**:
        - The `CloseEnough` method is a utility function used to compare two floating-point numbers with a small tolerance (`EPSILON`) to account for the precision errors inherent in floating-point arithmetic.
        - **Parameters**:
          - `f1` and `f2`: The two floating-point numbers to be compared.
@@ -30,7 +47,25 @@
          Returns `true` if the absolute difference between the two numbers is less than `EPSILON`, and `false` otherwise.
        - This method is essential in intersection testing and other computations where floating-point precision errors could cause incorrect results.
 
-    5. **Summary**:
+    9. **Memory and Aggregates (`GetMemoryBytes`, `IsAggregate`)**:
+       - Estimates the bytes the object holds: its own size plus the heap data of the base color, the emission and the four transform matrices. Derived classes with more data should add theirs. The shared texture is not counted, the scene reports textures separately.
+       - `IsAggregate()` is `true` for objects that stand for many primitives, such as `PagedGeometry`. Lights do not skip an aggregate in shadow tests even when it holds the shaded point, since other parts of it may cast the shadow, so an aggregate must avoid hitting the surface a ray starts on itself. The `PrimitiveSet` leaves aggregates to the scene.
+
+    10. **Level of Detail (`AddLOD`, `SetMinPixels`, `SelectLOD`)**:
+       - `AddLOD()` registers a cheaper stand-in (a simplified object, or a bounding proxy such as `ObjSphere::BoundingProxy()`) to be used for camera rays while the object covers fewer than `maxPixels` pixels on screen. With several levels the one with the smallest `maxPixels` that still applies wins, so the coarsest version is used for the smallest footprint.
+       - `SetMinPixels()` drops the object from camera rays entirely below that size, for fields of sub-pixel detail.
+       - `SelectLOD()` maps a projected size to `-1` (not traced), `0` (the object itself) or a level for `GetLODProxy()`. The scene makes this choice once per frame (see `scene.cpp`). Shadow rays always see the full object.
+       - Levels and the minimum size are part of `Serialize()`, so they key the render cache.
+
+    11. **Emission (`m_emission`, `IsEmissive`)**:
+       - `m_emission` is the radiance the surface gives off itself, black by default. The direct shading adds it to the pixel, and the path tracer also lights other surfaces with it (see `Scene::TracePath`). A non-black emission is part of `Serialize()`.
+
+    12. **Specular Surfaces (`m_reflectivity`, `m_transparency`, `IsSpecular`)**:
+       - `m_reflectivity` is the fraction of the light a surface mirrors and `m_transparency` the fraction it refracts with `m_refractiveIndex`; the rest is reflected diffusely with the base color, which also tints the specular part. Both are 0 by default. They are used by the path tracer and by the scene's photon pass (see `Scene::EmitPhotons`); the direct shading treats every surface as diffuse.
+       - A refracting object is treated as a convex solid: a ray that enters it leaves through the last surface along its way, which `TestIntersection()` finds from outside, so no object has to handle rays that start inside it. A plane refracts like a thin pane and lets the ray through unbent.
+       - Non-zero values are part of `Serialize()`.
+
+    13. **Summary**:
        - The `ObjectBase` class provides a basic interface for 3D objects in the ray tracing engine. It includes a method for testing ray-object intersections, a way to apply transformations to objects, and a utility for floating-point comparisons.
        - The `TestIntersection` method is designed to be overridden by derived classes that implement specific geometry (e.g., spheres, planes). This allows for flexibility in adding new object types to the ray tracing engine.
        - The `SetTransformMatrix` method ensures that each object can be transformed in 3D space, which is essential for realistic scene construction.
@@ -38,7 +73,9 @@
 */
 
 #include "objectbase.hpp"
+#include <algorithm>
 #include <math.h>
+#include <cmath>
 #define EPSILON 1e-21f;
 
 waRT::ObjectBase::ObjectBase(){}
@@ -48,11 +85,192 @@ bool waRT::ObjectBase::TestIntersection(const Ray &castRay, qbVector<double> &in
     return false;
 }
 
+bool waRT::ObjectBase::GetBoundingBox(waRT::AABB &worldBox) {
+    worldBox = waRT::AABB();
+    return false;
+}
+
+std::string waRT::ObjectBase::GetTypeName() { return "ObjectBase";}
+
+bool waRT::ObjectBase::IsAggregate() { return false;}
+
+// the object plus the heap data of its color and emission vectors and the four 4x4 matrices of its transforms
+size_t waRT::ObjectBase::GetMemoryBytes() {
+    return sizeof(*this) + 6 * sizeof(double) + 4 * 16 * sizeof(double);
+}
+
+void waRT::ObjectBase::Serialize(std::ostream &out) {
+    out << GetTypeName() << " ";
+    for (int i = 0; i < m_baseColor.GetNumDims(); ++i) {
+        out << std::hexfloat << m_baseColor.GetElement(i) << " ";
+    }
+    m_transformMatrix.Serialize(out);
+    if (m_hasMotion) {
+        out << "motion ";
+        m_motionTransform.Serialize(out);
+    }
+    if (m_texture) {
+        out << "texture " << m_texture->GetFileName() << " " << m_texture->GetStamp() << " ";
+    }
+    if (m_minPixels > 0.0) {
+        out << "minPixels " << m_minPixels << " ";
+    }
+    if (IsEmissive()) {
+        out << "emission " << std::hexfloat << m_emission.GetElement(0) << " " << m_emission.GetElement(1) << " " << m_emission.GetElement(2) << " ";
+    }
+    if (IsSpecular()) {
+        out << "specular " << std::hexfloat << m_reflectivity << " " << m_transparency << " " << m_refractiveIndex << " ";
+    }
+    out << std::defaultfloat << "\n";
+    for (const auto &level : m_lodLevels) {
+        out << "  lod " << std::hexfloat << level.maxPixels << std::defaultfloat << " ";
+        level.proxy->Serialize(out);
+    }
+}
+
+// levels are kept sorted by size, largest first
+void waRT::ObjectBase::AddLOD(const std::shared_ptr<waRT::ObjectBase> &proxy, double maxPixels) {
+    if (!proxy || !(maxPixels > 0.0)) {
+        return;
+    }
+    auto position = std::find_if(m_lodLevels.begin(), m_lodLevels.end(), [&](const LODLevel &level) { return level.maxPixels < maxPixels;});
+    m_lodLevels.insert(position, LODLevel{proxy, maxPixels});
+}
+
+void waRT::ObjectBase::ClearLOD() {
+    m_lodLevels.clear();
+    m_minPixels = 0.0;
+}
+
+void waRT::ObjectBase::SetMinPixels(double minPixels) {
+    m_minPixels = std::max(0.0, minPixels);
+}
+
+bool waRT::ObjectBase::HasLOD() {
+    return !m_lodLevels.empty() || (m_minPixels > 0.0);
+}
+
+int waRT::ObjectBase::SelectLOD(double pixels) {
+    if (pixels < m_minPixels) {
+        return -1;
+    }
+    int selected = 0;
+    for (size_t i = 0; i < m_lodLevels.size(); ++i) {
+        if (pixels < m_lodLevels[i].maxPixels) {
+            selected = static_cast<int>(i) + 1;
+        }
+    }
+    return selected;
+}
+
+std::shared_ptr<waRT::ObjectBase> waRT::ObjectBase::GetLODProxy(int level) {
+    if ((level < 1) || (level > static_cast<int>(m_lodLevels.size()))) {
+        return nullptr;
+    }
+    return m_lodLevels[level - 1].proxy;
+}
+
+bool waRT::ObjectBase::GetLocalUV(const double *localPoint, double &u, double &v, double *localNormal) {
+    return false;
+}
+
+bool waRT::ObjectBase::GetTextureFootprint(const waRT::Ray &worldRay, const qbVector<double> &worldPoint, waRT::TextureFootprint &footprint) {
+    thread_local waRT::Ray localRay;
+    thread_local qbVector<double> localPoint{3};
+
+    waRT::GTform &transform = GetTransformAt(worldRay.m_time);
+    transform.Apply(worldRay, waRT::BCKTFORM, localRay);
+    transform.Apply(worldPoint, waRT::BCKTFORM, localPoint);
+    double point[3] = {localPoint.GetElement(0), localPoint.GetElement(1), localPoint.GetElement(2)};
+    double normal[3];
+    if (!GetLocalUV(point, footprint.u, footprint.v, normal)) {
+        return false;
+    }
+    footprint.dudx = footprint.dvdx = footprint.dudy = footprint.dvdy = 0.0;
+    if (!localRay.m_hasDifferentials) {
+        return true;
+    }
+
+    // where an offset ray meets the tangent plane at the hit, in uv relative to the hit
+    auto offsetUV = [&](const qbVector<double> &origin, const qbVector<double> &direction, double &du, double &dv) {
+        double o[3], d[3];
+        for (int i = 0; i < 3; ++i) {
+            o[i] = origin.GetElement(i);
+            d[i] = direction.GetElement(i);
+        }
+        double denom = normal[0] * d[0] + normal[1] * d[1] + normal[2] * d[2];
+        if (fabs(denom) < 1e-12) {
+            return false;
+        }
+        double t = (normal[0] * (point[0] - o[0]) + normal[1] * (point[1] - o[1]) + normal[2] * (point[2] - o[2])) / denom;
+        double offsetPoint[3] = {o[0] + t * d[0], o[1] + t * d[1], o[2] + t * d[2]};
+        double offsetU, offsetV, offsetNormal[3];
+        if (!GetLocalUV(offsetPoint, offsetU, offsetV, offsetNormal)) {
+            return false;
+        }
+        du = offsetU - footprint.u;
+        dv = offsetV - footprint.v;
+        du -= std::round(du);
+        return true;
+    };
+
+    double dudx, dvdx, dudy, dvdy;
+    if (offsetUV(localRay.m_rxPoint1, localRay.m_rxLab, dudx, dvdx) && offsetUV(localRay.m_ryPoint1, localRay.m_ryLab, dudy, dvdy)) {
+        footprint.dudx = dudx;
+        footprint.dvdx = dvdx;
+        footprint.dudy = dudy;
+        footprint.dvdy = dvdy;
+    }
+    return true;
+}
+
 void waRT::ObjectBase::SetTransformMatrix(const waRT::GTform &transformMatrix) {
 	m_transformMatrix = transformMatrix;
 }
 
+// the object moves from m_transformMatrix at time 0 to endTransform at time 1
+void waRT::ObjectBase::SetMotionTransform(const waRT::GTform &endTransform) {
+	m_motionTransform = endTransform;
+	m_hasMotion = true;
+}
+
+void waRT::ObjectBase::ClearMotion() {
+	m_hasMotion = false;
+}
+
+bool waRT::ObjectBase::HasMotion() { return m_hasMotion;}
+
+waRT::GTform &waRT::ObjectBase::GetTransformAt(double time) {
+	if (!m_hasMotion || (time <= 0.0)) {
+		return m_transformMatrix;
+	}
+	if (time >= 1.0) {
+		return m_motionTransform;
+	}
+	// valid until the next call on this thread
+	thread_local waRT::GTform blended;
+	waRT::GTform::Interpolate(m_transformMatrix, m_motionTransform, time, blended);
+	return blended;
+}
+
+// world box of a local box, covering the whole motion for moving objects
+void waRT::ObjectBase::TransformLocalBox(const waRT::AABB &localBox, waRT::AABB &worldBox) {
+	m_transformMatrix.TransformBox(localBox, worldBox);
+	if (m_hasMotion) {
+		waRT::AABB endBox;
+		m_motionTransform.TransformBox(localBox, endBox);
+		worldBox.Grow(endBox);
+	}
+}
+
 bool waRT::ObjectBase::CloseEnough(const double f1, const double f2) {
     return fabs(f1-f2) < EPSILON;
 }
 
+bool waRT::ObjectBase::IsEmissive() {
+    return (m_emission.GetElement(0) > 0.0) || (m_emission.GetElement(1) > 0.0) || (m_emission.GetElement(2) > 0.0);
+}
+
+bool waRT::ObjectBase::IsSpecular() {
+    return (m_reflectivity > 0.0) || (m_transparency > 0.0);
+}
@@ -1,9 +1,14 @@
 #ifndef OBJECTBASE_H
 #define OBJECTBASE_H
 
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
 #include "../linAlgModule/qbVector.h"
 #include "../ray.hpp"
 #include "../gtfm.hpp"
+#include "../materials/texture.hpp"
 
 namespace waRT {
     class ObjectBase {
@@ -11,11 +16,47 @@ namespace waRT {
         ObjectBase();
         virtual ~ObjectBase();
         virtual bool TestIntersection(const Ray &castRay, qbVector<double> &intPoint, qbVector<double> &localNormal, qbVector<double> &localColor);
+        virtual bool GetBoundingBox(waRT::AABB &worldBox);
+        virtual std::string GetTypeName();
+        virtual void Serialize(std::ostream &out);
+        virtual bool GetLocalUV(const double *localPoint, double &u, double &v, double *localNormal);
+        virtual size_t GetMemoryBytes();
+        virtual bool IsAggregate();
+        void AddLOD(const std::shared_ptr<waRT::ObjectBase> &proxy, double maxPixels);
+        void ClearLOD();
+        void SetMinPixels(double minPixels);
+        bool HasLOD();
+        int SelectLOD(double pixels);
+        std::shared_ptr<waRT::ObjectBase> GetLODProxy(int level);
+        bool GetTextureFootprint(const waRT::Ray &worldRay, const qbVector<double> &worldPoint, waRT::TextureFootprint &footprint);
         void SetTransformMatrix(const waRT::GTform &transformMatrix);
+        void SetMotionTransform(const waRT::GTform &endTransform);
+        void ClearMotion();
+        bool HasMotion();
+        waRT::GTform &GetTransformAt(double time);
         bool CloseEnough(const double f1, const double f2);
+        bool IsEmissive();
+        bool IsSpecular();
     public:
         qbVector<double> m_baseColor{3};
+        qbVector<double> m_emission{3};
+        // fractions of the light that is mirrored and refracted, the rest is diffuse
+        double m_reflectivity    = 0.0;
+        double m_transparency    = 0.0;
+        double m_refractiveIndex = 1.0;
         waRT::GTform m_transformMatrix;
+        std::shared_ptr<waRT::Texture> m_texture;
+        waRT::GTform m_motionTransform;
+        bool m_hasMotion = false;
+    protected:
+        void TransformLocalBox(const waRT::AABB &localBox, waRT::AABB &worldBox);
+    private:
+        struct LODLevel {
+            std::shared_ptr<waRT::ObjectBase> proxy;
+            double maxPixels;
+        };
+        std::vector<LODLevel> m_lodLevels;
+        double m_minPixels = 0.0;
     };
 }
 #endif
\ No newline at end of file
@@ -5,7 +5,7 @@
 
     1. **Ray Transformation**: 
        The incoming ray (`castRay`) is first transformed from global space to the object's local space using the 
-       `m_transformMatrix.Apply` function. The transformed ray is stored in `bckRay`. The direction vector of the ray is normalized 
+       transform at the ray's time (`GetTransformAt(castRay.m_time)`, which is `m_transformMatrix` unless the plane moves). The transformed ray is stored in `bckRay`. The direction vector of the ray is normalized 
        for consistent calculations.
        
     2. **Intersection Test**: 
@@ -33,6 +33,12 @@
        
        If an intersection is found, the function returns `true`, otherwise, it returns `false`.
 
+    6. **Bounds (`GetBoundingBox`)**: 
+       The plane is the unit square `[-1, 1]^2` at local `z = 0`, so its world bounds are that flat box transformed with `GTform::TransformBox()`.
+
+    7. **Texture Coordinates (`GetLocalUV`)**: 
+       The square maps linearly onto `[0, 1]^2`, with `u` along local x and `v` along local y. Scaling the plane's transform stretches the texture with it.
+
     Summary:
     - This class method is essential for detecting ray-plane intersections in a ray tracing context. 
     - The function handles ray transformation, intersection testing, and calculates geometric details needed for shading.
@@ -44,10 +50,40 @@
 waRT::ObjectPlane::ObjectPlane()  {}
 waRT::ObjectPlane::~ObjectPlane() {}
 
+// the unit square in the local xy plane through the forward transform
+bool waRT::ObjectPlane::GetBoundingBox(waRT::AABB &worldBox) {
+    waRT::AABB localBox;
+    const double localMin[3] = {-1.0, -1.0, 0.0};
+    const double localMax[3] = {1.0, 1.0, 0.0};
+    localBox.Grow(localMin);
+    localBox.Grow(localMax);
+    TransformLocalBox(localBox, worldBox);
+    return true;
+}
+
+std::string waRT::ObjectPlane::GetTypeName() { return "ObjectPlane";}
+
+bool waRT::ObjectPlane::GetLocalUV(const double *localPoint, double &u, double &v, double *localNormal) {
+    u = (localPoint[0] + 1.0) * 0.5;
+    v = (localPoint[1] + 1.0) * 0.5;
+    localNormal[0] = 0.0;
+    localNormal[1] = 0.0;
+    localNormal[2] = 1.0;
+    return true;
+}
+
 bool waRT::ObjectPlane::TestIntersection(const waRT::Ray &castRay, qbVector<double> &intPoint,
                                          qbVector<double> &localNormal, qbVector<double> &localColor) {
-    waRT::Ray bckRay = m_transformMatrix.Apply(castRay, waRT::BCKTFORM);
-    qbVector<double> k = bckRay.m_lab;
+    // scratch vectors are reused by each thread, avoiding heap traffic per ray
+    thread_local waRT::Ray bckRay;
+    thread_local qbVector<double> k {3};
+    thread_local qbVector<double> poi {3};
+    thread_local qbVector<double> globalOrigin {3};
+    thread_local qbVector<double> globalNormal {3};
+
+    waRT::GTform &transform = GetTransformAt(castRay.m_time);
+    transform.Apply(castRay, waRT::BCKTFORM, bckRay);
+    k = bckRay.m_lab;
     k.Normalize();
 
     if (!CloseEnough(k.GetElement(2), 0.0)) { // GetElement(2) = z
@@ -58,13 +94,24 @@ bool waRT::ObjectPlane::TestIntersection(const waRT::Ray &castRay, qbVector<doub
             double v = bckRay.m_point1.GetElement(1) + (k.GetElement(1) * t);
 
             if ((abs(u) < 1.0) && (abs(v) < 1.0)) {
-                qbVector<double> poi = bckRay.m_point1 + t * k;
-                intPoint = m_transformMatrix.Apply(poi, waRT::FWDTFORM);
+                for (int i = 0; i < 3; ++i) {
+                    poi.SetElement(i, bckRay.m_point1.GetElement(i) + t * k.GetElement(i));
+                }
+                transform.Apply(poi, waRT::FWDTFORM, intPoint);
 
-                qbVector<double> localOrigin {std::vector<double>  {0.0, 0.0, 0.0}};
-                qbVector<double> normalVector {std::vector<double> {0.0, 0.0, -1.0}};
-                qbVector<double> globalOrigin = m_transformMatrix.Apply(localOrigin, waRT::FWDTFORM);
-                localNormal = m_transformMatrix.Apply(normalVector, waRT::FWDTFORM) - globalOrigin;
+                // local origin (0, 0, 0) and local normal (0, 0, -1) into world space
+                for (int i = 0; i < 3; ++i) {
+                    globalOrigin.SetElement(i, 0.0);
+                    globalNormal.SetElement(i, (i == 2) ? -1.0 : 0.0);
+                }
+                transform.Apply(globalOrigin, waRT::FWDTFORM, globalOrigin);
+                transform.Apply(globalNormal, waRT::FWDTFORM, globalNormal);
+                if (localNormal.GetNumDims() != 3) {
+                    localNormal = qbVector<double>{3};
+                }
+                for (int i = 0; i < 3; ++i) {
+                    localNormal.SetElement(i, globalNormal.GetElement(i) - globalOrigin.GetElement(i));
+                }
 
                 localColor = m_baseColor;
                 return true;
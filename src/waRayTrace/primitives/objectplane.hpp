@@ -11,6 +11,9 @@ namespace waRT {
             virtual ~ObjectPlane() override;
             virtual bool TestIntersection(const waRT::Ray &castRay, qbVector<double> &intPoint,
                                           qbVector<double> &localNormal, qbVector<double> &localColor) override;
+            virtual bool GetBoundingBox(waRT::AABB &worldBox) override;
+            virtual std::string GetTypeName() override;
+            virtual bool GetLocalUV(const double *localPoint, double &u, double &v, double *localNormal) override;
         private:
     };
 }
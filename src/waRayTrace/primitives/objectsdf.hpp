@@ -0,0 +1,103 @@
+#ifndef OBJECTSDF_H
+#define OBJECTSDF_H
+
+#include <cstdint>
+#include <vector>
+#include "objectbase.hpp"
+
+namespace waRT {
+    constexpr int    SDF_MAX_STEPS         = 256;
+    constexpr int    SDF_BRICK_CELLS       = 4;
+    constexpr int    SDF_DEFAULT_BRICKS    = 16;
+    // hit tolerance as a fraction of the diagonal of the local bounds
+    constexpr double SDF_DEFAULT_TOLERANCE = 1e-5;
+
+    enum SDFOperation {
+        SDF_SPHERE = 0,
+        SDF_BOX,
+        SDF_TORUS,
+        SDF_CAPSULE,
+        SDF_UNION,
+        SDF_INTERSECTION,
+        SDF_SUBTRACTION,
+        SDF_SMOOTH_UNION,
+        SDF_REPEAT
+    };
+
+    // a signed distance field built from shapes and operations in local space, found by sphere tracing
+    class ObjectSDF : public ObjectBase {
+    public:
+        ObjectSDF();
+        virtual ~ObjectSDF() override;
+
+        // each call returns the new node's index; shapes first, then operations on earlier nodes
+        int AddSphere(const double *centre, double radius);
+        int AddBox(const double *centre, const double *halfSize, double rounding = 0.0);
+        int AddTorus(const double *centre, double majorRadius, double minorRadius);
+        int AddCapsule(const double *start, const double *end, double radius);
+        int AddUnion(int a, int b);
+        // a balanced tree of unions over many nodes
+        int AddUnion(const std::vector<int> &nodes);
+        int AddIntersection(int a, int b);
+        int AddSubtraction(int a, int b);
+        int AddSmoothUnion(int a, int b, double smoothness);
+        // copies of node around the origin, count more along each axis in both directions
+        int AddRepeat(int node, const double *period, const int *count);
+        void Clear();
+
+        // distance lower bounds on a sparse grid of bricks, for skipping empty space; 0 drops the cache
+        void BuildBrickCache(int bricksPerAxis = SDF_DEFAULT_BRICKS);
+        double Distance(const double *localPoint);
+
+        virtual bool TestIntersection(const Ray &castRay, qbVector<double> &intPoint, qbVector<double> &localNormal, qbVector<double> &localColor) override;
+        virtual bool GetBoundingBox(waRT::AABB &worldBox) override;
+        virtual std::string GetTypeName() override;
+        virtual void Serialize(std::ostream &out) override;
+        virtual size_t GetMemoryBytes() override;
+
+        // SETTERS
+        void SetRoot(int node);
+        void SetLipschitzBound(double bound);
+        void SetTolerance(double tolerance);
+
+        // GETTERS
+        int GetRoot();
+        int GetNumNodes();
+        double GetLipschitzBound();
+        double GetTolerance();
+        bool GetLocalBounds(waRT::AABB &localBox);
+        bool HasBrickCache();
+        size_t GetNumNearBricks();
+
+    private:
+        struct SDFNode {
+            int        operation;
+            int        left, right;
+            double     params[8];
+            waRT::AABB bounds;
+        };
+
+        int AddNode(const SDFNode &node);
+        int AddUnionTree(std::vector<int> &parts, size_t begin, size_t end);
+        double Evaluate(int nodeIndex, const double *point) const;
+        double CachedStep(const double *point) const;
+        void LocalGradient(const double *point, double *gradient);
+
+    private:
+        std::vector<SDFNode> m_nodes;
+        int    m_root;
+        double m_lipschitz;
+        double m_tolerance;
+
+        // brick cache: a centre distance for every brick, cell centres only for bricks near the surface
+        int    m_bricksPerAxis;
+        int    m_brickCount[3];
+        double m_brickOrigin[3];
+        double m_brickSize;
+        std::vector<float>   m_brickCentre;
+        std::vector<int32_t> m_brickSamples;
+        std::vector<float>   m_samples;
+    };
+}
+
+#endif
@@ -15,7 +15,7 @@
          - `localColor`: A vector to store the color of the sphere at the intersection point.
 
        - **Local Space Conversion**:
-         The input ray (`castRay`) is transformed into the sphere's local object space using the object's transformation matrix (`m_transformMatrix.Apply(castRay, waRT::BCKTFORM)`). This allows for testing the intersection with a unit sphere centered at the origin in local space.
+         The input ray (`castRay`) is transformed into the sphere's local object space using the object's transformation matrix at the ray's time (`GetTransformAt(castRay.m_time)`, which is just `m_transformMatrix` unless the object moves). This allows for testing the intersection with a unit sphere centered at the origin in local space.
 
        - **Ray-Sphere Intersection**:
          In local space, the sphere has a radius of 1. The method solves the quadratic equation for ray-sphere intersection:
@@ -36,26 +36,90 @@
        - **Return Value**:
          The method returns `true` if a valid intersection is found and all the relevant data (intersection point, normal, color) has been computed. Otherwise, it returns `false`.
 
-    3. **Summary**:
+    3. **Bounds (`GetBoundingBox`)**:
+       - The box `[-1, 1]^3` around the unit sphere is transformed to world space with `GTform::TransformBox()`. For rotated spheres this is a little larger than the tightest box, which is fine for culling.
+
+    4. **Texture Coordinates (`GetLocalUV`)**:
+       - Spherical mapping: `u` is the longitude around the local z axis and `v` runs from the `+z` pole (0) to the `-z` pole (1). The point is normalized first, so points near the surface (such as the tangent plane hits used for ray differentials) map sensibly too.
+
+    5. **Bounding Proxy (`BoundingProxy`)**:
+       - Makes a sphere around another object's world bounding box (centred on it, radius half its diagonal) in that object's base color. It is the cheapest distant stand-in for `ObjectBase::AddLOD()` when no simplified version exists.
+
+    6. **Summary**:
        - The `ObjSphere` class implements the intersection test for a unit sphere in 3D space, with the ability to handle arbitrary transformations (position, scale, rotation) via transformation matrices.
        - The class handles both local space (unit sphere at the origin) and world space (transformed object in the scene) intersection testing.
        - It calculates and provides the intersection point, surface normal, and color at the intersection point, which are crucial for shading and rendering the object in the ray tracing engine.
 */
 
 #include "objectsphere.hpp"
+#include <algorithm>
 #include <cmath>
 
 waRT::ObjSphere::ObjSphere(){}
 waRT::ObjSphere::~ObjSphere(){}
 
+// the unit sphere through the forward transform
+bool waRT::ObjSphere::GetBoundingBox(waRT::AABB &worldBox) {
+    waRT::AABB localBox;
+    const double localMin[3] = {-1.0, -1.0, -1.0};
+    const double localMax[3] = {1.0, 1.0, 1.0};
+    localBox.Grow(localMin);
+    localBox.Grow(localMax);
+    TransformLocalBox(localBox, worldBox);
+    return true;
+}
+
+std::string waRT::ObjSphere::GetTypeName() { return "ObjSphere";}
+
+std::shared_ptr<waRT::ObjSphere> waRT::ObjSphere::BoundingProxy(waRT::ObjectBase &object) {
+    auto proxy = std::make_shared<waRT::ObjSphere>();
+    waRT::AABB box;
+    if (!object.GetBoundingBox(box) || box.IsEmpty()) {
+        return nullptr;
+    }
+    double centre[3];
+    double radius = 0.0;
+    for (int i = 0; i < 3; ++i) {
+        centre[i] = box.Centroid(i);
+        radius   += (box.boxMax[i] - centre[i]) * (box.boxMax[i] - centre[i]);
+    }
+    radius = std::max(sqrt(radius), 1e-9);
+    waRT::GTform transform;
+    transform.SetTransform(qbVector<double>{std::vector<double>{centre[0], centre[1], centre[2]}},
+                           qbVector<double>{std::vector<double>{0.0, 0.0, 0.0}},
+                           qbVector<double>{std::vector<double>{radius, radius, radius}});
+    proxy->SetTransformMatrix(transform);
+    proxy->m_baseColor = object.m_baseColor;
+    return proxy;
+}
+
+bool waRT::ObjSphere::GetLocalUV(const double *localPoint, double &u, double &v, double *localNormal) {
+    double length = sqrt(localPoint[0] * localPoint[0] + localPoint[1] * localPoint[1] + localPoint[2] * localPoint[2]);
+    if (length <= 0.0) {
+        return false;
+    }
+    for (int i = 0; i < 3; ++i) {
+        localNormal[i] = localPoint[i] / length;
+    }
+    u = atan2(localNormal[1], localNormal[0]) / (2.0 * M_PI) + 0.5;
+    v = acos(std::min(std::max(localNormal[2], -1.0), 1.0)) / M_PI;
+    return true;
+}
+
 bool waRT::ObjSphere::TestIntersection(const waRT::Ray &castRay, qbVector<double> &intPoint, qbVector<double> &localNormal, qbVector<double> &localColor) {
-	waRT::Ray bckRay = m_transformMatrix.Apply(castRay, waRT::BCKTFORM);
-	qbVector<double> vhat = bckRay.m_lab;
+	// per-thread scratch, so the test never allocates once warmed up
+	thread_local waRT::Ray bckRay;
+	thread_local qbVector<double> vhat {3};
+	thread_local qbVector<double> poi {3};
+	thread_local qbVector<double> newObjOrigin {3};
+
+	waRT::GTform &transform = GetTransformAt(castRay.m_time);
+	transform.Apply(castRay, waRT::BCKTFORM, bckRay);
+	vhat = bckRay.m_lab;
 	vhat.Normalize();
 	double b = 2.0 * qbVector<double>::dot(bckRay.m_point1, vhat);
 	double c = qbVector<double>::dot(bckRay.m_point1, bckRay.m_point1) - 1.0;
 	double intTest = (b*b) - 4.0 * c;
-	qbVector<double> poi;
 	
 	if (intTest > 0.0) {
 		double numSQRT = sqrtf(intTest);
@@ -65,15 +129,19 @@ bool waRT::ObjSphere::TestIntersection(const waRT::Ray &castRay, qbVector<double
 		if ((t1 < 0.0) || (t2 < 0.0)) {
 			return false;
 		} else {
-			if (t1 < t2) {
-				poi = bckRay.m_point1 + (vhat * t1);
-			} else {
-				poi = bckRay.m_point1 + (vhat * t2);
+			double t = (t1 < t2) ? t1 : t2;
+			for (int i = 0; i < 3; ++i) {
+				poi.SetElement(i, bckRay.m_point1.GetElement(i) + (vhat.GetElement(i) * t));
+				newObjOrigin.SetElement(i, 0.0);
+			}
+			transform.Apply(poi, waRT::FWDTFORM, intPoint);
+			transform.Apply(newObjOrigin, waRT::FWDTFORM, newObjOrigin);
+			if (localNormal.GetNumDims() != 3) {
+				localNormal = qbVector<double>{3};
+			}
+			for (int i = 0; i < 3; ++i) {
+				localNormal.SetElement(i, intPoint.GetElement(i) - newObjOrigin.GetElement(i));
 			}
-			intPoint = m_transformMatrix.Apply(poi, waRT::FWDTFORM);
-			qbVector<double> objOrigin    = qbVector<double>{std::vector<double>{0.0, 0.0, 0.0}};
-			qbVector<double> newObjOrigin = m_transformMatrix.Apply(objOrigin, waRT::FWDTFORM);
-			localNormal = intPoint - newObjOrigin;
 			localNormal.Normalize();
 			localColor = m_baseColor;
 		}
@@ -9,6 +9,10 @@ namespace waRT {
             ObjSphere();
             virtual ~ObjSphere() override;
             virtual bool TestIntersection(const Ray &castRay, qbVector<double> &intPoint, qbVector<double> &localNormal, qbVector<double> &localColor);
+            virtual bool GetBoundingBox(waRT::AABB &worldBox) override;
+            virtual std::string GetTypeName() override;
+            virtual bool GetLocalUV(const double *localPoint, double &u, double &v, double *localNormal) override;
+            static std::shared_ptr<waRT::ObjSphere> BoundingProxy(waRT::ObjectBase &object);
         private:
     };
 }
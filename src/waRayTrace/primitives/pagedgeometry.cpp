@@ -0,0 +1,625 @@
+/*
+    The `PagedGeometry` class lets a scene hold more spheres and planes than fit in memory. The primitives live in a page file on disk, and only a resident skeleton plus a bounded number of decoded pages stay in RAM. In the scene it is a single object in `m_objectList`.
+
+    1. **Page File (`Write`)**:
+       - `Write()` takes the spheres and planes from an object list that `PrimitiveSet` would also flatten (static, built-in types), builds a `BVH` over their bounds and cuts its primitive order into pages of `primitivesPerPage`. BVH leaves are contiguous in that order, so every page is a spatially coherent cluster and a ray only needs the few pages along its path.
+       - The file holds a 64 byte header (`WAGEO001`, page count, page size, primitive count), a table with the bounds, offset and count of every page, and then the pages. Each page starts on a 4 KB boundary and stores one fixed size record per primitive: the shape, the forward and backward 3x4 matrices and the color, all as raw doubles, so a page decodes to exactly the values the objects had.
+       - Other objects are left out and stay in the caller's object list. The file is written under a temporary name and renamed into place, like the tiled textures.
+
+    2. **Resident Skeleton (`Open`)**:
+       - `Open()` reads the header and page table only. The page bounds get their own small `BVH` (the skeleton), which is all that is needed to find the pages a ray may hit. It costs 64 bytes per page, a few KB for a million primitives.
+       - The header is checked against the file size before anything is sized from it: the page table has to fit between `tableOffset` and the end of the file, and so does every page it lists. A damaged or hostile file is then rejected instead of allocating whatever `numPages` says.
+       - The file is memory mapped read-only. If mapping fails, for example when the address space is too small, pages are read with `pread()` instead.
+
+    3. **Page Cache (`AcquirePage`)**:
+       - A page is brought in on first use. Its records are turned into temporary objects, a `PrimitiveSet` is built over them (see `primitives/primitiveset.cpp`), and the objects are dropped again, so a resident page costs what its primitive set costs. The mapped bytes of the page are released with `madvise()` straight away, the kernel does not need to keep them.
+       - Decoded pages are kept in an LRU list bounded by `SetMaxCacheBytes()` (`PAGED_DEFAULT_CACHE_BYTES` by default). Pages are shared pointers, so evicting a page another thread is still reading is safe. It is freed when the last reader lets go.
+       - Each render thread also remembers its last few pages (`THREAD_PAGE_SLOTS`), so neighbouring rays usually find their page without taking the cache lock.
+       - When the working set is larger than the cache, pages are evicted and brought in again. That makes rendering slower, but it never fails. A page that cannot be read counts as a failure (`GetPageFailures()`) and is treated as empty.
+
+    4. **Single Rays (`TestIntersection`)**:
+       - Traverses the skeleton nearest first and tests each page's primitive set until no closer page is left. The ray starts `PAGED_RAY_OFFSET` along its direction, so a shadow ray leaving a paged surface does not hit that surface again. This is also why it is an aggregate (`IsAggregate()`): lights do not skip it when it holds the shaded point, so paged geometry shadows itself.
+
+    5. **Ray Queues (`IntersectBatch`)**:
+       - For camera rays the scene hands over a whole row of rays. Each ray is run through the skeleton only, and a `(page, ray)` entry is queued for every page it reaches. The queue is sorted by page, and every page is then acquired once and tested against all rays waiting for it. Rays that already have a hit nearer than a page's entry distance skip it.
+       - So a page is brought in at most once per batch, however many rays need it, which is what keeps I/O low once the cache is smaller than the scene.
+
+    6. **Scene Integration**:
+       - `GetBoundingBox()` is the union of all pages. `Serialize()` writes the file name and its size and modification time, so the render cache notices a rewritten file.
+       - `GetMemoryBytes()` counts the skeleton, the page table and the currently resident pages, and the `Get...` functions report the cache counters.
+*/
+
+#include "pagedgeometry.hpp"
+#include "objectsphere.hpp"
+#include "objectplane.hpp"
+#include "../mappedfile.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <thread>
+
+constexpr char   PAGED_MAGIC[8]      = {'W', 'A', 'G', 'E', 'O', '0', '0', '1'};
+constexpr size_t PAGED_HEADER_BYTES  = 64;
+constexpr size_t PAGED_ALIGNMENT     = 4096;
+constexpr double PAGED_RAY_OFFSET    = 1e-6;
+constexpr double PAGED_NO_HIT        = std::numeric_limits<double>::max();
+constexpr int    THREAD_PAGE_SLOTS   = 8;
+
+enum PagedShape : int32_t {
+    PAGED_SPHERE = 0,
+    PAGED_PLANE  = 1
+};
+
+// one primitive in the file, 224 bytes
+struct PagedRecord {
+    int32_t shape;
+    int32_t reserved;
+    double  fwd[12];
+    double  bck[12];
+    double  color[3];
+};
+
+struct PagedHeader {
+    char     magic[8];
+    uint32_t numPages;
+    uint32_t primitivesPerPage;
+    uint64_t numPrimitives;
+    uint64_t tableOffset;
+    char     reserved[PAGED_HEADER_BYTES - 32];
+};
+
+static_assert(sizeof(PagedRecord) == 224, "page records must have a fixed size");
+static_assert(sizeof(PagedHeader) == PAGED_HEADER_BYTES, "the header is 64 bytes");
+
+static uint64_t NextPagedId() {
+    static std::atomic<uint64_t> nextId {1};
+    return nextId.fetch_add(1);
+}
+
+// last few pages a thread used, keyed by the owning geometry's id
+struct ThreadPageSlot {
+    uint64_t owner = 0;
+    int      page  = -1;
+    std::shared_ptr<waRT::GeometryPage> data;
+};
+
+static thread_local ThreadPageSlot t_pageSlots[THREAD_PAGE_SLOTS];
+
+static size_t AlignUp(size_t value) {
+    return (value + PAGED_ALIGNMENT - 1) / PAGED_ALIGNMENT * PAGED_ALIGNMENT;
+}
+
+waRT::PagedGeometry::PagedGeometry() {
+    m_file          = -1;
+    m_mapping       = nullptr;
+    m_mappingBytes  = 0;
+    m_numPrimitives = 0;
+    m_id            = 0;
+    m_cacheBytes    = 0;
+    m_maxCacheBytes = PAGED_DEFAULT_CACHE_BYTES;
+    m_hits      = 0;
+    m_misses    = 0;
+    m_evictions = 0;
+    m_failures  = 0;
+}
+
+waRT::PagedGeometry::~PagedGeometry() {
+    Close();
+}
+
+bool waRT::PagedGeometry::Write(const std::string &fileName, const std::vector<std::shared_ptr<waRT::ObjectBase>> &objectList,
+                                int primitivesPerPage, size_t *numWritten) {
+    if (numWritten != nullptr) {
+        *numWritten = 0;
+    }
+    primitivesPerPage = std::max(1, primitivesPerPage);
+
+    std::vector<PagedRecord> records;
+    std::vector<waRT::AABB>  bounds;
+    for (const auto &object : objectList) {
+        int32_t shape;
+        if (waRT::SphereShape::Accepts(*object)) {
+            shape = PAGED_SPHERE;
+        } else if (waRT::PlaneShape::Accepts(*object)) {
+            shape = PAGED_PLANE;
+        } else {
+            continue;
+        }
+        waRT::AABB box;
+        if (!object->GetBoundingBox(box)) {
+            continue;
+        }
+        PagedRecord record = {};
+        record.shape = shape;
+        qbMatrix2<double> fwd = object->m_transformMatrix.GetForward();
+        qbMatrix2<double> bck = object->m_transformMatrix.GetBackward();
+        for (int row = 0; row < 3; ++row) {
+            for (int col = 0; col < 4; ++col) {
+                record.fwd[row * 4 + col] = fwd.GetElement(row, col);
+                record.bck[row * 4 + col] = bck.GetElement(row, col);
+            }
+            record.color[row] = object->m_baseColor.GetElement(row);
+        }
+        records.push_back(record);
+        bounds.push_back(box);
+    }
+
+    // the BVH order keeps spatial neighbours next to each other, so consecutive runs make coherent pages
+    waRT::BVH bvh;
+    bvh.Build(bounds, std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
+    const std::vector<int> &order = bvh.GetPrimitiveOrder();
+
+    size_t numPrimitives = records.size();
+    size_t numPages = (numPrimitives + primitivesPerPage - 1) / primitivesPerPage;
+    std::vector<PageEntry> table(numPages);
+    size_t offset = AlignUp(PAGED_HEADER_BYTES + numPages * sizeof(PageEntry));
+    for (size_t page = 0; page < numPages; ++page) {
+        size_t first = page * primitivesPerPage;
+        size_t count = std::min(numPrimitives - first, static_cast<size_t>(primitivesPerPage));
+        waRT::AABB pageBounds;
+        for (size_t i = first; i < first + count; ++i) {
+            pageBounds.Grow(bounds[order[i]]);
+        }
+        PageEntry &entry = table[page];
+        for (int axis = 0; axis < 3; ++axis) {
+            entry.boundsMin[axis] = pageBounds.boxMin[axis];
+            entry.boundsMax[axis] = pageBounds.boxMax[axis];
+        }
+        entry.offset   = offset;
+        entry.count    = static_cast<uint32_t>(count);
+        entry.reserved = 0;
+        offset = AlignUp(offset + count * sizeof(PagedRecord));
+    }
+
+    std::string tempPath = waRT::TempFileName(fileName);
+    FILE *outFile = fopen(tempPath.c_str(), "wb");
+    if (outFile == NULL) {
+        return false;
+    }
+    PagedHeader header = {};
+    memcpy(header.magic, PAGED_MAGIC, sizeof(PAGED_MAGIC));
+    header.numPages          = static_cast<uint32_t>(numPages);
+    header.primitivesPerPage = static_cast<uint32_t>(primitivesPerPage);
+    header.numPrimitives     = numPrimitives;
+    header.tableOffset       = PAGED_HEADER_BYTES;
+    bool writeOk = (fwrite(&header, 1, sizeof(header), outFile) == sizeof(header));
+    writeOk = writeOk && (fwrite(table.data(), sizeof(PageEntry), numPages, outFile) == numPages);
+
+    size_t written = PAGED_HEADER_BYTES + numPages * sizeof(PageEntry);
+    std::vector<char> padding(PAGED_ALIGNMENT, 0);
+    std::vector<PagedRecord> pageRecords;
+    for (size_t page = 0; (page < numPages) && writeOk; ++page) {
+        size_t gap = table[page].offset - written;
+        writeOk = (fwrite(padding.data(), 1, gap, outFile) == gap);
+        size_t first = page * primitivesPerPage;
+        pageRecords.clear();
+        for (size_t i = first; i < first + table[page].count; ++i) {
+            pageRecords.push_back(records[order[i]]);
+        }
+        writeOk = writeOk && (fwrite(pageRecords.data(), sizeof(PagedRecord), pageRecords.size(), outFile) == pageRecords.size());
+        written = table[page].offset + pageRecords.size() * sizeof(PagedRecord);
+    }
+    writeOk = (fclose(outFile) == 0) && writeOk;
+
+    std::error_code error;
+    if (writeOk) {
+        std::filesystem::rename(tempPath, fileName, error);
+    }
+    if (!writeOk || error) {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    if (numWritten != nullptr) {
+        *numWritten = numPrimitives;
+    }
+    return true;
+}
+
+bool waRT::PagedGeometry::Open(const std::string &fileName) {
+    Close();
+    int file = open(fileName.c_str(), O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    struct stat fileInfo;
+    PagedHeader header;
+    if ((fstat(file, &fileInfo) != 0) ||
+        (pread(file, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) ||
+        (memcmp(header.magic, PAGED_MAGIC, sizeof(PAGED_MAGIC)) != 0)) {
+        close(file);
+        return false;
+    }
+
+    // the header is untrusted: check the table fits in the file before sizing anything from it
+    size_t fileBytes = static_cast<size_t>(fileInfo.st_size);
+    if ((header.tableOffset > fileBytes) || (header.numPages > (fileBytes - header.tableOffset) / sizeof(PageEntry))) {
+        close(file);
+        return false;
+    }
+    size_t tableBytes = static_cast<size_t>(header.numPages) * sizeof(PageEntry);
+    std::vector<PageEntry> pages(header.numPages);
+    if (pread(file, pages.data(), tableBytes, static_cast<off_t>(header.tableOffset)) != static_cast<ssize_t>(tableBytes)) {
+        close(file);
+        return false;
+    }
+    uint64_t numPrimitives = 0;
+    for (const auto &entry : pages) {
+        if ((entry.offset % PAGED_ALIGNMENT != 0) || (entry.offset > fileBytes) ||
+            (static_cast<uint64_t>(entry.count) * sizeof(PagedRecord) > fileBytes - entry.offset)) {
+            close(file);
+            return false;
+        }
+        numPrimitives += entry.count;
+    }
+
+    // without an address range for the whole file, pages are read with pread instead
+    void *mapping = mmap(nullptr, fileBytes, PROT_READ, MAP_PRIVATE, file, 0);
+    if ((mapping == MAP_FAILED) || (fileBytes == 0)) {
+        mapping = nullptr;
+    }
+
+    std::vector<waRT::AABB> pageBounds(pages.size());
+    m_bounds = waRT::AABB();
+    for (size_t page = 0; page < pages.size(); ++page) {
+        pageBounds[page].Grow(pages[page].boundsMin);
+        pageBounds[page].Grow(pages[page].boundsMax);
+        m_bounds.Grow(pageBounds[page]);
+    }
+    m_skeleton.Build(pageBounds, 1);
+    m_pageOrder = m_skeleton.GetPrimitiveOrder();
+
+    m_fileName      = fileName;
+    m_stamp         = std::to_string(fileInfo.st_size) + ":" + std::to_string(static_cast<long long>(fileInfo.st_mtime));
+    m_file          = file;
+    m_mapping       = static_cast<const unsigned char *>(mapping);
+    m_mappingBytes  = (mapping != nullptr) ? fileBytes : 0;
+    m_numPrimitives = numPrimitives;
+    m_pages.swap(pages);
+    m_id = NextPagedId();
+    return true;
+}
+
+void waRT::PagedGeometry::Close() {
+    {
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        m_cache.clear();
+        m_lru.clear();
+        m_cacheBytes = 0;
+    }
+    if (m_mapping != nullptr) {
+        munmap(const_cast<unsigned char *>(m_mapping), m_mappingBytes);
+    }
+    if (m_file >= 0) {
+        close(m_file);
+    }
+    m_file          = -1;
+    m_mapping       = nullptr;
+    m_mappingBytes  = 0;
+    m_numPrimitives = 0;
+    m_id            = 0;
+    m_pages.clear();
+    m_pageOrder.clear();
+    m_skeleton.Clear();
+    m_bounds = waRT::AABB();
+}
+
+bool waRT::PagedGeometry::IsOpen() { return m_file >= 0;}
+
+bool waRT::PagedGeometry::TestIntersection(const Ray &castRay, qbVector<double> &intPoint, qbVector<double> &localNormal, qbVector<double> &localColor) {
+    thread_local waRT::Ray offsetRay;
+    thread_local waRT::PrimitiveHit pageHit;
+    double origin[3];
+    double invDir[3];
+    if (!IsOpen() || !SetupRay(castRay, offsetRay, origin, invDir)) {
+        return false;
+    }
+
+    double tMax = PAGED_NO_HIT;
+    bool found = false;
+    m_skeleton.Traverse(origin, invDir, tMax, [&](int first, int count) {
+        for (int i = first; i < first + count; ++i) {
+            std::shared_ptr<waRT::GeometryPage> page = AcquirePage(m_pageOrder[i]);
+            if (page && page->primitives.ClosestHit(offsetRay, pageHit) && (pageHit.dist < tMax)) {
+                tMax        = pageHit.dist;
+                found       = true;
+                intPoint    = pageHit.point;
+                localNormal = pageHit.normal;
+                localColor  = pageHit.color;
+            }
+        }
+    });
+    return found;
+}
+
+void waRT::PagedGeometry::IntersectBatch(const waRT::RayBatch &batch, size_t count, std::vector<waRT::PrimitiveHit> &hits) {
+    struct QueuedRay {
+        int    page;
+        int    ray;
+        double tEntry;
+    };
+    thread_local std::vector<QueuedRay> queue;
+    thread_local waRT::Ray cameraRay;
+    thread_local waRT::Ray offsetRay;
+    thread_local waRT::PrimitiveHit pageHit;
+
+    if (hits.size() < count) {
+        hits.resize(count);
+    }
+    for (size_t ray = 0; ray < count; ++ray) {
+        hits[ray].dist        = PAGED_NO_HIT;
+        hits[ray].objectIndex = -1;
+    }
+    if (!IsOpen()) {
+        return;
+    }
+
+    // pass 1, the skeleton only: which pages does each ray reach
+    queue.clear();
+    double origin[3];
+    double invDir[3];
+    for (size_t ray = 0; ray < count; ++ray) {
+        if (batch.valid[ray] == 0) {
+            continue;
+        }
+        batch.GetRay(ray, cameraRay);
+        if (!SetupRay(cameraRay, offsetRay, origin, invDir)) {
+            continue;
+        }
+        double tMax = PAGED_NO_HIT;
+        m_skeleton.Traverse(origin, invDir, tMax, [&](int first, int numPages) {
+            for (int i = first; i < first + numPages; ++i) {
+                double tEntry;
+                if (PageEntryDistance(m_pageOrder[i], origin, invDir, tEntry)) {
+                    queue.push_back({m_pageOrder[i], static_cast<int>(ray), tEntry});
+                }
+            }
+        });
+    }
+
+    // pass 2, page by page: each page is acquired once for all rays waiting on it
+    std::sort(queue.begin(), queue.end(), [](const QueuedRay &a, const QueuedRay &b) {
+        return (a.page != b.page) ? (a.page < b.page) : (a.tEntry < b.tEntry);
+    });
+    size_t next = 0;
+    while (next < queue.size()) {
+        int pageIndex = queue[next].page;
+        size_t end = next;
+        while ((end < queue.size()) && (queue[end].page == pageIndex)) {
+            ++end;
+        }
+        std::shared_ptr<waRT::GeometryPage> page = AcquirePage(pageIndex);
+        for (size_t q = next; page && (q < end); ++q) {
+            waRT::PrimitiveHit &hit = hits[queue[q].ray];
+            if (queue[q].tEntry > hit.dist) {
+                continue;
+            }
+            batch.GetRay(queue[q].ray, cameraRay);
+            SetupRay(cameraRay, offsetRay, origin, invDir);
+            if (page->primitives.ClosestHit(offsetRay, pageHit) && (pageHit.dist < hit.dist)) {
+                hit.dist        = pageHit.dist;
+                hit.objectIndex = 0;
+                hit.point       = pageHit.point;
+                hit.normal      = pageHit.normal;
+                hit.color       = pageHit.color;
+            }
+        }
+        next = end;
+    }
+
+    // distances from the ray's own origin, comparable with other hits
+    for (size_t ray = 0; ray < count; ++ray) {
+        if (hits[ray].objectIndex >= 0) {
+            hits[ray].dist += PAGED_RAY_OFFSET;
+        }
+    }
+}
+
+bool waRT::PagedGeometry::GetBoundingBox(waRT::AABB &worldBox) {
+    worldBox = m_bounds;
+    return !m_bounds.IsEmpty();
+}
+
+std::string waRT::PagedGeometry::GetTypeName() { return "PagedGeometry";}
+
+void waRT::PagedGeometry::Serialize(std::ostream &out) {
+    out << GetTypeName() << " " << m_fileName << " " << m_stamp << " " << m_numPrimitives << "\n";
+}
+
+size_t waRT::PagedGeometry::GetMemoryBytes() {
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
+    return sizeof(*this) + m_pages.capacity() * sizeof(PageEntry) + m_pageOrder.capacity() * sizeof(int) +
+           m_skeleton.GetMemoryBytes() + m_cacheBytes;
+}
+
+bool waRT::PagedGeometry::IsAggregate() { return true;}
+
+// SETTERS
+void waRT::PagedGeometry::SetMaxCacheBytes(size_t maxBytes) {
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
+    m_maxCacheBytes = maxBytes;
+}
+
+// GETTERS
+std::string waRT::PagedGeometry::GetFileName() { return m_fileName;}
+size_t waRT::PagedGeometry::GetNumPages() { return m_pages.size();}
+size_t waRT::PagedGeometry::GetNumPrimitives() { return static_cast<size_t>(m_numPrimitives);}
+
+size_t waRT::PagedGeometry::GetMaxCacheBytes() {
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
+    return m_maxCacheBytes;
+}
+
+size_t waRT::PagedGeometry::GetCacheBytes() {
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
+    return m_cacheBytes;
+}
+
+size_t waRT::PagedGeometry::GetNumResidentPages() {
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
+    return m_cache.size();
+}
+
+uint64_t waRT::PagedGeometry::GetPageHits() { return m_hits.load();}
+uint64_t waRT::PagedGeometry::GetPageMisses() { return m_misses.load();}
+uint64_t waRT::PagedGeometry::GetPageEvictions() { return m_evictions.load();}
+uint64_t waRT::PagedGeometry::GetPageFailures() { return m_failures.load();}
+
+// private funks
+std::shared_ptr<waRT::GeometryPage> waRT::PagedGeometry::AcquirePage(int pageIndex) {
+    ThreadPageSlot &slot = t_pageSlots[pageIndex % THREAD_PAGE_SLOTS];
+    if ((slot.owner == m_id) && (slot.page == pageIndex)) {
+        return slot.data;
+    }
+
+    std::shared_ptr<waRT::GeometryPage> page;
+    {
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        auto found = m_cache.find(pageIndex);
+        if (found != m_cache.end()) {
+            m_lru.splice(m_lru.begin(), m_lru, found->second.lruPosition);
+            page = found->second.page;
+            ++m_hits;
+        }
+    }
+
+    if (!page) {
+        ++m_misses;
+        page = LoadPage(pageIndex);
+        if (!page) {
+            ++m_failures;
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        auto found = m_cache.find(pageIndex);
+        if (found != m_cache.end()) {
+            // another thread brought it in meanwhile, use theirs
+            page = found->second.page;
+        } else {
+            m_lru.push_front(pageIndex);
+            m_cache[pageIndex] = CacheSlot{page, m_lru.begin()};
+            m_cacheBytes += page->bytes;
+            // the newest page always stays, even if it alone is over the budget
+            while ((m_cacheBytes > m_maxCacheBytes) && (m_cache.size() > 1)) {
+                int oldest = m_lru.back();
+                m_lru.pop_back();
+                auto evicted = m_cache.find(oldest);
+                m_cacheBytes -= evicted->second.page->bytes;
+                m_cache.erase(evicted);
+                ++m_evictions;
+            }
+        }
+    }
+
+    slot.owner = m_id;
+    slot.page  = pageIndex;
+    slot.data  = page;
+    return page;
+}
+
+std::shared_ptr<waRT::GeometryPage> waRT::PagedGeometry::LoadPage(int pageIndex) {
+    thread_local std::vector<PagedRecord> readBuffer;
+    const PageEntry &entry = m_pages[pageIndex];
+    size_t bytes = static_cast<size_t>(entry.count) * sizeof(PagedRecord);
+
+    const PagedRecord *records;
+    if (m_mapping != nullptr) {
+        records = reinterpret_cast<const PagedRecord *>(m_mapping + entry.offset);
+    } else {
+        readBuffer.resize(entry.count);
+        if (pread(m_file, readBuffer.data(), bytes, static_cast<off_t>(entry.offset)) != static_cast<ssize_t>(bytes)) {
+            return nullptr;
+        }
+        records = readBuffer.data();
+    }
+
+    std::vector<std::shared_ptr<waRT::ObjectBase>> objects;
+    objects.reserve(entry.count);
+    qbMatrix2<double> fwd {4, 4};
+    qbMatrix2<double> bck {4, 4};
+    for (int col = 0; col < 4; ++col) {
+        fwd.SetElement(3, col, (col == 3) ? 1.0 : 0.0);
+        bck.SetElement(3, col, (col == 3) ? 1.0 : 0.0);
+    }
+    for (uint32_t i = 0; i < entry.count; ++i) {
+        const PagedRecord &record = records[i];
+        std::shared_ptr<waRT::ObjectBase> object;
+        if (record.shape == PAGED_SPHERE) {
+            object = std::make_shared<waRT::ObjSphere>();
+        } else if (record.shape == PAGED_PLANE) {
+            object = std::make_shared<waRT::ObjectPlane>();
+        } else {
+            continue;
+        }
+        for (int row = 0; row < 3; ++row) {
+            for (int col = 0; col < 4; ++col) {
+                fwd.SetElement(row, col, record.fwd[row * 4 + col]);
+                bck.SetElement(row, col, record.bck[row * 4 + col]);
+            }
+            object->m_baseColor.SetElement(row, record.color[row]);
+        }
+        object->SetTransformMatrix(waRT::GTform(fwd, bck));
+        objects.push_back(object);
+    }
+
+    auto page = std::make_shared<waRT::GeometryPage>();
+    page->primitives.Build(objects, 1);
+    page->bytes = sizeof(waRT::GeometryPage) + page->primitives.GetMemoryBytes() + page->primitives.GetBVHMemoryBytes();
+    ReleasePageData(pageIndex);
+    return page;
+}
+
+// the decoded copy is all that is needed, let the kernel drop the mapped bytes
+void waRT::PagedGeometry::ReleasePageData(int pageIndex) {
+    if (m_mapping == nullptr) {
+        return;
+    }
+    const PageEntry &entry = m_pages[pageIndex];
+    size_t bytes = AlignUp(static_cast<size_t>(entry.count) * sizeof(PagedRecord));
+    bytes = std::min(bytes, m_mappingBytes - static_cast<size_t>(entry.offset));
+    madvise(const_cast<unsigned char *>(m_mapping) + entry.offset, bytes, MADV_DONTNEED);
+}
+
+bool waRT::PagedGeometry::PageEntryDistance(int pageIndex, const double *origin, const double *invDir, double &tEntry) {
+    const PageEntry &entry = m_pages[pageIndex];
+    double tNear = 0.0;
+    double tFar  = PAGED_NO_HIT;
+    for (int axis = 0; axis < 3; ++axis) {
+        double t0 = (entry.boundsMin[axis] - origin[axis]) * invDir[axis];
+        double t1 = (entry.boundsMax[axis] - origin[axis]) * invDir[axis];
+        tNear = std::max(tNear, std::min(t0, t1));
+        tFar  = std::min(tFar,  std::max(t0, t1));
+    }
+    tEntry = tNear;
+    return tNear <= tFar;
+}
+
+// a unit length ray starting PAGED_RAY_OFFSET along the cast ray, and its slab test inputs
+bool waRT::PagedGeometry::SetupRay(const waRT::Ray &castRay, waRT::Ray &offsetRay, double *origin, double *invDir) {
+    double dir[3];
+    double length = 0.0;
+    for (int i = 0; i < 3; ++i) {
+        dir[i]  = castRay.m_lab.GetElement(i);
+        length += dir[i] * dir[i];
+    }
+    length = sqrt(length);
+    if (!(length > 0.0)) {
+        return false;
+    }
+    for (int i = 0; i < 3; ++i) {
+        dir[i]   /= length;
+        origin[i] = castRay.m_point1.GetElement(i) + dir[i] * PAGED_RAY_OFFSET;
+        invDir[i] = 1.0 / ((dir[i] != 0.0) ? dir[i] : 1e-300);
+        offsetRay.m_point1.SetElement(i, origin[i]);
+        offsetRay.m_point2.SetElement(i, origin[i] + dir[i]);
+        offsetRay.m_lab.SetElement(i, dir[i]);
+    }
+    offsetRay.m_time = castRay.m_time;
+    return true;
+}
@@ -0,0 +1,109 @@
+#ifndef PAGEDGEOMETRY_H
+#define PAGEDGEOMETRY_H
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "objectbase.hpp"
+#include "primitiveset.hpp"
+#include "../bvh.hpp"
+#include "../camera.hpp"
+
+namespace waRT {
+    constexpr int    PAGED_PRIMITIVES_PER_PAGE = 1024;
+    constexpr size_t PAGED_DEFAULT_CACHE_BYTES = size_t(256) << 20;
+
+    // one page of primitives brought into memory, searched through its own primitive set
+    struct GeometryPage {
+        waRT::PrimitiveSet primitives;
+        size_t bytes = 0;
+    };
+
+    // spheres and planes kept in a page file on disk, only a bounded set of pages is resident
+    class PagedGeometry : public ObjectBase {
+    public:
+        PagedGeometry();
+        virtual ~PagedGeometry() override;
+
+        static bool Write(const std::string &fileName, const std::vector<std::shared_ptr<waRT::ObjectBase>> &objectList,
+                          int primitivesPerPage = PAGED_PRIMITIVES_PER_PAGE, size_t *numWritten = nullptr);
+        bool Open(const std::string &fileName);
+        void Close();
+        bool IsOpen();
+
+        virtual bool TestIntersection(const Ray &castRay, qbVector<double> &intPoint, qbVector<double> &localNormal, qbVector<double> &localColor) override;
+        virtual bool GetBoundingBox(waRT::AABB &worldBox) override;
+        virtual std::string GetTypeName() override;
+        virtual void Serialize(std::ostream &out) override;
+        virtual size_t GetMemoryBytes() override;
+        virtual bool IsAggregate() override;
+
+        // closest hits of count rays, queued per page so each page is brought in once per batch
+        void IntersectBatch(const waRT::RayBatch &batch, size_t count, std::vector<waRT::PrimitiveHit> &hits);
+
+        // SETTERS
+        void SetMaxCacheBytes(size_t maxBytes);
+
+        // GETTERS
+        std::string GetFileName();
+        size_t GetNumPages();
+        size_t GetNumPrimitives();
+        size_t GetMaxCacheBytes();
+        size_t GetCacheBytes();
+        size_t GetNumResidentPages();
+        uint64_t GetPageHits();
+        uint64_t GetPageMisses();
+        uint64_t GetPageEvictions();
+        uint64_t GetPageFailures();
+
+    private:
+        struct PageEntry {
+            double   boundsMin[3];
+            double   boundsMax[3];
+            uint64_t offset;
+            uint32_t count;
+            uint32_t reserved;
+        };
+
+        struct CacheSlot {
+            std::shared_ptr<waRT::GeometryPage> page;
+            std::list<int>::iterator lruPosition;
+        };
+
+        std::shared_ptr<waRT::GeometryPage> AcquirePage(int pageIndex);
+        std::shared_ptr<waRT::GeometryPage> LoadPage(int pageIndex);
+        void ReleasePageData(int pageIndex);
+        bool PageEntryDistance(int pageIndex, const double *origin, const double *invDir, double &tEntry);
+        static bool SetupRay(const waRT::Ray &castRay, waRT::Ray &offsetRay, double *origin, double *invDir);
+
+    private:
+        std::string m_fileName;
+        std::string m_stamp;
+        uint64_t m_id;
+        int m_file;
+        const unsigned char *m_mapping;
+        size_t m_mappingBytes;
+        uint64_t m_numPrimitives;
+        std::vector<PageEntry> m_pages;
+        std::vector<int> m_pageOrder;
+        waRT::BVH  m_skeleton;
+        waRT::AABB m_bounds;
+
+        std::mutex m_cacheMutex;
+        std::unordered_map<int, CacheSlot> m_cache;
+        std::list<int> m_lru;
+        size_t m_cacheBytes;
+        size_t m_maxCacheBytes;
+        std::atomic<uint64_t> m_hits;
+        std::atomic<uint64_t> m_misses;
+        std::atomic<uint64_t> m_evictions;
+        std::atomic<uint64_t> m_failures;
+    };
+}
+
+#endif
@@ -0,0 +1,733 @@
+/*
+    The `PrimitiveSetT` class template is an alternate, flattened representation of the scene's objects for finding the closest hit of a ray. In `m_objectList` every intersection goes through the virtual `ObjectBase::TestIntersection`, which the compiler cannot inline and which builds the full hit point, normal and color for every object the ray touches. Here the set of primitive types is fixed at compile time instead, so the inner loops are plain, inlinable arithmetic that the compiler can vectorize.
+
+    1. **Closed Type Set**:
+       - Each primitive type is described by a small "shape" struct (`SphereShape`, `PlaneShape`) with three static functions:
+         - `Accepts()`: whether an object from the scene is exactly this type (a user subclass that overrides `TestIntersection` is not accepted). Moving objects are not accepted either, since the blocks hold a single transform; they go through `TestIntersection` with the ray's time.
+         - `Intersect()`: the intersection distance of a ray already transformed into the unit primitive's local space, or `NO_HIT`. This is branch-free apart from the final select, so a loop over many primitives vectorizes.
+         - `Normal()`: the world space normal at a hit point from the primitive's forward matrix, computed the same way as the object's own `TestIntersection`.
+       - `PrimitiveSet` is `PrimitiveSetT<SphereShape, PlaneShape>`. Adding a new built-in primitive means adding a shape struct to that list.
+
+    2. **Storage (`PrimitiveBlock`)**:
+       - For each shape there is one homogeneous block holding the backward and forward 3x4 matrices, the color and the original object index of every primitive of that type, stored as structure-of-arrays so consecutive primitives sit next to each other in memory.
+       - With `SetCompactStorage(true)` (applied at the next `Build()`) a block keeps only the backward matrix as floats and the color as half floats, 54 bytes per primitive plus its index instead of 216, and the BVHs switch to compact nodes (see `bvh.cpp`). The intersection loop converts to double as it reads, so the arithmetic is the same, only the stored transform is rounded to float precision. The forward matrix is needed only for the normal of the closest hit, so it is rebuilt there with `GTform::InvertAffine()`. Hit points and normals therefore differ from full storage in the last few float digits.
+       - `GetMemoryBytes()` and `GetBVHMemoryBytes()` report the bytes held by the blocks and by their trees.
+
+    3. **Building (`Build`)**:
+       - Walks the object list once and copies each object into the block of the first shape that accepts it. Anything that no shape accepts, such as user defined `ObjectBase` subclasses, is kept in `m_fallbackObjects` and still tested through the virtual interface, so extensions keep working.
+       - Aggregates (`ObjectBase::IsAggregate()`, e.g. `PagedGeometry`) are left out entirely. The scene intersects them itself, in batches.
+       - Each block then gets its own `BVH` (see `bvh.cpp`) over the objects' `GetBoundingBox()`, built with `numThreads` threads, and the block's arrays are reordered into the BVH's primitive order so every leaf is a contiguous run of primitives.
+
+    4. **Refitting (`Refit`)**:
+       - When objects have moved or changed color but the object list itself is the same, `Refit()` copies the new matrices and colors into their existing slots and refits every BVH instead of rebuilding it. The boxes of the fallback objects are taken again as well.
+
+    5. **Closest Hit (`ClosestHit`)**:
+       - The world ray direction is normalized once. Each primitive transforms the ray origin and direction into its local space without renormalizing the direction, so the local ray parameter is directly the world space distance and hits from different primitives can be compared without computing any hit points.
+       - Every block's BVH is traversed with the closest distance found so far as the ray's far limit, so later blocks and far subtrees are culled. Inside a leaf the same inlined shape kernel runs over the leaf's contiguous primitives. Only the winning primitive has its hit point, normal and color computed.
+       - Fallback objects are then tested as before and replace the hit if they are closer. Their world boxes are kept next to them (refreshed by `Build()`, `Load()` and `Refit()`), and an object is only asked when the ray enters its box before the closest hit so far, so procedural objects such as `ObjectSDF` are culled like the built-in shapes. Objects without bounds are always tested.
+       - The hit is returned in a `PrimitiveHit`, with the same values that the object's own `TestIntersection` would give.
+
+    6. **Acceleration Files (`Save`, `Load`)**:
+       - `Save()` writes a compact set to a file: a 128 byte header (`WABVH001`, byte order mark, node size, block count and the caller's stamp), a table with one entry per block, and then every array of every block in its own section on a 64 byte boundary. These are the compact BVH nodes, the object indices, the twelve float columns of the backward matrix and the three half float color columns, plus the indices of the fallback objects. The file holds offsets and indices only, no pointers, so it can be mapped at any address. It is written under a temporary name from `TempFileName()` (see `mappedfile.cpp`), unique per process and write, and renamed into place.
+       - `Load()` maps the file read-only (see `mappedfile.cpp`) and points the blocks and their BVHs straight at the mapped arrays, so nothing is built or copied apart from the object indices. Many processes loading the same file share its pages. The stamp (`GetStamp()`) is a 128 bit hash of what `Build()` takes from the object list: the block each object goes to, its backward matrix and its color. It is much cheaper than serializing the objects. A file with another stamp, another version, byte order or node size, or any offset or index out of range is rejected, leaving the set unchanged.
+       - A loaded set is in compact mode and read-only. `Refit()` leaves it alone, so its owner rebuilds it instead, and `Build()` drops the mapping.
+*/
+
+#include "primitiveset.hpp"
+#include "objectsphere.hpp"
+#include "objectplane.hpp"
+#include "../halffloat.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <typeinfo>
+#include <utility>
+
+constexpr double NO_HIT   = 1e300;
+constexpr double MAX_DIST = 1e6;
+
+constexpr char     ACCEL_MAGIC[8]      = {'W', 'A', 'B', 'V', 'H', '0', '0', '1'};
+constexpr size_t   ACCEL_HEADER_BYTES  = 128;
+constexpr size_t   ACCEL_ALIGNMENT     = 64;
+// written in the machine's own byte order, so a file from a machine of the other order is rejected
+constexpr uint32_t ACCEL_BYTE_ORDER    = 0x01020304u;
+
+struct AccelHeader {
+    char     magic[8];
+    uint32_t byteOrder;
+    uint32_t numBlocks;
+    uint32_t nodeBytes;
+    uint32_t numFallback;
+    uint64_t tableOffset;
+    uint64_t fallbackOffset;
+    char     stamp[32];
+    char     reserved[ACCEL_HEADER_BYTES - 72];
+};
+
+// where one block's arrays are, as byte offsets from the start of the file
+struct AccelBlockEntry {
+    uint64_t numPrimitives;
+    uint64_t numNodes;
+    uint64_t nodesOffset;
+    uint64_t indexOffset;
+    uint64_t bckOffset[12];
+    uint64_t colorOffset[3];
+};
+
+static_assert(sizeof(AccelHeader) == ACCEL_HEADER_BYTES, "the header is 128 bytes");
+static_assert(sizeof(AccelBlockEntry) == 152, "block entries must have a fixed size");
+static_assert(sizeof(int) == sizeof(int32_t), "object indices are stored as 32 bit integers");
+
+static size_t AccelAlignUp(size_t value) {
+    return (value + ACCEL_ALIGNMENT - 1) / ACCEL_ALIGNMENT * ACCEL_ALIGNMENT;
+}
+
+static void AccelHash(const void *data, size_t bytes, uint64_t &hashLo, uint64_t &hashHi) {
+    const unsigned char *bytePtr = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < bytes; ++i) {
+        hashLo = (hashLo ^ bytePtr[i]) * 0x100000001b3ull;
+        hashHi = (hashHi ^ bytePtr[i]) * 0x100000001b3ull;
+    }
+}
+
+// an aligned array of count elements that lies inside the file
+static bool AccelInFile(uint64_t offset, uint64_t count, size_t elementBytes, size_t fileBytes) {
+    return (offset % ACCEL_ALIGNMENT == 0) && (offset <= fileBytes) && (count <= (fileBytes - offset) / elementBytes);
+}
+
+// whether a ray enters a fallback object's box before tMax; unbounded objects are always in reach
+static bool FallbackInReach(const waRT::AABB &box, const double *origin, const double *invDir, double tMax) {
+    double tNear = 0.0;
+    double tFar  = tMax;
+    for (int axis = 0; axis < 3; ++axis) {
+        double t0 = (box.boxMin[axis] - origin[axis]) * invDir[axis];
+        double t1 = (box.boxMax[axis] - origin[axis]) * invDir[axis];
+        tNear = std::max(tNear, std::min(t0, t1));
+        tFar  = std::min(tFar,  std::max(t0, t1));
+    }
+    return tNear <= tFar;
+}
+
+// SPHERE
+bool waRT::SphereShape::Accepts(waRT::ObjectBase &object) {
+    return (typeid(object) == typeid(waRT::ObjSphere)) && !object.HasMotion();
+}
+
+inline double waRT::SphereShape::Intersect(const double *origin, const double *dir) {
+    double a = dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2];
+    double b = 2.0 * (origin[0] * dir[0] + origin[1] * dir[1] + origin[2] * dir[2]);
+    double c = origin[0] * origin[0] + origin[1] * origin[1] + origin[2] * origin[2] - 1.0;
+    double intTest = (b * b) - 4.0 * a * c;
+    double numSQRT = sqrt(intTest > 0.0 ? intTest : 0.0);
+    // the nearer root, both roots must be in front of the ray
+    double t = (-b - numSQRT) / (2.0 * a);
+    return ((intTest > 0.0) && (t >= 0.0)) ? t : NO_HIT;
+}
+
+void waRT::SphereShape::Normal(const double *fwd, const double *point, double *normal) {
+    double length = 0.0;
+    for (int i = 0; i < 3; ++i) {
+        normal[i] = point[i] - fwd[i * 4 + 3];
+        length += normal[i] * normal[i];
+    }
+    length = sqrt(length);
+    for (int i = 0; i < 3; ++i) {
+        normal[i] /= length;
+    }
+}
+
+// PLANE
+bool waRT::PlaneShape::Accepts(waRT::ObjectBase &object) {
+    return (typeid(object) == typeid(waRT::ObjectPlane)) && !object.HasMotion();
+}
+
+inline double waRT::PlaneShape::Intersect(const double *origin, const double *dir) {
+    double dirZ = (fabs(dir[2]) > 1e-300) ? dir[2] : 1e-300;
+    double t = origin[2] / -dirZ;
+    double u = origin[0] + (dir[0] * t);
+    double v = origin[1] + (dir[1] * t);
+    return ((t > 0.0) && (fabs(u) < 1.0) && (fabs(v) < 1.0)) ? t : NO_HIT;
+}
+
+void waRT::PlaneShape::Normal(const double *fwd, const double *point, double *normal) {
+    // the local normal (0, 0, -1) through the forward matrix, unnormalized like ObjectPlane
+    for (int i = 0; i < 3; ++i) {
+        normal[i] = -fwd[i * 4 + 2];
+    }
+}
+
+// SET
+template <class... Shapes>
+waRT::PrimitiveSetT<Shapes...>::PrimitiveSetT() {}
+
+template <class... Shapes>
+void waRT::PrimitiveSetT<Shapes...>::CopyObject(waRT::ObjectBase &object, waRT::PrimitiveBlock &block, size_t slot) {
+    qbMatrix2<double> fwd = object.m_transformMatrix.GetForward();
+    qbMatrix2<double> bck = object.m_transformMatrix.GetBackward();
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 4; ++col) {
+            if (m_compact) {
+                block.bckCompact[row * 4 + col][slot] = static_cast<float>(bck.GetElement(row, col));
+            } else {
+                block.fwd[row * 4 + col][slot] = fwd.GetElement(row, col);
+                block.bck[row * 4 + col][slot] = bck.GetElement(row, col);
+            }
+        }
+        if (m_compact) {
+            block.colorCompact[row][slot] = waRT::FloatToHalf(static_cast<float>(object.m_baseColor.GetElement(row)));
+        } else {
+            block.color[row][slot] = object.m_baseColor.GetElement(row);
+        }
+    }
+}
+
+// only the arrays of the current storage mode hold anything
+template <class... Shapes>
+void waRT::PrimitiveSetT<Shapes...>::ResizeBlock(waRT::PrimitiveBlock &block, size_t count) {
+    size_t fullCount    = m_compact ? 0 : count;
+    size_t compactCount = m_compact ? count : 0;
+    for (auto &column : block.bck)          { column.resize(fullCount);    column.shrink_to_fit(); }
+    for (auto &column : block.fwd)          { column.resize(fullCount);    column.shrink_to_fit(); }
+    for (auto &column : block.color)        { column.resize(fullCount);    column.shrink_to_fit(); }
+    for (auto &column : block.bckCompact)   { column.resize(compactCount); column.shrink_to_fit(); }
+    for (auto &column : block.colorCompact) { column.resize(compactCount); column.shrink_to_fit(); }
+}
+
+template <class... Shapes>
+void waRT::PrimitiveSetT<Shapes...>::UpdateFallbackBounds() {
+    m_fallbackBounds.resize(m_fallbackObjects.size());
+    for (size_t i = 0; i < m_fallbackObjects.size(); ++i) {
+        waRT::AABB &box = m_fallbackBounds[i];
+        if (!m_fallbackObjects[i]->GetBoundingBox(box)) {
+            for (int axis = 0; axis < 3; ++axis) {
+                box.boxMin[axis] = -std::numeric_limits<double>::infinity();
+                box.boxMax[axis] =  std::numeric_limits<double>::infinity();
+            }
+        }
+    }
+}
+
+template <class... Shapes>
+void waRT::PrimitiveSetT<Shapes...>::ClearBlocks() {
+    std::apply([&](auto &... blocks) {
+        auto clearBlock = [](waRT::PrimitiveBlock &block) {
+            for (auto &column : block.bck)          { column.clear(); }
+            for (auto &column : block.fwd)          { column.clear(); }
+            for (auto &column : block.color)        { column.clear(); }
+            for (auto &column : block.bckCompact)   { column.clear(); }
+            for (auto &column : block.colorCompact) { column.clear(); }
+            block.objectIndex.clear();
+            block.bvh.Clear();
+            for (auto &column : block.mappedBck)   { column = nullptr; }
+            for (auto &column : block.mappedColor) { column = nullptr; }
+        };
+        (clearBlock(blocks.second), ...);
+    }, m_blocks);
+    m_fallbackObjects.clear();
+    m_fallbackIndices.clear();
+    m_fallbackBounds.clear();
+    m_mapping.reset();
+}
+
+template <class... Shapes>
+void waRT::PrimitiveSetT<Shapes...>::Build(const std::vector<std::shared_ptr<waRT::ObjectBase>> &objectList, int numThreads) {
+    ClearBlocks();
+
+    for (size_t objIndex = 0; objIndex < objectList.size(); ++objIndex) {
+        waRT::ObjectBase &object = *objectList[objIndex];
+        if (object.IsAggregate()) {
+            continue;
+        }
+        bool accepted = false;
+        std::apply([&](auto &... blocks) {
+            auto tryBlock = [&](auto &shapeBlock) {
+                using Shape = typename std::decay_t<decltype(shapeBlock)>::first_type;
+                if (accepted || !Shape::Accepts(object)) {
+                    return;
+                }
+                accepted = true;
+                waRT::PrimitiveBlock &block = shapeBlock.second;
+                block.objectIndex.push_back(static_cast<int>(objIndex));
+            };
+            (tryBlock(blocks), ...);
+        }, m_blocks);
+
+        if (!accepted) {
+            m_fallbackObjects.push_back(objectList[objIndex]);
+            m_fallbackIndices.push_back(static_cast<int>(objIndex));
+        }
+    }
+    UpdateFallbackBounds();
+
+    // build each block's BVH, then lay the block out in BVH order
+    std::apply([&](auto &... blocks) {
+        auto buildBlock = [&](waRT::PrimitiveBlock &block) {
+            size_t count = block.objectIndex.size();
+            std::vector<waRT::AABB> bounds(count);
+            for (size_t i = 0; i < count; ++i) {
+                objectList[block.objectIndex[i]]->GetBoundingBox(bounds[i]);
+            }
+            block.bvh.Build(bounds, numThreads);
+
+            const std::vector<int> &order = block.bvh.GetPrimitiveOrder();
+            std::vector<int> orderedIndex(count);
+            for (size_t i = 0; i < count; ++i) {
+                orderedIndex[i] = block.objectIndex[order[i]];
+            }
+            block.objectIndex.swap(orderedIndex);
+            block.objectIndex.shrink_to_fit();
+            ResizeBlock(block, count);
+            for (size_t i = 0; i < count; ++i) {
+                CopyObject(*objectList[block.objectIndex[i]], block, i);
+            }
+            if (m_compact) {
+                block.bvh.Compact();
+            }
+        };
+        (buildBlock(blocks.second), ...);
+    }, m_blocks);
+}
+
+template <class... Shapes>
+void waRT::PrimitiveSetT<Shapes...>::Refit(const std::vector<std::shared_ptr<waRT::ObjectBase>> &objectList) {
+    UpdateFallbackBounds();
+    // mapped blocks are read-only, the owner rebuilds instead
+    if (m_mapping) {
+        return;
+    }
+    std::apply([&](auto &... blocks) {
+        auto refitBlock = [&](waRT::PrimitiveBlock &block) {
+            size_t count = block.objectIndex.size();
+            std::vector<waRT::AABB> bounds(count);
+            for (size_t i = 0; i < count; ++i) {
+                waRT::ObjectBase &object = *objectList[block.objectIndex[i]];
+                CopyObject(object, block, i);
+                object.GetBoundingBox(bounds[i]);
+            }
+            block.bvh.Refit(bounds);
+        };
+        (refitBlock(blocks.second), ...);
+    }, m_blocks);
+}
+
+template <class... Shapes>
+std::string waRT::PrimitiveSetT<Shapes...>::GetStamp(const std::vector<std::shared_ptr<waRT::ObjectBase>> &objectList) {
+    uint64_t hashLo = 0xcbf29ce484222325ull;
+    uint64_t hashHi = 0x84222325cbf29ce4ull;
+    for (const auto &objectPtr : objectList) {
+        waRT::ObjectBase &object = *objectPtr;
+        // the block the object goes to, -1 for a fallback and -2 for an aggregate
+        int32_t kind = object.IsAggregate() ? -2 : -1;
+        std::apply([&](auto &... blocks) {
+            int32_t blockNumber = 0;
+            auto tryBlock = [&](auto &shapeBlock) {
+                using Shape = typename std::decay_t<decltype(shapeBlock)>::first_type;
+                if ((kind == -1) && Shape::Accepts(object)) {
+                    kind = blockNumber;
+                }
+                ++blockNumber;
+            };
+            (tryBlock(blocks), ...);
+        }, m_blocks);
+        AccelHash(&kind, sizeof(kind), hashLo, hashHi);
+        if (kind < 0) {
+            continue;
+        }
+        double values[15];
+        qbMatrix2<double> bck = object.m_transformMatrix.GetBackward();
+        for (int row = 0; row < 3; ++row) {
+            for (int col = 0; col < 4; ++col) {
+                values[row * 4 + col] = bck.GetElement(row, col);
+            }
+            values[12 + row] = object.m_baseColor.GetElement(row);
+        }
+        AccelHash(values, sizeof(values), hashLo, hashHi);
+    }
+    char stamp[33];
+    snprintf(stamp, sizeof(stamp), "%016llx%016llx", static_cast<unsigned long long>(hashHi), static_cast<unsigned long long>(hashLo));
+    return std::string(stamp);
+}
+
+template <class... Shapes>
+bool waRT::PrimitiveSetT<Shapes...>::Save(const std::string &fileName, const std::string &stamp) {
+    AccelHeader header = {};
+    if (!m_compact || (stamp.size() > sizeof(header.stamp))) {
+        return false;
+    }
+    // every array gets its own aligned section, laid out before anything is written
+    struct Section {
+        uint64_t    offset;
+        const void *data;
+        size_t      bytes;
+    };
+    std::vector<Section> sections;
+    std::vector<AccelBlockEntry> table(sizeof...(Shapes));
+    size_t offset = AccelAlignUp(ACCEL_HEADER_BYTES + table.size() * sizeof(AccelBlockEntry));
+    auto addSection = [&](const void *data, size_t bytes) {
+        sections.push_back(Section{offset, data, bytes});
+        offset = AccelAlignUp(offset + bytes);
+        return sections.back().offset;
+    };
+    std::apply([&](auto &... blocks) {
+        size_t blockNumber = 0;
+        auto addBlock = [&](waRT::PrimitiveBlock &block) {
+            AccelBlockEntry &entry = table[blockNumber++];
+            size_t count = block.objectIndex.size();
+            entry.numPrimitives = count;
+            entry.numNodes      = block.bvh.GetNumNodes();
+            entry.nodesOffset   = addSection(block.bvh.GetCompactNodes(), entry.numNodes * sizeof(waRT::CompactBVHNode));
+            entry.indexOffset   = addSection(block.objectIndex.data(), count * sizeof(int32_t));
+            for (int k = 0; k < 12; ++k) {
+                entry.bckOffset[k] = addSection(block.CompactBck(k), count * sizeof(float));
+            }
+            for (int k = 0; k < 3; ++k) {
+                entry.colorOffset[k] = addSection(block.CompactColor(k), count * sizeof(uint16_t));
+            }
+        };
+        (addBlock(blocks.second), ...);
+    }, m_blocks);
+
+    memcpy(header.magic, ACCEL_MAGIC, sizeof(ACCEL_MAGIC));
+    memcpy(header.stamp, stamp.data(), stamp.size());
+    header.byteOrder      = ACCEL_BYTE_ORDER;
+    header.numBlocks      = static_cast<uint32_t>(table.size());
+    header.nodeBytes      = static_cast<uint32_t>(sizeof(waRT::CompactBVHNode));
+    header.numFallback    = static_cast<uint32_t>(m_fallbackIndices.size());
+    header.tableOffset    = ACCEL_HEADER_BYTES;
+    header.fallbackOffset = addSection(m_fallbackIndices.data(), m_fallbackIndices.size() * sizeof(int32_t));
+
+    std::string tempPath = waRT::TempFileName(fileName);
+    FILE *outFile = fopen(tempPath.c_str(), "wb");
+    if (outFile == NULL) {
+        return false;
+    }
+    bool writeOk = (fwrite(&header, 1, sizeof(header), outFile) == sizeof(header));
+    writeOk = writeOk && (fwrite(table.data(), sizeof(AccelBlockEntry), table.size(), outFile) == table.size());
+    size_t written = ACCEL_HEADER_BYTES + table.size() * sizeof(AccelBlockEntry);
+    std::vector<char> padding(ACCEL_ALIGNMENT, 0);
+    for (size_t i = 0; (i < sections.size()) && writeOk; ++i) {
+        size_t gap = sections[i].offset - written;
+        writeOk = (fwrite(padding.data(), 1, gap, outFile) == gap);
+        writeOk = writeOk && ((sections[i].bytes == 0) || (fwrite(sections[i].data, 1, sections[i].bytes, outFile) == sections[i].bytes));
+        written = sections[i].offset + sections[i].bytes;
+    }
+    writeOk = (fclose(outFile) == 0) && writeOk;
+
+    // renamed into place, so a process mapping the old file keeps its pages
+    std::error_code error;
+    if (writeOk) {
+        std::filesystem::rename(tempPath, fileName, error);
+    }
+    if (!writeOk || error) {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    return true;
+}
+
+template <class... Shapes>
+bool waRT::PrimitiveSetT<Shapes...>::Load(const std::string &fileName, const std::string &stamp,
+                                          const std::vector<std::shared_ptr<waRT::ObjectBase>> &objectList) {
+    auto mapping = std::make_shared<waRT::MappedFile>();
+    if (!mapping->Open(fileName) || (mapping->GetSize() < ACCEL_HEADER_BYTES)) {
+        return false;
+    }
+    const unsigned char *data = mapping->GetData();
+    size_t fileBytes = mapping->GetSize();
+    AccelHeader header;
+    memcpy(&header, data, sizeof(header));
+    if ((memcmp(header.magic, ACCEL_MAGIC, sizeof(ACCEL_MAGIC)) != 0) || (header.byteOrder != ACCEL_BYTE_ORDER) ||
+        (header.numBlocks != sizeof...(Shapes)) || (header.nodeBytes != sizeof(waRT::CompactBVHNode)) ||
+        (std::string(header.stamp, strnlen(header.stamp, sizeof(header.stamp))) != stamp) ||
+        (header.tableOffset + sizeof...(Shapes) * sizeof(AccelBlockEntry) > fileBytes) ||
+        !AccelInFile(header.fallbackOffset, header.numFallback, sizeof(int32_t), fileBytes)) {
+        return false;
+    }
+    std::vector<AccelBlockEntry> table(sizeof...(Shapes));
+    memcpy(table.data(), data + header.tableOffset, table.size() * sizeof(AccelBlockEntry));
+    const int32_t *fallbackIndices = reinterpret_cast<const int32_t *>(data + header.fallbackOffset);
+    for (uint32_t i = 0; i < header.numFallback; ++i) {
+        if ((fallbackIndices[i] < 0) || (static_cast<size_t>(fallbackIndices[i]) >= objectList.size())) {
+            return false;
+        }
+    }
+
+    // the file is checked completely before anything is replaced: arrays inside it, indices naming objects
+    // of the block's shape, and a tree whose children follow their parents and which fits the traversal stack
+    bool valid = true;
+    std::apply([&](auto &... blocks) {
+        size_t blockNumber = 0;
+        auto checkBlock = [&](auto &shapeBlock) {
+            using Shape = typename std::decay_t<decltype(shapeBlock)>::first_type;
+            const AccelBlockEntry &entry = table[blockNumber++];
+            if (!valid) {
+                return;
+            }
+            uint64_t count = entry.numPrimitives;
+            valid = AccelInFile(entry.nodesOffset, entry.numNodes, sizeof(waRT::CompactBVHNode), fileBytes) &&
+                    AccelInFile(entry.indexOffset, count, sizeof(int32_t), fileBytes) &&
+                    (count < static_cast<uint64_t>(INT32_MAX)) && ((count == 0) == (entry.numNodes == 0));
+            for (int k = 0; (k < 12) && valid; ++k) {
+                valid = AccelInFile(entry.bckOffset[k], count, sizeof(float), fileBytes);
+            }
+            for (int k = 0; (k < 3) && valid; ++k) {
+                valid = AccelInFile(entry.colorOffset[k], count, sizeof(uint16_t), fileBytes);
+            }
+            if (!valid) {
+                return;
+            }
+            const int32_t *objectIndex = reinterpret_cast<const int32_t *>(data + entry.indexOffset);
+            for (uint64_t i = 0; (i < count) && valid; ++i) {
+                valid = (objectIndex[i] >= 0) && (static_cast<size_t>(objectIndex[i]) < objectList.size()) &&
+                        Shape::Accepts(*objectList[objectIndex[i]]);
+            }
+            const waRT::CompactBVHNode *nodes = reinterpret_cast<const waRT::CompactBVHNode *>(data + entry.nodesOffset);
+            std::vector<int> depth(entry.numNodes, 0);
+            for (uint64_t i = 0; (i < entry.numNodes) && valid; ++i) {
+                const waRT::CompactBVHNode &node = nodes[i];
+                if (node.count > 0) {
+                    valid = (node.leftFirst >= 0) && (static_cast<uint64_t>(node.leftFirst) + node.count <= count);
+                } else {
+                    valid = (node.count == 0) && (static_cast<uint64_t>(node.leftFirst) > i) &&
+                            (static_cast<uint64_t>(node.leftFirst) + 1 < entry.numNodes) && (depth[i] < waRT::BVH_STACK_SIZE - 2);
+                    if (valid) {
+                        depth[node.leftFirst]     = depth[i] + 1;
+                        depth[node.leftFirst + 1] = depth[i] + 1;
+                    }
+                }
+            }
+        };
+        (checkBlock(blocks), ...);
+    }, m_blocks);
+    if (!valid) {
+        return false;
+    }
+
+    ClearBlocks();
+    m_compact = true;
+    std::apply([&](auto &... blocks) {
+        size_t blockNumber = 0;
+        auto mapBlock = [&](waRT::PrimitiveBlock &block) {
+            const AccelBlockEntry &entry = table[blockNumber++];
+            const int32_t *objectIndex = reinterpret_cast<const int32_t *>(data + entry.indexOffset);
+            block.objectIndex.assign(objectIndex, objectIndex + entry.numPrimitives);
+            for (int k = 0; k < 12; ++k) {
+                block.mappedBck[k] = reinterpret_cast<const float *>(data + entry.bckOffset[k]);
+            }
+            for (int k = 0; k < 3; ++k) {
+                block.mappedColor[k] = reinterpret_cast<const uint16_t *>(data + entry.colorOffset[k]);
+            }
+            block.bvh.MapNodes(reinterpret_cast<const waRT::CompactBVHNode *>(data + entry.nodesOffset), entry.numNodes);
+        };
+        (mapBlock(blocks.second), ...);
+    }, m_blocks);
+    for (uint32_t i = 0; i < header.numFallback; ++i) {
+        m_fallbackIndices.push_back(fallbackIndices[i]);
+        m_fallbackObjects.push_back(objectList[fallbackIndices[i]]);
+    }
+    UpdateFallbackBounds();
+    m_mapping = mapping;
+    return true;
+}
+
+template <class... Shapes>
+template <class Shape, class Real>
+void waRT::PrimitiveSetT<Shapes...>::TestBlock(const waRT::PrimitiveBlock &block, const Real *const *b, const double *origin, const double *dir, const double *invDir,
+                                               waRT::PrimitiveHit &hit, int &bestBlock, size_t &bestIndex, int blockNumber) {
+    if (block.objectIndex.empty()) {
+        return;
+    }
+
+    block.bvh.Traverse(origin, invDir, hit.dist, [&](int first, int count) {
+        for (int i = first; i < first + count; ++i) {
+            double localOrigin[3];
+            double localDir[3];
+            for (int row = 0; row < 3; ++row) {
+                localOrigin[row] = b[row * 4 + 0][i] * origin[0] + b[row * 4 + 1][i] * origin[1] + b[row * 4 + 2][i] * origin[2] + b[row * 4 + 3][i];
+                localDir[row]    = b[row * 4 + 0][i] * dir[0]    + b[row * 4 + 1][i] * dir[1]    + b[row * 4 + 2][i] * dir[2];
+            }
+            double dist = Shape::Intersect(localOrigin, localDir);
+            if (dist < hit.dist) {
+                hit.dist  = dist;
+                bestBlock = blockNumber;
+                bestIndex = static_cast<size_t>(i);
+            }
+        }
+    });
+}
+
+template <class... Shapes>
+bool waRT::PrimitiveSetT<Shapes...>::ClosestHit(const waRT::Ray &castRay, waRT::PrimitiveHit &hit) {
+    double origin[3];
+    double dir[3];
+    double length = 0.0;
+    for (int i = 0; i < 3; ++i) {
+        origin[i] = castRay.m_point1.GetElement(i);
+        dir[i]    = castRay.m_lab.GetElement(i);
+        length   += dir[i] * dir[i];
+    }
+    length = sqrt(length);
+    double invDir[3];
+    for (int i = 0; i < 3; ++i) {
+        dir[i] /= length;
+        // a huge finite value instead of infinity keeps the slab test free of 0 * inf
+        invDir[i] = 1.0 / ((dir[i] != 0.0) ? dir[i] : 1e-300);
+    }
+
+    hit.dist = MAX_DIST;
+    hit.objectIndex = -1;
+    int bestBlock = -1;
+    size_t bestIndex = 0;
+
+    std::apply([&](auto &... blocks) {
+        int blockNumber = 0;
+        auto testBlock = [&](auto &shapeBlock) {
+            using Shape = typename std::decay_t<decltype(shapeBlock)>::first_type;
+            if (m_compact) {
+                const float *columns[12];
+                for (int k = 0; k < 12; ++k) {
+                    columns[k] = shapeBlock.second.CompactBck(k);
+                }
+                TestBlock<Shape>(shapeBlock.second, columns, origin, dir, invDir, hit, bestBlock, bestIndex, blockNumber++);
+            } else {
+                const double *columns[12];
+                for (int k = 0; k < 12; ++k) {
+                    columns[k] = shapeBlock.second.bck[k].data();
+                }
+                TestBlock<Shape>(shapeBlock.second, columns, origin, dir, invDir, hit, bestBlock, bestIndex, blockNumber++);
+            }
+        };
+        (testBlock(blocks), ...);
+    }, m_blocks);
+
+    if (bestBlock >= 0) {
+        std::apply([&](auto &... blocks) {
+            int blockNumber = 0;
+            auto fillHit = [&](auto &shapeBlock) {
+                using Shape = typename std::decay_t<decltype(shapeBlock)>::first_type;
+                if (blockNumber++ != bestBlock) {
+                    return;
+                }
+                const waRT::PrimitiveBlock &block = shapeBlock.second;
+                double point[3];
+                double normal[3];
+                double fwd[12];
+                for (int i = 0; i < 3; ++i) {
+                    point[i] = origin[i] + dir[i] * hit.dist;
+                }
+                if (m_compact) {
+                    // the forward matrix is not stored, invert the backward one for the winner only
+                    double bck[12];
+                    for (int k = 0; k < 12; ++k) {
+                        bck[k] = block.CompactBck(k)[bestIndex];
+                    }
+                    waRT::GTform::InvertAffine(bck, fwd);
+                } else {
+                    for (int k = 0; k < 12; ++k) {
+                        fwd[k] = block.fwd[k][bestIndex];
+                    }
+                }
+                Shape::Normal(fwd, point, normal);
+                for (int i = 0; i < 3; ++i) {
+                    hit.point.SetElement(i, point[i]);
+                    hit.normal.SetElement(i, normal[i]);
+                    hit.color.SetElement(i, m_compact ? waRT::HalfToFloat(block.CompactColor(i)[bestIndex]) : block.color[i][bestIndex]);
+                }
+                hit.objectIndex = block.objectIndex[bestIndex];
+            };
+            (fillHit(blocks), ...);
+        }, m_blocks);
+    }
+
+    // user extensions still go through the virtual interface
+    if (!m_fallbackObjects.empty()) {
+        thread_local qbVector<double> tempIntPoint {3};
+        thread_local qbVector<double> tempNormal   {3};
+        thread_local qbVector<double> tempColor    {3};
+        for (size_t i = 0; i < m_fallbackObjects.size(); ++i) {
+            if (!FallbackInReach(m_fallbackBounds[i], origin, invDir, hit.dist)) {
+                continue;
+            }
+            if (!m_fallbackObjects[i]->TestIntersection(castRay, tempIntPoint, tempNormal, tempColor)) {
+                continue;
+            }
+            double distSquared = 0.0;
+            for (int k = 0; k < 3; ++k) {
+                double delta = tempIntPoint.GetElement(k) - origin[k];
+                distSquared += delta * delta;
+            }
+            double dist = sqrt(distSquared);
+            if (dist < hit.dist) {
+                hit.dist        = dist;
+                hit.objectIndex = m_fallbackIndices[i];
+                hit.point       = tempIntPoint;
+                hit.normal      = tempNormal;
+                hit.color       = tempColor;
+            }
+        }
+    }
+    return hit.objectIndex >= 0;
+}
+
+template <class... Shapes>
+size_t waRT::PrimitiveSetT<Shapes...>::GetNumPrimitives() {
+    size_t total = 0;
+    std::apply([&](auto &... blocks) { ((total += blocks.second.objectIndex.size()), ...);}, m_blocks);
+    return total;
+}
+
+template <class... Shapes>
+size_t waRT::PrimitiveSetT<Shapes...>::GetNumFallbackObjects() { return m_fallbackObjects.size();}
+
+// takes effect at the next Build()
+template <class... Shapes>
+void waRT::PrimitiveSetT<Shapes...>::SetCompactStorage(bool enable) {
+    m_compact = enable;
+}
+
+template <class... Shapes>
+bool waRT::PrimitiveSetT<Shapes...>::IsCompactStorage() { return m_compact;}
+
+template <class... Shapes>
+bool waRT::PrimitiveSetT<Shapes...>::IsMapped() { return m_mapping != nullptr;}
+
+// file pages, shared with every other process that maps the same file
+template <class... Shapes>
+size_t waRT::PrimitiveSetT<Shapes...>::GetMappedBytes() { return m_mapping ? m_mapping->GetSize() : 0;}
+
+template <class... Shapes>
+size_t waRT::PrimitiveSetT<Shapes...>::GetMemoryBytes() {
+    size_t total = m_fallbackObjects.capacity() * sizeof(std::shared_ptr<waRT::ObjectBase>) + m_fallbackIndices.capacity() * sizeof(int) +
+                   m_fallbackBounds.capacity() * sizeof(waRT::AABB);
+    std::apply([&](auto &... blocks) {
+        auto blockBytes = [&](waRT::PrimitiveBlock &block) {
+            for (auto &column : block.bck)          { total += column.capacity() * sizeof(double);}
+            for (auto &column : block.fwd)          { total += column.capacity() * sizeof(double);}
+            for (auto &column : block.color)        { total += column.capacity() * sizeof(double);}
+            for (auto &column : block.bckCompact)   { total += column.capacity() * sizeof(float);}
+            for (auto &column : block.colorCompact) { total += column.capacity() * sizeof(uint16_t);}
+            total += block.objectIndex.capacity() * sizeof(int);
+        };
+        (blockBytes(blocks.second), ...);
+    }, m_blocks);
+    return total;
+}
+
+template <class... Shapes>
+size_t waRT::PrimitiveSetT<Shapes...>::GetBVHMemoryBytes() {
+    size_t total = 0;
+    std::apply([&](auto &... blocks) { ((total += blocks.second.bvh.GetMemoryBytes()), ...);}, m_blocks);
+    return total;
+}
+
+template <class... Shapes>
+size_t waRT::PrimitiveSetT<Shapes...>::GetNumBVHNodes() {
+    size_t total = 0;
+    std::apply([&](auto &... blocks) { ((total += blocks.second.bvh.GetNumNodes()), ...);}, m_blocks);
+    return total;
+}
+
+template class waRT::PrimitiveSetT<waRT::SphereShape, waRT::PlaneShape>;
@@ -0,0 +1,98 @@
+#ifndef PRIMITIVESET_H
+#define PRIMITIVESET_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "../linAlgModule/qbVector.h"
+#include "../ray.hpp"
+#include "../bvh.hpp"
+#include "../mappedfile.hpp"
+#include "objectbase.hpp"
+
+namespace waRT {
+    // structure-of-arrays storage for all primitives of one type; in compact mode only
+    // the float backward matrix and half colors are kept
+    struct PrimitiveBlock {
+        std::vector<double> bck[12];
+        std::vector<double> fwd[12];
+        std::vector<double> color[3];
+        std::vector<float>    bckCompact[12];
+        std::vector<uint16_t> colorCompact[3];
+        std::vector<int>    objectIndex;
+        waRT::BVH           bvh;
+        // the compact columns when they are read from a mapped acceleration file instead
+        const float    *mappedBck[12]  = {};
+        const uint16_t *mappedColor[3] = {};
+
+        const float    *CompactBck(int k) const   { return (mappedBck[k] != nullptr) ? mappedBck[k] : bckCompact[k].data();}
+        const uint16_t *CompactColor(int k) const { return (mappedColor[k] != nullptr) ? mappedColor[k] : colorCompact[k].data();}
+    };
+
+    struct PrimitiveHit {
+        double dist;
+        int    objectIndex;
+        qbVector<double> point  {3};
+        qbVector<double> normal {3};
+        qbVector<double> color  {3};
+    };
+
+    // shape kernels, each one is a member of the closed type set
+    struct SphereShape {
+        static bool Accepts(ObjectBase &object);
+        static double Intersect(const double *origin, const double *dir);
+        static void Normal(const double *fwd, const double *point, double *normal);
+    };
+
+    struct PlaneShape {
+        static bool Accepts(ObjectBase &object);
+        static double Intersect(const double *origin, const double *dir);
+        static void Normal(const double *fwd, const double *point, double *normal);
+    };
+
+    template <class... Shapes>
+    class PrimitiveSetT {
+    public:
+        PrimitiveSetT();
+        void Build(const std::vector<std::shared_ptr<waRT::ObjectBase>> &objectList, int numThreads);
+        void Refit(const std::vector<std::shared_ptr<waRT::ObjectBase>> &objectList);
+        // hash of everything Build() takes from the list: which block each object goes to, its transform and color
+        std::string GetStamp(const std::vector<std::shared_ptr<waRT::ObjectBase>> &objectList);
+        // the compact blocks and trees as a relocatable file, tagged with the stamp of the list they were built from
+        bool Save(const std::string &fileName, const std::string &stamp);
+        // maps a file from Save() in place of Build(); fails if it is missing, damaged or has another stamp
+        bool Load(const std::string &fileName, const std::string &stamp, const std::vector<std::shared_ptr<waRT::ObjectBase>> &objectList);
+        bool ClosestHit(const waRT::Ray &castRay, waRT::PrimitiveHit &hit);
+        size_t GetNumPrimitives();
+        size_t GetNumFallbackObjects();
+        size_t GetNumBVHNodes();
+        void SetCompactStorage(bool enable);
+        bool IsCompactStorage();
+        bool IsMapped();
+        size_t GetMemoryBytes();
+        size_t GetMappedBytes();
+        size_t GetBVHMemoryBytes();
+
+    private:
+        template <class Shape, class Real>
+        void TestBlock(const PrimitiveBlock &block, const Real *const *bck, const double *origin, const double *dir, const double *invDir, waRT::PrimitiveHit &hit, int &bestBlock, size_t &bestIndex, int blockNumber);
+        void ClearBlocks();
+        void UpdateFallbackBounds();
+        void CopyObject(waRT::ObjectBase &object, PrimitiveBlock &block, size_t slot);
+        void ResizeBlock(PrimitiveBlock &block, size_t count);
+
+    private:
+        std::tuple<std::pair<Shapes, PrimitiveBlock>...> m_blocks;
+        std::vector<std::shared_ptr<waRT::ObjectBase>> m_fallbackObjects;
+        std::vector<int> m_fallbackIndices;
+        std::vector<waRT::AABB> m_fallbackBounds;
+        bool m_compact = false;
+        std::shared_ptr<waRT::MappedFile> m_mapping;
+    };
+
+    using PrimitiveSet = PrimitiveSetT<SphereShape, PlaneShape>;
+}
+
+#endif
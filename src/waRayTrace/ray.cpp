@@ -20,11 +20,18 @@
          - `GetPoint2() const`: Returns the direction endpoint of the ray (`m_point2`).
        These methods are useful when other components of the ray tracing engine, such as intersection tests, need to retrieve the ray's defining points.
 
-    4. **Usage in Ray Tracing**:
+    4. **Ray Differentials**:
+       - A ray can carry two offset rays, given by an origin and a direction each (`m_rxPoint1`/`m_rxLab` and `m_ryPoint1`/`m_ryLab`). They are the rays through the neighbouring pixel to the right and below. Together with the main ray they describe how much of the scene one pixel covers, which is used to pick the right level of detail when sampling textures.
+       - `m_hasDifferentials` is `false` by default. Camera rays get differentials from `Camera::GenerateRay()` when asked, and `GTform::Apply()` carries them along whenever a ray is transformed.
+
+    5. **Time**:
+       - `m_time` is when the ray was sent, for motion blur. Moving objects are at their start transform at time 0 and at their end transform at time 1 (see `ObjectBase::GetTransformAt()`). The camera picks the time within its shutter interval, and it is `0` by default, so static scenes never look at it.
+
+    6. **Usage in Ray Tracing**:
        - Rays are cast from the camera through each pixel on the image plane and are traced through the scene to detect intersections with objects. When an intersection is found, the ray's direction and origin are used to calculate the position of the hit point, surface normals, and shading effects based on the light sources.
        - In addition to casting rays from the camera, rays can also be traced from light sources to determine shadows or reflective rays for handling specular effects.
 
-    5. **Summary**:
+    7. **Summary**:
        - The `Ray` class is a fundamental building block of the ray tracing engine. It represents a directed line in 3D space with an origin and a direction endpoint.
        - The class provides essential operations such as constructing a ray from two points and retrieving the ray's defining points via getter methods.
        - The direction vector (`m_lab`) computed in both constructors is crucial for determining how the ray interacts with objects, which is key to implementing the core ray tracing algorithm.
@@ -14,6 +14,16 @@ namespace waRT {
         qbVector<double> m_point1{3};
         qbVector<double> m_point2{3};
         qbVector<double> m_lab{3};
+
+        // point in the shutter interval, 0 is the start transform of moving objects and 1 the end
+        double m_time = 0.0;
+
+        // offset rays one pixel to the right (x) and one pixel down (y)
+        bool m_hasDifferentials = false;
+        qbVector<double> m_rxPoint1{3};
+        qbVector<double> m_rxLab{3};
+        qbVector<double> m_ryPoint1{3};
+        qbVector<double> m_ryLab{3};
     };
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,240 @@
+/*
+    The `RenderCache` class is a content-addressed, on-disk cache of finished renders. Pipelines often submit the exact same job more than once (retries, unchanged shots in a sequence), and with the cache such a job only costs a hash and a file read instead of a full `Scene::Render`.
+
+    1. **Keys and Hashing (`HashKey`)**:
+       - The key is a text description of everything that affects the pixels: the serialized scene (camera, objects, lights), the render settings (image size) and the engine version (`ENGINE_VERSION`). It is built by `Scene::GetCacheKey()`.
+       - The key is hashed with two independent 64-bit FNV-1a hashes, giving a 128-bit name that is used as the file name (`<hash>.warc`). The hash and key length are also stored in the file header, and the key itself follows the header, so a load only accepts an entry whose key matches byte for byte. A hash collision then reads as a miss instead of someone else's image.
+
+    2. **Lookup (`Lookup`)**:
+       - Reads the entry for the key, checks the header and the stored key against the key and the image size, and copies the linear pixels straight into the output image. On a hit the entry becomes the most recently used one.
+       - Returns `false` if the entry is missing or does not match, in which case the caller renders as normal.
+
+    3. **Store (`Store`)**:
+       - Writes the linear HDR pixels of the image to a temporary file and renames it into place, so other processes sharing the directory never see a half-written entry.
+       - Afterwards `Evict()` enforces the size cap.
+
+    4. **LRU Eviction (`Evict`)**:
+       - The cache keeps an in-memory list of entries with their size and a use counter. The directory is scanned once at construction, ordering existing entries by modification time.
+       - When the total size exceeds `m_maxBytes`, the least recently used entries are deleted until it fits again.
+
+    5. **Thread Safety**:
+       - All bookkeeping is protected by `m_mutex`, so one cache can be shared by several scenes rendering at the same time.
+*/
+
+#include "rendercache.hpp"
+#include "mappedfile.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+constexpr uint32_t CACHE_MAGIC   = 0x43524157; // "WARC"
+// 2: the full key is stored after the header
+constexpr uint32_t CACHE_VERSION = 2;
+
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t hashLo;
+    uint64_t hashHi;
+    uint64_t keyLength;
+    int32_t  xSize;
+    int32_t  ySize;
+};
+
+static uint64_t Fnv1a(const std::string &data, uint64_t seed) {
+    uint64_t hash = seed;
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static void HashParts(const std::string &key, uint64_t &hashLo, uint64_t &hashHi) {
+    hashLo = Fnv1a(key, 0xcbf29ce484222325ull);
+    hashHi = Fnv1a(key, 0x84222325cbf29ce4ull ^ key.size());
+}
+
+waRT::RenderCache::RenderCache(const std::string &cacheDir, uint64_t maxBytes) {
+    m_cacheDir   = cacheDir;
+    m_maxBytes   = maxBytes;
+    m_totalBytes = 0;
+    m_useCounter = 0;
+    m_hits       = 0;
+    m_misses     = 0;
+    std::error_code error;
+    std::filesystem::create_directories(m_cacheDir, error);
+    ScanDirectory();
+}
+
+std::string waRT::RenderCache::HashKey(const std::string &key) {
+    uint64_t hashLo, hashHi;
+    HashParts(key, hashLo, hashHi);
+    char name[33];
+    snprintf(name, sizeof(name), "%016llx%016llx", static_cast<unsigned long long>(hashHi), static_cast<unsigned long long>(hashLo));
+    return std::string(name);
+}
+
+bool waRT::RenderCache::Lookup(const std::string &key, waImage &outputImage) {
+    std::string name = HashKey(key);
+    int xSize = outputImage.GetXSize();
+    int ySize = outputImage.GetYSize();
+
+    FILE *inFile = fopen(EntryPath(name).c_str(), "rb");
+    bool found = false;
+    if (inFile != NULL) {
+        CacheHeader header;
+        uint64_t hashLo, hashHi;
+        HashParts(key, hashLo, hashHi);
+        if ((fread(&header, sizeof(header), 1, inFile) == 1) &&
+            (header.magic == CACHE_MAGIC) && (header.version == CACHE_VERSION) &&
+            (header.hashLo == hashLo) && (header.hashHi == hashHi) &&
+            (header.keyLength == key.size()) &&
+            (header.xSize == xSize) && (header.ySize == ySize)) {
+            std::string storedKey(key.size(), '\0');
+            found = (fread(&storedKey[0], 1, storedKey.size(), inFile) == storedKey.size()) && (storedKey == key);
+            std::vector<float> row(static_cast<size_t>(xSize) * 3);
+            for (int y = 0; (y < ySize) && found; ++y) {
+                if (fread(row.data(), sizeof(float), row.size(), inFile) != row.size()) {
+                    found = false;
+                    break;
+                }
+                for (int x = 0; x < xSize; ++x) {
+                    outputImage.SetPixel(x, y, row[x * 3], row[x * 3 + 1], row[x * 3 + 2]);
+                }
+            }
+        }
+        fclose(inFile);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (found) {
+        ++m_hits;
+        uint64_t size = sizeof(CacheHeader) + key.size() + static_cast<uint64_t>(xSize) * ySize * 3 * sizeof(float);
+        Touch(name, size);
+    } else {
+        ++m_misses;
+    }
+    return found;
+}
+
+bool waRT::RenderCache::Store(const std::string &key, waImage &inputImage) {
+    std::string name = HashKey(key);
+    int xSize = inputImage.GetXSize();
+    int ySize = inputImage.GetYSize();
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic     = CACHE_MAGIC;
+    header.version   = CACHE_VERSION;
+    HashParts(key, header.hashLo, header.hashHi);
+    header.keyLength = key.size();
+    header.xSize     = xSize;
+    header.ySize     = ySize;
+
+    // write under a unique temporary name, then rename atomically
+    std::string tempPath = waRT::TempFileName(EntryPath(name));
+    FILE *outFile = fopen(tempPath.c_str(), "wb");
+    if (outFile == NULL) {
+        return false;
+    }
+    bool writeOk = (fwrite(&header, sizeof(header), 1, outFile) == 1) &&
+                   (fwrite(key.data(), 1, key.size(), outFile) == key.size());
+    std::vector<float> row(static_cast<size_t>(xSize) * 3);
+    for (int y = 0; (y < ySize) && writeOk; ++y) {
+        for (int x = 0; x < xSize; ++x) {
+            double red, green, blue;
+            inputImage.GetPixel(x, y, red, green, blue);
+            row[x * 3 + 0] = static_cast<float>(red);
+            row[x * 3 + 1] = static_cast<float>(green);
+            row[x * 3 + 2] = static_cast<float>(blue);
+        }
+        writeOk = (fwrite(row.data(), sizeof(float), row.size(), outFile) == row.size());
+    }
+    writeOk = (fclose(outFile) == 0) && writeOk;
+
+    std::error_code error;
+    if (writeOk) {
+        std::filesystem::rename(tempPath, EntryPath(name), error);
+        writeOk = !error;
+    }
+    if (!writeOk) {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t size = sizeof(CacheHeader) + key.size() + static_cast<uint64_t>(xSize) * ySize * 3 * sizeof(float);
+    Touch(name, size);
+    Evict();
+    return true;
+}
+
+void waRT::RenderCache::SetMaxBytes(uint64_t maxBytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_maxBytes = maxBytes;
+    Evict();
+}
+
+uint64_t waRT::RenderCache::GetTotalBytes() { std::lock_guard<std::mutex> lock(m_mutex); return m_totalBytes;}
+uint64_t waRT::RenderCache::GetHits()       { std::lock_guard<std::mutex> lock(m_mutex); return m_hits;}
+uint64_t waRT::RenderCache::GetMisses()     { std::lock_guard<std::mutex> lock(m_mutex); return m_misses;}
+
+// private funks
+
+void waRT::RenderCache::ScanDirectory() {
+    std::vector<std::pair<std::filesystem::file_time_type, Entry>> found;
+    std::error_code error;
+    for (auto &dirEntry : std::filesystem::directory_iterator(m_cacheDir, error)) {
+        if (!dirEntry.is_regular_file(error) || (dirEntry.path().extension() != ".warc")) {
+            continue;
+        }
+        Entry entry;
+        entry.name    = dirEntry.path().stem().string();
+        entry.size    = dirEntry.file_size(error);
+        entry.lastUse = 0;
+        found.push_back({dirEntry.last_write_time(error), entry});
+    }
+    std::sort(found.begin(), found.end(), [](const auto &a, const auto &b) { return a.first < b.first;});
+    for (auto &item : found) {
+        item.second.lastUse = ++m_useCounter;
+        m_totalBytes += item.second.size;
+        m_entries.push_back(item.second);
+    }
+    Evict();
+}
+
+// mark an entry as most recently used (caller holds m_mutex)
+void waRT::RenderCache::Touch(const std::string &name, uint64_t size) {
+    for (auto &entry : m_entries) {
+        if (entry.name == name) {
+            m_totalBytes  = m_totalBytes - entry.size + size;
+            entry.size    = size;
+            entry.lastUse = ++m_useCounter;
+            return;
+        }
+    }
+    m_entries.push_back({name, size, ++m_useCounter});
+    m_totalBytes += size;
+}
+
+// drop least recently used entries until under the cap (caller holds m_mutex)
+void waRT::RenderCache::Evict() {
+    if (m_totalBytes <= m_maxBytes) {
+        return;
+    }
+    std::sort(m_entries.begin(), m_entries.end(), [](const Entry &a, const Entry &b) { return a.lastUse < b.lastUse;});
+    size_t numEvicted = 0;
+    while ((numEvicted < m_entries.size()) && (m_totalBytes > m_maxBytes)) {
+        std::error_code error;
+        std::filesystem::remove(EntryPath(m_entries[numEvicted].name), error);
+        m_totalBytes -= m_entries[numEvicted].size;
+        ++numEvicted;
+    }
+    m_entries.erase(m_entries.begin(), m_entries.begin() + numEvicted);
+}
+
+std::string waRT::RenderCache::EntryPath(const std::string &name) {
+    return (std::filesystem::path(m_cacheDir) / (name + ".warc")).string();
+}
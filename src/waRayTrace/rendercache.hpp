@@ -0,0 +1,49 @@
+#ifndef RENDERCACHE_H
+#define RENDERCACHE_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "waImage.hpp"
+
+namespace waRT {
+    class RenderCache {
+    public:
+        RenderCache(const std::string &cacheDir, uint64_t maxBytes);
+
+        bool Lookup(const std::string &key, waImage &outputImage);
+        bool Store(const std::string &key, waImage &inputImage);
+
+        void SetMaxBytes(uint64_t maxBytes);
+        uint64_t GetTotalBytes();
+        uint64_t GetHits();
+        uint64_t GetMisses();
+
+        static std::string HashKey(const std::string &key);
+
+    private:
+        struct Entry {
+            std::string name;
+            uint64_t    size;
+            uint64_t    lastUse;
+        };
+
+        void ScanDirectory();
+        void Touch(const std::string &name, uint64_t size);
+        void Evict();
+        std::string EntryPath(const std::string &name);
+
+    private:
+        std::string m_cacheDir;
+        uint64_t m_maxBytes;
+        uint64_t m_totalBytes;
+        uint64_t m_useCounter;
+        uint64_t m_hits;
+        uint64_t m_misses;
+        std::vector<Entry> m_entries;
+        std::mutex m_mutex;
+    };
+}
+
+#endif
@@ -0,0 +1,45 @@
+/*
+    The `RenderControl` class lets a caller watch and steer a render that is running on other threads. An optional pointer to one is passed to `Scene::Render`. `Engine::Render()` creates one per frame and forwards its tile callback and `Cancel()` to it.
+
+    1. **Progress (`GetProgress`, `GetTilesDone`, `GetTilesTotal`)**:
+       - The renderer calls `BeginFrame()` with the number of tiles and `TileDone()` after each finished tile. Progress is the fraction of tiles done, and can be read from any thread at any time.
+
+    2. **Tile Callbacks (`m_onTileDone`)**:
+       - If set, the callback is invoked with the tile rectangle as soon as the tile has been traced and tone mapped. It runs on the render thread, so it must be thread safe and quick. It is meant for streaming tiles to a viewer or a client while the frame is still rendering.
+
+    3. **Cancellation (`Cancel`, `IsCancelled`)**:
+       - `Cancel()` sets a flag that the render threads check before starting each tile. Tiles already in flight are finished, no new ones are started, and `Scene::Render` returns `false`.
+*/
+
+#include "rendercontrol.hpp"
+
+waRT::RenderControl::RenderControl() {
+    m_cancelled.store(false);
+    m_tilesDone.store(0);
+    m_tilesTotal.store(0);
+}
+
+void waRT::RenderControl::Cancel()      { m_cancelled.store(true, std::memory_order_relaxed);}
+bool waRT::RenderControl::IsCancelled() { return m_cancelled.load(std::memory_order_relaxed);}
+int  waRT::RenderControl::GetTilesDone()  { return m_tilesDone.load(std::memory_order_acquire);}
+int  waRT::RenderControl::GetTilesTotal() { return m_tilesTotal.load(std::memory_order_acquire);}
+
+double waRT::RenderControl::GetProgress() {
+    int total = GetTilesTotal();
+    if (total == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(GetTilesDone()) / static_cast<double>(total);
+}
+
+void waRT::RenderControl::BeginFrame(int numTiles) {
+    m_tilesDone.store(0, std::memory_order_release);
+    m_tilesTotal.store(numTiles, std::memory_order_release);
+}
+
+void waRT::RenderControl::TileDone(int x0, int y0, int x1, int y1) {
+    if (m_onTileDone) {
+        m_onTileDone(x0, y0, x1, y1);
+    }
+    m_tilesDone.fetch_add(1, std::memory_order_acq_rel);
+}
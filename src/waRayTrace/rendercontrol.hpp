@@ -0,0 +1,33 @@
+#ifndef RENDERCONTROL_H
+#define RENDERCONTROL_H
+
+#include <atomic>
+#include <functional>
+
+namespace waRT {
+    class RenderControl {
+    public:
+        RenderControl();
+
+        void Cancel();
+        bool IsCancelled();
+        double GetProgress();
+        int GetTilesDone();
+        int GetTilesTotal();
+
+        // called by the renderer
+        void BeginFrame(int numTiles);
+        void TileDone(int x0, int y0, int x1, int y1);
+
+    public:
+        // invoked on the render thread that finished the tile (x1 and y1 are exclusive)
+        std::function<void(int, int, int, int)> m_onTileDone;
+
+    private:
+        std::atomic<bool> m_cancelled;
+        std::atomic<int>  m_tilesDone;
+        std::atomic<int>  m_tilesTotal;
+    };
+}
+
+#endif
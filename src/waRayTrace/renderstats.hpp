@@ -0,0 +1,72 @@
+#ifndef RENDERSTATS_H
+#define RENDERSTATS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace waRT {
+    struct BuildStats {
+        double buildSeconds  = 0.0;
+        bool   refitted      = false;
+        // the primitive set was mapped from the acceleration file, or written to it after the build
+        bool   loaded        = false;
+        bool   saved         = false;
+        int    numThreads    = 0;
+        size_t numPrimitives = 0;
+        size_t numNodes      = 0;
+    };
+
+    struct MemoryReport {
+        size_t objectBytes    = 0;
+        size_t lightBytes     = 0;
+        size_t primitiveBytes = 0;
+        size_t bvhBytes       = 0;
+        size_t textureBytes   = 0;
+        size_t imageBytes     = 0;
+        size_t irradianceBytes = 0;
+        size_t replicaBytes    = 0;
+        size_t photonBytes     = 0;
+        // pages of a mapped acceleration file, shared between processes and not part of the total
+        size_t mappedBytes     = 0;
+
+        size_t TotalBytes() const { return objectBytes + lightBytes + primitiveBytes + bvhBytes + textureBytes + imageBytes + irradianceBytes + replicaBytes + photonBytes;}
+    };
+
+    // what a budgeted render achieved; errors are relative standard errors of the pixel luminance
+    struct QualityReport {
+        int    passes            = 0;
+        double meanSamples       = 0.0;
+        double meanError         = 0.0;
+        double maxError          = 0.0;
+        double convergedFraction = 0.0;
+        bool   targetReached     = false;
+        bool   budgetExhausted   = false;
+    };
+
+    struct RenderStats {
+        double   renderSeconds      = 0.0;
+        double   samplesPerSecond   = 0.0;
+        int      numThreads         = 0;
+        int      numTiles           = 0;
+        int      numaNodes          = 0;
+        int      pinnedThreads      = 0;
+        bool     allocationsCounted = false;
+        uint64_t hotPathAllocations = 0;
+        int      culledObjects      = 0;
+        int      lodObjects         = 0;
+        bool     visibilityBuffer   = false;
+        double   visibilitySeconds  = 0.0;
+        size_t   irradianceRecords  = 0;
+        uint64_t irradianceGathers  = 0;
+        uint64_t shadowRays         = 0;
+        uint64_t shadowCacheHits    = 0;
+        uint64_t shadowTests        = 0;
+        size_t   causticPhotons     = 0;
+        double   photonSeconds      = 0.0;
+        BuildStats lastBuild;
+        MemoryReport memory;
+        QualityReport quality;
+    };
+}
+
+#endif
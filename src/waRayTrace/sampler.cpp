@@ -0,0 +1,105 @@
+/*
+    The `Sampler` class provides the random numbers for stochastic sampling (antialiasing today, soft shadows and glossy materials later). Every number it returns is a pure function of the scene seed, the pixel, the sample index and the dimension. Nothing depends on which thread renders a tile, in which order tiles are taken or on which machine they run, so a frame is bit for bit the same with any thread count and tiles rendered separately can be merged.
+
+    1. **Counter-Based Random Numbers (`Hash`, `Random`)**:
+       - `Hash()` is the PCG output hash: a single 32-bit state step followed by the PCG permutation. It has no state to share or advance, so it is safe to call from any thread.
+       - `Random()` hashes the four counters together and turns the result into a double in `[0, 1)`. Use it where a dimension has no structure worth stratifying.
+
+    2. **Low Discrepancy Samples (`Sobol`)**:
+       - The first two Sobol dimensions are computed directly from the sample index (bit reversal, and the `x ^= x >> 1` generator for the second one).
+       - Each pixel and pair of dimensions gets its own hash based Owen scramble (`OwenScramble`, the Laine-Karras permutation applied in reversed bit order), and the sample index is shuffled the same way. The sequence stays stratified within a pixel, while the error between neighbouring pixels is decorrelated, which looks like fine blue noise rather than structured aliasing.
+
+    3. **Per Pixel Streams (`StartPixelSample`, `Get1D`, `Get2D`)**:
+       - `StartPixelSample()` resets the dimension counter for one sample of one pixel. `Get2D()` then returns the next pair of scrambled Sobol dimensions and `Get1D()` the next single one, so the caller just asks for numbers in a fixed order. The scene uses the first pair for the position inside the pixel.
+       - A `Sampler` is a few integers and is meant to live on the stack of each render thread.
+*/
+
+#include "sampler.hpp"
+
+constexpr double UINT32_TO_UNIT = 1.0 / 4294967296.0;
+
+waRT::Sampler::Sampler(uint32_t seed) {
+    m_seed        = seed;
+    m_pixelHash   = 0;
+    m_sampleIndex = 0;
+    m_dimension   = 0;
+}
+
+// SETTERS
+void waRT::Sampler::SetSeed(uint32_t seed) { m_seed = seed;}
+
+// GETTERS
+uint32_t waRT::Sampler::GetSeed() { return m_seed;}
+
+void waRT::Sampler::StartPixelSample(int x, int y, uint32_t sampleIndex) {
+    m_pixelHash   = Hash(m_seed, static_cast<uint32_t>(x), static_cast<uint32_t>(y), 0x9e3779b9u);
+    m_sampleIndex = sampleIndex;
+    m_dimension   = 0;
+}
+
+double waRT::Sampler::Get1D() {
+    uint32_t dimensionSeed = Hash(m_pixelHash ^ (m_dimension * 0x85ebca6bu));
+    uint32_t index = OwenScramble(m_sampleIndex, dimensionSeed);
+    m_dimension++;
+    return Sobol(index, 0, Hash(dimensionSeed + 1));
+}
+
+void waRT::Sampler::Get2D(double &u, double &v) {
+    uint32_t dimensionSeed = Hash(m_pixelHash ^ (m_dimension * 0x85ebca6bu));
+    uint32_t index = OwenScramble(m_sampleIndex, dimensionSeed);
+    m_dimension += 2;
+    u = Sobol(index, 0, Hash(dimensionSeed + 1));
+    v = Sobol(index, 1, Hash(dimensionSeed + 2));
+}
+
+uint32_t waRT::Sampler::Hash(uint32_t value) {
+    uint32_t state = value * 747796405u + 2891336453u;
+    uint32_t word  = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+uint32_t waRT::Sampler::Hash(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    return Hash(d ^ Hash(c ^ Hash(b ^ Hash(a))));
+}
+
+double waRT::Sampler::Random(uint32_t seed, uint32_t pixelIndex, uint32_t sampleIndex, uint32_t dimension) {
+    return Hash(seed, pixelIndex, sampleIndex, dimension) * UINT32_TO_UNIT;
+}
+
+double waRT::Sampler::Sobol(uint32_t sampleIndex, uint32_t dimension, uint32_t scramble) {
+    uint32_t value = 0;
+    if (dimension == 0) {
+        value = ReverseBits(sampleIndex);
+    } else {
+        for (uint32_t direction = 1u << 31; sampleIndex != 0; sampleIndex >>= 1, direction ^= direction >> 1) {
+            if (sampleIndex & 1u) {
+                value ^= direction;
+            }
+        }
+    }
+    if (scramble != 0) {
+        value = OwenScramble(value, scramble);
+    }
+    return value * UINT32_TO_UNIT;
+}
+
+// private funks
+
+uint32_t waRT::Sampler::ReverseBits(uint32_t value) {
+    value = ((value >> 1) & 0x55555555u) | ((value & 0x55555555u) << 1);
+    value = ((value >> 2) & 0x33333333u) | ((value & 0x33333333u) << 2);
+    value = ((value >> 4) & 0x0f0f0f0fu) | ((value & 0x0f0f0f0fu) << 4);
+    value = ((value >> 8) & 0x00ff00ffu) | ((value & 0x00ff00ffu) << 8);
+    return (value >> 16) | (value << 16);
+}
+
+// nested uniform scramble: a hash that only lets lower bits depend on higher ones, in reversed bit order
+uint32_t waRT::Sampler::OwenScramble(uint32_t value, uint32_t seed) {
+    value = ReverseBits(value);
+    value += seed;
+    value ^= value * 0x6c50b47cu;
+    value ^= value * 0xb82f1e52u;
+    value ^= value * 0xc7afe638u;
+    value ^= value * 0x8d22f6e6u;
+    return ReverseBits(value);
+}
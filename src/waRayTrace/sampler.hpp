@@ -0,0 +1,35 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <cstdint>
+
+namespace waRT {
+    class Sampler {
+    public:
+        Sampler(uint32_t seed = 0);
+        void SetSeed(uint32_t seed);
+        uint32_t GetSeed();
+
+        // every sample is a pure function of (seed, pixel, sample index, dimension)
+        void StartPixelSample(int x, int y, uint32_t sampleIndex);
+        double Get1D();
+        void Get2D(double &u, double &v);
+
+        static uint32_t Hash(uint32_t value);
+        static uint32_t Hash(uint32_t a, uint32_t b, uint32_t c, uint32_t d);
+        static double Random(uint32_t seed, uint32_t pixelIndex, uint32_t sampleIndex, uint32_t dimension);
+        static double Sobol(uint32_t sampleIndex, uint32_t dimension, uint32_t scramble);
+
+    private:
+        static uint32_t ReverseBits(uint32_t value);
+        static uint32_t OwenScramble(uint32_t value, uint32_t seed);
+
+    private:
+        uint32_t m_seed;
+        uint32_t m_pixelHash;
+        uint32_t m_sampleIndex;
+        uint32_t m_dimension;
+    };
+}
+
+#endif
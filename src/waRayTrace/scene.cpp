@@ -29,20 +29,113 @@
          - The number of available threads is determined using `std::thread::hardware_concurrency()`, which dynamically adjusts rendering performance based on the hardware.
 
        - **Threading and Ray Casting**:
-         - The image is divided into horizontal slices, one for each thread (`chunkSize = xSize / numThreads`). Each thread renders its assigned slice.
-         - Each thread casts rays from the camera through the image pixels in its assigned chunk using normalized coordinates (`normX`, `normY`), generated by the `m_camera.GenerateRay()` function.
+         - The image is divided into square tiles of `TILE_SIZE` pixels. Each thread repeatedly takes the next unrendered tile from a shared atomic counter (`takeItem`, one counter per NUMA node when that is enabled), so threads that finish early simply pick up more work instead of idling.
+         - Each thread casts rays from the camera through the image pixels in its tile using normalized coordinates (`normX`, `normY`). For each row of the tile it first fills a `CameraSample` per pixel and sample (screen position, lens point and shutter time from the `Sampler`) and has `m_camera.GenerateRays()` make all the rays of the row in one batch. Rays the camera cannot make (outside a fisheye circle) count as misses.
+         - The shadow rays use the camera ray's time, so motion blurred objects shadow consistently. After setting or clearing an object's motion, call `NotifyObjectsChanged()`, since moving objects are kept out of the static primitive blocks.
+
+       - **NUMA Placement (`SetNumaAware`)**:
+         - By default threads run wherever the scheduler puts them and all take tiles from one counter. On a multi-socket machine that leaves the framebuffer and the primitives in one socket's memory, and above a few dozen threads the traffic to it across the interconnect limits the frame rate.
+         - With `SetNumaAware(true)` the threads are spread evenly over the NUMA nodes (see `topology.cpp`) and each is pinned to a cpu of its node before it allocates anything. The tiles are split into one contiguous range per node, each with its own counter. A thread takes tiles from its own node's range first and only helps the other nodes once that range is used up, so the load still balances.
+         - An image set up with `waImage::SetFirstTouch(true)` arrives with its color rows unwritten. Each node's threads clear the rows of the node's band of the image first, so those pages are placed in the node's memory, and all threads wait for the clearing to finish before tracing. Any other image that still needs clearing is cleared on the calling thread.
+         - The flattened primitives and their BVHs (`PrimitiveSet`), which every camera ray reads, are copied once per node by a thread pinned to it, and each thread traces against its own node's copy. The copies are made again after a rebuild or refit, and `MemoryReport::replicaBytes` counts them. A set mapped from an acceleration file is not copied, since its pages are shared with other processes. Objects, lights and textures are shared; they are read much less.
+         - Which thread renders a pixel does not change its value, so NUMA-aware frames are identical to the default ones. `RenderStats::numaNodes` and `pinnedThreads` report the placement.
+
+       - **Regions and Crops (`RenderRegions`, `RenderCrop`)**:
+         - `RenderRegions()` traces only a list of rectangles of the frame into the full size image and leaves every other pixel as it was, for example to redo a small fix in a finished frame. `RenderCrop()` traces one rectangle of a `frameWidth` x `frameHeight` frame into an image of just that rectangle's size.
+         - Both go through the same tile loop as `Render`. The rectangles are clipped to the frame and marked in the tiles they touch, one bit per pixel in each tile row, and only those tiles are handed out. Each row is then traced in runs of marked pixels, so overlapping rectangles trace each pixel once and the cost is proportional to the pixels asked for.
+         - Every way into the tile loop (`Render`, `RenderRegions`, `RenderCrop` and the passes of `RenderProgressive`) checks once, before any thread starts, that all the pixels it will trace land inside the output image, and returns `false` otherwise. That is the only bounds check of a frame: the image's per-pixel setters only `assert` their coordinates.
+         - Camera rays, samples and shadow rays use frame coordinates throughout, so every pixel is identical to the same pixel of a full render. Only where it is stored differs. `RenderControl::TileDone()` reports frame coordinates as well.
+         - Partial frames skip the render cache and the denoiser, which need the whole frame, and do not adapt the tone mapper's exposure.
+
+       - **Budgeted Rendering (`RenderProgressive`)**:
+         - Renders in refinement passes of `samplesPerPixel` samples each, within a `RenderBudget`: a wall clock time, a target error, a pass limit, or any mix of them. Pass `p` takes samples `p * samplesPerPixel` onwards of each pixel's sequence, so a pixel refined in every pass gets the same stratified samples as a render with that many samples per pixel. The image is the running mean of the passes.
+         - The spread of a pixel's pass luminances gives its standard error, as if the passes were independent. With stratified samples the real error is lower, so the estimate errs on the safe side. Divided by the pixel's luminance (at least `PROGRESSIVE_LUMINANCE_FLOOR`), this is the pixel's relative error. The first `PROGRESSIVE_MIN_PASSES` passes cover the whole frame. The variance and luminance are pooled over the window of `PROGRESSIVE_WINDOW` pixels around each pixel, since the few samples of one pixel can agree by chance (all missing a small light, for example) and then look converged. After that, a pass only traces the pixels whose error is above the target, or above the mean error when there is no target. A light reached only by rare paths can be missed by every sample of a whole window, so a pixel is also traced while it has fewer than `PROGRESSIVE_MIN_SHARE` of the average number of passes. The pixels are handed to the region renderer as runs along each row, so the samples go where the noise is.
+         - The render stops when no pixel is above the target. It also stops before a pass that would overrun the time from the measured cost per sample. A pass that is still running at the deadline, or when `control` is cancelled, stops taking tiles. The tiles it finished still count, so no traced work is thrown away. `control` only cancels; at the end it reports the frame as one rectangle, as a cache hit does.
+         - `RenderStats::quality` reports the passes, mean samples per pixel, mean and largest error, the fraction of pixels at the target, and whether the target was reached or the budget ran out. A farm can use it to trade time against noise per shot. The frame is not bit identical between runs when the time budget is what stops it, and it has no AOVs or denoising.
+
+       - **Samples per Pixel**:
+         - With `SetSamplesPerPixel(n)` each pixel averages `n` rays spread over the pixel, which antialiases edges. The offsets come from a `Sampler` (see `sampler.cpp`) seeded with `SetSampleSeed()`, so they depend only on the seed, the pixel and the sample index. The image is therefore the same for any number of threads and any tile order, and a tile rendered elsewhere matches the one rendered here. With one sample (the default) the ray goes through the pixel corner as before, except in the passes of a progressive render, which add up to many samples.
+         - The albedo AOV is averaged over the samples like the color. Normal and depth are taken from the first sample, since averaging them across an edge gives values that belong to neither surface.
          
        - **Intersection Testing**:
          - For each ray, the function checks for intersections with all objects in `m_objectList` by calling `TestIntersection` for each object.
          - If an intersection is found, the intersection point, normal, and color are stored. If multiple objects are hit, the closest one is selected.
          
+       - **Static Dispatch**:
+         - By default (`SetStaticDispatch(true)`) the object list is flattened into a `PrimitiveSet` (see `primitives/primitiveset.cpp`), which keeps a BVH per primitive type. Camera rays then find their closest hit by traversing the BVHs with inlined, per-type leaf loops instead of one virtual call per object, and user defined object types are still handled through `TestIntersection`. Turning it off uses the plain loop over `m_objectList` described above, and both give the same image.
+
+       - **Out-of-Core Geometry**:
+         - A `PagedGeometry` object (see `primitives/pagedgeometry.cpp`) stands for a page file of spheres and planes that need not fit in memory. With static dispatch the camera rays of each row are handed to it as one batch right after they are generated. It queues them per page and brings each page in once for the whole row, and its hits are merged with the primitive set's by distance. Shadow rays test it one at a time through `TestIntersection`, like any other object.
+         - Page faults allocate, so like texture tile misses they are exempt from the allocation-free hot path.
+
+       - **Hybrid Visibility**:
+         - With `SetHybridVisibility(true)` a full frame with one sample per pixel and a closed shutter first rasterizes a `VisibilityBuffer` (see `visibilitybuffer.cpp`): the index of the closest primary object and its depth for every pixel, found by binning object bounds into screen tiles on all threads. The tile loop then intersects only that one object again for the hit point, normal and color, and ray tracing is left to the shadow rays.
+         - The buffer is made with the same rays and the same closest hit rule as the object loop, so the image matches `SetStaticDispatch(false)`. Other frames (regions, several samples, motion blur, lens or panoramic cameras) are traced as usual. `RenderStats` tells whether the buffer was used and how long it took.
+
+       - **Culling and Level of Detail**:
+         - Before each build the objects camera rays are tested against are picked for the frame's size (`UpdatePrimaryView`). With a pinhole perspective camera, objects whose bounding box lies entirely outside the view frustum (widened by a pixel) are left out, which never changes the image. `SetViewCulling(false)` turns this off.
+         - An object with levels of detail (`ObjectBase::AddLOD()`) is measured by the angle its bounding sphere covers, in pixels. Below a level's size its proxy is traced instead, and below `SetMinPixels()` it is dropped. Hits on a proxy are shaded as the original object, but without its texture. The primitive set is rebuilt only when the selection changes.
+         - Shadow rays still test every object at full detail. `RenderStats` counts the culled and the swapped objects of the last frame.
+
        - **Illumination Calculation**:
-         - Once an intersection is detected, the function calculates the lighting using the lights in `m_lightList`. The `ComputeIllumination()` method determines the color and intensity of the light reaching the intersection point based on the surface normal, light direction, and other objects that may obstruct the light (shadows).
+         - Once an intersection is detected, the function calculates the lighting using the lights in `m_lightList`. The `ComputeIllumination()` method determines the color and intensity of the light reaching the intersection point based on the surface normal, light direction, and other objects that may obstruct the light (shadows). The hit object itself is passed as `currentObject` and skipped by the shadow test, so a surface never shadows itself because of rounding in its hit point.
          - The final color for the pixel is calculated based on the closest object's color and the intensity of light hitting it.
+         - Each render thread remembers the last occluder of every point light and tests it first (see `lights/pointlight.cpp`). At the end of its tiles a thread flushes its shadow counts into the lights, and `RenderStats` reports the frame's shadow rays, how many the remembered occluder stopped, and the intersection tests they took.
+         - If the closest object has a texture, its color comes from the texture instead. Only then is the ray generated again with differentials (offset rays one pixel over in x and y), and `GetTextureFootprint()` turns them into the UV footprint that picks the mip level. Tiles are streamed through the shared `TextureCache`, so a tile miss is the one place the hot path may still allocate.
          - If no intersection occurs, the pixel is set to black (`0.0, 0.0, 0.0`).
+         - The values written with `SetPixel()` are linear and unbounded. As soon as a tile is finished, `ResolveTile()` tone maps it for display on the same thread, and `EndFrame()` lets the tone mapper adapt its exposure after all tiles are done.
+
+       - **Indirect Light**:
+         - With `SetIndirectSamples(n)` every camera hit also gets diffuse light bounced off other surfaces. `n` cosine weighted rays leave the side of the surface the camera sees, each is lit by the direct light where it lands, and their average times the surface color is added to the pixel. Directions come from a Sobol pattern scrambled per pixel and sample. 0 (the default) leaves it off.
+         - Gathering at every pixel would cost `n` rays and their shadow rays per pixel, so by default the result is shared through an `IrradianceCache` (see `irradiancecache.cpp`) that the render threads search and extend without a lock. A hit first interpolates nearby records, and only gathers (and inserts a record) where none is close enough. `GetIrradianceCache().SetAccuracy()` trades quality for speed, and `SetIrradianceCaching(false)` gathers at every hit, which gives the reference image.
+         - The cache is cleared at the start of every frame. Which points gather depends on the order threads reach them, so with the cache the image varies very slightly with the thread count. `RenderStats` counts the gathers and the records of the last frame.
+
+       - **Path Tracing**:
+         - `SetIntegrator(INTEGRATOR_PATH)` replaces the shading of every camera hit with a path traced estimate of all the light arriving there (`TracePath`), for surfaces that are diffuse with their color as albedo. The camera, objects and lights are used through their usual interfaces: `GenerateRays`, `TestIntersection` and `ComputeIllumination`.
+         - Surfaces with `m_reflectivity` or `m_transparency` (see `primitives/objectbase.cpp`) pick at each vertex between a mirror bounce, a refraction through the object and a diffuse one, each with its own share, and only the diffuse choice gathers light. A bounce off a mirror or through glass has no pdf to weigh, so emission it finds counts in full.
+         - At every vertex, next event estimation adds the direct light: each light's `ComputeIllumination()` (point lights are only reachable this way), and a direction sampled towards each emissive object (`ObjectBase::m_emission`), uniformly in the cone around its bounding sphere. Then the path bounces in a cosine weighted direction. An emissive object found by the bounce and one found by the cone sample are the same light counted twice, so both are weighted with the power heuristic (multiple importance sampling).
+         - After `PATH_ROULETTE_DEPTH` bounces, Russian roulette ends the path with a probability that grows as its throughput falls, and divides the survivors by the survival probability, which keeps the estimate unbiased. `SetMaxPathDepth()` caps the length. A depth of 1 is direct light only, the same as the default shading.
+         - Paths take their random numbers from a second `Sampler` stream of the same seed, pixel and sample, so path traced frames are also the same for any thread count. Textures only apply at the camera hit, and the irradiance cache is not used.
+         - `RenderStats::samplesPerSecond` gives the throughput of the frame, and `waImage::ComputeRMSE()` measures the noise left against a converged reference.
+
+       - **Caustics (`SetCausticPhotons`)**:
+         - Light from a point light that reaches a diffuse surface through mirrors or glass cannot be found from the camera side at all: a path would have to leave the surface in the one direction that leads to the light. With `SetCausticPhotons(n)` every frame first sends `n` photons from the lights (`LightBase::GetPhotonSource()`), shared equally between them, and keeps the ones that reach a diffuse surface after at least one specular one in a `PhotonMap` (see `photonmap.cpp`). Both integrators then add the irradiance estimated from the nearest photons at each diffuse hit, times the albedo over pi. 0 (the default) leaves it off.
+         - Photons are only aimed at the bounding spheres of specular objects, with each photon's power divided by the density of its direction over all their cones. Which lobe a photon takes at a surface is picked like a path's. The photons are split over the render threads in consecutive ranges, each thread fills its own buffer, and the buffers are joined in order and balanced into the tree in parallel. Photon `i` takes its random numbers from its index and the pass, so the map is the same for any thread count.
+         - Lights here neither fall off with distance nor with the cosine, so a stored photon's power is scaled to the light's own model (see `TracePhoton`), and light that passes unbent glass looks just like the direct light it replaces.
+         - `SetCausticGather()` sets the photons per estimate (`PHOTON_DEFAULT_NEAREST`) and the largest radius they are gathered from, by default 1/`PHOTON_RADIUS_SHARE` of the scene's diagonal. Fewer photons or a wider radius blur the caustic, more photons sharpen it. Progressive passes send a new set each, so their average converges.
+         - `RenderStats` reports the photons stored and the time the pass took, and `MemoryReport::photonBytes` the size of the map.
 
        - **Thread Management**:
-         - The rendering tasks are distributed among multiple threads. Each thread processes a chunk of the image, and the main thread waits for all worker threads to finish using `t.join()`.
+         - The rendering tasks are distributed among multiple threads. Each thread processes tiles of the image, and the main thread waits for all worker threads to finish using `t.join()`.
+
+       - **Render Cache**:
+         - If a `RenderCache` has been attached with `SetRenderCache()`, `Render` first builds the cache key with `GetCacheKey()` (engine version, image size, samples per pixel and seed, and the output of `Serialize()`, which writes the camera, every object and every light). On a hit the stored linear image is copied into `outputImage` and no rays are traced at all. On a miss the frame is rendered as usual and stored afterwards.
+
+       - **Memory and Statistics**:
+         - The per-pixel loop works on vectors that are created once per thread and updated in place, and the camera, transforms, primitives and lights all write into existing vectors. Each thread calls every object and light once before its first tile so their thread-local scratch exists, and from then on the hot path makes no heap allocations.
+         - Each render thread's `MemArena` (see `memarena.cpp`) is reset at the start of every tile and holds that tile's camera samples. The calling thread's arena is reset once per frame and holds the frame's region tile tables (`ArenaAllocator`). The first tile's allocation sizes its block, so later tiles reuse the same memory, and the count of heap allocations below includes them.
+         - `GetRenderStats()` returns the `RenderStats` of the last frame: wall-clock time, thread and tile counts and, when built with `-DWART_COUNT_ALLOCS`, the number of heap allocations made while tracing tiles.
+         - `GetMemoryReport()` breaks the resident size of the scene down into objects, lights, flattened primitives, BVH nodes and cached texture tiles. A traced frame stores it in `RenderStats::memory`, together with the size of the output image.
+         - `SetCompactStorage(true)` makes the `PrimitiveSet` keep float transforms, half float colors and float BVH nodes, roughly a quarter of the full size, at the cost of float rounding in hit points (see `primitives/primitiveset.cpp`). It is part of the cache key, and switching it rebuilds the set.
+
+       - **Feature Buffers and Denoising**:
+         - If the output image has AOVs enabled (`waImage::EnableAOVs()`), every pixel also gets the albedo, world normal and distance of its closest hit, which the renderer has at hand anyway. Such frames skip the render cache, because the cache only stores color.
+         - If a `Denoiser` has been attached with `SetDenoiser()`, it filters every finished frame that has AOVs (see `denoiser.cpp`). The tiles shown while rendering are the raw ones. After denoising the whole frame is resolved again before `EndFrame()`.
+
+       - **Control and Resident State**:
+         - An optional `RenderControl` reports progress per tile, can call back as each tile completes and can cancel the frame, in which case `Render` returns `false` and nothing is stored in the cache.
+         - `SetNumThreads()` limits the number of render threads (0 uses every core), which lets several renders share a machine.
+         - `GetCamera()`, `GetObjectList()` and `GetLightList()` give access to the scene for edits.
+
+       - **Build Phase (`Scene::Build`)**:
+         - The acceleration structure is built in its own phase, which `Render` runs first if needed and which can also be called up front to have a large scene ready before the first frame. It uses the same number of threads as rendering (see `bvh.cpp` for the parallel builder).
+         - After `NotifyObjectsChanged()` (objects added, removed or replaced) the `PrimitiveSet` and its BVHs are rebuilt. After `NotifyTransformsChanged()` (the same objects moved or recolored, e.g. for animation) the BVHs are only refitted, which is much cheaper. If neither was called the resident structure is reused as is.
+         - The cost of the last build or refit is reported in `RenderStats::lastBuild`.
+
+       - **Acceleration Files (`SetAccelerationFile`)**:
+         - For a large static scene the build can be done once and reused by every process that renders it. With an acceleration file set, a rebuild first tries to map the file (see `PrimitiveSet::Load`). Only if that fails does it build, and it then writes the result to the file for the next process (`PrimitiveSet::Save`). `RenderStats::lastBuild` tells which of the two happened.
+         - The file is tagged with a hash of the objects it was built from (`PrimitiveSet::GetStamp`). A file from another scene, from edited objects or from another view's culled object list is therefore never used; it is rebuilt and replaced. With view culling on, the file matches one view, so static renders of a large scene usually turn it off.
+         - The file holds the compact layout, so setting one turns on `SetCompactStorage(true)`, and turning compact storage off again leaves the file unused. A mapped set cannot be refitted, so `NotifyTransformsChanged()` rebuilds it, which also writes a new file. `MemoryReport::mappedBytes` reports the file's size separately from the total, since its pages are shared with every process that maps it.
 
     3. **Multi-threading**:
        - Multi-threading significantly improves performance, especially for large images, by distributing the rendering workload across available CPU cores. Each thread is responsible for rendering a portion of the image, reducing the overall rendering time.
@@ -52,14 +145,47 @@
 
     5. **Summary**:
        - The `Scene` class handles the setup of objects, lights, and the camera. It also manages the rendering process by casting rays from the camera, testing intersections, calculating lighting, and rendering the final image in a multi-threaded environment.
-       - Multi-threading is used to accelerate the rendering, dividing the image into chunks processed by separate threads.
+       - Multi-threading is used to accelerate the rendering, dividing the image into tiles processed by separate threads.
        - The class is fundamental to the ray tracing engine, as it brings together all elements and manages their interaction during the rendering process.
 */
 
 #include "scene.hpp"
+#include "version.hpp"
+#include "allocstats.hpp"
+#include "memarena.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <sstream>
 #include <thread>
 #include <vector>
 
+// irradiance cache cells along the scene's diagonal
+constexpr double IRRADIANCE_CELLS_ACROSS = 64.0;
+// full frame passes before any pixel has an error estimate
+constexpr int    PROGRESSIVE_MIN_PASSES      = 4;
+// every pixel keeps at least this share of the average number of passes
+constexpr double PROGRESSIVE_MIN_SHARE       = 0.5;
+// radius of the window a pixel's error estimate is pooled over
+constexpr int    PROGRESSIVE_WINDOW          = 2;
+// luminance below which errors are taken relative to this instead, so black pixels do not look noisy
+constexpr double PROGRESSIVE_LUMINANCE_FLOOR = 0.01;
+// image rows a thread clears at a time when the image is left for first touch
+constexpr int FIRST_TOUCH_ROWS = 4;
+// separates the path sampler's stream from the camera's
+constexpr uint32_t PATH_SEED_SALT = 0x5bd1e995u;
+// and the photons' stream from both
+constexpr uint32_t PHOTON_SEED_SALT = 0x27d4eb2fu;
+// surfaces a photon may visit before it is given up
+constexpr int    PHOTON_MAX_BOUNCES   = 8;
+// the default largest caustic gather radius is the scene's diagonal over this
+constexpr double PHOTON_RADIUS_SHARE  = 50.0;
+// reflections inside a refracting object before the ray is taken as trapped
+constexpr int    REFRACT_MAX_INTERNAL = 4;
+
 waRT::Scene::Scene() {
     // test stuff
 	m_camera.SetPosition(qbVector<double>{std::vector<double> {0.0, -10.0, -2.0}});
@@ -114,85 +240,1821 @@ waRT::Scene::Scene() {
 	m_lightList.at(2) -> m_color    = qbVector<double> {std::vector<double> {0.0, 1.0, 0.0}};
 }
 
-bool waRT::Scene::Render(waImage &outputImage) {
+void waRT::Scene::SetRenderCache(const std::shared_ptr<waRT::RenderCache> &renderCache) {
+    m_renderCache = renderCache;
+}
+
+void waRT::Scene::Serialize(std::ostream &out) {
+    m_camera.Serialize(out);
+    for (auto currentObject : m_objectList) {
+        currentObject->Serialize(out);
+    }
+    for (auto currentLight : m_lightList) {
+        currentLight->Serialize(out);
+    }
+}
+
+void waRT::Scene::SetDenoiser(const std::shared_ptr<waRT::Denoiser> &denoiser) {
+    m_denoiser = denoiser;
+}
+
+void waRT::Scene::SetStaticDispatch(bool enable) {
+    m_staticDispatch = enable;
+}
+
+// 0 means one thread per hardware core
+void waRT::Scene::SetNumThreads(int numThreads) {
+    m_numThreads = std::max(0, numThreads);
+}
+
+// samples are jittered deterministically, see sampler.cpp
+void waRT::Scene::SetSamplesPerPixel(int samplesPerPixel) {
+    m_samplesPerPixel = std::max(1, samplesPerPixel);
+}
+
+void waRT::Scene::SetSampleSeed(uint32_t seed) {
+    m_sampleSeed = seed;
+}
+
+int waRT::Scene::GetSamplesPerPixel() { return m_samplesPerPixel;}
+uint32_t waRT::Scene::GetSampleSeed() { return m_sampleSeed;}
+
+// switches the primitive set between full and compact storage, rebuilt at the next Build()
+void waRT::Scene::SetCompactStorage(bool enable) {
+    if (enable != m_primitiveSet.IsCompactStorage()) {
+        m_primitiveSet.SetCompactStorage(enable);
+        m_objectsChanged = true;
+    }
+}
+
+bool waRT::Scene::IsCompactStorage() { return m_primitiveSet.IsCompactStorage();}
+
+// the file holds the compact layout, so naming one switches to compact storage; an empty name stops using it
+void waRT::Scene::SetAccelerationFile(const std::string &fileName) {
+    if (fileName != m_accelerationFile) {
+        m_accelerationFile = fileName;
+        m_objectsChanged   = true;
+    }
+    if (!fileName.empty()) {
+        SetCompactStorage(true);
+    }
+}
+
+std::string waRT::Scene::GetAccelerationFile() { return m_accelerationFile;}
+
+// call after adding, removing or replacing objects so derived structures are rebuilt
+void waRT::Scene::NotifyObjectsChanged() {
+    m_objectsChanged = true;
+}
+
+// call after changing the transforms or colors of existing objects, the BVHs are refitted
+void waRT::Scene::NotifyTransformsChanged() {
+    m_transformsChanged = true;
+}
+
+void waRT::Scene::Build() {
+    UpdatePrimaryView();
+    if (!m_staticDispatch || (!m_objectsChanged && !m_transformsChanged)) {
+        return;
+    }
+    auto startTime = std::chrono::steady_clock::now();
+    int numThreads = (m_numThreads > 0) ? m_numThreads : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    m_buildStats = waRT::BuildStats();
+    m_buildStats.numThreads = numThreads;
+    // a mapped set is read-only, so moved objects rebuild it too
+    if (m_objectsChanged || m_primitiveSet.IsMapped()) {
+        bool useFile = !m_accelerationFile.empty() && m_primitiveSet.IsCompactStorage();
+        std::string stamp = useFile ? m_primitiveSet.GetStamp(m_primaryObjects) : std::string();
+        m_buildStats.loaded = useFile && m_primitiveSet.Load(m_accelerationFile, stamp, m_primaryObjects);
+        if (!m_buildStats.loaded) {
+            m_primitiveSet.Build(m_primaryObjects, numThreads);
+            m_buildStats.saved = useFile && m_primitiveSet.Save(m_accelerationFile, stamp);
+        }
+        m_pagedGeometry.clear();
+        for (const auto &object : m_primaryObjects) {
+            auto paged = std::dynamic_pointer_cast<waRT::PagedGeometry>(object);
+            if (paged) {
+                m_pagedGeometry.push_back(paged);
+            }
+        }
+    } else {
+        m_primitiveSet.Refit(m_primaryObjects);
+        m_buildStats.refitted = true;
+    }
+    m_objectsChanged    = false;
+    m_transformsChanged = false;
+    m_replicasValid     = false;
+
+    m_buildStats.numPrimitives = m_primitiveSet.GetNumPrimitives();
+    m_buildStats.numNodes      = m_primitiveSet.GetNumBVHNodes();
+    m_buildStats.buildSeconds  = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+// any two unit directions perpendicular to the unit vector n and to each other
+static void OrthonormalBasis(const double *n, double *tangent, double *bitangent) {
+    if (fabs(n[0]) > 0.9) {
+        tangent[0] = n[2]; tangent[1] = 0.0;   tangent[2] = -n[0];
+    } else {
+        tangent[0] = 0.0;  tangent[1] = -n[2]; tangent[2] = n[1];
+    }
+    double length = sqrt(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+    for (int i = 0; i < 3; ++i) {
+        tangent[i] /= length;
+    }
+    bitangent[0] = n[1] * tangent[2] - n[2] * tangent[1];
+    bitangent[1] = n[2] * tangent[0] - n[0] * tangent[2];
+    bitangent[2] = n[0] * tangent[1] - n[1] * tangent[0];
+}
+
+// maps (u, v) in [0, 1)^2 to the hemisphere around n with density cos / pi
+static void CosineDirection(const double *n, const double *tangent, const double *bitangent, double u, double v, double *direction) {
+    double r   = sqrt(u);
+    double phi = 2.0 * M_PI * v;
+    double x = r * cos(phi);
+    double y = r * sin(phi);
+    double z = sqrt(std::max(0.0, 1.0 - u));
+    for (int i = 0; i < 3; ++i) {
+        direction[i] = tangent[i] * x + bitangent[i] * y + n[i] * z;
+    }
+}
+
+static void SetRay(waRT::Ray &ray, const qbVector<double> &origin, const double *direction, double time) {
+    for (int i = 0; i < 3; ++i) {
+        ray.m_point1.SetElement(i, origin.GetElement(i));
+        ray.m_point2.SetElement(i, origin.GetElement(i) + direction[i]);
+        ray.m_lab.SetElement(i, direction[i]);
+    }
+    ray.m_time = time;
+    ray.m_hasDifferentials = false;
+}
+
+// turns the normal against the direction the ray arrived in
+static void FaceForward(qbVector<double> &normal, const double *incoming) {
+    double facing = 0.0;
+    for (int i = 0; i < 3; ++i) {
+        facing += normal.GetElement(i) * incoming[i];
+    }
+    if (facing > 0.0) {
+        for (int i = 0; i < 3; ++i) {
+            normal.SetElement(i, -normal.GetElement(i));
+        }
+    }
+}
+
+// mirrors the unit direction about the normal
+static void Reflect(const double *direction, const double *normal, double *reflected) {
+    double along = direction[0] * normal[0] + direction[1] * normal[1] + direction[2] * normal[2];
+    for (int i = 0; i < 3; ++i) {
+        reflected[i] = direction[i] - 2.0 * along * normal[i];
+    }
+}
+
+// Snell's law for a unit direction and a unit normal facing against it, eta being the ratio of the indices; false on total internal reflection
+static bool Refract(const double *direction, const double *normal, double eta, double *refracted) {
+    double cosIn = -(direction[0] * normal[0] + direction[1] * normal[1] + direction[2] * normal[2]);
+    double k = 1.0 - eta * eta * (1.0 - cosIn * cosIn);
+    if (k < 0.0) {
+        return false;
+    }
+    double along = eta * cosIn - sqrt(k);
+    for (int i = 0; i < 3; ++i) {
+        refracted[i] = eta * direction[i] + along * normal[i];
+    }
+    return true;
+}
+
+// takes a ray that hits object at point through it as a convex solid; on return point and direction are where and how it leaves.
+// The way out is the last surface along the ray, which a ray sent back from beyond the object's bounds finds first.
+static bool RefractThrough(const std::shared_ptr<waRT::ObjectBase> &object, double time, qbVector<double> &point, qbVector<double> &normal, double *direction) {
+    thread_local waRT::Ray backRay;
+    thread_local qbVector<double> exitPoint  {3};
+    thread_local qbVector<double> exitNormal {3};
+    thread_local qbVector<double> exitColor  {3};
+
+    double n[3];
+    double facing = 0.0;
+    for (int i = 0; i < 3; ++i) {
+        n[i] = normal.GetElement(i);
+        facing += n[i] * direction[i];
+    }
+    double sign = (facing > 0.0) ? -1.0 : 1.0;
+    for (int i = 0; i < 3; ++i) {
+        n[i] *= sign;
+    }
+    double inside[3];
+    if (!Refract(direction, n, 1.0 / object->m_refractiveIndex, inside)) {
+        Reflect(direction, n, direction);
+        return true;
+    }
+    waRT::AABB box;
+    bool bounded = object->GetBoundingBox(box);
+    for (int bounce = 0; bounce < REFRACT_MAX_INTERNAL; ++bounce) {
+        // far enough along the ray to be outside the bounds
+        double reach = 0.0;
+        for (int i = 0; i < 3; ++i) {
+            double span = bounded ? std::max(fabs(box.boxMax[i] - point.GetElement(i)), fabs(box.boxMin[i] - point.GetElement(i))) : 0.0;
+            reach += span * span;
+        }
+        reach = 2.0 * sqrt(reach) + 1e-6;
+        for (int i = 0; i < 3; ++i) {
+            backRay.m_point1.SetElement(i, point.GetElement(i) + inside[i] * reach);
+            backRay.m_point2.SetElement(i, point.GetElement(i));
+            backRay.m_lab.SetElement(i, -inside[i]);
+        }
+        backRay.m_time = time;
+        backRay.m_hasDifferentials = false;
+        // a ray that finds no way out (a thin surface, or a graze) leaves where it came in
+        if (bounded && object->TestIntersection(backRay, exitPoint, exitNormal, exitColor)) {
+            point  = exitPoint;
+            normal = exitNormal;
+        }
+        facing = 0.0;
+        for (int i = 0; i < 3; ++i) {
+            n[i] = normal.GetElement(i);
+            facing += n[i] * inside[i];
+        }
+        sign = (facing > 0.0) ? -1.0 : 1.0;
+        for (int i = 0; i < 3; ++i) {
+            n[i] *= sign;
+        }
+        if (Refract(inside, n, object->m_refractiveIndex, direction)) {
+            return true;
+        }
+        Reflect(inside, n, inside);
+    }
+    return false;
+}
+
+// mean of each pixel's (2 * radius + 1)^2 window, clipped at the edges, as a row pass and then a column pass
+static void BoxMean(const std::vector<double> &values, int xSize, int ySize, int radius, std::vector<double> &scratch, std::vector<double> &means) {
+    for (int y = 0; y < ySize; ++y) {
+        for (int x = 0; x < xSize; ++x) {
+            double sum = 0.0;
+            int x0 = std::max(0, x - radius), x1 = std::min(xSize - 1, x + radius);
+            for (int k = x0; k <= x1; ++k) {
+                sum += values[static_cast<size_t>(y) * xSize + k];
+            }
+            scratch[static_cast<size_t>(y) * xSize + x] = sum / (x1 - x0 + 1);
+        }
+    }
+    for (int y = 0; y < ySize; ++y) {
+        int y0 = std::max(0, y - radius), y1 = std::min(ySize - 1, y + radius);
+        for (int x = 0; x < xSize; ++x) {
+            double sum = 0.0;
+            for (int k = y0; k <= y1; ++k) {
+                sum += scratch[static_cast<size_t>(k) * xSize + x];
+            }
+            means[static_cast<size_t>(y) * xSize + x] = sum / (y1 - y0 + 1);
+        }
+    }
+}
+
+// conservative: the box is outside only if all of it is behind one plane
+static bool OutsideView(const waRT::AABB &box, const double planes[4][4]) {
+    for (int p = 0; p < 4; ++p) {
+        double farthest = planes[p][3];
+        for (int i = 0; i < 3; ++i) {
+            farthest += planes[p][i] * ((planes[p][i] >= 0.0) ? box.boxMax[i] : box.boxMin[i]);
+        }
+        if (farthest < 0.0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// angular size of the box's bounding sphere, in pixels
+static double ProjectedPixels(const waRT::AABB &box, const double *eye, double pixelsPerRadian) {
+    double radius   = 0.0;
+    double distance = 0.0;
+    for (int i = 0; i < 3; ++i) {
+        double halfSize = 0.5 * (box.boxMax[i] - box.boxMin[i]);
+        double offset   = box.Centroid(i) - eye[i];
+        radius   += halfSize * halfSize;
+        distance += offset * offset;
+    }
+    radius   = sqrt(radius);
+    distance = sqrt(distance);
+    if (distance <= radius) {
+        return std::numeric_limits<double>::infinity();
+    }
+    return 2.0 * asin(radius / distance) * pixelsPerRadian;
+}
+
+// picks what camera rays are tested against: objects in view, each at the level of detail for its size on screen
+void waRT::Scene::UpdatePrimaryView() {
+    std::vector<std::shared_ptr<waRT::ObjectBase>> objects;
+    std::vector<int> owners;
+    objects.reserve(m_objectList.size());
+    owners.reserve(m_objectList.size());
+
+    bool haveView = (m_viewWidth > 0) && (m_viewHeight > 0);
+    double planes[4][4];
+    // one pixel of margin, samples may lie half a pixel outside the frame
+    bool cull = haveView && m_viewCulling && m_camera.GetViewFrustum(2.0 / m_viewWidth, 2.0 / m_viewHeight, planes);
+    double pixelsPerRadian = haveView ? m_camera.GetPixelsPerRadian(m_viewWidth) : 0.0;
+    qbVector<double> position = m_camera.GetPosition();
+    double eye[3] = {position.GetElement(0), position.GetElement(1), position.GetElement(2)};
+
+    m_culledObjects = 0;
+    m_lodObjects    = 0;
+    for (size_t i = 0; i < m_objectList.size(); ++i) {
+        const auto &object = m_objectList[i];
+        waRT::AABB box;
+        bool bounded = object->GetBoundingBox(box);
+        if (bounded && cull && OutsideView(box, planes)) {
+            ++m_culledObjects;
+            continue;
+        }
+        std::shared_ptr<waRT::ObjectBase> chosen = object;
+        if (bounded && haveView && object->HasLOD()) {
+            int level = object->SelectLOD(ProjectedPixels(box, eye, pixelsPerRadian));
+            if (level < 0) {
+                ++m_culledObjects;
+                continue;
+            }
+            if (level > 0) {
+                chosen = object->GetLODProxy(level);
+                ++m_lodObjects;
+            }
+        }
+        objects.push_back(chosen);
+        owners.push_back(static_cast<int>(i));
+    }
+
+    // the primitive set is rebuilt only when the selection changes
+    if ((objects != m_primaryObjects) || (owners != m_primaryOwners)) {
+        m_primaryObjects.swap(objects);
+        m_primaryOwners.swap(owners);
+        m_objectsChanged = true;
+    }
+}
+
+void waRT::Scene::SetViewCulling(bool enable) {
+    m_viewCulling = enable;
+}
+
+bool waRT::Scene::IsViewCulling() { return m_viewCulling;}
+
+void waRT::Scene::SetHybridVisibility(bool enable) {
+    m_hybridVisibility = enable;
+    if (!enable) {
+        m_visibility.Clear();
+    }
+}
+
+bool waRT::Scene::IsHybridVisibility() { return m_hybridVisibility;}
+
+void waRT::Scene::SetIndirectSamples(int numSamples) {
+    m_indirectSamples = std::max(0, numSamples);
+}
+
+int waRT::Scene::GetIndirectSamples() { return m_indirectSamples;}
+
+void waRT::Scene::SetIrradianceCaching(bool enable) {
+    m_irradianceCaching = enable;
+}
+
+bool waRT::Scene::IsIrradianceCaching() { return m_irradianceCaching;}
+
+void waRT::Scene::SetIntegrator(waRT::Integrator integrator) {
+    m_integrator = integrator;
+}
+
+waRT::Integrator waRT::Scene::GetIntegrator() { return m_integrator;}
+
+void waRT::Scene::SetMaxPathDepth(int maxDepth) {
+    m_maxPathDepth = std::max(1, maxDepth);
+}
+
+int waRT::Scene::GetMaxPathDepth() { return m_maxPathDepth;}
+
+void waRT::Scene::SetCausticPhotons(int numPhotons) {
+    m_causticPhotons = std::max(0, numPhotons);
+    if (m_causticPhotons == 0) {
+        m_causticMap.Clear();
+    }
+}
+
+int waRT::Scene::GetCausticPhotons() { return m_causticPhotons;}
+
+void waRT::Scene::SetCausticGather(int nearest, double maxRadius) {
+    m_causticNearest = std::max(1, std::min(nearest, waRT::PHOTON_MAX_NEAREST));
+    m_causticRadius  = std::max(0.0, maxRadius);
+}
+
+waRT::PhotonMap &waRT::Scene::GetCausticMap() { return m_causticMap;}
+
+void waRT::Scene::SetNumaAware(bool enable) { m_numaAware = enable;}
+
+bool waRT::Scene::IsNumaAware() { return m_numaAware;}
+waRT::IrradianceCache &waRT::Scene::GetIrradianceCache() { return m_irradianceCache;}
+
+waRT::Camera &waRT::Scene::GetCamera() { return m_camera;}
+std::vector<std::shared_ptr<waRT::ObjectBase>> &waRT::Scene::GetObjectList() { return m_objectList;}
+std::vector<std::shared_ptr<waRT::LightBase>>  &waRT::Scene::GetLightList()  { return m_lightList;}
+
+waRT::RenderStats waRT::Scene::GetRenderStats() { return m_renderStats;}
+
+waRT::MemoryReport waRT::Scene::GetMemoryReport() {
+    waRT::MemoryReport report;
+    report.objectBytes = m_objectList.capacity() * sizeof(std::shared_ptr<waRT::ObjectBase>);
+    for (auto &object : m_objectList) {
+        report.objectBytes += object->GetMemoryBytes();
+    }
+    // each light holds a location and a color vector
+    report.lightBytes = m_lightList.capacity() * sizeof(std::shared_ptr<waRT::LightBase>)
+                      + m_lightList.size() * (sizeof(waRT::PointLight) + 6 * sizeof(double));
+    report.primitiveBytes = m_primitiveSet.GetMemoryBytes();
+    report.bvhBytes       = m_primitiveSet.GetBVHMemoryBytes();
+    report.mappedBytes    = m_primitiveSet.GetMappedBytes();
+    report.textureBytes   = waRT::TextureCache::Global().GetTotalBytes();
+    report.irradianceBytes = m_irradianceCache.GetMemoryBytes();
+    report.photonBytes     = m_causticMap.GetMemoryBytes();
+    for (auto &replica : m_nodePrimitiveSets) {
+        report.replicaBytes += replica.GetMemoryBytes() + replica.GetBVHMemoryBytes();
+    }
+    return report;
+}
+
+std::string waRT::Scene::GetCacheKey(int xSize, int ySize) {
+    std::ostringstream key;
+    key << "waRT " << waRT::ENGINE_VERSION << "\n";
+    key << "Settings " << xSize << " " << ySize << " " << m_samplesPerPixel << " " << m_sampleSeed << " " << (IsCompactStorage() ? 1 : 0)
+        << " " << m_indirectSamples << " " << (m_irradianceCaching ? 1 : 0) << " " << std::hexfloat << m_irradianceCache.GetAccuracy() << std::defaultfloat
+        << " " << static_cast<int>(m_integrator) << " " << m_maxPathDepth << "\n";
+    if (m_causticPhotons > 0) {
+        key << "Caustics " << m_causticPhotons << " " << m_causticNearest << " " << std::hexfloat << m_causticRadius << std::defaultfloat << "\n";
+    }
+    Serialize(key);
+    return key.str();
+}
+
+bool waRT::Scene::Render(waImage &outputImage, waRT::RenderControl *control) {
+    return RenderPixels(outputImage, outputImage.GetXSize(), outputImage.GetYSize(), 0, 0, nullptr, control);
+}
+
+// renders only the given rectangles of the frame into the full size image, the rest is left as it was
+bool waRT::Scene::RenderRegions(waImage &outputImage, const std::vector<waRT::RenderRegion> &regions, waRT::RenderControl *control) {
+    return RenderPixels(outputImage, outputImage.GetXSize(), outputImage.GetYSize(), 0, 0, &regions, control);
+}
+
+// renders one rectangle of a frameWidth x frameHeight frame into an image of the rectangle's size
+bool waRT::Scene::RenderCrop(waImage &cropImage, int frameWidth, int frameHeight, const waRT::RenderRegion &region, waRT::RenderControl *control) {
+    waRT::RenderRegion clipped = region.Clipped(frameWidth, frameHeight);
+    if (clipped.IsEmpty() || (cropImage.GetXSize() != clipped.GetWidth()) || (cropImage.GetYSize() != clipped.GetHeight())) {
+        return false;
+    }
+    std::vector<waRT::RenderRegion> regions {clipped};
+    return RenderPixels(cropImage, frameWidth, frameHeight, clipped.x0, clipped.y0, &regions, control);
+}
+
+// refinement passes of samplesPerPixel each, until the budget runs out, the error target is met or the caller cancels
+bool waRT::Scene::RenderProgressive(waImage &outputImage, const waRT::RenderBudget &budget, waRT::RenderControl *control) {
+    auto startTime = std::chrono::steady_clock::now();
     int xSize = outputImage.GetXSize();
     int ySize = outputImage.GetYSize();
+    size_t numPixels = static_cast<size_t>(xSize) * ySize;
+
+    waImage passImage;
+    passImage.Initialize(xSize, ySize, nullptr);
+    // per pixel: running mean color, and mean and squared deviations (Welford) of the pass luminances
+    std::vector<double>   meanColor(numPixels * 3, 0.0);
+    std::vector<double>   meanLuminance(numPixels, 0.0);
+    std::vector<double>   sumSquares(numPixels, 0.0);
+    std::vector<int>      pixelPasses(numPixels, 0);
+    std::vector<double>   pixelVariance(numPixels, 0.0);
+    std::vector<double>   windowVariance(numPixels);
+    std::vector<double>   windowLuminance(numPixels);
+    std::vector<double>   pixelError(numPixels);
+    std::vector<double>   boxScratch(numPixels);
+    std::vector<uint8_t>  selected(numPixels, 0);
+    std::vector<waRT::RenderRegion> regions;
+    std::vector<waRT::RenderRegion> doneTiles;
+    std::mutex doneMutex;
+
+    // a pixel's error pools the variance and luminance of its window, since a few samples can agree by chance
+    auto updateErrors = [&]() {
+        BoxMean(pixelVariance, xSize, ySize, PROGRESSIVE_WINDOW, boxScratch, windowVariance);
+        BoxMean(meanLuminance, xSize, ySize, PROGRESSIVE_WINDOW, boxScratch, windowLuminance);
+        for (size_t i = 0; i < numPixels; ++i) {
+            pixelError[i] = (pixelPasses[i] < 2) ? std::numeric_limits<double>::infinity()
+                          : sqrt(windowVariance[i] / pixelPasses[i]) / std::max(fabs(windowLuminance[i]), PROGRESSIVE_LUMINANCE_FLOOR);
+        }
+    };
+
+    uint64_t totalSamples = 0;
+    double secondsPerSample = 0.0;
+    bool cancelled = false;
+    bool targetReached = false;
+    bool budgetExhausted = false;
+    int pass = 0;
+    for (; pass < budget.maxPasses; ++pass) {
+        // the first passes cover the frame, later ones only the pixels still above the threshold
+        double threshold = budget.targetError;
+        if (pass >= PROGRESSIVE_MIN_PASSES) {
+            updateErrors();
+            if (threshold <= 0.0) {
+                // without a target, refine whatever is worse than the average
+                double errorSum = 0.0;
+                for (size_t i = 0; i < numPixels; ++i) {
+                    errorSum += std::isfinite(pixelError[i]) ? pixelError[i] : 0.0;
+                }
+                threshold = errorSum / static_cast<double>(numPixels);
+            }
+        }
+        // rare bright paths can hide from every estimate, so no pixel falls far behind the average
+        uint64_t passSum = 0;
+        for (size_t i = 0; i < numPixels; ++i) {
+            passSum += pixelPasses[i];
+        }
+        double minPasses = PROGRESSIVE_MIN_SHARE * static_cast<double>(passSum) / static_cast<double>(numPixels);
+        regions.clear();
+        size_t numActive = 0;
+        for (int y = 0; y < ySize; ++y) {
+            int runStart = -1;
+            for (int x = 0; x <= xSize; ++x) {
+                size_t index = static_cast<size_t>(y) * xSize + x;
+                bool active = (x < xSize) && ((pass < PROGRESSIVE_MIN_PASSES) || (pixelError[index] > threshold) ||
+                                              (pixelPasses[index] < minPasses));
+                if (x < xSize) {
+                    selected[index] = active ? 1 : 0;
+                }
+                if (active && (runStart < 0)) {
+                    runStart = x;
+                } else if (!active && (runStart >= 0)) {
+                    regions.push_back(waRT::RenderRegion{runStart, y, x, y + 1});
+                    numActive += x - runStart;
+                    runStart = -1;
+                }
+            }
+        }
+        if (numActive == 0) {
+            targetReached = true;
+            break;
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        if ((budget.seconds > 0.0) && (pass > 0) &&
+            (elapsed + secondsPerSample * static_cast<double>(numActive) * m_samplesPerPixel > budget.seconds)) {
+            budgetExhausted = true;
+            break;
+        }
+
+        // the pass stops taking tiles once the deadline or a cancel comes, the tiles it finished still count
+        waRT::RenderControl passControl;
+        doneTiles.clear();
+        passControl.m_onTileDone = [&](int x0, int y0, int x1, int y1) {
+            {
+                std::lock_guard<std::mutex> lock(doneMutex);
+                doneTiles.push_back(waRT::RenderRegion{x0, y0, x1, y1});
+            }
+            bool late = (budget.seconds > 0.0) &&
+                        (std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count() > budget.seconds);
+            if (late || ((control != nullptr) && control->IsCancelled())) {
+                passControl.Cancel();
+            }
+        };
+        // pass p takes samples p * samplesPerPixel onwards, so a pixel refined in every pass walks its sequence in order,
+        // and even one sample per pass is spread over the pixel, since the passes add up to many
+        auto passStart = std::chrono::steady_clock::now();
+        bool finished = RenderPixels(passImage, xSize, ySize, 0, 0, &regions, &passControl, static_cast<uint32_t>(pass * m_samplesPerPixel), true);
+
+        size_t numDone = 0;
+        for (const auto &tile : doneTiles) {
+            for (int y = tile.y0; y < tile.y1; ++y) {
+                for (int x = tile.x0; x < tile.x1; ++x) {
+                    size_t index = static_cast<size_t>(y) * xSize + x;
+                    if (!selected[index]) {
+                        continue;
+                    }
+                    double color[3];
+                    passImage.GetPixel(x, y, color[0], color[1], color[2]);
+                    int n = ++pixelPasses[index];
+                    for (int i = 0; i < 3; ++i) {
+                        meanColor[index * 3 + i] += (color[i] - meanColor[index * 3 + i]) / n;
+                    }
+                    double luminance = 0.2126 * color[0] + 0.7152 * color[1] + 0.0722 * color[2];
+                    double delta = luminance - meanLuminance[index];
+                    meanLuminance[index] += delta / n;
+                    sumSquares[index]    += delta * (luminance - meanLuminance[index]);
+                    pixelVariance[index]  = (n >= 2) ? sumSquares[index] / (n - 1.0) : 0.0;
+                    ++numDone;
+                }
+            }
+        }
+        totalSamples += static_cast<uint64_t>(numDone) * m_samplesPerPixel;
+        double passSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - passStart).count();
+        if (numDone > 0) {
+            secondsPerSample = passSeconds / (static_cast<double>(numDone) * m_samplesPerPixel);
+        }
+        if (!finished) {
+            cancelled = (control != nullptr) && control->IsCancelled();
+            budgetExhausted = !cancelled;
+            ++pass;
+            break;
+        }
+    }
+
+    for (int y = 0; y < ySize; ++y) {
+        for (int x = 0; x < xSize; ++x) {
+            size_t index = (static_cast<size_t>(y) * xSize + x) * 3;
+            outputImage.SetPixel(x, y, meanColor[index], meanColor[index + 1], meanColor[index + 2]);
+        }
+    }
+    outputImage.GetToneMapper().ClearHistogram();
+    outputImage.ResolveAll();
+    outputImage.EndFrame();
+    if (control != nullptr) {
+        control->BeginFrame(1);
+        control->TileDone(0, 0, xSize, ySize);
+    }
+
+    updateErrors();
+    waRT::QualityReport quality;
+    quality.passes          = pass;
+    quality.budgetExhausted = budgetExhausted || ((pass >= budget.maxPasses) && !targetReached);
+    size_t numMeasured = 0;
+    size_t numConverged = 0;
+    double errorSum = 0.0;
+    uint64_t passSum = 0;
+    for (size_t i = 0; i < numPixels; ++i) {
+        passSum += pixelPasses[i];
+        if (pixelPasses[i] < 2) {
+            continue;
+        }
+        ++numMeasured;
+        errorSum += pixelError[i];
+        quality.maxError = std::max(quality.maxError, pixelError[i]);
+        if ((budget.targetError > 0.0) && (pixelError[i] <= budget.targetError)) {
+            ++numConverged;
+        }
+    }
+    quality.meanSamples       = static_cast<double>(passSum) * m_samplesPerPixel / static_cast<double>(std::max<size_t>(1, numPixels));
+    quality.meanError         = (numMeasured > 0) ? errorSum / static_cast<double>(numMeasured) : 0.0;
+    quality.convergedFraction = static_cast<double>(numConverged) / static_cast<double>(std::max<size_t>(1, numPixels));
+    // without a target, running out of pixels to refine means every error is zero
+    quality.targetReached     = targetReached && (numMeasured == numPixels);
+
+    m_renderStats.quality          = quality;
+    m_renderStats.renderSeconds    = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    m_renderStats.samplesPerSecond = (m_renderStats.renderSeconds > 0.0) ? static_cast<double>(totalSamples) / m_renderStats.renderSeconds : 0.0;
+    m_renderStats.memory.imageBytes = outputImage.GetMemoryBytes() + passImage.GetMemoryBytes();
+    return !cancelled;
+}
+
+// frame pixel (x, y) goes to image pixel (x - offsetX, y - offsetY); without regions the whole frame is traced.
+// The samples taken are firstSample onwards of each pixel's sequence; spreadSamples spreads even a single sample over the pixel.
+bool waRT::Scene::RenderPixels(waImage &outputImage, int xSize, int ySize, int offsetX, int offsetY,
+                               const std::vector<waRT::RenderRegion> *regions, waRT::RenderControl *control, uint32_t firstSample,
+                               bool spreadSamples) {
+    auto startTime = std::chrono::steady_clock::now();
+    bool fullFrame = (regions == nullptr);
+
+    // the one bounds check of the frame: every pixel traced has to land in the image, the per-pixel writes only assert it
+    waRT::RenderRegion traced = fullFrame ? waRT::RenderRegion{0, 0, xSize, ySize} : waRT::RenderRegion{xSize, ySize, 0, 0};
+    if (!fullFrame) {
+        for (const auto &region : *regions) {
+            waRT::RenderRegion clipped = region.Clipped(xSize, ySize);
+            if (!clipped.IsEmpty()) {
+                traced = waRT::RenderRegion{std::min(traced.x0, clipped.x0), std::min(traced.y0, clipped.y0),
+                                            std::max(traced.x1, clipped.x1), std::max(traced.y1, clipped.y1)};
+            }
+        }
+    }
+    if (!traced.IsEmpty() && ((traced.x0 - offsetX < 0) || (traced.y0 - offsetY < 0) ||
+                              (traced.x1 - offsetX > outputImage.GetXSize()) || (traced.y1 - offsetY > outputImage.GetYSize()))) {
+        return false;
+    }
+    int numThreads = (m_numThreads > 0) ? m_numThreads : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    m_renderStats = waRT::RenderStats();
+    m_renderStats.numThreads = numThreads;
+    m_renderStats.allocationsCounted = waRT::AllocationCountingEnabled();
+
+    // the cache only stores color, so frames with AOVs are always traced
+    bool writeAOVs = outputImage.HasAOVs();
+    bool useCache  = fullFrame && m_renderCache && !writeAOVs;
+
+    std::string cacheKey;
+    if (useCache) {
+        cacheKey = GetCacheKey(xSize, ySize);
+        if (!outputImage.IsCleared()) {
+            outputImage.ClearRows(0, outputImage.GetYSize());
+        }
+        if (m_renderCache->Lookup(cacheKey, outputImage)) {
+            outputImage.ResolveAll();
+            outputImage.EndFrame();
+            if (control != nullptr) {
+                control->BeginFrame(1);
+                control->TileDone(0, 0, xSize, ySize);
+            }
+            m_renderStats.renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+            return true;
+        }
+    }
     
-    int numThreads = std::thread::hardware_concurrency();   
+    m_viewWidth  = xSize;
+    m_viewHeight = ySize;
+    Build();
+    m_renderStats.lastBuild     = m_buildStats;
+    m_renderStats.culledObjects = m_culledObjects;
+    m_renderStats.lodObjects    = m_lodObjects;
+
+    // primary visibility from the rasterized buffer, only for the rays it was made with
+    bool useVisibility = m_hybridVisibility && fullFrame && (m_samplesPerPixel == 1) &&
+                         (m_camera.GetShutterOpen() == m_camera.GetShutterClose());
+    if (useVisibility) {
+        auto visibilityStart = std::chrono::steady_clock::now();
+        useVisibility = m_visibility.Rasterize(m_camera, m_primaryObjects, xSize, ySize, numThreads);
+        m_renderStats.visibilityBuffer  = useVisibility;
+        m_renderStats.visibilitySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - visibilityStart).count();
+    }
+
+    // indirect light is cached per frame, in cells of about 1/IRRADIANCE_CELLS_ACROSS of the scene
+    if ((m_indirectSamples > 0) && m_irradianceCaching) {
+        waRT::AABB sceneBox;
+        for (const auto &object : m_objectList) {
+            waRT::AABB box;
+            if (object->GetBoundingBox(box)) {
+                sceneBox.Grow(box);
+            }
+        }
+        double diagonal = 0.0;
+        if (!sceneBox.IsEmpty()) {
+            for (int i = 0; i < 3; ++i) {
+                diagonal += (sceneBox.boxMax[i] - sceneBox.boxMin[i]) * (sceneBox.boxMax[i] - sceneBox.boxMin[i]);
+            }
+            diagonal = sqrt(diagonal);
+        }
+        m_irradianceCache.Reset(waRT::IRRADIANCE_DEFAULT_RECORDS, (diagonal > 0.0) ? diagonal / IRRADIANCE_CELLS_ACROSS : 1.0);
+    }
+    std::atomic<uint64_t> irradianceGathers {0};
+
+    // emissive objects the path tracer samples directly, by their bounding spheres
+    m_emitters.clear();
+    if (m_integrator == waRT::INTEGRATOR_PATH) {
+        for (size_t i = 0; i < m_objectList.size(); ++i) {
+            waRT::AABB box;
+            if (m_objectList[i]->IsEmissive() && m_objectList[i]->GetBoundingBox(box)) {
+                Emitter emitter;
+                emitter.object = static_cast<int>(i);
+                emitter.radius = 0.0;
+                for (int k = 0; k < 3; ++k) {
+                    double halfSize = 0.5 * (box.boxMax[k] - box.boxMin[k]);
+                    emitter.centre[k] = box.Centroid(k);
+                    emitter.radius   += halfSize * halfSize;
+                }
+                emitter.radius = sqrt(emitter.radius);
+                m_emitters.push_back(emitter);
+            }
+        }
+    }
+
+    // caustic photons are sent again for every frame and pass, so passes average independent maps
+    if (m_causticPhotons > 0) {
+        EmitPhotons(firstSample, numThreads);
+    }
+    waRT::ShadowStats shadowsBefore;
+    for (const auto &currentLight : m_lightList) {
+        waRT::ShadowStats lightStats = currentLight->GetShadowStats();
+        shadowsBefore.rays      += lightStats.rays;
+        shadowsBefore.cacheHits += lightStats.cacheHits;
+        shadowsBefore.tests     += lightStats.tests;
+    }
+
+    // NUMA-aware threads are pinned node by node and trace against their node's copy of the primitives
+    waRT::Topology &topology = waRT::Topology::System();
+    int numNodes = m_numaAware ? std::max(1, std::min(topology.GetNumNodes(), numThreads)) : 1;
+    // mapped primitives are page cache pages, which cannot be copied to a node and still be shared
+    bool useReplicas = (numNodes > 1) && m_staticDispatch && !m_primitiveSet.IsMapped();
+    if (useReplicas && (!m_replicasValid || (m_nodePrimitiveSets.size() < static_cast<size_t>(numNodes)))) {
+        ReplicatePrimitives(numNodes);
+    }
+    // an image left for first touch is cleared by the threads that will render its rows
+    bool clearRows = !outputImage.IsCleared() && m_numaAware;
+    if (!outputImage.IsCleared() && !m_numaAware) {
+        outputImage.ClearRows(0, outputImage.GetYSize());
+    }
+    std::atomic<int> pinnedThreads {0};
+    std::atomic<int> threadsCleared {0};
+
     std::vector<std::thread> threads;
 
     double xFact = 1.0 / (static_cast<double>(xSize) / 2.0);
     double yFact = 1.0 / (static_cast<double>(ySize) / 2.0);
+
+    int numTilesX = (xSize + TILE_SIZE - 1) / TILE_SIZE;
+    int numTilesY = (ySize + TILE_SIZE - 1) / TILE_SIZE;
+    int numTiles  = numTilesX * numTilesY;
+
+    // a regional render visits only the tiles it touches, with one bit per covered pixel in each tile row
+    static_assert(TILE_SIZE <= 32, "tile rows are 32 bit masks");
+    // the tables only live for this frame, so they come from the calling thread's arena (the render threads have their own)
+    waRT::MemArena &frameArena = waRT::MemArena::ForThisThread();
+    frameArena.Reset();
+    std::vector<int, waRT::ArenaAllocator<int>>           regionTiles {waRT::ArenaAllocator<int>(frameArena)};
+    std::vector<uint32_t, waRT::ArenaAllocator<uint32_t>> regionMasks {waRT::ArenaAllocator<uint32_t>(frameArena)};
+    if (!fullFrame) {
+        std::vector<int, waRT::ArenaAllocator<int>> tileSlot(numTiles, -1, waRT::ArenaAllocator<int>(frameArena));
+        for (const auto &region : *regions) {
+            waRT::RenderRegion clipped = region.Clipped(xSize, ySize);
+            if (clipped.IsEmpty()) {
+                continue;
+            }
+            for (int tileY = clipped.y0 / TILE_SIZE; tileY <= (clipped.y1 - 1) / TILE_SIZE; ++tileY) {
+                for (int tileX = clipped.x0 / TILE_SIZE; tileX <= (clipped.x1 - 1) / TILE_SIZE; ++tileX) {
+                    int tile = tileY * numTilesX + tileX;
+                    if (tileSlot[tile] < 0) {
+                        tileSlot[tile] = static_cast<int>(regionTiles.size());
+                        regionTiles.push_back(tile);
+                        regionMasks.resize(regionMasks.size() + TILE_SIZE, 0);
+                    }
+                    uint32_t *rowMasks = &regionMasks[static_cast<size_t>(tileSlot[tile]) * TILE_SIZE];
+                    int bit0 = std::max(clipped.x0, tileX * TILE_SIZE) - tileX * TILE_SIZE;
+                    int bit1 = std::min(clipped.x1, (tileX + 1) * TILE_SIZE) - tileX * TILE_SIZE;
+                    uint32_t spanMask = static_cast<uint32_t>(((uint64_t(1) << bit1) - 1) & ~((uint64_t(1) << bit0) - 1));
+                    for (int y = std::max(clipped.y0, tileY * TILE_SIZE); y < std::min(clipped.y1, (tileY + 1) * TILE_SIZE); ++y) {
+                        rowMasks[y - tileY * TILE_SIZE] |= spanMask;
+                    }
+                }
+            }
+        }
+    }
+    int numWorkItems = fullFrame ? numTiles : static_cast<int>(regionTiles.size());
+
+    // work items and image rows in one contiguous range per node; a thread drains its own node's range, then helps the others
+    int imageRows = outputImage.GetYSize();
+    std::vector<int> nodeFirstItem(numNodes + 1);
+    std::vector<int> nodeFirstRow(numNodes + 1);
+    for (int node = 0; node <= numNodes; ++node) {
+        nodeFirstItem[node] = static_cast<int>((static_cast<long long>(node) * numWorkItems) / numNodes);
+        nodeFirstRow[node]  = static_cast<int>((static_cast<long long>(node) * imageRows) / numNodes);
+    }
+    std::unique_ptr<std::atomic<int>[]> nodeNextItem(new std::atomic<int>[numNodes]);
+    std::unique_ptr<std::atomic<int>[]> nodeNextRow(new std::atomic<int>[numNodes]);
+    for (int node = 0; node < numNodes; ++node) {
+        nodeNextItem[node].store(nodeFirstItem[node]);
+        nodeNextRow[node].store(nodeFirstRow[node]);
+    }
+    auto takeItem = [&](int node) {
+        for (int k = 0; k < numNodes; ++k) {
+            int from = (node + k) % numNodes;
+            if (nodeNextItem[from].load(std::memory_order_relaxed) < nodeFirstItem[from + 1]) {
+                int item = nodeNextItem[from].fetch_add(1);
+                if (item < nodeFirstItem[from + 1]) {
+                    return item;
+                }
+            }
+        }
+        return numWorkItems;
+    };
+    if (control != nullptr) {
+        control->BeginFrame(numWorkItems);
+    }
+    std::atomic<uint64_t> hotPathAllocations {0};
+    int    samplesPerPixel = m_samplesPerPixel;
+    double sampleWeight    = 1.0 / static_cast<double>(samplesPerPixel);
      
-    auto renderChunk = [&](int startX, int endX) {
+    auto renderTiles = [&](int threadIndex) {
+        // pinned before anything is allocated, so the thread's scratch is in its node's memory too
+        int node = 0;
+        if (m_numaAware) {
+            node = topology.NodeOfWorker(threadIndex, numThreads, numNodes);
+            if (waRT::Topology::PinThisThread(topology.CpuOfWorker(threadIndex, numThreads, numNodes))) {
+                pinnedThreads.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        if (clearRows) {
+            for (int y = nodeNextRow[node].fetch_add(FIRST_TOUCH_ROWS); y < nodeFirstRow[node + 1]; y = nodeNextRow[node].fetch_add(FIRST_TOUCH_ROWS)) {
+                outputImage.ClearRows(y, std::min(y + FIRST_TOUCH_ROWS, nodeFirstRow[node + 1]));
+            }
+            // stolen tiles may lie in another node's band, so every row must be cleared before any is traced
+            threadsCleared.fetch_add(1);
+            while (threadsCleared.load() < numThreads) {
+                std::this_thread::yield();
+            }
+        }
+        waRT::PrimitiveSet &primitiveSet = useReplicas ? m_nodePrimitiveSets[node] : m_primitiveSet;
+        waRT::MemArena &arena = waRT::MemArena::ForThisThread();
+        waRT::Sampler sampler(m_sampleSeed);
+        // paths draw from their own stream, so the camera's dimensions stay as they are
+        waRT::Sampler pathSampler(m_sampleSeed ^ PATH_SEED_SALT);
+        // the samples of a tile row live in the arena; this first allocation sizes its block before counting starts
+        size_t rowSamples = static_cast<size_t>(TILE_SIZE) * samplesPerPixel;
+        waRT::CameraSample *cameraSamples = arena.AllocateArray<waRT::CameraSample>(rowSamples);
+        waRT::RayBatch rayBatch;
+        m_camera.GenerateRays(cameraSamples, rowSamples, rayBatch);
+        std::vector<std::vector<waRT::PrimitiveHit>> pagedHits((m_staticDispatch && !useVisibility) ? m_pagedGeometry.size() : 0,
+                                                               std::vector<waRT::PrimitiveHit>(rowSamples));
         waRT::Ray cameraRay;
+        waRT::Ray footprintRay;
+        waRT::TextureFootprint footprint;
+        double texel[3];
         qbVector<double> tempIntPoint(3);
         qbVector<double> tempNormal(3);
         qbVector<double> tempColor(3);
-        double minDist = 1e6;
-        double maxDist = 0.0;
-
-        for (int x = startX; x < endX; x++) {
-            for (int y = 0; y < ySize; y++) {
-                double normX = (static_cast<double>(x) * xFact) - 1.0;
-                double normY = (static_cast<double>(y) * yFact) - 1.0;
-                m_camera.GenerateRay(normX, normY, cameraRay);
-                std::shared_ptr<waRT::ObjectBase> closestObject; 
-                qbVector<double> closestIntPoint{3};    
-                qbVector<double> closestNormal  {3};      
-                qbVector<double> closestColor   {3};       
-                double closestDist = 1e6;          
-                bool hitObject = false; 
-                for (auto currentObject : m_objectList) {
-                    bool validInt = currentObject->TestIntersection(cameraRay, tempIntPoint, tempNormal, tempColor);
-                    if (validInt) {
-                        hitObject = true;
-                        double dist = (tempIntPoint - cameraRay.m_point1).norm();
-                        if (dist < closestDist) {
-                            closestDist     = dist;
-                            closestIntPoint = tempIntPoint;
-                            closestNormal   = tempNormal;
-                            closestColor    = tempColor;
-                            closestObject   = currentObject;
+        qbVector<double> closestIntPoint{3};    
+        qbVector<double> closestNormal  {3};      
+        qbVector<double> closestColor   {3};       
+        qbVector<double> color{3};
+        std::shared_ptr<waRT::ObjectBase> closestObject; 
+        bool closestIsProxy = false;
+        waRT::PrimitiveHit primitiveHit;
+        double intensity;
+
+        // create every object's and light's thread-local scratch before counting starts
+        for (const auto &currentObject : m_objectList) {
+            currentObject->TestIntersection(cameraRay, tempIntPoint, tempNormal, tempColor);
+            if (currentObject->m_texture) {
+                currentObject->GetTextureFootprint(cameraRay, tempIntPoint, footprint);
+            }
+        }
+        for (const auto &currentLight : m_lightList) {
+            currentLight->ComputeIllumination(tempIntPoint, tempNormal, m_objectList, nullptr, 0.0, color, intensity);
+        }
+        if (m_staticDispatch) {
+            primitiveSet.ClosestHit(cameraRay, primitiveHit);
+        }
+        if (m_indirectSamples > 0) {
+            double upNormal[3] = {0.0, 0.0, 1.0};
+            double irradiance[3];
+            double radius;
+            GatherIrradiance(tempIntPoint, upNormal, nullptr, 0.0, 0, irradiance, radius);
+        }
+        uint64_t gathers = 0;
+
+        for (int item = takeItem(node); item < numWorkItems; item = takeItem(node)) {
+            if ((control != nullptr) && control->IsCancelled()) {
+                break;
+            }
+            int tile   = fullFrame ? item : regionTiles[item];
+            int startX = (tile % numTilesX) * TILE_SIZE;
+            int startY = (tile / numTilesX) * TILE_SIZE;
+            int endX   = std::min(startX + TILE_SIZE, xSize);
+            int endY   = std::min(startY + TILE_SIZE, ySize);
+            const uint32_t *rowMasks = fullFrame ? nullptr : &regionMasks[static_cast<size_t>(item) * TILE_SIZE];
+            uint32_t fullRowMask = static_cast<uint32_t>((uint64_t(1) << (endX - startX)) - 1);
+            int doneX0 = endX, doneY0 = endY, doneX1 = startX, doneY1 = startY;
+            uint64_t allocsBefore = waRT::GetThreadAllocationCount();
+            arena.Reset();
+            cameraSamples = arena.AllocateArray<waRT::CameraSample>(rowSamples);
+
+            for (int y = startY; y < endY; y++) {
+                uint32_t rowMask = (rowMasks != nullptr) ? rowMasks[y - startY] : fullRowMask;
+                int bit = 0;
+                while (bit < endX - startX) {
+                    // each run of covered pixels in the row is one span
+                    if (((rowMask >> bit) & 1u) == 0) {
+                        ++bit;
+                        continue;
+                    }
+                    int spanX0 = startX + bit;
+                    while ((bit < endX - startX) && (((rowMask >> bit) & 1u) != 0)) {
+                        ++bit;
+                    }
+                    int spanX1 = startX + bit;
+                    doneX0 = std::min(doneX0, spanX0);
+                    doneX1 = std::max(doneX1, spanX1);
+                    doneY0 = std::min(doneY0, y);
+                    doneY1 = std::max(doneY1, y + 1);
+
+                    // camera rays for every sample of the row in one batch
+                    size_t rowSample = 0;
+                    for (int x = spanX0; x < spanX1; x++) {
+                        for (int sample = 0; sample < samplesPerPixel; ++sample) {
+                            // one sample keeps the ray through the pixel corner, more (or a pass of many) are spread over the pixel around it
+                            waRT::CameraSample &cameraSample = cameraSamples[rowSample++];
+                            double offsetX = 0.0;
+                            double offsetY = 0.0;
+                            sampler.StartPixelSample(x, y, firstSample + static_cast<uint32_t>(sample));
+                            if ((samplesPerPixel > 1) || spreadSamples) {
+                                sampler.Get2D(offsetX, offsetY);
+                                offsetX -= 0.5;
+                                offsetY -= 0.5;
+                            }
+                            sampler.Get2D(cameraSample.lensU, cameraSample.lensV);
+                            cameraSample.time    = sampler.Get1D();
+                            cameraSample.screenX = ((static_cast<double>(x) + offsetX) * xFact) - 1.0;
+                            cameraSample.screenY = ((static_cast<double>(y) + offsetY) * yFact) - 1.0;
                         }
                     }
-                }
-                 
-                if (hitObject) {
-                    double intensity;
-                    bool validIllum = false;
-                    bool illumFound = false;
-                    qbVector<double> color{3};
-                    double red   = 0.0;
-                    double green = 0.0;
-                    double blue  = 0.0;
-                    for (auto currentLight : m_lightList) {
-                        validIllum = currentLight->ComputeIllumination(closestIntPoint, closestNormal, m_objectList, nullptr, color, intensity);
-                        if (validIllum){
-						    illumFound = true;
-						    red   += color.GetElement(0) * intensity;
-						    green += color.GetElement(1) * intensity;
-						    blue  += color.GetElement(2) * intensity;
-					    }
+                    m_camera.GenerateRays(cameraSamples, rowSample, rayBatch);
+                    for (size_t paged = 0; paged < pagedHits.size(); ++paged) {
+                        m_pagedGeometry[paged]->IntersectBatch(rayBatch, rowSample, pagedHits[paged]);
                     }
-                    if (illumFound) {
-                        red   *= closestColor.GetElement(0);
-                        green *= closestColor.GetElement(1);
-                        blue  *= closestColor.GetElement(2);
-                        outputImage.SetPixel(x, y, red, green, blue);
+
+                    rowSample = 0;
+                    for (int x = spanX0; x < spanX1; x++) {
+                        double red   = 0.0;
+                        double green = 0.0;
+                        double blue  = 0.0;
+                        double albedo[3] = {0.0, 0.0, 0.0};
+                        for (int sample = 0; sample < samplesPerPixel; ++sample, ++rowSample) {
+                            rayBatch.GetRay(rowSample, cameraRay);
+                            bool rayValid = (rayBatch.valid[rowSample] != 0);
+                            double normX = cameraSamples[rowSample].screenX;
+                            double normY = cameraSamples[rowSample].screenY;
+                            double closestDist = 1e6;          
+                            bool hitObject = false; 
+                            if (useVisibility) {
+                                // the buffer names the closest object, only it is intersected again for the hit details
+                                int visibleIndex = m_visibility.GetObjectIndex(x, y);
+                                if (rayValid && (visibleIndex >= 0)) {
+                                    const auto &visibleObject = m_primaryObjects[visibleIndex];
+                                    hitObject = visibleObject->TestIntersection(cameraRay, closestIntPoint, closestNormal, closestColor);
+                                    if (hitObject) {
+                                        double distSquared = 0.0;
+                                        for (int i = 0; i < 3; ++i) {
+                                            double delta = closestIntPoint.GetElement(i) - cameraRay.m_point1.GetElement(i);
+                                            distSquared += delta * delta;
+                                        }
+                                        closestDist    = sqrt(distSquared);
+                                        closestObject  = m_objectList[m_primaryOwners[visibleIndex]];
+                                        closestIsProxy = (visibleObject != closestObject);
+                                    }
+                                }
+                            } else if (m_staticDispatch) {
+                                hitObject = rayValid && primitiveSet.ClosestHit(cameraRay, primitiveHit);
+                                if (hitObject) {
+                                    closestDist     = primitiveHit.dist;
+                                    closestIntPoint = primitiveHit.point;
+                                    closestNormal   = primitiveHit.normal;
+                                    closestColor    = primitiveHit.color;
+                                    closestObject   = m_objectList[m_primaryOwners[primitiveHit.objectIndex]];
+                                    closestIsProxy  = (m_primaryObjects[primitiveHit.objectIndex] != closestObject);
+                                }
+                                for (size_t paged = 0; paged < pagedHits.size(); ++paged) {
+                                    const waRT::PrimitiveHit &pagedHit = pagedHits[paged][rowSample];
+                                    if (rayValid && (pagedHit.objectIndex >= 0) && (pagedHit.dist < closestDist)) {
+                                        hitObject       = true;
+                                        closestDist     = pagedHit.dist;
+                                        closestIntPoint = pagedHit.point;
+                                        closestNormal   = pagedHit.normal;
+                                        closestColor    = pagedHit.color;
+                                        closestObject   = m_pagedGeometry[paged];
+                                        closestIsProxy  = false;
+                                    }
+                                }
+                            } else if (rayValid) {
+                                for (size_t primary = 0; primary < m_primaryObjects.size(); ++primary) {
+                                    const auto &currentObject = m_primaryObjects[primary];
+                                    bool validInt = currentObject->TestIntersection(cameraRay, tempIntPoint, tempNormal, tempColor);
+                                    if (validInt) {
+                                        hitObject = true;
+                                        double distSquared = 0.0;
+                                        for (int i = 0; i < 3; ++i) {
+                                            double delta = tempIntPoint.GetElement(i) - cameraRay.m_point1.GetElement(i);
+                                            distSquared += delta * delta;
+                                        }
+                                        double dist = sqrt(distSquared);
+                                        if (dist < closestDist) {
+                                            closestDist     = dist;
+                                            closestIntPoint = tempIntPoint;
+                                            closestNormal   = tempNormal;
+                                            closestColor    = tempColor;
+                                            closestObject   = m_objectList[m_primaryOwners[primary]];
+                                            closestIsProxy  = (currentObject != closestObject);
+                                        }
+                                    }
+                                }
+                            }
+
+                            if (hitObject && !closestIsProxy && closestObject->m_texture) {
+                                // only textured hits pay for the differentials
+                                m_camera.GenerateRay(normX, normY, xFact, yFact, footprintRay);
+                                footprintRay.m_time = cameraRay.m_time;
+                                if (closestObject->GetTextureFootprint(footprintRay, closestIntPoint, footprint)) {
+                                    closestObject->m_texture->Sample(footprint, texel);
+                                    for (int i = 0; i < 3; ++i) {
+                                        closestColor.SetElement(i, texel[i]);
+                                    }
+                                }
+                            }
+                            if (hitObject && (m_integrator == waRT::INTEGRATOR_PATH)) {
+                                // the path tracer does all the shading from the first hit on
+                                double radiance[3];
+                                pathSampler.StartPixelSample(x, y, firstSample + static_cast<uint32_t>(sample));
+                                TracePath(cameraRay, closestObject, closestIntPoint, closestNormal, closestColor, pathSampler, radiance);
+                                red   += radiance[0];
+                                green += radiance[1];
+                                blue  += radiance[2];
+                                for (int i = 0; i < 3; ++i) {
+                                    albedo[i] += closestColor.GetElement(i);
+                                }
+                            } else if (hitObject) {
+                                double sampleRed   = 0.0;
+                                double sampleGreen = 0.0;
+                                double sampleBlue  = 0.0;
+                                bool validIllum = false;
+                                bool illumFound = false;
+                                for (const auto &currentLight : m_lightList) {
+                                    validIllum = currentLight->ComputeIllumination(closestIntPoint, closestNormal, m_objectList, closestObject, cameraRay.m_time, color, intensity);
+                                    if (validIllum){
+                                        illumFound = true;
+                                        sampleRed   += color.GetElement(0) * intensity;
+                                        sampleGreen += color.GetElement(1) * intensity;
+                                        sampleBlue  += color.GetElement(2) * intensity;
+                                    }
+                                }
+                                if (illumFound) {
+                                    red   += sampleRed   * closestColor.GetElement(0);
+                                    green += sampleGreen * closestColor.GetElement(1);
+                                    blue  += sampleBlue  * closestColor.GetElement(2);
+                                }
+                                if (m_causticMap.GetNumPhotons() > 0) {
+                                    // focused light on the side of the surface the camera sees, reflected diffusely
+                                    double facing = 0.0;
+                                    for (int i = 0; i < 3; ++i) {
+                                        facing += closestNormal.GetElement(i) * cameraRay.m_lab.GetElement(i);
+                                    }
+                                    double viewNormal[3];
+                                    for (int i = 0; i < 3; ++i) {
+                                        viewNormal[i] = (facing > 0.0) ? -closestNormal.GetElement(i) : closestNormal.GetElement(i);
+                                    }
+                                    double caustic[3];
+                                    if (CausticIrradiance(closestIntPoint, viewNormal, caustic)) {
+                                        red   += caustic[0] * closestColor.GetElement(0) / M_PI;
+                                        green += caustic[1] * closestColor.GetElement(1) / M_PI;
+                                        blue  += caustic[2] * closestColor.GetElement(2) / M_PI;
+                                    }
+                                }
+                                if (m_indirectSamples > 0) {
+                                    // gather over the side of the surface the camera sees
+                                    double facing = 0.0;
+                                    for (int i = 0; i < 3; ++i) {
+                                        facing += closestNormal.GetElement(i) * cameraRay.m_lab.GetElement(i);
+                                    }
+                                    double shadingNormal[3];
+                                    for (int i = 0; i < 3; ++i) {
+                                        shadingNormal[i] = (facing > 0.0) ? -closestNormal.GetElement(i) : closestNormal.GetElement(i);
+                                    }
+                                    double indirect[3];
+                                    uint32_t scramble = waRT::Sampler::Hash(m_sampleSeed, static_cast<uint32_t>(x), static_cast<uint32_t>(y), firstSample + static_cast<uint32_t>(sample));
+                                    if (ComputeIndirect(closestIntPoint, shadingNormal, closestObject, cameraRay.m_time, scramble, indirect)) {
+                                        ++gathers;
+                                    }
+                                    red   += indirect[0] * closestColor.GetElement(0);
+                                    green += indirect[1] * closestColor.GetElement(1);
+                                    blue  += indirect[2] * closestColor.GetElement(2);
+                                }
+                                red   += closestObject->m_emission.GetElement(0);
+                                green += closestObject->m_emission.GetElement(1);
+                                blue  += closestObject->m_emission.GetElement(2);
+                                for (int i = 0; i < 3; ++i) {
+                                    albedo[i] += closestColor.GetElement(i);
+                                }
+                            }
+                            if (writeAOVs && (sample == 0)) {
+                                if (hitObject) {
+                                    outputImage.SetNormal(x - offsetX, y - offsetY, closestNormal.GetElement(0), closestNormal.GetElement(1), closestNormal.GetElement(2));
+                                    outputImage.SetDepth (x - offsetX, y - offsetY, closestDist);
+                                } else {
+                                    outputImage.SetNormal(x - offsetX, y - offsetY, 0.0, 0.0, 0.0);
+                                    outputImage.SetDepth (x - offsetX, y - offsetY, 0.0);
+                                }
+                            }
+                        }
+                        outputImage.SetPixel(x - offsetX, y - offsetY, red * sampleWeight, green * sampleWeight, blue * sampleWeight);
+                        if (writeAOVs) {
+                            outputImage.SetAlbedo(x - offsetX, y - offsetY, albedo[0] * sampleWeight, albedo[1] * sampleWeight, albedo[2] * sampleWeight);
+                        }
                     }
-                } 
+                }
+            }
+
+            hotPathAllocations.fetch_add(waRT::GetThreadAllocationCount() - allocsBefore, std::memory_order_relaxed);
+
+            // tone map the finished tile while it is still hot in cache
+            outputImage.ResolveTile(doneX0 - offsetX, doneY0 - offsetY, doneX1 - offsetX, doneY1 - offsetY);
+            if (control != nullptr) {
+                control->TileDone(doneX0, doneY0, doneX1, doneY1);
             }
         }
+        irradianceGathers.fetch_add(gathers, std::memory_order_relaxed);
+        for (const auto &currentLight : m_lightList) {
+            currentLight->FlushShadowStats();
+        }
     };
 
-    int chunkSize = xSize / numThreads;   
-
     for (int i = 0; i < numThreads; ++i) {
-        int startX = i * chunkSize;
-        int endX   = (i == numThreads - 1) ? xSize : (i + 1) * chunkSize;   
-        threads.emplace_back(renderChunk, startX, endX);   
+        threads.emplace_back(renderTiles, i);
     }
     for (auto &t : threads) { t.join();}
+
+    bool cancelled = (control != nullptr) && control->IsCancelled();
+    if (fullFrame) {
+        if (m_denoiser && writeAOVs && !cancelled) {
+            m_denoiser->Denoise(outputImage);
+            outputImage.GetToneMapper().ClearHistogram();
+            outputImage.ResolveAll();
+        }
+        outputImage.EndFrame();
+    } else {
+        // a partial frame says nothing about the whole frame's exposure
+        outputImage.GetToneMapper().ClearHistogram();
+    }
+
+    if (useCache && !cancelled) {
+        m_renderCache->Store(cacheKey, outputImage);
+    }
+
+    m_renderStats.numTiles           = numWorkItems;
+    m_renderStats.numaNodes          = numNodes;
+    m_renderStats.pinnedThreads      = pinnedThreads.load();
+    m_renderStats.hotPathAllocations = hotPathAllocations.load();
+    m_renderStats.irradianceGathers  = irradianceGathers.load();
+    for (const auto &currentLight : m_lightList) {
+        waRT::ShadowStats lightStats = currentLight->GetShadowStats();
+        m_renderStats.shadowRays      += lightStats.rays;
+        m_renderStats.shadowCacheHits += lightStats.cacheHits;
+        m_renderStats.shadowTests     += lightStats.tests;
+    }
+    m_renderStats.shadowRays      -= shadowsBefore.rays;
+    m_renderStats.shadowCacheHits -= shadowsBefore.cacheHits;
+    m_renderStats.shadowTests     -= shadowsBefore.tests;
+    m_renderStats.irradianceRecords  = ((m_indirectSamples > 0) && m_irradianceCaching) ? m_irradianceCache.GetNumRecords() : 0;
+    m_renderStats.renderSeconds      = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (m_renderStats.renderSeconds > 0.0) {
+        double numSamples = 0.0;
+        if (fullFrame) {
+            numSamples = static_cast<double>(xSize) * ySize;
+        } else {
+            for (size_t item = 0; item < regionMasks.size(); ++item) {
+                numSamples += __builtin_popcount(regionMasks[item]);
+            }
+        }
+        m_renderStats.samplesPerSecond = numSamples * samplesPerPixel / m_renderStats.renderSeconds;
+    }
+    m_renderStats.memory             = GetMemoryReport();
+    m_renderStats.memory.imageBytes  = outputImage.GetMemoryBytes();
+    return !cancelled;
+}
+
+// private funks
+
+// each copy is made by a thread pinned to its node, so the copy's memory is placed there
+void waRT::Scene::ReplicatePrimitives(int numNodes) {
+    waRT::Topology &topology = waRT::Topology::System();
+    m_nodePrimitiveSets.clear();
+    m_nodePrimitiveSets.resize(numNodes);
+    std::vector<std::thread> threads;
+    for (int node = 0; node < numNodes; ++node) {
+        threads.emplace_back([this, &topology, node]() {
+            waRT::Topology::PinThisThread(topology.GetNodeCpus(node).front());
+            m_nodePrimitiveSets[node] = m_primitiveSet;
+        });
+    }
+    for (auto &t : threads) { t.join();}
+    m_replicasValid = true;
+}
+
+// diffuse indirect light leaving the point, per unit albedo; true if it had to be gathered
+bool waRT::Scene::ComputeIndirect(const qbVector<double> &point, const double *normal, const std::shared_ptr<waRT::ObjectBase> &currentObject,
+                                  double time, uint32_t scramble, double *indirect) {
+    double position[3] = {point.GetElement(0), point.GetElement(1), point.GetElement(2)};
+    if (m_irradianceCaching && m_irradianceCache.Lookup(position, normal, indirect)) {
+        return false;
+    }
+    double radius;
+    GatherIrradiance(point, normal, currentObject, time, scramble, indirect, radius);
+    if (m_irradianceCaching) {
+        m_irradianceCache.Insert(position, normal, indirect, radius);
+    }
     return true;
 }
+
+// cosine weighted hemisphere rays, each lit by the direct light at the surface it hits
+void waRT::Scene::GatherIrradiance(const qbVector<double> &point, const double *normal, const std::shared_ptr<waRT::ObjectBase> &currentObject,
+                                   double time, uint32_t scramble, double *irradiance, double &radius) {
+    thread_local waRT::Ray gatherRay;
+    thread_local qbVector<double> bestPoint   {3};
+    thread_local qbVector<double> bestNormal  {3};
+    thread_local qbVector<double> bestColor   {3};
+    thread_local qbVector<double> lightColor  {3};
+
+    double tangent[3];
+    double bitangent[3];
+    OrthonormalBasis(normal, tangent, bitangent);
+
+    double sum[3] = {0.0, 0.0, 0.0};
+    double inverseDistSum = 0.0;
+    uint32_t scrambleV = waRT::Sampler::Hash(scramble);
+    for (int j = 0; j < m_indirectSamples; ++j) {
+        double direction[3];
+        CosineDirection(normal, tangent, bitangent, waRT::Sampler::Sobol(static_cast<uint32_t>(j), 0, scramble),
+                        waRT::Sampler::Sobol(static_cast<uint32_t>(j), 1, scrambleV), direction);
+        SetRay(gatherRay, point, direction, time);
+
+        double bestDist;
+        const std::shared_ptr<waRT::ObjectBase> *bestObject = TraceClosest(gatherRay, currentObject, bestPoint, bestNormal, bestColor, bestDist);
+        if (bestObject == nullptr) {
+            continue;
+        }
+        inverseDistSum += 1.0 / std::max(bestDist, 1e-9);
+
+        // light the side of the surface facing back along the ray
+        FaceForward(bestNormal, direction);
+        double intensity;
+        for (const auto &currentLight : m_lightList) {
+            if (currentLight->ComputeIllumination(bestPoint, bestNormal, m_objectList, *bestObject, time, lightColor, intensity)) {
+                for (int i = 0; i < 3; ++i) {
+                    sum[i] += lightColor.GetElement(i) * intensity * bestColor.GetElement(i);
+                }
+            }
+        }
+    }
+
+    // with cosine weighted directions the average of the incoming light is what a white diffuse surface sends back
+    double weight = (m_indirectSamples > 0) ? 1.0 / m_indirectSamples : 0.0;
+    for (int i = 0; i < 3; ++i) {
+        irradiance[i] = sum[i] * weight;
+    }
+    radius = (inverseDistSum > 0.0) ? m_indirectSamples / inverseDistSum : std::numeric_limits<double>::infinity();
+}
+
+// closest hit of a secondary ray over every object, skipping the surface it leaves like the shadow rays do
+const std::shared_ptr<waRT::ObjectBase> *waRT::Scene::TraceClosest(const waRT::Ray &ray, const std::shared_ptr<waRT::ObjectBase> &skipObject,
+                                                                    qbVector<double> &point, qbVector<double> &normal, qbVector<double> &color, double &dist) {
+    thread_local qbVector<double> hitPoint  {3};
+    thread_local qbVector<double> hitNormal {3};
+    thread_local qbVector<double> hitColor  {3};
+
+    const std::shared_ptr<waRT::ObjectBase> *closest = nullptr;
+    dist = 1e6;
+    for (const auto &sceneObject : m_objectList) {
+        if ((sceneObject == skipObject) && !sceneObject->IsAggregate()) {
+            continue;
+        }
+        if (!sceneObject->TestIntersection(ray, hitPoint, hitNormal, hitColor)) {
+            continue;
+        }
+        double distSquared = 0.0;
+        for (int i = 0; i < 3; ++i) {
+            double delta = hitPoint.GetElement(i) - ray.m_point1.GetElement(i);
+            distSquared += delta * delta;
+        }
+        double hitDist = sqrt(distSquared);
+        if (hitDist < dist) {
+            dist    = hitDist;
+            closest = &sceneObject;
+            point   = hitPoint;
+            normal  = hitNormal;
+            color   = hitColor;
+        }
+    }
+    return closest;
+}
+
+// one path from a camera hit: next event estimation at every vertex, cosine weighted bounces and Russian roulette
+void waRT::Scene::TracePath(const waRT::Ray &cameraRay, const std::shared_ptr<waRT::ObjectBase> &hitObject, const qbVector<double> &hitPoint,
+                            const qbVector<double> &hitNormal, const qbVector<double> &hitColor, waRT::Sampler &sampler, double *radiance) {
+    thread_local waRT::Ray pathRay;
+    thread_local waRT::Ray emitterRay;
+    thread_local qbVector<double> point       {3};
+    thread_local qbVector<double> normal      {3};
+    thread_local qbVector<double> lightNormal {3};
+    thread_local qbVector<double> albedo      {3};
+    thread_local qbVector<double> nextPoint   {3};
+    thread_local qbVector<double> nextNormal  {3};
+    thread_local qbVector<double> nextColor   {3};
+    thread_local qbVector<double> lightColor  {3};
+
+    double time = cameraRay.m_time;
+    double throughput[3] = {1.0, 1.0, 1.0};
+    double incoming[3];
+    double incomingLength = 0.0;
+    for (int i = 0; i < 3; ++i) {
+        radiance[i] = hitObject->m_emission.GetElement(i);
+        incoming[i] = cameraRay.m_lab.GetElement(i);
+        incomingLength += incoming[i] * incoming[i];
+    }
+    incomingLength = sqrt(incomingLength);
+    for (int i = 0; i < 3; ++i) {
+        incoming[i] /= incomingLength;
+    }
+    point  = hitPoint;
+    normal = hitNormal;
+    lightNormal = hitNormal;
+    albedo = hitColor;
+    FaceForward(normal, incoming);
+    const std::shared_ptr<waRT::ObjectBase> *object = &hitObject;
+
+    for (int depth = 0; ; ++depth) {
+        double n[3] = {normal.GetElement(0), normal.GetElement(1), normal.GetElement(2)};
+        double p[3] = {point.GetElement(0), point.GetElement(1), point.GetElement(2)};
+
+        // a specular surface mirrors, refracts or reflects diffusely, each picked with its own share, so no weight is needed
+        bool mirror  = false;
+        bool refract = false;
+        if ((*object)->IsSpecular()) {
+            double lobe = sampler.Get1D();
+            mirror  = (lobe < (*object)->m_reflectivity);
+            refract = !mirror && (lobe < (*object)->m_reflectivity + (*object)->m_transparency);
+        }
+        bool diffuse = !mirror && !refract;
+
+        // point lights can only be reached by next event estimation, so they need no MIS weight;
+        // they light the side the object's normal is on, as in direct shading
+        double intensity;
+        for (size_t l = 0; diffuse && (l < m_lightList.size()); ++l) {
+            if (m_lightList[l]->ComputeIllumination(point, lightNormal, m_objectList, *object, time, lightColor, intensity)) {
+                for (int i = 0; i < 3; ++i) {
+                    radiance[i] += throughput[i] * albedo.GetElement(i) * lightColor.GetElement(i) * intensity;
+                }
+            }
+        }
+
+        // point light that reached the surface through mirrors and glass, which no path can find, comes from the photon map
+        double caustic[3];
+        if (diffuse && (m_causticMap.GetNumPhotons() > 0) && CausticIrradiance(point, n, caustic)) {
+            for (int i = 0; i < 3; ++i) {
+                radiance[i] += throughput[i] * (albedo.GetElement(i) / M_PI) * caustic[i];
+            }
+        }
+
+        // emissive objects: a direction in the cone around each one's bounding sphere, MIS weighted against the bounce
+        for (size_t e = 0; diffuse && (e < m_emitters.size()); ++e) {
+            double u, v;
+            sampler.Get2D(u, v);
+            const Emitter &emitter = m_emitters[e];
+            const auto &emitterObject = m_objectList[emitter.object];
+            if (emitterObject == *object) {
+                continue;
+            }
+            double axis[3];
+            double centreDist = 0.0;
+            for (int i = 0; i < 3; ++i) {
+                axis[i]     = emitter.centre[i] - p[i];
+                centreDist += axis[i] * axis[i];
+            }
+            centreDist = sqrt(centreDist);
+            if (centreDist <= emitter.radius) {
+                continue;
+            }
+            for (int i = 0; i < 3; ++i) {
+                axis[i] /= centreDist;
+            }
+            double sinMax2  = (emitter.radius * emitter.radius) / (centreDist * centreDist);
+            double cosMax   = sqrt(std::max(0.0, 1.0 - sinMax2));
+            double cosTheta = 1.0 - u * (1.0 - cosMax);
+            double sinTheta = sqrt(std::max(0.0, 1.0 - cosTheta * cosTheta));
+            double tangent[3], bitangent[3], direction[3];
+            OrthonormalBasis(axis, tangent, bitangent);
+            for (int i = 0; i < 3; ++i) {
+                direction[i] = (tangent[i] * cos(2.0 * M_PI * v) + bitangent[i] * sin(2.0 * M_PI * v)) * sinTheta + axis[i] * cosTheta;
+            }
+            double cosSurface = direction[0] * n[0] + direction[1] * n[1] + direction[2] * n[2];
+            if (cosSurface <= 0.0) {
+                continue;
+            }
+            SetRay(emitterRay, point, direction, time);
+            double dist;
+            if (TraceClosest(emitterRay, *object, nextPoint, nextNormal, nextColor, dist) != &emitterObject) {
+                continue;
+            }
+            double lightPdf = 1.0 / (2.0 * M_PI * (1.0 - cosMax));
+            double bsdfPdf  = cosSurface / M_PI;
+            double weight   = (lightPdf * lightPdf) / (lightPdf * lightPdf + bsdfPdf * bsdfPdf);
+            for (int i = 0; i < 3; ++i) {
+                radiance[i] += throughput[i] * (albedo.GetElement(i) / M_PI) * emitterObject->m_emission.GetElement(i) * cosSurface / lightPdf * weight;
+            }
+        }
+
+        if (depth + 1 >= m_maxPathDepth) {
+            break;
+        }
+
+        // bounce: a cosine weighted direction, for which the Lambertian BSDF times cosine over pdf is the albedo,
+        // or the one specular direction, tinted by the surface color; a pdf of 0 marks the specular bounce
+        double direction[3];
+        double bsdfPdf = 0.0;
+        if (diffuse) {
+            double u, v;
+            sampler.Get2D(u, v);
+            double tangent[3], bitangent[3];
+            OrthonormalBasis(n, tangent, bitangent);
+            CosineDirection(n, tangent, bitangent, u, v, direction);
+            bsdfPdf = (direction[0] * n[0] + direction[1] * n[1] + direction[2] * n[2]) / M_PI;
+        } else if (mirror) {
+            Reflect(incoming, n, direction);
+        } else {
+            for (int i = 0; i < 3; ++i) {
+                direction[i] = incoming[i];
+            }
+            if (!RefractThrough(*object, time, point, normal, direction)) {
+                break;
+            }
+        }
+        for (int i = 0; i < 3; ++i) {
+            throughput[i] *= albedo.GetElement(i);
+        }
+        SetRay(pathRay, point, direction, time);
+        double dist;
+        const std::shared_ptr<waRT::ObjectBase> *next = TraceClosest(pathRay, *object, nextPoint, nextNormal, nextColor, dist);
+        if (next == nullptr) {
+            break;
+        }
+
+        // emission found by the bounce, weighted against having sampled it directly
+        if ((*next)->IsEmissive()) {
+            double weight = 1.0;
+            for (size_t e = 0; (bsdfPdf > 0.0) && (e < m_emitters.size()); ++e) {
+                if (m_objectList[m_emitters[e].object] == *next) {
+                    double lightPdf = EmitterConePdf(static_cast<int>(e), p, direction);
+                    weight = (bsdfPdf * bsdfPdf) / (bsdfPdf * bsdfPdf + lightPdf * lightPdf);
+                    break;
+                }
+            }
+            for (int i = 0; i < 3; ++i) {
+                radiance[i] += throughput[i] * (*next)->m_emission.GetElement(i) * weight;
+            }
+        }
+
+        point  = nextPoint;
+        normal = nextNormal;
+        lightNormal = nextNormal;
+        albedo = nextColor;
+        FaceForward(normal, direction);
+        object = next;
+        for (int i = 0; i < 3; ++i) {
+            incoming[i] = direction[i];
+        }
+
+        // Russian roulette keeps the estimate unbiased while ending paths that carry little light
+        if (depth + 1 >= PATH_ROULETTE_DEPTH) {
+            double survive = std::min(0.95, std::max(throughput[0], std::max(throughput[1], throughput[2])));
+            if ((survive <= 0.0) || (sampler.Get1D() >= survive)) {
+                break;
+            }
+            for (int i = 0; i < 3; ++i) {
+                throughput[i] /= survive;
+            }
+        }
+    }
+}
+
+// the density with which next event estimation picks this direction towards an emitter
+double waRT::Scene::EmitterConePdf(int emitter, const double *point, const double *direction) {
+    const Emitter &target = m_emitters[emitter];
+    double axis[3];
+    double centreDist = 0.0;
+    double length     = 0.0;
+    for (int i = 0; i < 3; ++i) {
+        axis[i]     = target.centre[i] - point[i];
+        centreDist += axis[i] * axis[i];
+        length     += direction[i] * direction[i];
+    }
+    centreDist = sqrt(centreDist);
+    if (centreDist <= target.radius) {
+        return 0.0;
+    }
+    double cosMax   = sqrt(std::max(0.0, 1.0 - (target.radius * target.radius) / (centreDist * centreDist)));
+    double cosAngle = (axis[0] * direction[0] + axis[1] * direction[1] + axis[2] * direction[2]) / (centreDist * sqrt(length));
+    return (cosAngle >= cosMax) ? 1.0 / (2.0 * M_PI * (1.0 - cosMax)) : 0.0;
+}
+
+// sends m_causticPhotons photons from the lights towards the specular objects and keeps those that reach a diffuse surface through them
+void waRT::Scene::EmitPhotons(uint32_t pass, int numThreads) {
+    auto startTime = std::chrono::steady_clock::now();
+    m_causticMap.Clear();
+
+    // only the bounding spheres of specular objects are aimed at, since only photons that pass them make caustics
+    struct Target {
+        double centre[3];
+        double radius;
+    };
+    struct Source {
+        double position[3];
+        double intensity[3];
+        size_t first;
+        size_t count;
+    };
+    std::vector<Target> targets;
+    waRT::AABB sceneBox;
+    for (const auto &object : m_objectList) {
+        waRT::AABB box;
+        if (!object->GetBoundingBox(box)) {
+            continue;
+        }
+        sceneBox.Grow(box);
+        if (!object->IsSpecular()) {
+            continue;
+        }
+        Target target;
+        target.radius = 0.0;
+        for (int k = 0; k < 3; ++k) {
+            double halfSize = 0.5 * (box.boxMax[k] - box.boxMin[k]);
+            target.centre[k] = box.Centroid(k);
+            target.radius   += halfSize * halfSize;
+        }
+        target.radius = sqrt(target.radius);
+        targets.push_back(target);
+    }
+    std::vector<Source> sources;
+    for (const auto &currentLight : m_lightList) {
+        Source source;
+        if (currentLight->GetPhotonSource(source.position, source.intensity)) {
+            sources.push_back(source);
+        }
+    }
+    if (targets.empty() || sources.empty()) {
+        m_renderStats.photonSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        return;
+    }
+
+    double diagonal = 0.0;
+    for (int i = 0; i < 3; ++i) {
+        diagonal += (sceneBox.boxMax[i] - sceneBox.boxMin[i]) * (sceneBox.boxMax[i] - sceneBox.boxMin[i]);
+    }
+    diagonal = sqrt(diagonal);
+    m_causticFrameRadius = (m_causticRadius > 0.0) ? m_causticRadius : ((diagonal > 0.0) ? diagonal / PHOTON_RADIUS_SHARE : 1.0);
+
+    // every light sends an equal share; photon i is the same photon for any number of threads
+    size_t total = static_cast<size_t>(m_causticPhotons);
+    for (size_t l = 0; l < sources.size(); ++l) {
+        sources[l].first = l * total / sources.size();
+        sources[l].count = (l + 1) * total / sources.size() - sources[l].first;
+    }
+    uint32_t seed = m_sampleSeed ^ PHOTON_SEED_SALT;
+    double time = m_camera.GetShutterOpen();
+    int numTargets = static_cast<int>(targets.size());
+
+    std::vector<std::vector<waRT::Photon>> threadPhotons(numThreads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; ++t) {
+        threads.emplace_back([&, t]() {
+            size_t begin = t * total / numThreads;
+            size_t end   = (t + 1) * total / numThreads;
+            for (const Source &source : sources) {
+                for (size_t index = std::max(begin, source.first); index < std::min(end, source.first + source.count); ++index) {
+                    uint32_t photonIndex = static_cast<uint32_t>(index);
+                    double pick = waRT::Sampler::Random(seed, photonIndex, pass, 0);
+                    double u    = waRT::Sampler::Random(seed, photonIndex, pass, 1);
+                    double v    = waRT::Sampler::Random(seed, photonIndex, pass, 2);
+                    const Target &aim = targets[std::min(static_cast<int>(pick * numTargets), numTargets - 1)];
+
+                    // a direction in the cone around the target, or anywhere if the light is inside its sphere
+                    double axis[3];
+                    double centreDist = 0.0;
+                    for (int i = 0; i < 3; ++i) {
+                        axis[i]     = aim.centre[i] - source.position[i];
+                        centreDist += axis[i] * axis[i];
+                    }
+                    centreDist = sqrt(centreDist);
+                    double direction[3];
+                    if (centreDist <= aim.radius) {
+                        double z = 1.0 - 2.0 * u;
+                        double r = sqrt(std::max(0.0, 1.0 - z * z));
+                        direction[0] = r * cos(2.0 * M_PI * v);
+                        direction[1] = r * sin(2.0 * M_PI * v);
+                        direction[2] = z;
+                    } else {
+                        for (int i = 0; i < 3; ++i) {
+                            axis[i] /= centreDist;
+                        }
+                        double cosMax   = sqrt(std::max(0.0, 1.0 - (aim.radius * aim.radius) / (centreDist * centreDist)));
+                        double cosTheta = 1.0 - u * (1.0 - cosMax);
+                        double sinTheta = sqrt(std::max(0.0, 1.0 - cosTheta * cosTheta));
+                        double tangent[3], bitangent[3];
+                        OrthonormalBasis(axis, tangent, bitangent);
+                        for (int i = 0; i < 3; ++i) {
+                            direction[i] = (tangent[i] * cos(2.0 * M_PI * v) + bitangent[i] * sin(2.0 * M_PI * v)) * sinTheta + axis[i] * cosTheta;
+                        }
+                    }
+
+                    // the density of the direction over all targets' cones, since the cones may overlap
+                    double pdf = 0.0;
+                    for (const Target &target : targets) {
+                        double toCentre[3];
+                        double dist   = 0.0;
+                        double cosDir = 0.0;
+                        for (int i = 0; i < 3; ++i) {
+                            toCentre[i] = target.centre[i] - source.position[i];
+                            dist       += toCentre[i] * toCentre[i];
+                            cosDir     += toCentre[i] * direction[i];
+                        }
+                        dist = sqrt(dist);
+                        if (dist <= target.radius) {
+                            pdf += 1.0 / (4.0 * M_PI);
+                            continue;
+                        }
+                        double cosMax = sqrt(std::max(0.0, 1.0 - (target.radius * target.radius) / (dist * dist)));
+                        if (cosDir / dist >= cosMax) {
+                            pdf += 1.0 / (2.0 * M_PI * (1.0 - cosMax));
+                        }
+                    }
+                    pdf /= numTargets;
+                    if (!(pdf > 0.0)) {
+                        continue;
+                    }
+                    double power[3];
+                    for (int i = 0; i < 3; ++i) {
+                        power[i] = source.intensity[i] / (source.count * pdf);
+                    }
+                    TracePhoton(source.position, direction, power, time, photonIndex, pass, threadPhotons[t]);
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) { thread.join();}
+
+    // the buffers hold consecutive photons, so joining them in thread order gives the same list for any thread count
+    std::vector<waRT::Photon> photons;
+    size_t numStored = 0;
+    for (const auto &buffer : threadPhotons) {
+        numStored += buffer.size();
+    }
+    photons.reserve(numStored);
+    for (const auto &buffer : threadPhotons) {
+        photons.insert(photons.end(), buffer.begin(), buffer.end());
+    }
+    m_causticMap.Build(photons, numThreads);
+
+    m_renderStats.causticPhotons = m_causticMap.GetNumPhotons();
+    m_renderStats.photonSeconds  = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+// follows one photon through mirrors and glass; it is stored where it first reaches a diffuse surface after at least one of them
+void waRT::Scene::TracePhoton(const double *origin, const double *direction, const double *power, double time, uint32_t photonIndex,
+                              uint32_t pass, std::vector<waRT::Photon> &photons) {
+    thread_local waRT::Ray photonRay;
+    thread_local qbVector<double> point  {3};
+    thread_local qbVector<double> normal {3};
+    thread_local qbVector<double> color  {3};
+
+    double travel[3];
+    double flux[3];
+    for (int i = 0; i < 3; ++i) {
+        point.SetElement(i, origin[i]);
+        travel[i] = direction[i];
+        flux[i]   = power[i];
+    }
+    uint32_t seed = m_sampleSeed ^ PHOTON_SEED_SALT;
+    uint32_t dimension = 3;
+    std::shared_ptr<waRT::ObjectBase> noObject;
+    const std::shared_ptr<waRT::ObjectBase> *skip = &noObject;
+    for (int bounce = 0; bounce < PHOTON_MAX_BOUNCES; ++bounce) {
+        SetRay(photonRay, point, travel, time);
+        double dist;
+        const std::shared_ptr<waRT::ObjectBase> *hit = TraceClosest(photonRay, *skip, point, normal, color, dist);
+        if (hit == nullptr) {
+            return;
+        }
+        const std::shared_ptr<waRT::ObjectBase> &object = *hit;
+        bool mirror  = false;
+        bool refract = false;
+        if (object->IsSpecular()) {
+            double lobe = waRT::Sampler::Random(seed, photonIndex, pass, dimension++);
+            mirror  = (lobe < object->m_reflectivity);
+            refract = !mirror && (lobe < object->m_reflectivity + object->m_transparency);
+        }
+        if (!mirror && !refract) {
+            // a photon that came straight from the light is direct light, which the shading already has
+            if (bounce == 0) {
+                return;
+            }
+            // lights here do not fall off with distance and fade linearly with the angle of incidence, so the photon gets back
+            // the 1 / r^2 its density carries, its cosine is swapped for that fade, and pi is added, which makes light that
+            // passes glass unbent exactly as bright as the light's direct shading
+            double lightDistSquared = 0.0;
+            double cosIn  = 0.0;
+            double length = 0.0;
+            for (int i = 0; i < 3; ++i) {
+                double delta = point.GetElement(i) - origin[i];
+                lightDistSquared += delta * delta;
+                cosIn  += travel[i] * normal.GetElement(i);
+                length += normal.GetElement(i) * normal.GetElement(i);
+            }
+            cosIn = std::min(1.0, fabs(cosIn) / sqrt(length));
+            double fade  = (1.0 - acos(cosIn) / (0.5 * M_PI)) / std::max(cosIn, 1e-6);
+            double scale = M_PI * lightDistSquared * fade;
+            waRT::Photon photon;
+            for (int i = 0; i < 3; ++i) {
+                photon.position[i] = static_cast<float>(point.GetElement(i));
+                photon.power[i]    = static_cast<float>(flux[i] * scale);
+            }
+            waRT::PhotonMap::PackDirection(travel, photon.direction);
+            photon.axis = 0;
+            photons.push_back(photon);
+            return;
+        }
+        for (int i = 0; i < 3; ++i) {
+            flux[i] *= color.GetElement(i);
+        }
+        if (mirror) {
+            FaceForward(normal, travel);
+            double n[3] = {normal.GetElement(0), normal.GetElement(1), normal.GetElement(2)};
+            Reflect(travel, n, travel);
+        } else if (!RefractThrough(object, time, point, normal, travel)) {
+            return;
+        }
+        skip = hit;
+    }
+}
+
+// the caustic irradiance arriving on the side of the surface the normal is on
+bool waRT::Scene::CausticIrradiance(const qbVector<double> &point, const double *normal, double *irradiance) {
+    double position[3] = {point.GetElement(0), point.GetElement(1), point.GetElement(2)};
+    return m_causticMap.EstimateIrradiance(position, normal, m_causticNearest, m_causticFrameRadius, irradiance);
+}
@@ -1,25 +1,176 @@
 #ifndef SCENE_H
 #define SCENE_H
 
+#include <algorithm>
 #include <memory>
+#include <ostream>
+#include <string>
 #include <vector>
-#include <SDL2/SDL.h>
 #include "waImage.hpp"
 #include "camera.hpp"
+#include "denoiser.hpp"
+#include "rendercache.hpp"
+#include "rendercontrol.hpp"
+#include "renderstats.hpp"
+#include "irradiancecache.hpp"
+#include "photonmap.hpp"
+#include "sampler.hpp"
+#include "topology.hpp"
+#include "visibilitybuffer.hpp"
 #include "./primitives/objectplane.hpp"
 #include "./primitives/objectsphere.hpp"
+#include "./primitives/objectsdf.hpp"
+#include "./primitives/primitiveset.hpp"
+#include "./primitives/pagedgeometry.hpp"
 #include "./lights/pointlight.hpp"
 
 namespace waRT {
+    constexpr int TILE_SIZE = 32;
+    constexpr int PATH_DEFAULT_MAX_DEPTH = 8;
+    constexpr int PATH_ROULETTE_DEPTH    = 3;
+    constexpr int PROGRESSIVE_DEFAULT_MAX_PASSES = 256;
+
+    enum Integrator {
+        INTEGRATOR_DIRECT = 0,
+        INTEGRATOR_PATH
+    };
+
+    // a rectangle of frame pixels, x1 and y1 are exclusive
+    struct RenderRegion {
+        int x0 = 0, y0 = 0;
+        int x1 = 0, y1 = 0;
+
+        bool IsEmpty() const { return (x1 <= x0) || (y1 <= y0);}
+        int GetWidth() const { return std::max(0, x1 - x0);}
+        int GetHeight() const { return std::max(0, y1 - y0);}
+        RenderRegion Clipped(int width, int height) const {
+            return RenderRegion{std::max(x0, 0), std::max(y0, 0), std::min(x1, width), std::min(y1, height)};
+        }
+    };
+
+    // limits of RenderProgressive(); a zero time or error is no limit
+    struct RenderBudget {
+        double seconds     = 0.0;
+        double targetError = 0.0;
+        int    maxPasses   = PROGRESSIVE_DEFAULT_MAX_PASSES;
+    };
+
     class Scene {
     public:
         Scene();
-        bool Render(waImage &outputImage);
+        bool Render(waImage &outputImage, waRT::RenderControl *control = nullptr);
+        bool RenderRegions(waImage &outputImage, const std::vector<waRT::RenderRegion> &regions, waRT::RenderControl *control = nullptr);
+        bool RenderCrop(waImage &cropImage, int frameWidth, int frameHeight, const waRT::RenderRegion &region, waRT::RenderControl *control = nullptr);
+        bool RenderProgressive(waImage &outputImage, const waRT::RenderBudget &budget, waRT::RenderControl *control = nullptr);
+        void SetRenderCache(const std::shared_ptr<waRT::RenderCache> &renderCache);
+        void SetDenoiser(const std::shared_ptr<waRT::Denoiser> &denoiser);
+        void SetStaticDispatch(bool enable);
+        void SetNumThreads(int numThreads);
+        void SetSamplesPerPixel(int samplesPerPixel);
+        void SetSampleSeed(uint32_t seed);
+        int GetSamplesPerPixel();
+        uint32_t GetSampleSeed();
+        void SetCompactStorage(bool enable);
+        bool IsCompactStorage();
+        void SetAccelerationFile(const std::string &fileName);
+        std::string GetAccelerationFile();
+        void SetViewCulling(bool enable);
+        bool IsViewCulling();
+        void SetHybridVisibility(bool enable);
+        bool IsHybridVisibility();
+        void SetIndirectSamples(int numSamples);
+        int GetIndirectSamples();
+        void SetIrradianceCaching(bool enable);
+        bool IsIrradianceCaching();
+        waRT::IrradianceCache &GetIrradianceCache();
+        void SetIntegrator(waRT::Integrator integrator);
+        waRT::Integrator GetIntegrator();
+        void SetMaxPathDepth(int maxDepth);
+        int GetMaxPathDepth();
+        // photons sent from the lights each frame for caustics, 0 turns them off
+        void SetCausticPhotons(int numPhotons);
+        int GetCausticPhotons();
+        // photons per estimate and the largest radius they are gathered from, 0 for a share of the scene's size
+        void SetCausticGather(int nearest, double maxRadius);
+        waRT::PhotonMap &GetCausticMap();
+        void SetNumaAware(bool enable);
+        bool IsNumaAware();
+        void NotifyObjectsChanged();
+        void NotifyTransformsChanged();
+        void Build();
+        waRT::Camera &GetCamera();
+        std::vector<std::shared_ptr<waRT::ObjectBase>> &GetObjectList();
+        std::vector<std::shared_ptr<waRT::LightBase>> &GetLightList();
+        void Serialize(std::ostream &out);
+        std::string GetCacheKey(int xSize, int ySize);
+        waRT::RenderStats GetRenderStats();
+        waRT::MemoryReport GetMemoryReport();
     private:
+        bool RenderPixels(waImage &outputImage, int xSize, int ySize, int offsetX, int offsetY,
+                          const std::vector<waRT::RenderRegion> *regions, waRT::RenderControl *control, uint32_t firstSample = 0,
+                          bool spreadSamples = false);
+        void UpdatePrimaryView();
+        bool ComputeIndirect(const qbVector<double> &point, const double *normal, const std::shared_ptr<waRT::ObjectBase> &currentObject,
+                             double time, uint32_t scramble, double *indirect);
+        void GatherIrradiance(const qbVector<double> &point, const double *normal, const std::shared_ptr<waRT::ObjectBase> &currentObject,
+                              double time, uint32_t scramble, double *irradiance, double &radius);
+        const std::shared_ptr<waRT::ObjectBase> *TraceClosest(const waRT::Ray &ray, const std::shared_ptr<waRT::ObjectBase> &skipObject,
+                                                              qbVector<double> &point, qbVector<double> &normal, qbVector<double> &color, double &dist);
+        void TracePath(const waRT::Ray &cameraRay, const std::shared_ptr<waRT::ObjectBase> &hitObject, const qbVector<double> &hitPoint,
+                       const qbVector<double> &hitNormal, const qbVector<double> &hitColor, waRT::Sampler &sampler, double *radiance);
+        double EmitterConePdf(int emitter, const double *point, const double *direction);
+        void EmitPhotons(uint32_t pass, int numThreads);
+        void TracePhoton(const double *origin, const double *direction, const double *power, double time, uint32_t photonIndex,
+                         uint32_t pass, std::vector<waRT::Photon> &photons);
+        bool CausticIrradiance(const qbVector<double> &point, const double *normal, double *irradiance);
+        void ReplicatePrimitives(int numNodes);
     private:
         waRT::Camera m_camera;
         std::vector<std::shared_ptr<waRT::ObjectBase>> m_objectList;
         std::vector<std::shared_ptr<waRT::LightBase>> m_lightList;
+        std::shared_ptr<waRT::RenderCache> m_renderCache;
+        std::shared_ptr<waRT::Denoiser> m_denoiser;
+        waRT::RenderStats m_renderStats;
+        waRT::BuildStats  m_buildStats;
+        waRT::PrimitiveSet m_primitiveSet;
+        std::string m_accelerationFile;
+        std::vector<std::shared_ptr<waRT::PagedGeometry>> m_pagedGeometry;
+        std::vector<std::shared_ptr<waRT::ObjectBase>> m_primaryObjects;
+        std::vector<int> m_primaryOwners;
+        bool m_viewCulling   = true;
+        int  m_viewWidth     = 0;
+        int  m_viewHeight    = 0;
+        int  m_culledObjects = 0;
+        int  m_lodObjects    = 0;
+        bool m_hybridVisibility = false;
+        waRT::VisibilityBuffer m_visibility;
+        int  m_indirectSamples   = 0;
+        bool m_irradianceCaching = true;
+        waRT::IrradianceCache m_irradianceCache;
+        waRT::Integrator m_integrator = waRT::INTEGRATOR_DIRECT;
+        int m_maxPathDepth = waRT::PATH_DEFAULT_MAX_DEPTH;
+        // bounding spheres of the emissive objects, for sampling them directly
+        struct Emitter {
+            int    object;
+            double centre[3];
+            double radius;
+        };
+        std::vector<Emitter> m_emitters;
+        int    m_causticPhotons = 0;
+        int    m_causticNearest = waRT::PHOTON_DEFAULT_NEAREST;
+        double m_causticRadius  = 0.0;
+        double m_causticFrameRadius = 0.0;
+        waRT::PhotonMap m_causticMap;
+        bool m_numaAware = false;
+        // one copy of the primitive set per NUMA node, in that node's memory
+        std::vector<waRT::PrimitiveSet> m_nodePrimitiveSets;
+        bool m_replicasValid = false;
+        bool m_staticDispatch = true;
+        bool m_objectsChanged    = true;
+        bool m_transformsChanged = false;
+        int  m_numThreads     = 0;
+        int  m_samplesPerPixel = 1;
+        uint32_t m_sampleSeed  = 0;
         void renderChunk(int startX, int endX, int ySize, double xFact, double yFact, waImage &outputImage);
     };
 }
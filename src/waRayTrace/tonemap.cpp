@@ -0,0 +1,197 @@
+/*
+    The `ToneMapper` class turns the linear, unbounded radiance values produced by the renderer into display-ready 8-bit colours. It replaces the old approach of dividing every pixel by the brightest value in the frame, which needed a serial scan of the whole image before any pixel could be converted and made the exposure jump whenever the brightest pixel changed.
+
+    1. **Exposure**:
+       - `SetExposure()` sets a fixed exposure in stops (EV). Every pixel is multiplied by `2^exposure` before the tone curve is applied.
+       - With `SetAutoExposure(true)` the exposure is instead driven by a running luminance histogram. Each finished tile contributes its own histogram through `AddToHistogram()`, and `EndFrame()` computes the average log luminance of the middle of the distribution, converts it into the exposure that maps it to middle grey (0.18), and moves the adapted exposure towards that value at `m_adaptationRate`. The current frame is always mapped with the exposure adapted from previous frames, so no full-frame pass is needed and the exposure changes smoothly.
+       - Pixels with (almost) zero luminance, such as background misses, fall into the first histogram bin and are ignored by the metering.
+       - `ClearHistogram()` throws away what the tiles of the current frame have merged so far. It is used when a finished frame is changed afterwards (e.g. denoised) and resolved a second time, so it is not metered twice.
+
+    2. **Tone Curves (`SetOperator`)**:
+       - `TMO_LINEAR`: the exposed value is simply clamped to [0, 1].
+       - `TMO_REINHARD`: the luminance-based Reinhard operator `L / (1 + L)`, which keeps hue and saturation and never clips.
+       - `TMO_ACES`: the Narkowicz fit of the ACES filmic curve, which has a pleasing toe and shoulder.
+
+    3. **Display Encoding**:
+       - The tone-mapped value is finally encoded with the sRGB transfer function using a pre-computed lookup table (`m_srgbTable`), which avoids calling `pow()` for every channel of every pixel.
+
+    4. **Per-Tile Operation (`MapSpan`)**:
+       - `MapSpan()` is const and only reads the exposure for the current frame, so any number of render threads can map their tiles concurrently. The per-tile histogram is accumulated into a caller-owned array and merged with relaxed atomic adds once per tile, keeping contention negligible.
+*/
+
+#include "tonemap.hpp"
+#include <algorithm>
+#include <cmath>
+
+constexpr int SRGB_TABLE_SIZE = 4096;
+
+waRT::ToneMapper::ToneMapper() {
+    m_operator       = waRT::TMO_ACES;
+    m_exposure       = 0.0;
+    m_autoExposure   = false;
+    m_adaptationRate = 0.25;
+    m_adaptedEV      = 0.0;
+    m_hasAdapted     = false;
+    m_frameScale     = 1.0f;
+    for (auto &bin : m_histogram) {
+        bin.store(0, std::memory_order_relaxed);
+    }
+
+    m_srgbTable.resize(SRGB_TABLE_SIZE + 1);
+    for (int i = 0; i <= SRGB_TABLE_SIZE; ++i) {
+        double linear = static_cast<double>(i) / static_cast<double>(SRGB_TABLE_SIZE);
+        double encoded = (linear <= 0.0031308) ? (linear * 12.92) : (1.055 * pow(linear, 1.0 / 2.4) - 0.055);
+        m_srgbTable.at(i) = static_cast<float>(encoded);
+    }
+    UpdateFrameScale();
+}
+
+// SETTERS
+void waRT::ToneMapper::SetOperator(int newOperator)     { m_operator = newOperator;}
+void waRT::ToneMapper::SetExposure(double newExposure)  { m_exposure = newExposure; UpdateFrameScale();}
+void waRT::ToneMapper::SetAutoExposure(bool enable)     { m_autoExposure = enable; UpdateFrameScale();}
+void waRT::ToneMapper::SetAdaptationRate(double newRate){ m_adaptationRate = std::clamp(newRate, 0.0, 1.0);}
+
+// GETTERS
+int    waRT::ToneMapper::GetOperator()     { return m_operator;}
+double waRT::ToneMapper::GetExposure()     { return m_exposure;}
+bool   waRT::ToneMapper::GetAutoExposure() { return m_autoExposure;}
+double waRT::ToneMapper::GetFrameScale()   { return m_frameScale;}
+
+void waRT::ToneMapper::MapSpan(const float *linearRGB, int numPixels, float *displayRGB, uint32_t *tileHistogram) const {
+    const double binScale = static_cast<double>(HISTOGRAM_BINS - 1) / (HISTOGRAM_MAX_EV - HISTOGRAM_MIN_EV);
+
+    for (int i = 0; i < numPixels; ++i) {
+        float red   = linearRGB[i * 3 + 0];
+        float green = linearRGB[i * 3 + 1];
+        float blue  = linearRGB[i * 3 + 2];
+        float luminance = 0.2126f * red + 0.7152f * green + 0.0722f * blue;
+
+        if (tileHistogram != nullptr) {
+            int bin = 0;
+            if (luminance > 1e-6f) {
+                double ev = std::clamp(static_cast<double>(log2f(luminance)), HISTOGRAM_MIN_EV, HISTOGRAM_MAX_EV);
+                bin = 1 + static_cast<int>((ev - HISTOGRAM_MIN_EV) * binScale);
+                bin = std::min(bin, HISTOGRAM_BINS - 1);
+            }
+            ++tileHistogram[bin];
+        }
+
+        red       *= m_frameScale;
+        green     *= m_frameScale;
+        blue      *= m_frameScale;
+        luminance *= m_frameScale;
+
+        if (m_operator == waRT::TMO_REINHARD) {
+            if (luminance > 0.0f) {
+                float ratio = 1.0f / (1.0f + luminance);
+                red   *= ratio;
+                green *= ratio;
+                blue  *= ratio;
+            }
+        } else if (m_operator == waRT::TMO_ACES) {
+            red   = ApplyCurve(red);
+            green = ApplyCurve(green);
+            blue  = ApplyCurve(blue);
+        }
+
+        displayRGB[i * 3 + 0] = EncodeSRGB(red);
+        displayRGB[i * 3 + 1] = EncodeSRGB(green);
+        displayRGB[i * 3 + 2] = EncodeSRGB(blue);
+    }
+}
+
+void waRT::ToneMapper::AddToHistogram(const uint32_t *tileHistogram) {
+    for (int bin = 0; bin < HISTOGRAM_BINS; ++bin) {
+        if (tileHistogram[bin] != 0) {
+            m_histogram[bin].fetch_add(tileHistogram[bin], std::memory_order_relaxed);
+        }
+    }
+}
+
+void waRT::ToneMapper::EndFrame() {
+    uint64_t counts[HISTOGRAM_BINS];
+    uint64_t total = 0;
+    for (int bin = 0; bin < HISTOGRAM_BINS; ++bin) {
+        counts[bin] = m_histogram[bin].exchange(0, std::memory_order_relaxed);
+        if (bin > 0) {
+            total += counts[bin];
+        }
+    }
+    if (!m_autoExposure || (total == 0)) {
+        return;
+    }
+
+    // average log luminance between the 10th and 90th percentiles
+    const double binWidth = (HISTOGRAM_MAX_EV - HISTOGRAM_MIN_EV) / static_cast<double>(HISTOGRAM_BINS - 1);
+    double lowCut  = 0.1 * static_cast<double>(total);
+    double highCut = 0.9 * static_cast<double>(total);
+    double seen = 0.0;
+    double sumEV = 0.0;
+    double sumWeight = 0.0;
+    for (int bin = 1; bin < HISTOGRAM_BINS; ++bin) {
+        double binCount = static_cast<double>(counts[bin]);
+        double lower = std::max(seen, lowCut);
+        double upper = std::min(seen + binCount, highCut);
+        if (upper > lower) {
+            double binEV = HISTOGRAM_MIN_EV + (static_cast<double>(bin - 1) + 0.5) * binWidth;
+            sumEV     += binEV * (upper - lower);
+            sumWeight += upper - lower;
+        }
+        seen += binCount;
+    }
+    if (sumWeight <= 0.0) {
+        return;
+    }
+
+    double targetEV = log2(0.18) - (sumEV / sumWeight);
+    if (m_hasAdapted) {
+        m_adaptedEV += (targetEV - m_adaptedEV) * m_adaptationRate;
+    } else {
+        m_adaptedEV  = targetEV;
+        m_hasAdapted = true;
+    }
+    UpdateFrameScale();
+}
+
+// drop the tiles merged so far, for a frame that is about to be resolved again
+void waRT::ToneMapper::ClearHistogram() {
+    for (int bin = 0; bin < HISTOGRAM_BINS; ++bin) {
+        m_histogram[bin].store(0, std::memory_order_relaxed);
+    }
+}
+
+void waRT::ToneMapper::ResetAdaptation() {
+    m_adaptedEV  = 0.0;
+    m_hasAdapted = false;
+    UpdateFrameScale();
+}
+
+// private funks
+
+float waRT::ToneMapper::ApplyCurve(float value) const {
+    float numerator   = value * (2.51f * value + 0.03f);
+    float denominator = value * (2.43f * value + 0.59f) + 0.14f;
+    return numerator / denominator;
+}
+
+float waRT::ToneMapper::EncodeSRGB(float value) const {
+    if (!(value > 0.0f)) {
+        return 0.0f;
+    }
+    if (value >= 1.0f) {
+        return 1.0f;
+    }
+    float position = value * static_cast<float>(SRGB_TABLE_SIZE);
+    int index = static_cast<int>(position);
+    float fraction = position - static_cast<float>(index);
+    return m_srgbTable[index] + (m_srgbTable[index + 1] - m_srgbTable[index]) * fraction;
+}
+
+void waRT::ToneMapper::UpdateFrameScale() {
+    double ev = m_exposure;
+    if (m_autoExposure) {
+        ev += m_adaptedEV;
+    }
+    m_frameScale = static_cast<float>(pow(2.0, ev));
+}
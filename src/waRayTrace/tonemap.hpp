@@ -0,0 +1,59 @@
+#ifndef TONEMAP_H
+#define TONEMAP_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace waRT {
+    constexpr int TMO_LINEAR   = 0;
+    constexpr int TMO_REINHARD = 1;
+    constexpr int TMO_ACES     = 2;
+
+    constexpr int    HISTOGRAM_BINS    = 64;
+    constexpr double HISTOGRAM_MIN_EV  = -12.0;
+    constexpr double HISTOGRAM_MAX_EV  = 4.0;
+
+    class ToneMapper {
+    public:
+        ToneMapper();
+
+        void SetOperator(int newOperator);
+        void SetExposure(double newExposure);
+        void SetAutoExposure(bool enable);
+        void SetAdaptationRate(double newRate);
+
+        int    GetOperator();
+        double GetExposure();
+        bool   GetAutoExposure();
+        double GetFrameScale();
+
+        // map a span of linear rgb pixels into display-encoded [0, 1] rgb
+        void MapSpan(const float *linearRGB, int numPixels, float *displayRGB, uint32_t *tileHistogram) const;
+
+        // merge a finished tile's histogram, then adapt once the frame is done
+        void AddToHistogram(const uint32_t *tileHistogram);
+        void EndFrame();
+        void ClearHistogram();
+        void ResetAdaptation();
+
+    private:
+        float ApplyCurve(float value) const;
+        float EncodeSRGB(float value) const;
+        void UpdateFrameScale();
+
+    private:
+        int    m_operator;
+        double m_exposure;
+        bool   m_autoExposure;
+        double m_adaptationRate;
+        double m_adaptedEV;
+        bool   m_hasAdapted;
+        float  m_frameScale;
+
+        std::atomic<uint32_t> m_histogram[HISTOGRAM_BINS];
+        std::vector<float> m_srgbTable;
+    };
+}
+
+#endif
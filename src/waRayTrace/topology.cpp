@@ -0,0 +1,156 @@
+/*
+    The `Topology` class describes how the cpus of the machine are grouped into NUMA nodes, so the renderer can keep each thread next to the memory it works on.
+
+    1. **Detection (`System`, `Detect`)**:
+       - On Linux the nodes are read from `/sys/devices/system/node/node<N>/cpulist`, and only the cpus in the process's affinity mask (`sched_getaffinity`) are kept, so a render started under `taskset` or a container's cpuset never pins a thread outside it. Nodes left without cpus (memory-only nodes) are dropped.
+       - Anywhere else, or if nothing can be read, the machine is one node holding every allowed cpu, or `hardware_concurrency()` cpus numbered from 0.
+       - `System()` detects the topology once and shares it.
+
+    2. **Placing Workers (`NodeOfWorker`, `CpuOfWorker`)**:
+       - `numThreads` workers are split over the first `numNodes` nodes in contiguous groups of nearly equal size. Within its node, a worker takes the next cpu in turn, wrapping around if the node has fewer cpus than workers.
+
+    3. **Pinning (`PinThisThread`)**:
+       - Restricts the calling thread to one cpu with `pthread_setaffinity_np`. It returns `false` where this is not supported, and the thread then runs wherever the scheduler puts it.
+*/
+
+#include "topology.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+waRT::Topology::Topology() {
+    Detect();
+}
+
+waRT::Topology &waRT::Topology::System() {
+    static waRT::Topology topology;
+    return topology;
+}
+
+int waRT::Topology::NodeOfWorker(int index, int numThreads, int numNodes) {
+    numNodes = std::max(1, std::min(numNodes, GetNumNodes()));
+    return static_cast<int>((static_cast<long long>(index) * numNodes) / std::max(1, numThreads));
+}
+
+int waRT::Topology::CpuOfWorker(int index, int numThreads, int numNodes) {
+    numNodes = std::max(1, std::min(numNodes, GetNumNodes()));
+    int node = NodeOfWorker(index, numThreads, numNodes);
+    // the first worker of the node, the smallest index that maps to it
+    int firstWorker = static_cast<int>((static_cast<long long>(node) * numThreads + numNodes - 1) / numNodes);
+    const std::vector<int> &cpus = m_nodeCpus[node];
+    return cpus[(index - firstWorker) % cpus.size()];
+}
+
+bool waRT::Topology::PinThisThread(int cpu) {
+#ifdef __linux__
+    if ((cpu < 0) || (cpu >= CPU_SETSIZE)) {
+        return false;
+    }
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpu, &cpuSet);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+// GETTERS
+int waRT::Topology::GetNumNodes() { return static_cast<int>(m_nodeCpus.size());}
+
+int waRT::Topology::GetNumCpus() {
+    size_t numCpus = 0;
+    for (const auto &cpus : m_nodeCpus) {
+        numCpus += cpus.size();
+    }
+    return static_cast<int>(numCpus);
+}
+
+const std::vector<int> &waRT::Topology::GetNodeCpus(int node) { return m_nodeCpus.at(node);}
+
+// private funks
+
+void waRT::Topology::Detect() {
+    m_nodeCpus.clear();
+    std::vector<int> allowed;
+#ifdef __linux__
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    bool haveMask = (sched_getaffinity(0, sizeof(cpuSet), &cpuSet) == 0);
+    if (haveMask) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &cpuSet)) {
+                allowed.push_back(cpu);
+            }
+        }
+    }
+
+    std::vector<int> nodeIds;
+    DIR *nodeDir = opendir("/sys/devices/system/node");
+    if (nodeDir != nullptr) {
+        while (dirent *entry = readdir(nodeDir)) {
+            int nodeId;
+            char tail;
+            if (sscanf(entry->d_name, "node%d%c", &nodeId, &tail) == 1) {
+                nodeIds.push_back(nodeId);
+            }
+        }
+        closedir(nodeDir);
+    }
+    std::sort(nodeIds.begin(), nodeIds.end());
+    for (int nodeId : nodeIds) {
+        std::ifstream listFile("/sys/devices/system/node/node" + std::to_string(nodeId) + "/cpulist");
+        std::string text;
+        std::vector<int> cpus;
+        if (!std::getline(listFile, text) || !ParseCpuList(text, cpus)) {
+            continue;
+        }
+        if (haveMask) {
+            cpus.erase(std::remove_if(cpus.begin(), cpus.end(), [&](int cpu) { return !std::binary_search(allowed.begin(), allowed.end(), cpu);}), cpus.end());
+        }
+        if (!cpus.empty()) {
+            m_nodeCpus.push_back(cpus);
+        }
+    }
+#endif
+    if (m_nodeCpus.empty()) {
+        if (allowed.empty()) {
+            int numCpus = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+            for (int cpu = 0; cpu < numCpus; ++cpu) {
+                allowed.push_back(cpu);
+            }
+        }
+        m_nodeCpus.push_back(allowed);
+    }
+}
+
+// "0-3,8,10-11" style lists
+bool waRT::Topology::ParseCpuList(const std::string &text, std::vector<int> &cpus) {
+    std::istringstream list(text);
+    std::string range;
+    while (std::getline(list, range, ',')) {
+        int first, last;
+        char dash;
+        std::istringstream parts(range);
+        if (!(parts >> first)) {
+            continue;
+        }
+        last = first;
+        if ((parts >> dash) && (dash == '-') && !(parts >> last)) {
+            return false;
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    return !cpus.empty();
+}
@@ -0,0 +1,35 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <string>
+#include <vector>
+
+namespace waRT {
+    // the machine's NUMA nodes, each with the cpus of it this process may run on
+    class Topology {
+    public:
+        Topology();
+
+        // detected once, on first use
+        static Topology &System();
+
+        // workers are spread over the first numNodes nodes in contiguous, even groups
+        int NodeOfWorker(int index, int numThreads, int numNodes);
+        int CpuOfWorker(int index, int numThreads, int numNodes);
+        static bool PinThisThread(int cpu);
+
+        // GETTERS
+        int GetNumNodes();
+        int GetNumCpus();
+        const std::vector<int> &GetNodeCpus(int node);
+
+    private:
+        void Detect();
+        static bool ParseCpuList(const std::string &text, std::vector<int> &cpus);
+
+    private:
+        std::vector<std::vector<int>> m_nodeCpus;
+    };
+}
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef VERSION_H
+#define VERSION_H
+
+namespace waRT {
+    // bump whenever a change alters rendered pixels, so cached results are not reused
+    constexpr const char *ENGINE_VERSION = "0.2.0";
+    // bump whenever a declaration in engine.hpp changes incompatibly, so embedding hosts can check what they link against
+    constexpr int ENGINE_API_VERSION = 1;
+}
+
+#endif
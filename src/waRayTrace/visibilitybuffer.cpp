@@ -0,0 +1,275 @@
+/*
+    The `VisibilityBuffer` class finds the primary visibility of a frame up front: for every pixel, the index of the closest object along its camera ray and the distance to it. With it the render loop only has to intersect the one visible object again to get its hit point, normal and color, and ray tracing is left to shadows and everything after the first hit.
+
+    1. **Binning**:
+       - The scene has no triangles to rasterize, so each object is rasterized through its bounding box. The eight corners are projected with `Camera::ProjectPoint()`, and the pixel rectangle around them (widened by a pixel for rounding) is the set of pixels whose ray can reach the object. A box reaching behind the camera, and any object without bounds, covers the whole frame.
+       - The frame is split into tiles of `VISIBILITY_TILE_SIZE` pixels and every object is added to the bin of each tile its rectangle touches, together with the rectangle and its nearest possible distance from the camera (the distance to the box).
+       - The objects are split evenly over the threads, and each thread fills its own set of bins, so binning needs no locks.
+
+    2. **Resolving Tiles**:
+       - Threads take tiles from a shared counter. A tile gathers its entries from every thread's bins and sorts them front to back by their nearest distance.
+       - Each pixel generates exactly the ray a one sample render generates for it and walks the sorted entries. Entries whose rectangle misses the pixel are skipped without a test, and the walk stops at the first entry that starts behind the closest hit so far, so a pixel covered by a near object usually tests just that object.
+       - Hits are resolved with each object's own `TestIntersection()` and measured from the ray origin with the same rule as the object loop in `Scene::Render` (the first of equally close objects wins), so the result matches tracing the same ray against every object.
+
+    3. **Storage**:
+       - The buffer keeps a 32 bit object index and a float depth per pixel, 8 bytes in all, plus the bins. Everything is kept between frames and only grows, so rasterizing the next frame of the same size allocates nothing new.
+       - `GetNumBinEntries()` and `GetNumTests()` report how many tile entries the last frame made and how many intersection tests the tiles ran.
+
+    4. **Limits**:
+       - The rectangles only hold for a pinhole perspective camera, so `Rasterize()` returns `false` for the panoramic projections and with a lens aperture. With several samples per pixel, or an open shutter, the rays differ from the ones rasterized here and the scene traces them instead.
+*/
+
+#include "visibilitybuffer.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+// the hit point lies in its box, up to the rounding of the distances
+constexpr double VISIBILITY_DEPTH_SLACK = 1e-9;
+// the object loop in Scene::Render ignores hits past this distance
+constexpr double VISIBILITY_MAX_DIST    = 1e6;
+
+waRT::VisibilityBuffer::VisibilityBuffer() {
+    m_xSize = m_ySize = 0;
+    m_numTilesX = m_numTilesY = 0;
+    m_eye[0] = m_eye[1] = m_eye[2] = 0.0;
+    m_numBinEntries = 0;
+    m_numTests      = 0;
+}
+
+bool waRT::VisibilityBuffer::Rasterize(waRT::Camera &camera, const std::vector<std::shared_ptr<waRT::ObjectBase>> &objectList,
+                                       int xSize, int ySize, int numThreads) {
+    if ((camera.GetProjection() != waRT::PROJECTION_PERSPECTIVE) || (camera.GetAperture() > 0.0) || (xSize <= 0) || (ySize <= 0)) {
+        return false;
+    }
+    m_xSize = xSize;
+    m_ySize = ySize;
+    m_numTilesX = (xSize + VISIBILITY_TILE_SIZE - 1) / VISIBILITY_TILE_SIZE;
+    m_numTilesY = (ySize + VISIBILITY_TILE_SIZE - 1) / VISIBILITY_TILE_SIZE;
+    int numTiles = m_numTilesX * m_numTilesY;
+    qbVector<double> position = camera.GetPosition();
+    for (int i = 0; i < 3; ++i) {
+        m_eye[i] = position.GetElement(i);
+    }
+
+    size_t numPixels = static_cast<size_t>(xSize) * ySize;
+    m_objectIndex.assign(numPixels, -1);
+    m_depth.assign(numPixels, 0.0f);
+
+    numThreads = std::max(1, std::min(numThreads, numTiles));
+    m_threadBins.resize(numThreads);
+    for (auto &bins : m_threadBins) {
+        bins.resize(numTiles);
+        for (auto &bin : bins) {
+            bin.clear();
+        }
+    }
+
+    std::vector<std::thread> threads;
+    size_t numObjects = objectList.size();
+    for (int t = 0; t < numThreads; ++t) {
+        size_t first = numObjects * t / numThreads;
+        size_t last  = numObjects * (t + 1) / numThreads;
+        threads.emplace_back([&, t, first, last]() { BinObjects(camera, objectList, first, last, m_threadBins[t]);});
+    }
+    for (auto &thread : threads) { thread.join();}
+    threads.clear();
+
+    std::atomic<int> nextTile {0};
+    std::atomic<size_t> numTests {0};
+    for (int t = 0; t < numThreads; ++t) {
+        threads.emplace_back([&]() {
+            std::vector<BinEntry> candidates;
+            size_t tests = 0;
+            for (int tile = nextTile.fetch_add(1); tile < numTiles; tile = nextTile.fetch_add(1)) {
+                tests += ResolveTile(camera, objectList, tile, candidates);
+            }
+            numTests.fetch_add(tests, std::memory_order_relaxed);
+        });
+    }
+    for (auto &thread : threads) { thread.join();}
+
+    m_numBinEntries = 0;
+    for (const auto &bins : m_threadBins) {
+        for (const auto &bin : bins) {
+            m_numBinEntries += bin.size();
+        }
+    }
+    m_numTests = numTests.load();
+    return true;
+}
+
+void waRT::VisibilityBuffer::Clear() {
+    m_xSize = m_ySize = 0;
+    m_numTilesX = m_numTilesY = 0;
+    m_objectIndex.clear();
+    m_depth.clear();
+    m_threadBins.clear();
+    m_numBinEntries = 0;
+    m_numTests      = 0;
+}
+
+// GETTERS
+int waRT::VisibilityBuffer::GetXSize()            { return m_xSize;}
+int waRT::VisibilityBuffer::GetYSize()            { return m_ySize;}
+size_t waRT::VisibilityBuffer::GetNumBinEntries() { return m_numBinEntries;}
+size_t waRT::VisibilityBuffer::GetNumTests()      { return m_numTests;}
+
+size_t waRT::VisibilityBuffer::GetMemoryBytes() {
+    size_t bytes = m_objectIndex.capacity() * sizeof(int32_t) + m_depth.capacity() * sizeof(float);
+    for (const auto &bins : m_threadBins) {
+        bytes += bins.capacity() * sizeof(std::vector<BinEntry>);
+        for (const auto &bin : bins) {
+            bytes += bin.capacity() * sizeof(BinEntry);
+        }
+    }
+    return bytes;
+}
+
+// private funks
+
+// false if the box is outside the frame
+bool waRT::VisibilityBuffer::ProjectBounds(waRT::Camera &camera, const waRT::AABB &box, BinEntry &entry) {
+    double minX =  std::numeric_limits<double>::infinity(), minY =  std::numeric_limits<double>::infinity();
+    double maxX = -std::numeric_limits<double>::infinity(), maxY = -std::numeric_limits<double>::infinity();
+    bool wholeFrame = false;
+    for (int corner = 0; (corner < 8) && !wholeFrame; ++corner) {
+        double point[3];
+        for (int i = 0; i < 3; ++i) {
+            point[i] = ((corner >> i) & 1) ? box.boxMax[i] : box.boxMin[i];
+        }
+        double screenX, screenY, depth;
+        if (!camera.ProjectPoint(point, screenX, screenY, depth)) {
+            wholeFrame = true;
+            break;
+        }
+        // pixel x has its ray at screen x * (2 / xSize) - 1
+        double pixelX = (screenX + 1.0) * 0.5 * m_xSize;
+        double pixelY = (screenY + 1.0) * 0.5 * m_ySize;
+        minX = std::min(minX, pixelX);
+        maxX = std::max(maxX, pixelX);
+        minY = std::min(minY, pixelY);
+        maxY = std::max(maxY, pixelY);
+    }
+
+    if (wholeFrame) {
+        entry.x0 = 0;
+        entry.y0 = 0;
+        entry.x1 = m_xSize;
+        entry.y1 = m_ySize;
+    } else {
+        // clamp before converting, far off screen corners do not fit an int
+        entry.x0 = static_cast<int>(floor(std::max(minX, -2.0))) - 1;
+        entry.y0 = static_cast<int>(floor(std::max(minY, -2.0))) - 1;
+        entry.x1 = static_cast<int>(ceil(std::min(maxX, m_xSize + 2.0))) + 2;
+        entry.y1 = static_cast<int>(ceil(std::min(maxY, m_ySize + 2.0))) + 2;
+        entry.x0 = std::max(entry.x0, 0);
+        entry.y0 = std::max(entry.y0, 0);
+        entry.x1 = std::min(entry.x1, m_xSize);
+        entry.y1 = std::min(entry.y1, m_ySize);
+        if ((entry.x1 <= entry.x0) || (entry.y1 <= entry.y0)) {
+            return false;
+        }
+    }
+
+    double distSquared = 0.0;
+    for (int i = 0; i < 3; ++i) {
+        double outside = std::max(std::max(box.boxMin[i] - m_eye[i], m_eye[i] - box.boxMax[i]), 0.0);
+        distSquared += outside * outside;
+    }
+    entry.nearDist = sqrt(distSquared);
+    return true;
+}
+
+void waRT::VisibilityBuffer::BinObjects(waRT::Camera &camera, const std::vector<std::shared_ptr<waRT::ObjectBase>> &objectList,
+                                        size_t first, size_t last, std::vector<std::vector<BinEntry>> &bins) {
+    for (size_t i = first; i < last; ++i) {
+        BinEntry entry;
+        entry.object = static_cast<int>(i);
+        waRT::AABB box;
+        if (objectList[i]->GetBoundingBox(box)) {
+            if (!ProjectBounds(camera, box, entry)) {
+                continue;
+            }
+        } else {
+            entry.nearDist = 0.0;
+            entry.x0 = 0;
+            entry.y0 = 0;
+            entry.x1 = m_xSize;
+            entry.y1 = m_ySize;
+        }
+        for (int tileY = entry.y0 / VISIBILITY_TILE_SIZE; tileY <= (entry.y1 - 1) / VISIBILITY_TILE_SIZE; ++tileY) {
+            for (int tileX = entry.x0 / VISIBILITY_TILE_SIZE; tileX <= (entry.x1 - 1) / VISIBILITY_TILE_SIZE; ++tileX) {
+                bins[tileY * m_numTilesX + tileX].push_back(entry);
+            }
+        }
+    }
+}
+
+// returns the number of intersection tests
+size_t waRT::VisibilityBuffer::ResolveTile(waRT::Camera &camera, const std::vector<std::shared_ptr<waRT::ObjectBase>> &objectList,
+                                           int tile, std::vector<BinEntry> &candidates) {
+    candidates.clear();
+    for (const auto &bins : m_threadBins) {
+        candidates.insert(candidates.end(), bins[tile].begin(), bins[tile].end());
+    }
+    if (candidates.empty()) {
+        return 0;
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const BinEntry &a, const BinEntry &b) {
+        return (a.nearDist < b.nearDist) || ((a.nearDist == b.nearDist) && (a.object < b.object));
+    });
+
+    int startX = (tile % m_numTilesX) * VISIBILITY_TILE_SIZE;
+    int startY = (tile / m_numTilesX) * VISIBILITY_TILE_SIZE;
+    int endX   = std::min(startX + VISIBILITY_TILE_SIZE, m_xSize);
+    int endY   = std::min(startY + VISIBILITY_TILE_SIZE, m_ySize);
+    double xFact = 1.0 / (static_cast<double>(m_xSize) / 2.0);
+    double yFact = 1.0 / (static_cast<double>(m_ySize) / 2.0);
+
+    waRT::CameraSample sample;
+    waRT::Ray cameraRay;
+    qbVector<double> intPoint(3);
+    qbVector<double> localNormal(3);
+    qbVector<double> localColor(3);
+    size_t tests = 0;
+    for (int y = startY; y < endY; ++y) {
+        for (int x = startX; x < endX; ++x) {
+            // the same screen position, shutter time and lens point as a one sample render
+            sample.screenX = (static_cast<double>(x) * xFact) - 1.0;
+            sample.screenY = (static_cast<double>(y) * yFact) - 1.0;
+            camera.GenerateRay(sample, cameraRay);
+
+            int    closestObject = -1;
+            double closestDist   = VISIBILITY_MAX_DIST;
+            for (const auto &entry : candidates) {
+                if (entry.nearDist > closestDist * (1.0 + VISIBILITY_DEPTH_SLACK)) {
+                    break;
+                }
+                if ((x < entry.x0) || (x >= entry.x1) || (y < entry.y0) || (y >= entry.y1)) {
+                    continue;
+                }
+                ++tests;
+                if (!objectList[entry.object]->TestIntersection(cameraRay, intPoint, localNormal, localColor)) {
+                    continue;
+                }
+                double distSquared = 0.0;
+                for (int i = 0; i < 3; ++i) {
+                    double delta = intPoint.GetElement(i) - cameraRay.m_point1.GetElement(i);
+                    distSquared += delta * delta;
+                }
+                double dist = sqrt(distSquared);
+                if ((dist < closestDist) || ((dist == closestDist) && (closestObject >= 0) && (entry.object < closestObject))) {
+                    closestDist   = dist;
+                    closestObject = entry.object;
+                }
+            }
+            size_t pixel = static_cast<size_t>(y) * m_xSize + x;
+            m_objectIndex[pixel] = closestObject;
+            m_depth[pixel]       = (closestObject >= 0) ? static_cast<float>(closestDist) : 0.0f;
+        }
+    }
+    return tests;
+}
@@ -0,0 +1,60 @@
+#ifndef VISIBILITYBUFFER_H
+#define VISIBILITYBUFFER_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "camera.hpp"
+#include "./primitives/objectbase.hpp"
+
+namespace waRT {
+    constexpr int VISIBILITY_TILE_SIZE = 16;
+
+    // object index and depth of the closest hit along each pixel's camera ray
+    class VisibilityBuffer {
+    public:
+        VisibilityBuffer();
+
+        // needs a pinhole perspective camera, the rays are the ones one sample per pixel renders with
+        bool Rasterize(waRT::Camera &camera, const std::vector<std::shared_ptr<waRT::ObjectBase>> &objectList,
+                       int xSize, int ySize, int numThreads);
+        void Clear();
+
+        // -1 where no object is visible
+        int GetObjectIndex(int x, int y) const { return m_objectIndex[static_cast<size_t>(y) * m_xSize + x];}
+        float GetDepth(int x, int y) const { return m_depth[static_cast<size_t>(y) * m_xSize + x];}
+
+        // GETTERS
+        int GetXSize();
+        int GetYSize();
+        size_t GetNumBinEntries();
+        size_t GetNumTests();
+        size_t GetMemoryBytes();
+
+    private:
+        // an object's screen rectangle in pixels (x1, y1 exclusive) and its distance from the camera
+        struct BinEntry {
+            double nearDist;
+            int    object;
+            int    x0, y0, x1, y1;
+        };
+
+        bool ProjectBounds(waRT::Camera &camera, const waRT::AABB &box, BinEntry &entry);
+        void BinObjects(waRT::Camera &camera, const std::vector<std::shared_ptr<waRT::ObjectBase>> &objectList,
+                        size_t first, size_t last, std::vector<std::vector<BinEntry>> &bins);
+        size_t ResolveTile(waRT::Camera &camera, const std::vector<std::shared_ptr<waRT::ObjectBase>> &objectList,
+                           int tile, std::vector<BinEntry> &candidates);
+
+    private:
+        int m_xSize, m_ySize;
+        double m_eye[3];
+        int m_numTilesX, m_numTilesY;
+        std::vector<int32_t> m_objectIndex;
+        std::vector<float>   m_depth;
+        std::vector<std::vector<std::vector<BinEntry>>> m_threadBins;
+        size_t m_numBinEntries;
+        size_t m_numTests;
+    };
+}
+
+#endif
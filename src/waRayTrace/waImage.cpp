@@ -5,191 +5,536 @@
     1. **Constructor and Destructor**:
        - **Constructor (`waImage::waImage`)**:
          - Initializes the image dimensions (`m_xSize` and `m_ySize`) to zero.
-         - Sets the texture pointer (`m_pTexture`) to `NULL`, indicating that no texture has been created yet.
+         - Sets the texture pointers (`m_pTextures`) to `NULL`, indicating that no texture has been created yet.
        
        - **Destructor (`waImage::~waImage`)**:
-         - If a texture exists (`m_pTexture != NULL`), it is destroyed using `SDL_DestroyTexture()` to free up memory.
+         - Every texture that exists is destroyed using `SDL_DestroyTexture()` to free up memory.
 
     2. **Image Initialization (`waImage::Initialize`)**:
        - This method initializes the image with the specified dimensions (`xSize` and `ySize`) and binds it to the provided SDL renderer (`pRenderer`).
-       - **Color Channels**:
-         - Three 2D vectors (`m_rChannel`, `m_gChannel`, `m_bChannel`) are created to store the red, green, and blue color values for each pixel. These vectors are resized to the given image dimensions and initialized to `0.0` (black).
+       - **Color Buffers**:
+         - `m_hdrPixels` is a single row-major buffer of linear 32-bit float RGB triplets, one per pixel, initialized to `0.0` (black). Values are unbounded, so the image keeps its full dynamic range.
+         - `m_displayPixels` holds the tone-mapped `Uint32` colors that are uploaded to the texture.
+       - **First Touch**:
+         - Normally `Initialize()` clears both buffers itself. On a multi-socket machine that puts every page of them in the memory of the socket the calling thread runs on, and the render threads of the other sockets then write to it across the interconnect.
+         - With `SetFirstTouch(true)` before `Initialize()`, the buffers are allocated without being written (`UninitializedAllocator`), so no page is placed yet. Every row must then be cleared once with `ClearRows()`, from the thread that will later render it, and the operating system puts each page next to that thread. `IsCleared()` tells whether that has happened; the scene's NUMA-aware render does it for an image it gets uncleared (see `scene.cpp`), and otherwise clears the rows itself before tracing.
+         - The AOV buffers are always cleared by `EnableAOVs()`.
        - **Renderer and Texture**:
-         - The SDL renderer is stored in `m_pRenderer`, and the texture is initialized using `InitTexture()`.
+         - The SDL renderer is stored in `m_pRenderer`, and the textures are initialized using `InitTexture()`. A `NULL` renderer is allowed for headless rendering, in which case no texture is created.
+         - The whole image starts out dirty (see section 7), so the first `Display()` uploads all of it.
+       - **Caller Buffers (`AttachBuffers`)**:
+         - A host that embeds the engine can hand over its own arrays instead: `xSize * ySize * 3` linear floats and optionally `xSize * ySize` display pixels (RGBA bytes, as `ConvertColor()` packs them). The renderer then writes into them directly and nothing has to be copied out of the image afterwards. Without a display array the image keeps its own.
+         - The arrays are cleared like the image's own buffers (or left to `ClearRows()` with first touch). They stay the caller's, must hold the whole frame and must outlive the image or the next `Initialize()`. An attached image is headless, `IsAttached()` tells the two kinds apart, and `GetMemoryBytes()` does not count the caller's arrays.
 
-    3. **Setting Pixel Color (`waImage::SetPixel`)**:
-       - This function sets the color of an individual pixel at coordinates `(x, y)` using the specified red, green, and blue values.
-       - The color values are stored in the respective channels (`m_rChannel`, `m_gChannel`, `m_bChannel`) using the `at()` function for bounds checking.
+    3. **Setting and Getting Pixel Color (`waImage::SetPixel`, `waImage::GetPixel`)**:
+       - These functions write and read the linear color of an individual pixel at coordinates `(x, y)`.
+       - The values are stored in the linear buffer. These run for every sample on every render thread, so they do not check the coordinates in release builds, only `assert` them. The renderer checks a frame's pixels against the image once before it starts (see `Scene::RenderPixels`), and a caller filling pixels by hand has to stay inside `GetXSize()` x `GetYSize()`.
        
-    4. **Image Size Retrieval (`waImage::GetXSize`, `waImage::GetYSize`)**:
+    4. **Auxiliary Buffers (`waImage::EnableAOVs`)**:
+       - With `EnableAOVs(true)` the image also keeps three feature buffers for the denoiser (see `denoiser.cpp`): the surface albedo (`m_albedo`, RGB), the world space normal (`m_normal`, XYZ) and the distance from the camera to the hit (`m_depth`). They are sized in `Initialize()` like the color buffer and stay empty while AOVs are off, so plain renders pay nothing for them.
+       - The renderer fills them with `SetAlbedo()`, `SetNormal()` and `SetDepth()` next to `SetPixel()`. Pixels where the ray hits nothing keep a zero normal and a depth of `0.0`.
+       - `GetHDRBuffer()` and the `Get...Buffer()` getters give direct access to the row-major arrays for whole-image filters.
+
+    5. **Image Size Retrieval (`waImage::GetXSize`, `waImage::GetYSize`, `waImage::GetMemoryBytes`)**:
        - These getter methods return the image width (`m_xSize`) and height (`m_ySize`), respectively.
+       - `GetMemoryBytes()` returns the bytes held by the linear, display and AOV buffers.
+       - `ComputeRMSE()` is the root mean square difference of the linear colors from a reference image of the same size (-1 if the sizes differ). It measures the noise left in a sampled frame against a converged one.
 
-    5. **Displaying the Image (`waImage::Display`)**:
-       - **Pixel Buffer (`tempPixel`)**:
-         - A temporary array (`tempPixel`) is created to store the image data as a 1D array of `Uint32` values, where each `Uint32` represents the color of a pixel.
-         - The array is initialized to zero using `memset()`, ensuring the image starts off as black.
+    6. **Tone Mapping (`waImage::ResolveTile`, `waImage::EndFrame`)**:
+       - `ResolveTile()` converts one rectangle of linear pixels into display colors using the image's `ToneMapper` (see `tonemap.cpp`). The renderer calls it as soon as each tile is finished, so conversion runs in parallel on the render threads instead of in a serial pass over the whole frame. It then marks the rectangle dirty for display.
+       - While mapping, a luminance histogram of the tile is collected and merged into the tone mapper, which uses it for auto-exposure.
+       - `EndFrame()` is called once all tiles are done and lets the tone mapper adapt its exposure for the next frame. `ResolveAll()` maps the whole image in one go for callers that fill pixels by hand.
+       - `GetToneMapper()` gives access to the operator (linear, Reinhard, ACES), the exposure and the auto-exposure settings.
 
-       - **Color Conversion**:
-         - For each pixel `(x, y)`, the method converts the red, green, and blue values from the 2D color channels into a single `Uint32` value using the `ConvertColor()` function. This converted color is stored in the `tempPixel` array at the corresponding position.
+    7. **Displaying the Image (`waImage::Display`)**:
+       - **Dirty Tiles**:
+         - The image is divided into `DISPLAY_DIRTY_TILE` square tiles, each with an atomic flag holding one bit per texture. `ResolveTile()` sets every bit of the tiles it touched, from whichever render thread it runs on, and `Display()` clears the bit of the texture it updates.
+         - Only the rectangle bounding that texture's dirty tiles is uploaded, so a region render or a frame that changed in one corner copies only that part. Tiles inside the rectangle that did not change are copied along with it, the copy is cheap next to the conversion.
 
        - **Texture Update**:
-         - After processing all pixels, the `SDL_UpdateTexture()` function is called to update the SDL texture (`m_pTexture`) with the newly computed pixel colors from `tempPixel`.
+         - The textures are streaming textures. `Display()` locks the dirty rectangle of the texture once and copies the already tone-mapped rows of `m_displayPixels` straight into the locked pixels, then unlocks it, which hands the rectangle to the GPU. Nothing is allocated per frame.
+         - `Display()` alternates between the `DISPLAY_TEXTURES` textures, so the texture it locks is never the one the previous frame is still being drawn from, and the driver does not have to wait for that draw. Each texture keeps its own dirty bits, so it catches up on everything that changed since it was last shown.
+         - The pixels are still converted on the render threads into `m_displayPixels`, not into the locked texture: SDL textures may only be locked on the thread that owns the renderer, and headless images have no texture at all.
 
        - **Rendering the Texture**:
-         - The texture is rendered onto the screen using `SDL_RenderCopy()`. The `srcRect` and `bounds` are set to cover the entire image size.
+         - The texture is rendered onto the screen using `SDL_RenderCopy()`. The `srcRect` and `bounds` are set to cover the entire image size. Headless images (no renderer) skip all of this.
+
+    8. **HDR Output (`waImage::SavePFM`, `waImage::SaveEXR`)**:
+       - `SavePFM()` writes the linear float buffer as a Portable Float Map (little-endian, rows stored bottom to top as the format requires).
+       - `SaveEXR()` writes an uncompressed scanline OpenEXR file with half float `R`, `G` and `B` channels, which any compositing package can read.
+       - Both return `false` if the file cannot be written.
 
-    6. **Texture Initialization (`waImage::InitTexture`)**:
-       - This function creates an SDL texture that will be used to display the image. It handles both little-endian and big-endian systems by setting appropriate masks for red, green, blue, and alpha channels.
+    9. **Texture Initialization (`waImage::InitTexture`)**:
+       - This function creates the streaming SDL textures that will be used to display the image. It handles both little-endian and big-endian systems by picking the pixel format that matches `ConvertColor()`.
        
        - **Endianness Handling**:
-         - Depending on the system's byte order (`SDL_BYTEORDER`), the red, green, blue, and alpha masks (`rmask`, `gmask`, `bmask`, `amask`) are set accordingly.
+         - Depending on the system's byte order (`SDL_BYTEORDER`), the format is `SDL_PIXELFORMAT_RGBA8888` (big-endian) or `SDL_PIXELFORMAT_ABGR8888` (little-endian). Both put red, green, blue and alpha in memory in that order, which is what `ConvertColor()` writes, so rows can be copied into the texture unchanged.
        
        - **Texture Creation**:
-         - First, any previously created texture is destroyed using `SDL_DestroyTexture()` to avoid memory leaks.
-         - A temporary surface (`SDL_Surface`) is created using `SDL_CreateRGBSurface()` with the image dimensions (`m_xSize`, `m_ySize`) and the appropriate color masks.
-         - The surface is then converted into a texture using `SDL_CreateTextureFromSurface()`, and the surface is freed using `SDL_FreeSurface()`.
+         - First, any previously created textures are destroyed using `SDL_DestroyTexture()` to avoid memory leaks.
+         - `DISPLAY_TEXTURES` textures with the image dimensions (`m_xSize`, `m_ySize`) are created with `SDL_CreateTexture()` and `SDL_TEXTUREACCESS_STREAMING`.
 
-    7. **Color Conversion (`waImage::ConvertColor`)**:
-       - This method converts red, green, and blue values (stored as `double`s) into a single `Uint32` value for use with SDL.
+    10. **Color Conversion (`waImage::ConvertColor`)**:
+       - This method converts display-encoded red, green, and blue values in `[0, 1]` into a single `Uint32` value for use with SDL.
        
        - **Color Range**:
-         - The method clamps the red, green, and blue values to the range `[0, 255]` by casting them to `unsigned char` (8-bit per channel).
+         - The values are clamped to `[0, 1]`, scaled to `[0, 255]` and rounded to `unsigned char` (8-bit per channel).
        
        - **Endianness Handling**:
          - On big-endian systems, the red, green, and blue channels are shifted into the most significant bytes of the `Uint32` value, while alpha (transparency) is set to `255` (opaque).
          - On little-endian systems, the alpha channel is placed in the most significant byte, followed by blue, green, and red.
 
-    8. **Summary**:
+    11. **Summary**:
        - The `waImage` class encapsulates all the functionality required to manage an image in memory and render it using SDL. It handles pixel-level manipulation, texture creation, and efficient rendering.
        - The class also accounts for differences in system architecture (big-endian vs. little-endian) to ensure correct color representation on different platforms.
        - **Key Features**:
          - **Dynamic Image Resizing**: The image can be dynamically resized during initialization.
          - **Pixel Color Manipulation**: Pixels are set individually, making the class suitable for ray tracing, where each pixel is computed one by one.
-         - **SDL Integration**: The class is tightly integrated with SDL, leveraging its texture and rendering functionalities for displaying images.
+         - **SDL Integration**: The class is tightly integrated with SDL, leveraging its texture and rendering functionalities for displaying images. Built with `WART_NO_SDL` (the makefile's `NO_SDL=1`, for the engine library and the service) it does not include SDL at all: images are headless, `Display()` does nothing and the byte order comes from the compiler.
 */
 
 #include "waImage.hpp"
+#include "halffloat.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+// SDL's byte order where SDL is used, the compiler's otherwise
+#ifndef WART_NO_SDL
+#define WAIMAGE_BIG_ENDIAN (SDL_BYTEORDER == SDL_BIG_ENDIAN)
+#else
+#define WAIMAGE_BIG_ENDIAN (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#endif
+
+constexpr int RESOLVE_SPAN = 64;
+constexpr int DISPLAY_DIRTY_TILE = 64;
+constexpr uint8_t DISPLAY_ALL_DIRTY = (1 << DISPLAY_TEXTURES) - 1;
 
 waImage::waImage() {
     m_xSize = 0;
     m_ySize = 0;
-    m_pTexture = NULL;
+    m_pRenderer = NULL;
+    for (int i = 0; i < DISPLAY_TEXTURES; ++i) {
+        m_pTextures[i] = NULL;
+    }
+    m_hdr      = nullptr;
+    m_display  = nullptr;
+    m_attached = false;
+    m_nextTexture = 0;
+    m_numDirtyX = 0;
+    m_numDirtyY = 0;
+    m_hasAOVs = false;
+    m_firstTouch = false;
+    m_rowsToClear.store(0);
 }
 
 waImage::~waImage() {
-    if (m_pTexture != NULL) {
-        SDL_DestroyTexture(m_pTexture);
+#ifndef WART_NO_SDL
+    for (int i = 0; i < DISPLAY_TEXTURES; ++i) {
+        if (m_pTextures[i] != NULL) {
+            SDL_DestroyTexture(m_pTextures[i]);
+        }
     }
+#endif
 }
 
 void waImage::Initialize(const int xSize, const int ySize, SDL_Renderer *pRenderer) {
-    m_rChannel.resize(xSize, std::vector<double>(ySize, 0.0));
-    m_gChannel.resize(xSize, std::vector<double>(ySize, 0.0));
-    m_bChannel.resize(xSize, std::vector<double>(ySize, 0.0));
+    // new storage every time, so a first touch image never keeps pages placed by an earlier size
+    m_hdrPixels.clear();
+    m_hdrPixels.shrink_to_fit();
+    m_displayPixels.clear();
+    m_displayPixels.shrink_to_fit();
+    m_hdrPixels.resize(static_cast<size_t>(xSize) * ySize * 3);
+    m_displayPixels.resize(static_cast<size_t>(xSize) * ySize);
+    m_hdr       = m_hdrPixels.data();
+    m_display   = m_displayPixels.data();
+    m_attached  = false;
+    m_pRenderer = pRenderer;
+    SetupFrame(xSize, ySize);
+}
+
+// the caller's arrays become the image, it must keep them alive until the next Initialize() or AttachBuffers()
+void waImage::AttachBuffers(const int xSize, const int ySize, float *hdrPixels, uint32_t *displayPixels) {
+    m_hdrPixels.clear();
+    m_hdrPixels.shrink_to_fit();
+    m_displayPixels.clear();
+    m_displayPixels.shrink_to_fit();
+    if (displayPixels == nullptr) {
+        m_displayPixels.resize(static_cast<size_t>(xSize) * ySize);
+        displayPixels = m_displayPixels.data();
+    }
+    m_hdr       = hdrPixels;
+    m_display   = displayPixels;
+    m_attached  = true;
+    m_pRenderer = NULL;
+    SetupFrame(xSize, ySize);
+}
+
+bool waImage::IsAttached() { return m_attached;}
+
+// sizes, clears and marks the frame in whichever buffers m_hdr and m_display point at
+void waImage::SetupFrame(const int xSize, const int ySize) {
     m_xSize = xSize;
     m_ySize = ySize;
-    m_pRenderer = pRenderer;
+    m_rowsToClear.store(ySize);
+    if (!m_firstTouch) {
+        ClearRows(0, ySize);
+    }
+    m_numDirtyX = (xSize + DISPLAY_DIRTY_TILE - 1) / DISPLAY_DIRTY_TILE;
+    m_numDirtyY = (ySize + DISPLAY_DIRTY_TILE - 1) / DISPLAY_DIRTY_TILE;
+    m_dirtyTiles.reset(new std::atomic<uint8_t>[static_cast<size_t>(m_numDirtyX) * m_numDirtyY]());
+    MarkDirty(0, 0, xSize, ySize);
+    EnableAOVs(m_hasAOVs);
     InitTexture();
 }
 
 void waImage::SetPixel(const int x, const int y, const double red, const double green, const double blue) {
-    m_rChannel.at(x).at(y) = red;
-    m_gChannel.at(x).at(y) = green;
-    m_bChannel.at(x).at(y) = blue;
+    size_t index = PixelIndex(x, y) * 3;
+    m_hdr[index + 0] = static_cast<float>(red);
+    m_hdr[index + 1] = static_cast<float>(green);
+    m_hdr[index + 2] = static_cast<float>(blue);
+}
+
+void waImage::GetPixel(const int x, const int y, double &red, double &green, double &blue) {
+    size_t index = PixelIndex(x, y) * 3;
+    red   = m_hdr[index + 0];
+    green = m_hdr[index + 1];
+    blue  = m_hdr[index + 2];
+}
+
+// callers keep to the image, the renderer checks a whole frame once before tracing it
+size_t waImage::PixelIndex(const int x, const int y) {
+    assert((x >= 0) && (y >= 0) && (x < m_xSize) && (y < m_ySize));
+    return static_cast<size_t>(y) * m_xSize + x;
+}
+
+void waImage::EnableAOVs(bool enable) {
+    m_hasAOVs = enable;
+    size_t numPixels = enable ? static_cast<size_t>(m_xSize) * m_ySize : 0;
+    m_albedo.assign(numPixels * 3, 0.0f);
+    m_normal.assign(numPixels * 3, 0.0f);
+    m_depth.assign(numPixels, 0.0f);
+}
+
+void waImage::SetAlbedo(const int x, const int y, const double red, const double green, const double blue) {
+    assert(m_hasAOVs);
+    size_t index = PixelIndex(x, y) * 3;
+    m_albedo[index + 0] = static_cast<float>(red);
+    m_albedo[index + 1] = static_cast<float>(green);
+    m_albedo[index + 2] = static_cast<float>(blue);
 }
 
+void waImage::SetNormal(const int x, const int y, const double nx, const double ny, const double nz) {
+    assert(m_hasAOVs);
+    size_t index = PixelIndex(x, y) * 3;
+    m_normal[index + 0] = static_cast<float>(nx);
+    m_normal[index + 1] = static_cast<float>(ny);
+    m_normal[index + 2] = static_cast<float>(nz);
+}
+
+void waImage::SetDepth(const int x, const int y, const double depth) {
+    assert(m_hasAOVs);
+    m_depth[PixelIndex(x, y)] = static_cast<float>(depth);
+}
+
+// each row once, rows of different calls may be cleared on different threads at the same time
+void waImage::ClearRows(const int y0, const int y1) {
+    if (y1 <= y0) {
+        return;
+    }
+    uint32_t black = ConvertColor(0.0, 0.0, 0.0);
+    size_t first = static_cast<size_t>(y0) * m_xSize;
+    size_t last  = static_cast<size_t>(y1) * m_xSize;
+    std::fill(m_hdr + first * 3, m_hdr + last * 3, 0.0f);
+    std::fill(m_display + first, m_display + last, black);
+    m_rowsToClear.fetch_sub(y1 - y0, std::memory_order_release);
+}
+
+void waImage::SetFirstTouch(bool enable) { m_firstTouch = enable;}
+bool waImage::IsFirstTouch() { return m_firstTouch;}
+bool waImage::IsCleared() { return m_rowsToClear.load(std::memory_order_acquire) <= 0;}
+
+bool waImage::HasAOVs() { return m_hasAOVs;}
+float *waImage::GetHDRBuffer() { return m_hdr;}
+const uint32_t *waImage::GetDisplayBuffer() { return m_display;}
+const float *waImage::GetAlbedoBuffer() { return m_albedo.data();}
+const float *waImage::GetNormalBuffer() { return m_normal.data();}
+const float *waImage::GetDepthBuffer()  { return m_depth.data();}
+
 int waImage::GetXSize() { return m_xSize;}
 int waImage::GetYSize() { return m_ySize;}
 
+waRT::ToneMapper &waImage::GetToneMapper() { return m_toneMapper;}
+
+size_t waImage::GetMemoryBytes() {
+    return sizeof(*this) + (m_hdrPixels.capacity() + m_albedo.capacity() + m_normal.capacity() + m_depth.capacity()) * sizeof(float)
+                         + m_displayPixels.capacity() * sizeof(uint32_t) + static_cast<size_t>(m_numDirtyX) * m_numDirtyY * sizeof(std::atomic<uint8_t>);
+}
+
+double waImage::ComputeRMSE(waImage &reference) {
+    size_t numValues = static_cast<size_t>(m_xSize) * m_ySize * 3;
+    if ((reference.m_xSize != m_xSize) || (reference.m_ySize != m_ySize) || (numValues == 0)) {
+        return -1.0;
+    }
+    double sum = 0.0;
+    for (size_t i = 0; i < numValues; ++i) {
+        double delta = static_cast<double>(m_hdr[i]) - static_cast<double>(reference.m_hdr[i]);
+        sum += delta * delta;
+    }
+    return sqrt(sum / static_cast<double>(numValues));
+}
+
+// tone map one finished tile (x1 and y1 are exclusive) into the display buffer
+void waImage::ResolveTile(const int x0, const int y0, const int x1, const int y1) {
+    uint32_t tileHistogram[waRT::HISTOGRAM_BINS] = {0};
+    float displayRGB[RESOLVE_SPAN * 3];
+
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; x += RESOLVE_SPAN) {
+            int spanLength = std::min(RESOLVE_SPAN, x1 - x);
+            size_t index = static_cast<size_t>(y) * m_xSize + x;
+            m_toneMapper.MapSpan(&m_hdr[index * 3], spanLength, displayRGB, tileHistogram);
+            for (int i = 0; i < spanLength; ++i) {
+                m_display[index + i] = ConvertColor(displayRGB[i * 3], displayRGB[i * 3 + 1], displayRGB[i * 3 + 2]);
+            }
+        }
+    }
+    m_toneMapper.AddToHistogram(tileHistogram);
+    MarkDirty(x0, y0, x1, y1);
+}
+
+void waImage::ResolveAll() {
+    ResolveTile(0, 0, m_xSize, m_ySize);
+}
+
+void waImage::EndFrame() {
+    m_toneMapper.EndFrame();
+}
+
 void waImage::Display() {
-  ComputeMaxValues();
-  Uint32 *tempPixel = new Uint32[m_xSize * m_ySize];
-  memset(tempPixel, 0, m_xSize * m_ySize * sizeof(Uint32));
-
-  for (int x = 0; x < m_xSize; ++x){
-      for (int y = 0; y < m_ySize; ++y) {
-          // convert the 2 dimentional x and y coords into a linear index into tempPixel.
-          tempPixel[(y * m_xSize) + x] = ConvertColor(m_rChannel.at(x).at(y), m_gChannel.at(x).at(y), m_bChannel.at(x).at(y));
+#ifndef WART_NO_SDL
+  if ((m_pRenderer == NULL) || (m_pTextures[0] == NULL)) {
+    return;
+  }
+  int current = m_nextTexture;
+  m_nextTexture = (m_nextTexture + 1) % DISPLAY_TEXTURES;
+  SDL_Texture *pTexture = m_pTextures[current];
+  uint8_t textureBit = static_cast<uint8_t>(1 << current);
+
+  // bounding rectangle of the tiles this texture has not seen yet
+  int tileX0 = m_numDirtyX, tileY0 = m_numDirtyY, tileX1 = -1, tileY1 = -1;
+  for (int ty = 0; ty < m_numDirtyY; ++ty) {
+    for (int tx = 0; tx < m_numDirtyX; ++tx) {
+      if (m_dirtyTiles[static_cast<size_t>(ty) * m_numDirtyX + tx].fetch_and(~textureBit, std::memory_order_acquire) & textureBit) {
+        tileX0 = std::min(tileX0, tx);
+        tileY0 = std::min(tileY0, ty);
+        tileX1 = std::max(tileX1, tx);
+        tileY1 = std::max(tileY1, ty);
       }
+    }
+  }
+  if (tileX1 >= 0) {
+    SDL_Rect dirtyRect;
+    dirtyRect.x = tileX0 * DISPLAY_DIRTY_TILE;
+    dirtyRect.y = tileY0 * DISPLAY_DIRTY_TILE;
+    dirtyRect.w = std::min(m_xSize, (tileX1 + 1) * DISPLAY_DIRTY_TILE) - dirtyRect.x;
+    dirtyRect.h = std::min(m_ySize, (tileY1 + 1) * DISPLAY_DIRTY_TILE) - dirtyRect.y;
+    void *pPixels;
+    int pitch;
+    if (SDL_LockTexture(pTexture, &dirtyRect, &pPixels, &pitch) == 0) {
+      for (int row = 0; row < dirtyRect.h; ++row) {
+        memcpy(static_cast<Uint8 *>(pPixels) + static_cast<size_t>(row) * pitch,
+               &m_display[static_cast<size_t>(dirtyRect.y + row) * m_xSize + dirtyRect.x], dirtyRect.w * sizeof(uint32_t));
+      }
+      SDL_UnlockTexture(pTexture);
+    } else {
+      // try again next time this texture comes round
+      for (int ty = tileY0; ty <= tileY1; ++ty) {
+        for (int tx = tileX0; tx <= tileX1; ++tx) {
+          m_dirtyTiles[static_cast<size_t>(ty) * m_numDirtyX + tx].fetch_or(textureBit, std::memory_order_relaxed);
+        }
+      }
+    }
   }
 
-  SDL_UpdateTexture(m_pTexture, NULL, tempPixel, m_xSize * sizeof(Uint32));
-  delete[] tempPixel;
   SDL_Rect srcRect, bounds;
   srcRect.x = 0;
   srcRect.y = 0;
   srcRect.w = m_xSize;
   srcRect.h = m_ySize;
   bounds = srcRect;
-  SDL_RenderCopy(m_pRenderer, m_pTexture, &srcRect, &bounds);
+  SDL_RenderCopy(m_pRenderer, pTexture, &srcRect, &bounds);
+#endif
+}
+
+// write the linear image as a little-endian Portable Float Map
+bool waImage::SavePFM(const std::string &fileName) {
+    FILE *outFile = fopen(fileName.c_str(), "wb");
+    if (outFile == NULL) {
+        return false;
+    }
+    fprintf(outFile, "PF\n%d %d\n-1.0\n", m_xSize, m_ySize);
+    // PFM stores rows bottom to top
+    bool writeOk = true;
+    for (int y = m_ySize - 1; y >= 0; --y) {
+        size_t index = static_cast<size_t>(y) * m_xSize * 3;
+        if (fwrite(&m_hdr[index], sizeof(float), m_xSize * 3, outFile) != static_cast<size_t>(m_xSize * 3)) {
+            writeOk = false;
+            break;
+        }
+    }
+    fclose(outFile);
+    return writeOk;
+}
+
+static void AppendBytes(std::vector<unsigned char> &buffer, uint64_t value, int numBytes) {
+    for (int i = 0; i < numBytes; ++i) {
+        buffer.push_back(static_cast<unsigned char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+static void AppendFloat(std::vector<unsigned char> &buffer, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    AppendBytes(buffer, bits, 4);
+}
+
+static void AppendAttribute(std::vector<unsigned char> &buffer, const std::string &name, const std::string &type, int size) {
+    buffer.insert(buffer.end(), name.begin(), name.end());
+    buffer.push_back(0);
+    buffer.insert(buffer.end(), type.begin(), type.end());
+    buffer.push_back(0);
+    AppendBytes(buffer, static_cast<uint32_t>(size), 4);
+}
+
+// write the linear image as an uncompressed, half float, scanline OpenEXR file
+bool waImage::SaveEXR(const std::string &fileName) {
+    std::vector<unsigned char> header;
+    AppendBytes(header, 20000630, 4);
+    AppendBytes(header, 2, 4);
+
+    // channels are stored in alphabetical order
+    const char channelNames[3] = {'B', 'G', 'R'};
+    AppendAttribute(header, "channels", "chlist", 3 * 18 + 1);
+    for (char channel : channelNames) {
+        header.push_back(static_cast<unsigned char>(channel));
+        header.push_back(0);
+        AppendBytes(header, 1, 4);   // HALF
+        AppendBytes(header, 0, 4);   // pLinear + reserved
+        AppendBytes(header, 1, 4);   // xSampling
+        AppendBytes(header, 1, 4);   // ySampling
+    }
+    header.push_back(0);
+
+    AppendAttribute(header, "compression", "compression", 1);
+    header.push_back(0);
+    AppendAttribute(header, "dataWindow", "box2i", 16);
+    AppendBytes(header, 0, 4);
+    AppendBytes(header, 0, 4);
+    AppendBytes(header, static_cast<uint32_t>(m_xSize - 1), 4);
+    AppendBytes(header, static_cast<uint32_t>(m_ySize - 1), 4);
+    AppendAttribute(header, "displayWindow", "box2i", 16);
+    AppendBytes(header, 0, 4);
+    AppendBytes(header, 0, 4);
+    AppendBytes(header, static_cast<uint32_t>(m_xSize - 1), 4);
+    AppendBytes(header, static_cast<uint32_t>(m_ySize - 1), 4);
+    AppendAttribute(header, "lineOrder", "lineOrder", 1);
+    header.push_back(0);
+    AppendAttribute(header, "pixelAspectRatio", "float", 4);
+    AppendFloat(header, 1.0f);
+    AppendAttribute(header, "screenWindowCenter", "v2f", 8);
+    AppendFloat(header, 0.0f);
+    AppendFloat(header, 0.0f);
+    AppendAttribute(header, "screenWindowWidth", "float", 4);
+    AppendFloat(header, 1.0f);
+    header.push_back(0);
+
+    // one chunk per scanline: y, byte count, then each channel's row of halves
+    uint64_t lineBytes  = static_cast<uint64_t>(m_xSize) * 3 * sizeof(uint16_t);
+    uint64_t chunkBytes = 8 + lineBytes;
+    uint64_t firstChunk = header.size() + static_cast<uint64_t>(m_ySize) * 8;
+    for (int y = 0; y < m_ySize; ++y) {
+        AppendBytes(header, firstChunk + static_cast<uint64_t>(y) * chunkBytes, 8);
+    }
+
+    FILE *outFile = fopen(fileName.c_str(), "wb");
+    if (outFile == NULL) {
+        return false;
+    }
+    bool writeOk = (fwrite(header.data(), 1, header.size(), outFile) == header.size());
+
+    std::vector<unsigned char> chunk;
+    chunk.reserve(chunkBytes);
+    for (int y = 0; (y < m_ySize) && writeOk; ++y) {
+        chunk.clear();
+        AppendBytes(chunk, static_cast<uint32_t>(y), 4);
+        AppendBytes(chunk, static_cast<uint32_t>(lineBytes), 4);
+        for (int channel = 2; channel >= 0; --channel) {
+            for (int x = 0; x < m_xSize; ++x) {
+                float value = m_hdr[(static_cast<size_t>(y) * m_xSize + x) * 3 + channel];
+                AppendBytes(chunk, waRT::FloatToHalf(value), 2);
+            }
+        }
+        writeOk = (fwrite(chunk.data(), 1, chunk.size(), outFile) == chunk.size());
+    }
+    fclose(outFile);
+    return writeOk;
 }
 
 // func to initialize the texture
 void waImage::InitTexture() {
-    Uint32 rmask, gmask, bmask, amask;
-
+#ifndef WART_NO_SDL
+    // bytes in memory are red, green, blue, alpha, as ConvertColor() packs them
     #if SDL_BYTEORDER == SDL_BIG_ENDIAN
-        rmask = 0xff000000;
-        gmask = 0x00ff0000;
-        bmask = 0x0000ff00;
-        amask = 0x000000ff;
+        Uint32 pixelFormat = SDL_PIXELFORMAT_RGBA8888;
     #else
-        rmask = 0x000000ff;
-        gmask = 0x0000ff00;
-        bmask = 0x00ff0000;
-        amask = 0xff000000;
+        Uint32 pixelFormat = SDL_PIXELFORMAT_ABGR8888;
     #endif
 
-    if (m_pTexture != NULL) {
-        SDL_DestroyTexture(m_pTexture);
+    for (int i = 0; i < DISPLAY_TEXTURES; ++i) {
+        if (m_pTextures[i] != NULL) {
+            SDL_DestroyTexture(m_pTextures[i]);
+            m_pTextures[i] = NULL;
+        }
+    }
+    m_nextTexture = 0;
+    if (m_pRenderer == NULL) {
+        return;
+    }
+    for (int i = 0; i < DISPLAY_TEXTURES; ++i) {
+        m_pTextures[i] = SDL_CreateTexture(m_pRenderer, pixelFormat, SDL_TEXTUREACCESS_STREAMING, m_xSize, m_ySize);
+    }
+#endif
+}
+
+// flags every display tile the rectangle (x1 and y1 exclusive) touches as changed for all textures
+void waImage::MarkDirty(const int x0, const int y0, const int x1, const int y1) {
+    if ((x1 <= x0) || (y1 <= y0) || !m_dirtyTiles) {
+        return;
+    }
+    int tileX1 = std::min(m_numDirtyX - 1, (x1 - 1) / DISPLAY_DIRTY_TILE);
+    int tileY1 = std::min(m_numDirtyY - 1, (y1 - 1) / DISPLAY_DIRTY_TILE);
+    for (int ty = std::max(0, y0 / DISPLAY_DIRTY_TILE); ty <= tileY1; ++ty) {
+        for (int tx = std::max(0, x0 / DISPLAY_DIRTY_TILE); tx <= tileX1; ++tx) {
+            m_dirtyTiles[static_cast<size_t>(ty) * m_numDirtyX + tx].fetch_or(DISPLAY_ALL_DIRTY, std::memory_order_release);
+        }
     }
-    SDL_Surface *tempSurface = SDL_CreateRGBSurface(0, m_xSize, m_ySize, 32, rmask, gmask, bmask, amask);
-    m_pTexture = SDL_CreateTextureFromSurface(m_pRenderer, tempSurface);
-    SDL_FreeSurface(tempSurface);
 }
 
-Uint32 waImage::ConvertColor(const double red, const double green, const double blue) {
-    unsigned char r = static_cast<unsigned char>((red / m_overallMax) * 255.0);
-    unsigned char g = static_cast<unsigned char>((green / m_overallMax) * 255.0);
-    unsigned char b = static_cast<unsigned char>((blue / m_overallMax) * 255.0);
+// takes display-encoded values in [0, 1]
+uint32_t waImage::ConvertColor(const double red, const double green, const double blue) {
+    unsigned char r = static_cast<unsigned char>(std::clamp(red, 0.0, 1.0) * 255.0 + 0.5);
+    unsigned char g = static_cast<unsigned char>(std::clamp(green, 0.0, 1.0) * 255.0 + 0.5);
+    unsigned char b = static_cast<unsigned char>(std::clamp(blue, 0.0, 1.0) * 255.0 + 0.5);
 
-    #if SDL_BYTEORDER == SDL_BIG_ENDIAN
-        Uint32 pixelColor = (r << 24) + (g << 16) + (b << 8) + 255;
+    #if WAIMAGE_BIG_ENDIAN
+        uint32_t pixelColor = (r << 24) + (g << 16) + (b << 8) + 255;
     #else
-        Uint32 pixelColor = (255 << 24) + (b << 16) + (g << 8) + r;
+        uint32_t pixelColor = (255 << 24) + (b << 16) + (g << 8) + r;
     #endif
 
     return pixelColor;
 }
-
-void waImage::ComputeMaxValues() {
-	m_maxRed     = 0.0;
-	m_maxGreen   = 0.0;
-	m_maxBlue    = 0.0;
-	m_overallMax = 0.0;
-	for (int x=0; x<m_xSize; ++x) {
-		for (int y=0; y<m_ySize; ++y) {
-			double redValue		= m_rChannel.at(x).at(y);
-			double greenValue	= m_gChannel.at(x).at(y);
-			double blueValue	= m_bChannel.at(x).at(y);
-
-			if (redValue > m_maxRed)
-			  m_maxRed = redValue;
-			
-      if (greenValue > m_maxGreen)
-				m_maxGreen = greenValue;
-			
-      if (blueValue > m_maxBlue)
-				m_maxBlue = blueValue;
-			
-      if (m_maxRed > m_overallMax)
-				m_overallMax = m_maxRed;
-			
-      if (m_maxGreen > m_overallMax)
-				m_overallMax = m_maxGreen;
-			
-      if (m_maxBlue > m_overallMax)
-				m_overallMax = m_maxBlue;
-		}
-	}
-}
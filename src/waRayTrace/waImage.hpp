@@ -1,32 +1,89 @@
 #ifndef WAIMAGE_H
 #define WAIMAGE_H
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
+#ifndef WART_NO_SDL
 #include <SDL2/SDL.h>
+#else
+// headless builds only pass NULL renderers around
+struct SDL_Renderer;
+struct SDL_Texture;
+#endif
+#include "tonemap.hpp"
+#include "memarena.hpp"
+
+// streaming textures Display() alternates between, so it never locks the one the last frame drew from
+constexpr int DISPLAY_TEXTURES = 2;
 
 class waImage {
     public:
         waImage();
         ~waImage();
         void Initialize(const int xSize, const int yZixe, SDL_Renderer *pRenderer);
+        // renders straight into caller memory: xSize * ySize * 3 linear floats, and optionally xSize * ySize RGBA8 display pixels
+        void AttachBuffers(const int xSize, const int ySize, float *hdrPixels, uint32_t *displayPixels = nullptr);
+        bool IsAttached();
+        // with first touch on, Initialize() leaves the color buffers unwritten and every row must go through ClearRows()
+        void SetFirstTouch(bool enable);
+        bool IsFirstTouch();
+        void ClearRows(const int y0, const int y1);
+        bool IsCleared();
         void SetPixel(const int x, const int y, const double red, const double green, const double blue);
+        void GetPixel(const int x, const int y, double &red, double &green, double &blue);
+        void EnableAOVs(bool enable);
+        bool HasAOVs();
+        void SetAlbedo(const int x, const int y, const double red, const double green, const double blue);
+        void SetNormal(const int x, const int y, const double nx, const double ny, const double nz);
+        void SetDepth(const int x, const int y, const double depth);
+        float *GetHDRBuffer();
+        const uint32_t *GetDisplayBuffer();
+        const float *GetAlbedoBuffer();
+        const float *GetNormalBuffer();
+        const float *GetDepthBuffer();
+        void ResolveTile(const int x0, const int y0, const int x1, const int y1);
+        void ResolveAll();
+        void EndFrame();
         void Display();
+        bool SavePFM(const std::string &fileName);
+        bool SaveEXR(const std::string &fileName);
+        waRT::ToneMapper &GetToneMapper();
         int GetXSize();
         int GetYSize();
+        size_t GetMemoryBytes();
+        double ComputeRMSE(waImage &reference);
     private:
-        Uint32 ConvertColor(const double red, const double green, const double blue);
+        uint32_t ConvertColor(const double red, const double green, const double blue);
+        void SetupFrame(const int xSize, const int ySize);
+        size_t PixelIndex(const int x, const int y);
         void InitTexture();
-        void ComputeMaxValues();
+        void MarkDirty(const int x0, const int y0, const int x1, const int y1);
     private:
-        std::vector<std::vector<double>> m_rChannel;
-        std::vector<std::vector<double>> m_gChannel;
-        std::vector<std::vector<double>> m_bChannel;
+        std::vector<float, waRT::UninitializedAllocator<float>>   m_hdrPixels;
+        std::vector<uint32_t, waRT::UninitializedAllocator<uint32_t>> m_displayPixels;
+        // the buffers in use, the vectors above or the caller's
+        float              *m_hdr;
+        uint32_t           *m_display;
+        bool                m_attached;
+        std::vector<float>  m_albedo;
+        std::vector<float>  m_normal;
+        std::vector<float>  m_depth;
+        bool                m_hasAOVs;
+        bool                m_firstTouch;
+        std::atomic<int>    m_rowsToClear;
+        waRT::ToneMapper    m_toneMapper;
         int m_xSize,
             m_ySize;
-        double m_maxRed, m_maxGreen, m_maxBlue, m_overallMax;
         SDL_Renderer *m_pRenderer;
-        SDL_Texture *m_pTexture;
+        SDL_Texture *m_pTextures[DISPLAY_TEXTURES];
+        int m_nextTexture;
+        // one bit per texture for every display tile that changed since that texture was updated
+        std::unique_ptr<std::atomic<uint8_t>[]> m_dirtyTiles;
+        int m_numDirtyX,
+            m_numDirtyY;
 };
 
-#endif
\ No newline at end of file
+#endif
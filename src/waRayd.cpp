@@ -0,0 +1,66 @@
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "./waRayService/httpserver.hpp"
+#include "./waRayService/renderservice.hpp"
+
+static waRT::HttpServer *g_server = nullptr;
+
+static void OnSignal(int) {
+    if (g_server != nullptr) {
+        g_server->Stop();
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int port = 8765;
+    int maxJobs = 2;
+    std::string cacheDir;
+    long cacheMegabytes = 1024;
+    std::string accelerationDir;
+
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = (i + 1 < argc);
+        if ((strcmp(argv[i], "--port") == 0) && hasValue) {
+            port = atoi(argv[++i]);
+        } else if ((strcmp(argv[i], "--jobs") == 0) && hasValue) {
+            maxJobs = atoi(argv[++i]);
+        } else if ((strcmp(argv[i], "--cache") == 0) && hasValue) {
+            cacheDir = argv[++i];
+        } else if ((strcmp(argv[i], "--cache-size") == 0) && hasValue) {
+            cacheMegabytes = atol(argv[++i]);
+        } else if ((strcmp(argv[i], "--accel") == 0) && hasValue) {
+            accelerationDir = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--port N] [--jobs N] [--cache DIR] [--cache-size MB] [--accel DIR]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    waRT::RenderService service(maxJobs);
+    if (!cacheDir.empty()) {
+        service.SetRenderCache(std::make_shared<waRT::RenderCache>(cacheDir, static_cast<uint64_t>(cacheMegabytes) * 1024 * 1024));
+    }
+    if (!accelerationDir.empty()) {
+        service.SetAccelerationDir(accelerationDir);
+    }
+
+    waRT::HttpServer server;
+    if (!server.Listen("127.0.0.1", port)) {
+        fprintf(stderr, "waRayd: could not listen on 127.0.0.1:%d\n", port);
+        return 1;
+    }
+    g_server = &server;
+    signal(SIGINT,  OnSignal);
+    signal(SIGTERM, OnSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("waRayd listening on 127.0.0.1:%d with %d job slots\n", port, maxJobs);
+    server.Serve([&service](const waRT::HttpRequest &request) { return service.Handle(request); });
+
+    g_server = nullptr;
+    service.Shutdown();
+    return 0;
+}